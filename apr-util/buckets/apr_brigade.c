@@ -386,6 +386,145 @@ APU_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b,
     return APR_SUCCESS;
 }
 
+/* Most iovecs given to a single apr_socket_sendv() */
+#if APR_MAX_IOVEC_SIZE > 64
+#define MAX_SEND_VECS 64
+#else
+#define MAX_SEND_VECS APR_MAX_IOVEC_SIZE
+#endif
+
+/* Smaller files are read and written along with the memory buckets */
+#define MIN_SENDFILE_BYTES 256
+
+/* Deletes the first nbytes of data of the brigade, which were sent, along
+ * with any empty bucket they end with.
+ */
+static void brigade_consume(apr_bucket_brigade *b, apr_size_t nbytes)
+{
+    apr_bucket *e;
+
+    while (!APR_BRIGADE_EMPTY(b)) {
+        e = APR_BRIGADE_FIRST(b);
+        if (e->length > nbytes) {
+            if (nbytes) {
+                apr_bucket_split(e, nbytes);
+                apr_bucket_delete(e);
+            }
+            break;
+        }
+        nbytes -= e->length;
+        apr_bucket_delete(e);
+    }
+}
+
+APU_DECLARE(apr_status_t) apr_brigade_send(apr_socket_t *sock,
+                                           apr_bucket_brigade *b,
+                                           apr_int32_t flags,
+                                           apr_size_t *bytes_sent)
+{
+    int nonblock = (flags & APR_BRIGADE_SEND_NONBLOCK) != 0;
+    apr_interval_time_t timeout = 0;
+    apr_status_t rv = APR_SUCCESS;
+
+    *bytes_sent = 0;
+
+    if (nonblock) {
+        apr_socket_timeout_get(sock, &timeout);
+        if (timeout != 0) {
+            rv = apr_socket_timeout_set(sock, 0);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+        }
+    }
+
+    while (!APR_BRIGADE_EMPTY(b)) {
+        struct iovec vec[MAX_SEND_VECS];
+        apr_status_t read_rv = APR_SUCCESS;
+        apr_bucket *e, *sendfile_bucket = NULL;
+        apr_size_t nbytes = 0;
+        int nvec = 0;
+
+        /* Gather the data up to a file worth sending, or as much as fits
+         * in the iovec.
+         */
+        for (e = APR_BRIGADE_FIRST(b);
+             e != APR_BRIGADE_SENTINEL(b) && nvec < MAX_SEND_VECS;
+             e = APR_BUCKET_NEXT(e)) {
+            const char *data;
+            apr_size_t len;
+
+            if (APR_BUCKET_IS_METADATA(e)) {
+                continue;
+            }
+#if APR_HAS_SENDFILE
+            if (APR_BUCKET_IS_FILE(e) && e->length >= MIN_SENDFILE_BYTES) {
+                apr_bucket_file *f = e->data;
+
+                if (!(apr_file_flags_get(f->fd) & APR_FOPEN_BUFFERED)) {
+                    sendfile_bucket = e;
+                    break;
+                }
+            }
+#endif
+            read_rv = apr_bucket_read(e, &data, &len, APR_NONBLOCK_READ);
+            if (APR_STATUS_IS_EAGAIN(read_rv) && !nonblock && !nvec) {
+                /* Nothing else to send while waiting */
+                read_rv = apr_bucket_read(e, &data, &len, APR_BLOCK_READ);
+            }
+            if (read_rv != APR_SUCCESS) {
+                break;
+            }
+            if (len) {
+                vec[nvec].iov_base = (void *)data;
+                vec[nvec].iov_len = len;
+                nvec++;
+            }
+        }
+
+        if (sendfile_bucket) {
+#if APR_HAS_SENDFILE
+            apr_bucket_file *f = sendfile_bucket->data;
+            apr_hdtr_t hdtr;
+            apr_off_t offset = sendfile_bucket->start;
+
+            /* The memory buckets before go as headers */
+            memset(&hdtr, 0, sizeof(hdtr));
+            hdtr.headers = vec;
+            hdtr.numheaders = nvec;
+            nbytes = sendfile_bucket->length;
+            rv = apr_socket_sendfile(sock, f->fd, &hdtr, &offset, &nbytes, 0);
+#endif
+        }
+        else if (nvec) {
+            rv = apr_socket_sendv(sock, vec, nvec, &nbytes);
+        }
+        else if (read_rv == APR_SUCCESS) {
+            /* Only metadata or empty buckets left */
+            apr_brigade_cleanup(b);
+            break;
+        }
+
+        *bytes_sent += nbytes;
+        brigade_consume(b, nbytes);
+        if (rv == APR_SUCCESS && read_rv != APR_SUCCESS
+            && (!APR_STATUS_IS_EAGAIN(read_rv) || !nvec)) {
+            /* What was read before is sent, report the read error (or the
+             * lack of data without blocking).
+             */
+            rv = read_rv;
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+
+    if (nonblock && timeout != 0) {
+        apr_socket_timeout_set(sock, timeout);
+    }
+    return rv;
+}
+
 APU_DECLARE(apr_status_t) apr_brigade_vputstrs(apr_bucket_brigade *b, 
                                                apr_brigade_flush flush,
                                                void *ctx,
@@ -18,6 +18,8 @@
 
 #include "apr_buckets.h"
 #include "apr_allocator.h"
+#include "apr_atomic.h"
+#include "apr_portable.h"
 #include "apr_version.h"
 
 #define ALLOC_AMT (8192 - APR_MEMNODE_T_SIZE)
@@ -40,8 +42,36 @@ struct apr_bucket_alloc_t {
     apr_allocator_t *allocator;
     node_header_t *freelist;
     apr_memnode_t *blocks;
+    apr_uint32_t flags;
+#if APR_HAS_THREADS
+    /** With APR_BUCKET_ALLOC_XTHREAD, the thread allocating, and the nodes
+     *  freed by the others, pushed lock-free and reclaimed in a batch.
+     */
+    apr_os_thread_t owner;
+    node_header_t * volatile remote;
+#endif
 };
 
+#if APR_HAS_THREADS
+/* Takes back all the nodes freed by the other threads so far */
+static void reclaim_remote(apr_bucket_alloc_t *list)
+{
+    node_header_t *node, *next;
+
+    node = apr_atomic_xchgptr((volatile void **)&list->remote, NULL);
+    for (; node; node = next) {
+        next = node->next;
+        if (node->size == SMALL_NODE_SIZE) {
+            node->next = list->freelist;
+            list->freelist = node;
+        }
+        else {
+            apr_allocator_free(list->allocator, node->memnode);
+        }
+    }
+}
+#endif
+
 static apr_status_t alloc_cleanup(void *data)
 {
     apr_bucket_alloc_t *list = data;
@@ -55,6 +85,11 @@ static apr_status_t alloc_cleanup(void *data)
     }
 #endif
 
+#if APR_HAS_THREADS
+    if (list->remote) {
+        reclaim_remote(list);
+    }
+#endif
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -111,6 +146,10 @@ APU_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create_ex(
     list->allocator = allocator;
     list->freelist = NULL;
     list->blocks = block;
+    list->flags = 0;
+#if APR_HAS_THREADS
+    list->remote = NULL;
+#endif
     block->first_avail += APR_ALIGN_DEFAULT(sizeof(*list));
 
     return list;
@@ -122,6 +161,11 @@ APU_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list)
         apr_pool_cleanup_kill(list->pool, list, alloc_cleanup);
     }
 
+#if APR_HAS_THREADS
+    if (list->remote) {
+        reclaim_remote(list);
+    }
+#endif
     apr_allocator_free(list->allocator, list->blocks);
 
 #if APR_POOL_DEBUG
@@ -131,6 +175,27 @@ APU_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list)
 #endif
 }
 
+APU_DECLARE_NONSTD(apr_status_t) apr_bucket_alloc_flags_set(
+                                             apr_bucket_alloc_t *list,
+                                             apr_uint32_t flags)
+{
+    if (flags & ~APR_BUCKET_ALLOC_XTHREAD) {
+        return APR_EINVAL;
+    }
+#if APR_HAS_THREADS
+    if (flags & APR_BUCKET_ALLOC_XTHREAD) {
+        list->owner = apr_os_thread_current();
+    }
+    else if (list->remote) {
+        reclaim_remote(list);
+    }
+    list->flags = flags;
+    return APR_SUCCESS;
+#else
+    return flags ? APR_ENOTIMPL : APR_SUCCESS;
+#endif
+}
+
 APU_DECLARE_NONSTD(apr_size_t) apr_bucket_alloc_aligned_floor(apr_bucket_alloc_t *list,
                                                               apr_size_t size)
 {
@@ -169,6 +234,13 @@ APU_DECLARE_NONSTD(void *) apr_bucket_alloc(apr_size_t size,
     apr_memnode_t *active = list->blocks;
     char *endp;
 
+#if APR_HAS_THREADS
+    /* Whatever the size, so that no freed memory is held back */
+    if (list->remote) {
+        reclaim_remote(list);
+    }
+#endif
+
     size += SIZEOF_NODE_HEADER_T;
     if (size <= SMALL_NODE_SIZE) {
         if (list->freelist) {
@@ -232,6 +304,21 @@ APU_DECLARE_NONSTD(void) apr_bucket_free(void *mem)
     node_header_t *node = (node_header_t *)((char *)mem - SIZEOF_NODE_HEADER_T);
     apr_bucket_alloc_t *list = node->alloc;
 
+#if APR_HAS_THREADS
+    if ((list->flags & APR_BUCKET_ALLOC_XTHREAD)
+        && !apr_os_thread_equal(list->owner, apr_os_thread_current())) {
+        node_header_t *head;
+
+        /* Left for the owner to take back, whatever the size */
+        do {
+            head = list->remote;
+            node->next = head;
+        } while (apr_atomic_casptr((volatile void **)&list->remote, node,
+                                   head) != head);
+        return;
+    }
+#endif
+
     if (node->size == SMALL_NODE_SIZE) {
         check_not_already_free(node);
         node->next = list->freelist;
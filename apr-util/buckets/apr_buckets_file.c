@@ -18,6 +18,7 @@
 #include "apr_general.h"
 #include "apr_file_io.h"
 #include "apr_buckets.h"
+#include "apu_internal.h"
 
 #if APR_HAS_MMAP
 #include "apr_mmap.h"
@@ -29,6 +30,15 @@
 
 #endif /* APR_HAS_MMAP */
 
+/* The apr_bucket_file structure is public, so what only this file needs
+ * lives alongside it, in the same allocation.
+ */
+typedef struct file_bucket_t {
+    apr_bucket_file file;
+    /** How far ahead of the reads the data is asked for, or zero */
+    apr_size_t readahead;
+} file_bucket_t;
+
 static void file_bucket_destroy(void *data)
 {
     apr_bucket_file *f = data;
@@ -51,6 +61,11 @@ static int file_make_mmap(apr_bucket *e, apr_size_t filelength,
         return 0;
     }
 
+    if (apu_mmap_cache_bucket(e, a->fd, fileoffset, filelength)) {
+        file_bucket_destroy(a);
+        return 1;
+    }
+
     if (filelength > APR_MMAP_LIMIT) {
         if (apr_mmap_create(&mm, a->fd, fileoffset, APR_MMAP_LIMIT,
                             APR_MMAP_READ, p) != APR_SUCCESS)
@@ -72,27 +87,16 @@ static int file_make_mmap(apr_bucket *e, apr_size_t filelength,
 }
 #endif
 
-static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
-                                     apr_size_t *len, apr_read_type_e block)
+/* Reads at offset through the file position, where no positional read */
+static apr_status_t file_read_at(apr_bucket_file *a, apr_file_t **pf,
+                                 char *buf, apr_size_t *len,
+                                 apr_off_t offset)
 {
-    apr_bucket_file *a = e->data;
-    apr_file_t *f = a->fd;
-    apr_bucket *b = NULL;
-    char *buf;
+    apr_file_t *f = *pf;
     apr_status_t rv;
-    apr_size_t filelength = e->length;  /* bytes remaining in file past offset */
-    apr_off_t fileoffset = e->start;
 #if APR_HAS_THREADS && !APR_HAS_XTHREAD_FILES
     apr_int32_t flags;
-#endif
-
-#if APR_HAS_MMAP
-    if (file_make_mmap(e, filelength, fileoffset, a->readpool)) {
-        return apr_bucket_read(e, str, len, block);
-    }
-#endif
 
-#if APR_HAS_THREADS && !APR_HAS_XTHREAD_FILES
     if ((flags = apr_file_flags_get(f)) & APR_FOPEN_XTHREAD) {
         /* this file descriptor is shared across multiple threads and
          * this OS doesn't support that natively, so as a workaround
@@ -104,7 +108,33 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
         if (rv != APR_SUCCESS)
             return rv;
 
-        a->fd = f;
+        a->fd = *pf = f;
+    }
+#endif
+
+    /* Handle offset ... */
+    rv = apr_file_seek(f, APR_SET, &offset);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    return apr_file_read(f, buf, len);
+}
+
+static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
+                                     apr_size_t *len, apr_read_type_e block)
+{
+    apr_bucket_file *a = e->data;
+    apr_file_t *f = a->fd;
+    apr_bucket *b = NULL;
+    char *buf;
+    apr_status_t rv;
+    apr_size_t filelength = e->length;  /* bytes remaining in file past offset */
+    apr_off_t fileoffset = e->start;
+    apr_size_t readahead;
+
+#if APR_HAS_MMAP
+    if (file_make_mmap(e, filelength, fileoffset, a->readpool)) {
+        return apr_bucket_read(e, str, len, block);
     }
 #endif
 
@@ -112,17 +142,34 @@ static apr_status_t file_bucket_read(apr_bucket *e, const char **str,
     *len = (filelength > a->read_size) ? a->read_size : filelength;
     buf = apr_bucket_alloc(*len, e->list);
 
-    /* Handle offset ... */
-    rv = apr_file_seek(f, APR_SET, &fileoffset);
-    if (rv != APR_SUCCESS) {
-        apr_bucket_free(buf);
-        return rv;
+    /* Positional reads need neither a seek nor the file position, nor
+     * a file of its own per thread; whatever was written to the buffer
+     * of the file must reach it first though.
+     */
+    if (apr_file_flags_get(f) & APR_FOPEN_BUFFERED) {
+        apr_file_flush(f);
+    }
+    rv = apr_file_pread(f, buf, len, fileoffset);
+    if (rv == APR_ENOTIMPL || rv == APR_ESPIPE) {
+        *len = (filelength > a->read_size) ? a->read_size : filelength;
+        rv = file_read_at(a, &f, buf, len, fileoffset);
     }
-    rv = apr_file_read(f, buf, len);
     if (rv != APR_SUCCESS && rv != APR_EOF) {
         apr_bucket_free(buf);
         return rv;
     }
+
+    /* Keep the next chunks requested, half the read-ahead at a time */
+    readahead = ((file_bucket_t *)a)->readahead;
+    if (readahead && filelength > *len) {
+        apr_off_t step = (readahead > 1) ? readahead / 2 : 1;
+
+        if (fileoffset / step != (fileoffset + *len) / step) {
+            apr_file_advise(f, fileoffset + *len, readahead,
+                            APR_FADVISE_WILLNEED);
+        }
+    }
+
     filelength -= *len;
     /*
      * Change the current bucket to refer to what we read,
@@ -155,9 +202,12 @@ APU_DECLARE(apr_bucket *) apr_bucket_file_make(apr_bucket *b, apr_file_t *fd,
                                                apr_off_t offset,
                                                apr_size_t len, apr_pool_t *p)
 {
+    file_bucket_t *fb;
     apr_bucket_file *f;
 
-    f = apr_bucket_alloc(sizeof(*f), b->list);
+    fb = apr_bucket_alloc(sizeof(*fb), b->list);
+    fb->readahead = 0;
+    f = &fb->file;
     f->fd = fd;
     f->readpool = p;
 #if APR_HAS_MMAP
@@ -212,6 +262,27 @@ APU_DECLARE(apr_status_t) apr_bucket_file_set_buf_size(apr_bucket *e,
     return APR_SUCCESS;
 }
 
+APU_DECLARE(apr_status_t) apr_bucket_file_set_readahead(apr_bucket *e,
+                                                        apr_size_t size)
+{
+    apr_bucket_file *a;
+
+    if (!APR_BUCKET_IS_FILE(e)) {
+        return APR_EINVAL;
+    }
+    a = e->data;
+
+    ((file_bucket_t *)a)->readahead = size;
+    if (size) {
+        apr_file_advise(a->fd, 0, 0, APR_FADVISE_SEQUENTIAL);
+        apr_file_advise(a->fd, e->start,
+                        (e->length > size) ? size : e->length,
+                        APR_FADVISE_WILLNEED);
+    }
+
+    return APR_SUCCESS;
+}
+
 static apr_status_t file_bucket_setaside(apr_bucket *b, apr_pool_t *reqpool)
 {
     apr_bucket_file *a = b->data;
@@ -236,8 +307,8 @@ static apr_status_t file_bucket_setaside(apr_bucket *b, apr_pool_t *reqpool)
             return rv;
         }
 
-        new = apr_bucket_alloc(sizeof(*new), b->list);
-        memcpy(new, a, sizeof(*new));
+        new = apr_bucket_alloc(sizeof(file_bucket_t), b->list);
+        memcpy(new, a, sizeof(file_bucket_t));
         new->refcount.refcount = 1;
         new->readpool = reqpool;
 
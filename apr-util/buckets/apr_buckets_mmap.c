@@ -15,9 +15,210 @@
  */
 
 #include "apr_buckets.h"
+#include "apr_file_info.h"
+#include "apr_hash.h"
+#include "apr_ring.h"
+#include "apr_thread_mutex.h"
+#include "apu_internal.h"
+
+#if APR_HAVE_STRING_H
+#include <string.h>
+#endif
 
 #if APR_HAS_MMAP
 
+/* The process-wide cache of the mappings of file buckets, shared by all
+ * the buckets mapping the same window of the same version of a file.
+ * Mappings in use are refcounted, idle ones are kept in LRU order and
+ * unmapped only when the byte budget needs room.
+ */
+typedef struct {
+    apr_ino_t inode;
+    apr_dev_t device;
+    apr_time_t mtime;
+    apr_off_t size;
+    apr_off_t window;
+} mmap_cache_key_t;
+
+typedef struct mmap_cache_entry_t mmap_cache_entry_t;
+struct mmap_cache_entry_t {
+    APR_RING_ENTRY(mmap_cache_entry_t) link;
+    mmap_cache_key_t key;
+    apr_pool_t *pool;
+    apr_mmap_t *mmap;
+    apr_size_t refs;
+};
+
+typedef struct {
+    apr_pool_t *pool;
+#if APR_HAS_THREADS
+    apr_thread_mutex_t *mutex;
+#endif
+    apr_hash_t *by_key;
+    apr_hash_t *by_mmap;
+    APR_RING_HEAD(mmap_cache_lru_t, mmap_cache_entry_t) lru;
+    apr_size_t max_bytes;
+    apr_size_t bytes;
+} mmap_cache_t;
+
+static mmap_cache_t *mmap_cache = NULL;
+
+#if APR_HAS_THREADS
+#define MMAP_CACHE_LOCK()   apr_thread_mutex_lock(mmap_cache->mutex)
+#define MMAP_CACHE_UNLOCK() apr_thread_mutex_unlock(mmap_cache->mutex)
+#else
+#define MMAP_CACHE_LOCK()
+#define MMAP_CACHE_UNLOCK()
+#endif
+
+static apr_status_t mmap_cache_cleanup(void *data)
+{
+    mmap_cache = NULL;
+    return APR_SUCCESS;
+}
+
+static void mmap_cache_evict(mmap_cache_entry_t *entry)
+{
+    apr_hash_set(mmap_cache->by_key, &entry->key, sizeof(entry->key), NULL);
+    apr_hash_set(mmap_cache->by_mmap, &entry->mmap, sizeof(entry->mmap),
+                 NULL);
+    APR_RING_REMOVE(entry, link);
+    mmap_cache->bytes -= entry->mmap->size;
+    apr_pool_destroy(entry->pool);
+}
+
+/* Maps a new window, making room for it; called with the lock held */
+static mmap_cache_entry_t *mmap_cache_insert(const mmap_cache_key_t *key,
+                                             apr_file_t *fd,
+                                             apr_size_t size)
+{
+    mmap_cache_entry_t *entry;
+    apr_pool_t *pool;
+    apr_mmap_t *mm;
+
+    while (mmap_cache->bytes + size > mmap_cache->max_bytes
+           && !APR_RING_EMPTY(&mmap_cache->lru, mmap_cache_entry_t, link)) {
+        mmap_cache_evict(APR_RING_FIRST(&mmap_cache->lru));
+    }
+    if (mmap_cache->bytes + size > mmap_cache->max_bytes) {
+        return NULL;
+    }
+
+    if (apr_pool_create(&pool, mmap_cache->pool) != APR_SUCCESS) {
+        return NULL;
+    }
+    if (apr_mmap_create(&mm, fd, key->window, size, APR_MMAP_READ,
+                        pool) != APR_SUCCESS) {
+        apr_pool_destroy(pool);
+        return NULL;
+    }
+
+    entry = apr_palloc(pool, sizeof(*entry));
+    APR_RING_ELEM_INIT(entry, link);
+    entry->key = *key;
+    entry->pool = pool;
+    entry->mmap = mm;
+    entry->refs = 1;
+    mmap_cache->bytes += size;
+    apr_hash_set(mmap_cache->by_key, &entry->key, sizeof(entry->key), entry);
+    apr_hash_set(mmap_cache->by_mmap, &entry->mmap, sizeof(entry->mmap),
+                 entry);
+    return entry;
+}
+
+/* Takes a reference on mm if it belongs to the cache */
+static int mmap_cache_ref(apr_mmap_t *mm)
+{
+    mmap_cache_entry_t *entry;
+
+    if (!mmap_cache) {
+        return 0;
+    }
+    MMAP_CACHE_LOCK();
+    entry = apr_hash_get(mmap_cache->by_mmap, &mm, sizeof(mm));
+    if (entry && entry->refs++ == 0) {
+        APR_RING_REMOVE(entry, link);
+    }
+    MMAP_CACHE_UNLOCK();
+    return entry != NULL;
+}
+
+/* Gives back a reference on mm if it belongs to the cache */
+static int mmap_cache_unref(apr_mmap_t *mm)
+{
+    mmap_cache_entry_t *entry;
+
+    if (!mmap_cache) {
+        return 0;
+    }
+    MMAP_CACHE_LOCK();
+    entry = apr_hash_get(mmap_cache->by_mmap, &mm, sizeof(mm));
+    if (entry && --entry->refs == 0) {
+        APR_RING_INSERT_TAIL(&mmap_cache->lru, entry, mmap_cache_entry_t,
+                             link);
+    }
+    MMAP_CACHE_UNLOCK();
+    return entry != NULL;
+}
+
+/* Whether mm belongs to the cache */
+static int mmap_cache_owns(apr_mmap_t *mm)
+{
+    void *entry;
+
+    if (!mmap_cache) {
+        return 0;
+    }
+    MMAP_CACHE_LOCK();
+    entry = apr_hash_get(mmap_cache->by_mmap, &mm, sizeof(mm));
+    MMAP_CACHE_UNLOCK();
+    return entry != NULL;
+}
+
+APU_DECLARE(apr_status_t) apr_bucket_mmap_cache_enable(apr_pool_t *p,
+                                                       apr_size_t max_bytes)
+{
+    apr_allocator_t *allocator;
+    mmap_cache_t *cache;
+    apr_pool_t *pool;
+    apr_status_t rv;
+
+    if (mmap_cache) {
+        return APR_EEXIST;
+    }
+
+    /* Only ever used with the lock held, whoever the caller */
+    if ((rv = apr_allocator_create(&allocator)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_pool_create_ex(&pool, p, NULL, allocator)) != APR_SUCCESS) {
+        apr_allocator_destroy(allocator);
+        return rv;
+    }
+    apr_allocator_owner_set(allocator, pool);
+    apr_pool_tag(pool, "apr_bucket_mmap_cache");
+
+    cache = apr_pcalloc(pool, sizeof(*cache));
+    cache->pool = pool;
+#if APR_HAS_THREADS
+    rv = apr_thread_mutex_create(&cache->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                 pool);
+    if (rv != APR_SUCCESS) {
+        apr_pool_destroy(pool);
+        return rv;
+    }
+#endif
+    cache->by_key = apr_hash_make(pool);
+    cache->by_mmap = apr_hash_make(pool);
+    APR_RING_INIT(&cache->lru, mmap_cache_entry_t, link);
+    cache->max_bytes = max_bytes;
+
+    apr_pool_cleanup_register(pool, NULL, mmap_cache_cleanup,
+                              apr_pool_cleanup_null);
+    mmap_cache = cache;
+    return APR_SUCCESS;
+}
+
 static apr_status_t mmap_bucket_read(apr_bucket *b, const char **str, 
                                      apr_size_t *length, apr_read_type_e block)
 {
@@ -57,7 +258,7 @@ static void mmap_bucket_destroy(void *data)
     apr_bucket_mmap *m = data;
 
     if (apr_bucket_shared_destroy(m)) {
-        if (m->mmap) {
+        if (m->mmap && !mmap_cache_unref(m->mmap)) {
             apr_pool_cleanup_kill(m->mmap->cntxt, m, mmap_bucket_cleanup);
             apr_mmap_delete(m->mmap);
         }
@@ -65,20 +266,20 @@ static void mmap_bucket_destroy(void *data)
     }
 }
 
-/*
- * XXX: are the start and length arguments useful?
- */
-APU_DECLARE(apr_bucket *) apr_bucket_mmap_make(apr_bucket *b, apr_mmap_t *mm, 
-                                               apr_off_t start, 
-                                               apr_size_t length)
+static apr_bucket *mmap_bucket_make(apr_bucket *b, apr_mmap_t *mm,
+                                    apr_off_t start, apr_size_t length,
+                                    int cached)
 {
     apr_bucket_mmap *m;
 
     m = apr_bucket_alloc(sizeof(*m), b->list);
     m->mmap = mm;
 
-    apr_pool_cleanup_register(mm->cntxt, m, mmap_bucket_cleanup,
-                              apr_pool_cleanup_null);
+    /* a cached mapping outlives its users, whatever their pools */
+    if (!cached) {
+        apr_pool_cleanup_register(mm->cntxt, m, mmap_bucket_cleanup,
+                                  apr_pool_cleanup_null);
+    }
 
     b = apr_bucket_shared_make(b, m, start, length);
     b->type = &apr_bucket_type_mmap;
@@ -86,6 +287,69 @@ APU_DECLARE(apr_bucket *) apr_bucket_mmap_make(apr_bucket *b, apr_mmap_t *mm,
     return b;
 }
 
+/*
+ * XXX: are the start and length arguments useful?
+ */
+APU_DECLARE(apr_bucket *) apr_bucket_mmap_make(apr_bucket *b, apr_mmap_t *mm, 
+                                               apr_off_t start, 
+                                               apr_size_t length)
+{
+    return mmap_bucket_make(b, mm, start, length, mmap_cache_ref(mm));
+}
+
+int apu_mmap_cache_bucket(apr_bucket *e, apr_file_t *fd,
+                          apr_off_t offset, apr_size_t length)
+{
+    mmap_cache_entry_t *entry;
+    mmap_cache_key_t key;
+    apr_finfo_t finfo;
+    apr_size_t size;
+
+    if (!mmap_cache || length < APR_MMAP_THRESHOLD) {
+        return 0;
+    }
+    if (apr_file_info_get(&finfo, APR_FINFO_IDENT | APR_FINFO_MTIME
+                                  | APR_FINFO_SIZE | APR_FINFO_TYPE,
+                          fd) != APR_SUCCESS
+        || finfo.filetype != APR_REG) {
+        return 0;
+    }
+
+    if (offset >= finfo.size) {
+        return 0;
+    }
+
+    /* Map whole windows, whatever part of them the buckets refer to */
+    memset(&key, 0, sizeof(key));
+    key.inode = finfo.inode;
+    key.device = finfo.device;
+    key.mtime = finfo.mtime;
+    key.size = finfo.size;
+    key.window = offset - offset % APR_MMAP_LIMIT;
+    size = (finfo.size - key.window > APR_MMAP_LIMIT)
+           ? APR_MMAP_LIMIT : (apr_size_t)(finfo.size - key.window);
+
+    MMAP_CACHE_LOCK();
+    entry = apr_hash_get(mmap_cache->by_key, &key, sizeof(key));
+    if (!entry) {
+        entry = mmap_cache_insert(&key, fd, size);
+    }
+    else if (entry->refs++ == 0) {
+        APR_RING_REMOVE(entry, link);
+    }
+    MMAP_CACHE_UNLOCK();
+    if (!entry) {
+        return 0;
+    }
+
+    if (length > (apr_size_t)(key.window + size - offset)) {
+        apr_bucket_split(e, (apr_size_t)(key.window + size - offset));
+        length = (apr_size_t)(key.window + size - offset);
+    }
+    mmap_bucket_make(e, entry->mmap, offset - key.window, length, 1);
+    return 1;
+}
+
 
 APU_DECLARE(apr_bucket *) apr_bucket_mmap_create(apr_mmap_t *mm, 
                                                  apr_off_t start, 
@@ -113,7 +377,7 @@ static apr_status_t mmap_bucket_setaside(apr_bucket *b, apr_pool_t *p)
     }
 
     /* shortcut if possible */
-    if (apr_pool_is_ancestor(mm->cntxt, p)) {
+    if (apr_pool_is_ancestor(mm->cntxt, p) || mmap_cache_owns(mm)) {
         return APR_SUCCESS;
     }
 
@@ -16,28 +16,85 @@
 
 #include "apr_buckets.h"
 
+/* The SOCKET_EX buckets of a socket share a reader, which recycles the
+ * buffers given back by the HEAP buckets they turn into, and sizes its
+ * reads after how much the previous ones got.
+ */
+#define READER_BUFF_SIZE APR_BUCKET_BUFF_SIZE
+#define READER_MAX_VECS  128
+
+typedef struct socket_reader_t {
+    apr_socket_t *sock;
+    apr_bucket_alloc_t *list;
+    /** The SOCKET_EX bucket and the buffers in use */
+    apr_size_t refs;
+    /** How many buffers the next read fills, from 1 to max_vecs */
+    apr_size_t nvec;
+    apr_size_t max_vecs;
+    /** The buffers given back, up to max_vecs of them */
+    apr_size_t nfree;
+    char *free[READER_MAX_VECS];
+} socket_reader_t;
+
+/* Each buffer starts with its reader, out of the data */
+#define READER_HEADER_SIZE APR_ALIGN_DEFAULT(sizeof(socket_reader_t *))
+
+static void socket_reader_unref(socket_reader_t *r)
+{
+    if (--r->refs == 0) {
+        while (r->nfree) {
+            apr_bucket_free(r->free[--r->nfree] - READER_HEADER_SIZE);
+        }
+        apr_bucket_free(r);
+    }
+}
+
+static char *socket_reader_buffer(socket_reader_t *r)
+{
+    char *mem;
+
+    r->refs++;
+    if (r->nfree) {
+        return r->free[--r->nfree];
+    }
+    mem = apr_bucket_alloc(READER_HEADER_SIZE + READER_BUFF_SIZE, r->list);
+    *(socket_reader_t **)mem = r;
+    return mem + READER_HEADER_SIZE;
+}
+
+/* The free function of the HEAP buckets made from the buffers */
+static void socket_reader_recycle(void *data)
+{
+    char *buf = data;
+    socket_reader_t *r = *(socket_reader_t **)(buf - READER_HEADER_SIZE);
+
+    if (r->nfree < r->max_vecs) {
+        r->free[r->nfree++] = buf;
+    }
+    else {
+        apr_bucket_free(buf - READER_HEADER_SIZE);
+    }
+    socket_reader_unref(r);
+}
+
 static apr_status_t socket_bucket_read(apr_bucket *a, const char **str,
                                        apr_size_t *len, apr_read_type_e block)
 {
     apr_socket_t *p = a->data;
     char *buf;
     apr_status_t rv;
-    apr_interval_time_t timeout;
-
-    if (block == APR_NONBLOCK_READ) {
-        apr_socket_timeout_get(p, &timeout);
-        apr_socket_timeout_set(p, 0);
-    }
+    struct iovec vec;
 
     *str = NULL;
     *len = APR_BUCKET_BUFF_SIZE;
     buf = apr_bucket_alloc(*len, a->list); /* XXX: check for failure? */
 
-    rv = apr_socket_recv(p, buf, len);
-
-    if (block == APR_NONBLOCK_READ) {
-        apr_socket_timeout_set(p, timeout);
-    }
+    /* a nonblocking read doesn't switch the socket's mode back and forth */
+    vec.iov_base = buf;
+    vec.iov_len = *len;
+    rv = apr_socket_recvv(p, &vec, 1,
+                          (block == APR_NONBLOCK_READ) ? APR_RECV_NONBLOCK : 0,
+                          len);
 
     if (rv != APR_SUCCESS && rv != APR_EOF) {
         apr_bucket_free(buf);
@@ -104,6 +161,135 @@ APU_DECLARE(apr_bucket *) apr_bucket_socket_create(apr_socket_t *p,
     return apr_bucket_socket_make(b, p);
 }
 
+static apr_bucket *socket_ex_make(apr_bucket *b, socket_reader_t *r)
+{
+    b->type        = &apr_bucket_type_socket_ex;
+    b->length      = (apr_size_t)(-1);
+    b->start       = -1;
+    b->data        = r;
+
+    return b;
+}
+
+static void socket_ex_bucket_destroy(void *data)
+{
+    socket_reader_unref(data);
+}
+
+static apr_status_t socket_ex_bucket_read(apr_bucket *a, const char **str,
+                                          apr_size_t *len,
+                                          apr_read_type_e block)
+{
+    socket_reader_t *r = a->data;
+    struct iovec vec[READER_MAX_VECS];
+    apr_size_t nvec, i, got;
+    apr_status_t rv;
+    apr_bucket *b, *last;
+
+    /* nvec is kept between 1 and max_vecs */
+    nvec = r->nvec;
+    i = 0;
+    do {
+        vec[i].iov_base = socket_reader_buffer(r);
+        vec[i].iov_len = READER_BUFF_SIZE;
+    } while (++i < nvec);
+
+    *str = NULL;
+    rv = apr_socket_recvv(r->sock, vec, (apr_int32_t)nvec,
+                          (block == APR_NONBLOCK_READ) ? APR_RECV_NONBLOCK : 0,
+                          len);
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        for (i = 0; i < nvec; i++) {
+            socket_reader_recycle(vec[i].iov_base);
+        }
+        return rv;
+    }
+
+    /* Read more at once while the reads fill up, less when they don't */
+    if (*len == nvec * READER_BUFF_SIZE) {
+        r->nvec = (nvec * 2 < r->max_vecs) ? nvec * 2 : r->max_vecs;
+    }
+    else if (*len < nvec * READER_BUFF_SIZE / 4 && nvec > 1) {
+        r->nvec = nvec / 2;
+    }
+
+    if (*len == 0) {
+        for (i = 0; i < nvec; i++) {
+            socket_reader_recycle(vec[i].iov_base);
+        }
+        socket_reader_unref(r);
+        a = apr_bucket_immortal_make(a, "", 0);
+        *str = a->data;
+        return APR_SUCCESS;
+    }
+
+    /* One HEAP bucket per buffer filled, the SOCKET_EX bucket after them */
+    got = *len;
+    *len = (got > READER_BUFF_SIZE) ? READER_BUFF_SIZE : got;
+    *str = vec[0].iov_base;
+    last = apr_bucket_heap_make(a, vec[0].iov_base, *len,
+                                socket_reader_recycle);
+    ((apr_bucket_heap *)last->data)->alloc_len = READER_BUFF_SIZE;
+    got -= *len;
+    for (i = 1; i < nvec; i++) {
+        apr_size_t n = (got > READER_BUFF_SIZE) ? READER_BUFF_SIZE : got;
+
+        if (!n) {
+            socket_reader_recycle(vec[i].iov_base);
+            continue;
+        }
+        b = apr_bucket_heap_create(vec[i].iov_base, n, socket_reader_recycle,
+                                   last->list);
+        ((apr_bucket_heap *)b->data)->alloc_len = READER_BUFF_SIZE;
+        APR_BUCKET_INSERT_AFTER(last, b);
+        last = b;
+        got -= n;
+    }
+
+    /* The new SOCKET_EX bucket takes over the reference of this one */
+    b = apr_bucket_alloc(sizeof(*b), last->list);
+    APR_BUCKET_INIT(b);
+    b->free = apr_bucket_free;
+    b->list = last->list;
+    APR_BUCKET_INSERT_AFTER(last, socket_ex_make(b, r));
+    return APR_SUCCESS;
+}
+
+APU_DECLARE(apr_bucket *) apr_bucket_socket_make_ex(apr_bucket *b,
+                                                    apr_socket_t *p,
+                                                    apr_size_t max_read)
+{
+    socket_reader_t *r;
+
+    r = apr_bucket_alloc(sizeof(*r), b->list);
+    r->sock = p;
+    r->list = b->list;
+    r->refs = 1;
+    r->nvec = 1;
+    r->max_vecs = max_read / READER_BUFF_SIZE;
+    if (r->max_vecs < 1) {
+        r->max_vecs = 1;
+    }
+    else if (r->max_vecs > READER_MAX_VECS) {
+        r->max_vecs = READER_MAX_VECS;
+    }
+    r->nfree = 0;
+
+    return socket_ex_make(b, r);
+}
+
+APU_DECLARE(apr_bucket *) apr_bucket_socket_create_ex(apr_socket_t *p,
+                                                      apr_size_t max_read,
+                                                      apr_bucket_alloc_t *list)
+{
+    apr_bucket *b = apr_bucket_alloc(sizeof(*b), list);
+
+    APR_BUCKET_INIT(b);
+    b->free = apr_bucket_free;
+    b->list = list;
+    return apr_bucket_socket_make_ex(b, p, max_read);
+}
+
 APU_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_socket = {
     "SOCKET", 5, APR_BUCKET_DATA,
     apr_bucket_destroy_noop,
@@ -112,3 +298,12 @@ APU_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_socket = {
     apr_bucket_split_notimpl,
     apr_bucket_copy_notimpl
 };
+
+APU_DECLARE_DATA const apr_bucket_type_t apr_bucket_type_socket_ex = {
+    "SOCKET_EX", 5, APR_BUCKET_DATA,
+    socket_ex_bucket_destroy,
+    socket_ex_bucket_read,
+    apr_bucket_setaside_notimpl,
+    apr_bucket_split_notimpl,
+    apr_bucket_copy_notimpl
+};
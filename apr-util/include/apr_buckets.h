@@ -477,6 +477,12 @@ typedef apr_status_t (*apr_brigade_flush)(apr_bucket_brigade *bb, void *ctx);
  * @return true or false
  */
 #define APR_BUCKET_IS_SOCKET(e)      ((e)->type == &apr_bucket_type_socket)
+/**
+ * Determine if a bucket is a SOCKET_EX bucket
+ * @param e The bucket to inspect
+ * @return true or false
+ */
+#define APR_BUCKET_IS_SOCKET_EX(e)   ((e)->type == &apr_bucket_type_socket_ex)
 /**
  * Determine if a bucket is a HEAP bucket
  * @param e The bucket to inspect
@@ -789,6 +795,33 @@ APU_DECLARE(apr_status_t) apr_brigade_split_line(apr_bucket_brigade *bbOut,
 APU_DECLARE(apr_status_t) apr_brigade_to_iovec(apr_bucket_brigade *b, 
                                                struct iovec *vec, int *nvec);
 
+/** Flag for apr_brigade_send(): neither wait for the socket nor block
+ *  reading the buckets */
+#define APR_BRIGADE_SEND_NONBLOCK 1
+
+/**
+ * Send the contents of a bucket brigade to a socket, deleting the buckets
+ * as they are sent.  The memory buckets are gathered and sent with
+ * apr_socket_sendv(), and the file buckets with apr_socket_sendfile()
+ * (where available), along with the memory buckets before them.
+ * @param sock The socket to send to
+ * @param b The bucket brigade to send
+ * @param flags 0, or #APR_BRIGADE_SEND_NONBLOCK
+ * @param bytes_sent The number of bytes sent
+ * @return APR_SUCCESS once the whole brigade is sent; otherwise the error,
+ *         the unsent buckets being left in the brigade.
+ * @remark In blocking mode, the socket's timeout applies to each write and
+ *         the buckets are read blocking (once whatever was read before is
+ *         sent).  With #APR_BRIGADE_SEND_NONBLOCK, the socket is not
+ *         waited for whatever its timeout, and APR_EAGAIN is returned as
+ *         soon as it would block or a bucket has no data available yet.
+ * @remark Metadata buckets are deleted with the data around them.
+ */
+APU_DECLARE(apr_status_t) apr_brigade_send(apr_socket_t *sock,
+                                           apr_bucket_brigade *b,
+                                           apr_int32_t flags,
+                                           apr_size_t *bytes_sent);
+
 /**
  * This function writes a list of strings into a bucket brigade. 
  * @param b The bucket brigade to add to
@@ -943,7 +976,9 @@ APU_DECLARE(apr_bucket *) apr_brigade_insert_file(apr_bucket_brigade *bb,
  *          the bucket allocator will free large memory blocks back to the
  *          allocator when it's done with them, thereby preventing memory
  *          footprint growth that would occur if we allocated from the pool.
- * @warning The allocator must never be used by more than one thread at a time.
+ * @warning The allocator must never be used by more than one thread at a time
+ *          (though other threads may free its memory with
+ *          #APR_BUCKET_ALLOC_XTHREAD).
  */
 APU_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create(apr_pool_t *p);
 
@@ -953,7 +988,9 @@ APU_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create(apr_pool_t *p);
  *          allocator and all memory handed out by the bucket allocator.  The
  *          caller is responsible for destroying the bucket allocator and the
  *          apr_allocator_t -- no automatic cleanups will happen.
- * @warning The allocator must never be used by more than one thread at a time.
+ * @warning The allocator must never be used by more than one thread at a time
+ *          (though other threads may free its memory with
+ *          #APR_BUCKET_ALLOC_XTHREAD).
  */
 APU_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create_ex(apr_allocator_t *allocator);
 
@@ -963,6 +1000,33 @@ APU_DECLARE_NONSTD(apr_bucket_alloc_t *) apr_bucket_alloc_create_ex(apr_allocato
  */
 APU_DECLARE_NONSTD(void) apr_bucket_alloc_destroy(apr_bucket_alloc_t *list);
 
+/**
+ * Let other threads free memory of the bucket allocator, see
+ * apr_bucket_alloc_flags_set().
+ */
+#define APR_BUCKET_ALLOC_XTHREAD 0x1
+
+/**
+ * Set the flags of a bucket allocator.
+ * @param list The allocator to change
+ * @param flags Zero, or #APR_BUCKET_ALLOC_XTHREAD for the buckets (and
+ *        other memory) of the allocator to be destroyed by any thread.
+ * @remark With #APR_BUCKET_ALLOC_XTHREAD, the calling thread becomes the
+ *         owner of the allocator, the only one allocating from it.  The
+ *         memory freed by the other threads is pushed onto a lock-free list,
+ *         which the owner takes back all at once on its next allocation, or
+ *         when the allocator is destroyed.  This lets a brigade be handed
+ *         over to another thread without copying or setting aside its
+ *         buckets.  Buckets sharing their data (split or copied) are
+ *         still to be destroyed by the same thread, since their reference
+ *         count is not atomic.
+ * @remark Returns APR_ENOTIMPL for #APR_BUCKET_ALLOC_XTHREAD without
+ *         thread support, APR_EINVAL for unknown flags.
+ */
+APU_DECLARE_NONSTD(apr_status_t) apr_bucket_alloc_flags_set(
+                                             apr_bucket_alloc_t *list,
+                                             apr_uint32_t flags);
+
 /**
  * Get the aligned size corresponding to the requested size, but minus the
  * allocator(s) overhead such that the allocation would remain in the
@@ -1233,6 +1297,11 @@ APU_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_transient;
  * The SOCKET bucket type.  This bucket represents a socket to another machine
  */
 APU_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_socket;
+/**
+ * The SOCKET_EX bucket type.  This bucket represents a socket to another
+ * machine, read into recycled buffers, as much at once as it can take
+ */
+APU_DECLARE_DATA extern const apr_bucket_type_t apr_bucket_type_socket_ex;
 
 
 /*  *****  Simple buckets  *****  */
@@ -1497,6 +1566,25 @@ APU_DECLARE(apr_bucket *) apr_bucket_mmap_create(apr_mmap_t *mm,
 APU_DECLARE(apr_bucket *) apr_bucket_mmap_make(apr_bucket *b, apr_mmap_t *mm,
                                                apr_off_t start, 
                                                apr_size_t length);
+
+/**
+ * Share the memory maps of the FILE buckets through a process-wide
+ * cache, rather than mapping and unmapping the file for each bucket.
+ * Mappings are keyed by the file's device, inode, mtime and size, and
+ * by the @a APR_MMAP_LIMIT window of the file they cover; the ones not
+ * referred to by any bucket are unmapped in LRU order when room is
+ * needed.
+ * @param p The pool whose cleanup disables the cache and unmaps all
+ * @param max_bytes The most bytes mapped by the cache at once
+ * @return APR_SUCCESS, APR_EEXIST if the cache is already enabled, or
+ *         an error code if it could not be created
+ * @remark This must be called before any thread reads from buckets, and
+ *         @a p must outlive all the buckets.  The MMAP buckets made
+ *         from a cached mapping need no setaside, and a file changing
+ *         without its mtime or size changing is not seen by them.
+ */
+APU_DECLARE(apr_status_t) apr_bucket_mmap_cache_enable(apr_pool_t *p,
+                                                       apr_size_t max_bytes);
 #endif
 
 /**
@@ -1516,6 +1604,35 @@ APU_DECLARE(apr_bucket *) apr_bucket_socket_create(apr_socket_t *thissock,
 APU_DECLARE(apr_bucket *) apr_bucket_socket_make(apr_bucket *b, 
                                                  apr_socket_t *thissock);
 
+/**
+ * Create a bucket referring to a socket, read into a ring of recycled
+ * buffers.  Each read fills as many buffers as the previous reads suggest,
+ * in a single system call, up to @a max_read bytes; the data then comes as
+ * one HEAP bucket per buffer.
+ * @param thissock The socket to put in the bucket
+ * @param max_read The most bytes read at once (at least
+ *                 @a APR_BUCKET_BUFF_SIZE, at most 128 times that)
+ * @param list The freelist from which this bucket should be allocated
+ * @return The new bucket, or NULL if allocation failed
+ * @remark The buffers go back to the ring when their buckets are
+ * destroyed, which must happen in the thread reading the socket.
+ */
+APU_DECLARE(apr_bucket *) apr_bucket_socket_create_ex(apr_socket_t *thissock,
+                                                      apr_size_t max_read,
+                                                      apr_bucket_alloc_t *list);
+/**
+ * Make the bucket passed in a bucket refer to a socket, read into a ring
+ * of recycled buffers
+ * @param b The bucket to make into a SOCKET_EX bucket
+ * @param thissock The socket to put in the bucket
+ * @param max_read The most bytes read at once
+ * @return The new bucket, or NULL if allocation failed
+ * @see apr_bucket_socket_create_ex
+ */
+APU_DECLARE(apr_bucket *) apr_bucket_socket_make_ex(apr_bucket *b,
+                                                    apr_socket_t *thissock,
+                                                    apr_size_t max_read);
+
 /**
  * Create a bucket referring to a pipe.
  * @param thispipe The pipe to put in the bucket
@@ -1592,6 +1709,22 @@ APU_DECLARE(apr_status_t) apr_bucket_file_enable_mmap(apr_bucket *b,
 APU_DECLARE(apr_status_t) apr_bucket_file_set_buf_size(apr_bucket *b,
                                                        apr_size_t size);
 
+/**
+ * Have a FILE bucket ask the system for the data ahead of its reads, so
+ * that it is read from the disk while the previous chunks are consumed
+ * (default is no read-ahead)
+ * @param b The bucket
+ * @param size How many bytes to keep requested ahead of the reads, or
+ *             zero to stop asking
+ * @return APR_SUCCESS normally, or APR_EINVAL if @a b is not a FILE bucket
+ * @remark The file is then also hinted as read sequentially, and the
+ * first @a size bytes of the bucket are requested right away.  Like
+ * @a apr_bucket_file_set_buf_size, relevant only when memory-mapping is
+ * disabled or not possible.
+ */
+APU_DECLARE(apr_status_t) apr_bucket_file_set_readahead(apr_bucket *b,
+                                                        apr_size_t size);
+
 /** @} */
 #ifdef __cplusplus
 }
@@ -56,6 +56,28 @@ APU_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **queue,
                                            unsigned int queue_capacity, 
                                            apr_pool_t *a);
 
+/**
+ * Use a lock-free ring for the queue, see apr_queue_create_ex().
+ */
+#define APR_QUEUE_LOCKFREE 0x1
+
+/**
+ * create a FIFO queue
+ * @param queue The new queue
+ * @param queue_capacity maximum size of the queue
+ * @param flags Zero, or APR_QUEUE_LOCKFREE to back the queue with a
+ *        lock-free ring where producers and consumers only block on the
+ *        mutex and conditions when the queue is full or empty.
+ * @param a pool to allocate queue from
+ * @remark With APR_QUEUE_LOCKFREE, the capacity is rounded up to the next
+ *         power of 2.
+ * @returns APR_EINVAL if the capacity is invalid for the given flags
+ */
+APU_DECLARE(apr_status_t) apr_queue_create_ex(apr_queue_t **queue,
+                                              unsigned int queue_capacity,
+                                              unsigned int flags,
+                                              apr_pool_t *a);
+
 /**
  * push/add an object to the queue, blocking if the queue is already full
  *
@@ -102,6 +124,40 @@ APU_DECLARE(apr_status_t) apr_queue_trypush(apr_queue_t *queue, void *data);
  */
 APU_DECLARE(apr_status_t) apr_queue_trypop(apr_queue_t *queue, void **data);
 
+/**
+ * push/add up to nelts objects to the queue, blocking only if the queue
+ * is already full
+ * @param queue the queue
+ * @param data the array of data to push, in order
+ * @param nelts the number of elements in data
+ * @param pushed the number of elements pushed, between 1 and nelts on
+ *        success (fewer if the queue fills up)
+ * @returns APR_EINTR the blocking was interrupted (try again)
+ * @returns APR_EOF the queue has been terminated
+ * @returns APR_SUCCESS on a successful push
+ */
+APU_DECLARE(apr_status_t) apr_queue_push_batch(apr_queue_t *queue,
+                                               void **data,
+                                               unsigned int nelts,
+                                               unsigned int *pushed);
+
+/**
+ * pop/get up to nelts objects from the queue, blocking only if the queue
+ * is already empty
+ * @param queue the queue
+ * @param data the array to store the data in, in order
+ * @param nelts the number of elements data can hold
+ * @param popped the number of elements popped, between 1 and nelts on
+ *        success (fewer if the queue empties)
+ * @returns APR_EINTR the blocking was interrupted (try again)
+ * @returns APR_EOF if the queue has been terminated
+ * @returns APR_SUCCESS on a successful pop
+ */
+APU_DECLARE(apr_status_t) apr_queue_pop_batch(apr_queue_t *queue,
+                                              void **data,
+                                              unsigned int nelts,
+                                              unsigned int *popped);
+
 /**
  * returns the size of the queue.
  *
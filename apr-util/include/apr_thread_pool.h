@@ -79,6 +79,36 @@ APU_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t **me,
                                                  apr_size_t max_threads,
                                                  apr_pool_t *pool);
 
+/**
+ * Give each worker thread its own tasks deque: the tasks pushed by a task
+ * (from within a worker thread of the pool) go to the worker's deque, with
+ * no contention on the pool's lock, and idle workers steal from the others'
+ * deques.  Priorities are honored per deque, and against the shared tasks
+ * (pushed from outside the pool) which are run first when they have a
+ * higher priority.  Owners and apr_thread_pool_tasks_cancel() work the same.
+ */
+#define APR_THREAD_POOL_WORK_STEALING 0x1
+
+/**
+ * Create a thread pool with flags
+ * @param me The pointer in which to return the newly created apr_thread_pool
+ * object, or NULL if thread pool creation fails.
+ * @param init_threads The number of threads to be created initially, this number
+ * will also be used as the initial value for the maximum number of idle threads.
+ * @param max_threads The maximum number of threads that can be created
+ * @param flags Zero or APR_THREAD_POOL_WORK_STEALING
+ * @param pool The pool to use
+ * @return APR_SUCCESS if the thread pool was created successfully. Otherwise,
+ * the error code.
+ * @remark apr_thread_pool_create() is apr_thread_pool_create_ex() with no
+ * flags.
+ */
+APU_DECLARE(apr_status_t) apr_thread_pool_create_ex(apr_thread_pool_t **me,
+                                                    apr_size_t init_threads,
+                                                    apr_size_t max_threads,
+                                                    unsigned int flags,
+                                                    apr_pool_t *pool);
+
 /**
  * Destroy the thread pool and stop all the threads
  * @return APR_SUCCESS if all threads are stopped.
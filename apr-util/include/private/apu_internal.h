@@ -21,6 +21,20 @@
 #ifndef APU_INTERNAL_H
 #define APU_INTERNAL_H
 
+#if APR_HAS_MMAP
+
+#include "apr_buckets.h"
+
+/* Turns the file bucket e, at offset in fd, into an MMAP bucket sharing
+ * the mapping of the cache enabled by apr_bucket_mmap_cache_enable(),
+ * splitting it at the end of the mapped window.  Returns zero if the
+ * cache is disabled or can't take the mapping.
+ */
+int apu_mmap_cache_bucket(apr_bucket *e, apr_file_t *fd,
+                          apr_off_t offset, apr_size_t length);
+
+#endif /* APR_HAS_MMAP */
+
 #if APU_DSO_BUILD
 
 #ifdef __cplusplus
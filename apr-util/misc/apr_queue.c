@@ -27,6 +27,7 @@
 #endif
 
 #include "apu.h"
+#include "apr_atomic.h"
 #include "apr_portable.h"
 #include "apr_thread_mutex.h"
 #include "apr_thread_cond.h"
@@ -40,18 +41,41 @@
 #define QUEUE_DEBUG
  */
 
+/**
+ * A slot of the lock-free ring, whose sequence number tells whether it
+ * is ready to be filled (seq == pos) or consumed (seq == pos + 1) by the
+ * producer or consumer at position pos.
+ */
+typedef struct queue_cell_t {
+    volatile apr_uint32_t seq;
+    void                 *data;
+} queue_cell_t;
+
+#define QUEUE_CACHELINE 64
+
 struct apr_queue_t {
     void              **data;
     unsigned int        nelts; /**< # elements */
     unsigned int        in;    /**< next empty location */
     unsigned int        out;   /**< next filled location */
     unsigned int        bounds;/**< max size of queue */
-    unsigned int        full_waiters;
-    unsigned int        empty_waiters;
+    volatile apr_uint32_t full_waiters;
+    volatile apr_uint32_t empty_waiters;
     apr_thread_mutex_t *one_big_mutex;
     apr_thread_cond_t  *not_empty;
     apr_thread_cond_t  *not_full;
     int                 terminated;
+    unsigned int        flags;
+    /* APR_QUEUE_LOCKFREE: the mutex and conditions are only used to
+     * wait when the ring is empty or full.
+     */
+    queue_cell_t       *cells;
+    apr_uint32_t        mask;  /**< bounds - 1, bounds being a power of 2 */
+    char                pad_in[QUEUE_CACHELINE];
+    volatile apr_uint32_t enqueue_pos;
+    char                pad_out[QUEUE_CACHELINE];
+    volatile apr_uint32_t dequeue_pos;
+    char                pad_end[QUEUE_CACHELINE];
 };
 
 #ifdef QUEUE_DEBUG
@@ -101,9 +125,24 @@ static apr_status_t queue_destroy(void *data)
 APU_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **q, 
                                            unsigned int queue_capacity, 
                                            apr_pool_t *a)
+{
+    return apr_queue_create_ex(q, queue_capacity, 0, a);
+}
+
+APU_DECLARE(apr_status_t) apr_queue_create_ex(apr_queue_t **q,
+                                              unsigned int queue_capacity,
+                                              unsigned int flags,
+                                              apr_pool_t *a)
 {
     apr_status_t rv;
     apr_queue_t *queue;
+    apr_uint32_t i;
+
+    if ((flags & APR_QUEUE_LOCKFREE)
+        && (queue_capacity == 0 || queue_capacity > 0x80000000U)) {
+        return APR_EINVAL;
+    }
+
     queue = apr_palloc(a, sizeof(apr_queue_t));
     *q = queue;
 
@@ -125,12 +164,34 @@ APU_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **q,
         return rv;
     }
 
-    /* Set all the data in the queue to NULL */
-    queue->data = apr_pcalloc(a, queue_capacity * sizeof(void*));
+    queue->flags = flags;
+    if (flags & APR_QUEUE_LOCKFREE) {
+        /* The ring's capacity is rounded up to a power of 2, so that the
+         * positions can wrap around with the sequence numbers.
+         */
+        for (i = 1; i < queue_capacity; i <<= 1)
+            ;
+        queue_capacity = i;
+        queue->data = NULL;
+        queue->cells = apr_palloc(a, queue_capacity * sizeof(queue_cell_t));
+        for (i = 0; i < queue_capacity; i++) {
+            queue->cells[i].seq = i;
+            queue->cells[i].data = NULL;
+        }
+        queue->mask = queue_capacity - 1;
+    }
+    else {
+        /* Set all the data in the queue to NULL */
+        queue->data = apr_pcalloc(a, queue_capacity * sizeof(void*));
+        queue->cells = NULL;
+        queue->mask = 0;
+    }
     queue->bounds = queue_capacity;
     queue->nelts = 0;
     queue->in = 0;
     queue->out = 0;
+    queue->enqueue_pos = 0;
+    queue->dequeue_pos = 0;
     queue->terminated = 0;
     queue->full_waiters = 0;
     queue->empty_waiters = 0;
@@ -140,6 +201,207 @@ APU_DECLARE(apr_status_t) apr_queue_create(apr_queue_t **q,
     return APR_SUCCESS;
 }
 
+/**
+ * Lock-free ring (APR_QUEUE_LOCKFREE), a bounded MPMC queue where
+ * producers and consumers claim runs of cells by advancing enqueue_pos
+ * and dequeue_pos with compare-and-swap, and hand them over to each other
+ * with the cells' sequence numbers.
+ */
+
+/**
+ * Push up to n elements, returns how many were pushed (0 if full).
+ */
+static apr_uint32_t lf_push(apr_queue_t *queue, void **data, apr_uint32_t n)
+{
+    queue_cell_t *cell;
+    apr_uint32_t pos, seq = 0, k, i;
+
+    pos = apr_atomic_read32(&queue->enqueue_pos);
+    for (;;) {
+        for (k = 0; k < n && k <= queue->mask; k++) {
+            cell = &queue->cells[(pos + k) & queue->mask];
+            seq = apr_atomic_read32(&cell->seq);
+            if (seq != pos + k) {
+                break;
+            }
+        }
+        if (k == 0) {
+            if ((apr_int32_t)(seq - pos) < 0) {
+                return 0; /* full */
+            }
+            /* another producer got there first */
+            pos = apr_atomic_read32(&queue->enqueue_pos);
+            continue;
+        }
+        i = apr_atomic_cas32(&queue->enqueue_pos, pos + k, pos);
+        if (i == pos) {
+            break;
+        }
+        pos = i;
+    }
+
+    for (i = 0; i < k; i++) {
+        cell = &queue->cells[(pos + i) & queue->mask];
+        cell->data = data[i];
+        apr_atomic_set32(&cell->seq, pos + i + 1);
+    }
+
+    return k;
+}
+
+/**
+ * Pop up to n elements, returns how many were popped (0 if empty).
+ */
+static apr_uint32_t lf_pop(apr_queue_t *queue, void **data, apr_uint32_t n)
+{
+    queue_cell_t *cell;
+    apr_uint32_t pos, seq = 0, k, i;
+
+    pos = apr_atomic_read32(&queue->dequeue_pos);
+    for (;;) {
+        for (k = 0; k < n && k <= queue->mask; k++) {
+            cell = &queue->cells[(pos + k) & queue->mask];
+            seq = apr_atomic_read32(&cell->seq);
+            if (seq != pos + k + 1) {
+                break;
+            }
+        }
+        if (k == 0) {
+            if ((apr_int32_t)(seq - (pos + 1)) < 0) {
+                return 0; /* empty */
+            }
+            /* another consumer got there first */
+            pos = apr_atomic_read32(&queue->dequeue_pos);
+            continue;
+        }
+        i = apr_atomic_cas32(&queue->dequeue_pos, pos + k, pos);
+        if (i == pos) {
+            break;
+        }
+        pos = i;
+    }
+
+    for (i = 0; i < k; i++) {
+        cell = &queue->cells[(pos + i) & queue->mask];
+        data[i] = cell->data;
+        apr_atomic_set32(&cell->seq, pos + i + queue->mask + 1);
+    }
+
+    return k;
+}
+
+/**
+ * Wake up the threads waiting for the n elements (or slots) just made
+ * available, if any.
+ */
+static apr_status_t lf_wakeup(apr_queue_t *queue,
+                              volatile apr_uint32_t *waiters,
+                              apr_thread_cond_t *cond, apr_uint32_t n)
+{
+    apr_status_t rv;
+
+    if (!apr_atomic_read32(waiters)) {
+        return APR_SUCCESS;
+    }
+
+    rv = apr_thread_mutex_lock(queue->one_big_mutex);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    if (n > 1) {
+        rv = apr_thread_cond_broadcast(cond);
+    }
+    else {
+        rv = apr_thread_cond_signal(cond);
+    }
+    if (rv != APR_SUCCESS) {
+        apr_thread_mutex_unlock(queue->one_big_mutex);
+        return rv;
+    }
+
+    return apr_thread_mutex_unlock(queue->one_big_mutex);
+}
+
+/**
+ * Push or pop (according to push) up to n elements, blocking on the
+ * mutex and condition only if the ring is full or empty.
+ */
+static apr_status_t lf_transfer(apr_queue_t *queue, void **data,
+                                apr_uint32_t n, apr_uint32_t *done,
+                                int push, int block)
+{
+    apr_uint32_t (*transfer)(apr_queue_t *, void **, apr_uint32_t);
+    volatile apr_uint32_t *waiters, *wakees;
+    apr_thread_cond_t *wait, *wake;
+    apr_status_t rv = APR_SUCCESS;
+    apr_uint32_t k;
+
+    if (push) {
+        transfer = lf_push;
+        waiters = &queue->full_waiters;
+        wait = queue->not_full;
+        wakees = &queue->empty_waiters;
+        wake = queue->not_empty;
+    }
+    else {
+        transfer = lf_pop;
+        waiters = &queue->empty_waiters;
+        wait = queue->not_empty;
+        wakees = &queue->full_waiters;
+        wake = queue->not_full;
+    }
+
+    *done = 0;
+
+    if (queue->terminated) {
+        return APR_EOF; /* no more elements ever again */
+    }
+
+    if ((k = transfer(queue, data, n)) == 0) {
+        if (!block) {
+            return APR_EAGAIN;
+        }
+
+        rv = apr_thread_mutex_lock(queue->one_big_mutex);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        /* Announce ourselves before trying again, so that the other
+         * side either sees us waiting or we see its transfer.
+         */
+        apr_atomic_inc32(waiters);
+        if ((k = transfer(queue, data, n)) == 0 && !queue->terminated) {
+            Q_DBG("lock-free wait", queue);
+            rv = apr_thread_cond_wait(wait, queue->one_big_mutex);
+        }
+        apr_atomic_dec32(waiters);
+
+        if (rv != APR_SUCCESS) {
+            apr_thread_mutex_unlock(queue->one_big_mutex);
+            return rv;
+        }
+        rv = apr_thread_mutex_unlock(queue->one_big_mutex);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+
+        /* If we wake up and still can't transfer, we were interrupted */
+        if (k == 0 && (k = transfer(queue, data, n)) == 0) {
+            if (queue->terminated) {
+                return APR_EOF; /* no more elements ever again */
+            }
+            else {
+                return APR_EINTR;
+            }
+        }
+    }
+
+    *done = k;
+
+    return lf_wakeup(queue, wakees, wake, k);
+}
+
 /**
  * Push new data onto the queue. Blocks if the queue is full. Once
  * the push operation has completed, it signals other threads waiting
@@ -149,6 +411,11 @@ APU_DECLARE(apr_status_t) apr_queue_push(apr_queue_t *queue, void *data)
 {
     apr_status_t rv;
 
+    if (queue->flags & APR_QUEUE_LOCKFREE) {
+        apr_uint32_t done;
+        return lf_transfer(queue, &data, 1, &done, 1, 1);
+    }
+
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
@@ -212,6 +479,11 @@ APU_DECLARE(apr_status_t) apr_queue_trypush(apr_queue_t *queue, void *data)
 {
     apr_status_t rv;
 
+    if (queue->flags & APR_QUEUE_LOCKFREE) {
+        apr_uint32_t done;
+        return lf_transfer(queue, &data, 1, &done, 1, 0);
+    }
+
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
@@ -249,6 +521,10 @@ APU_DECLARE(apr_status_t) apr_queue_trypush(apr_queue_t *queue, void *data)
  * not thread safe
  */
 APU_DECLARE(unsigned int) apr_queue_size(apr_queue_t *queue) {
+    if (queue->flags & APR_QUEUE_LOCKFREE) {
+        apr_uint32_t out = apr_atomic_read32(&queue->dequeue_pos);
+        return apr_atomic_read32(&queue->enqueue_pos) - out;
+    }
     return queue->nelts;
 }
 
@@ -262,6 +538,11 @@ APU_DECLARE(apr_status_t) apr_queue_pop(apr_queue_t *queue, void **data)
 {
     apr_status_t rv;
 
+    if (queue->flags & APR_QUEUE_LOCKFREE) {
+        apr_uint32_t done;
+        return lf_transfer(queue, data, 1, &done, 0, 1);
+    }
+
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
@@ -326,6 +607,11 @@ APU_DECLARE(apr_status_t) apr_queue_trypop(apr_queue_t *queue, void **data)
 {
     apr_status_t rv;
 
+    if (queue->flags & APR_QUEUE_LOCKFREE) {
+        apr_uint32_t done;
+        return lf_transfer(queue, data, 1, &done, 0, 0);
+    }
+
     if (queue->terminated) {
         return APR_EOF; /* no more elements ever again */
     }
@@ -359,6 +645,187 @@ APU_DECLARE(apr_status_t) apr_queue_trypop(apr_queue_t *queue, void **data)
     return rv;
 }
 
+/**
+ * Push up to nelts new data onto the queue, blocking only if the queue is
+ * full.  Once the push operation has completed, it signals other threads
+ * waiting in apr_queue_pop() that they may continue consuming.
+ */
+APU_DECLARE(apr_status_t) apr_queue_push_batch(apr_queue_t *queue,
+                                               void **data,
+                                               unsigned int nelts,
+                                               unsigned int *pushed)
+{
+    apr_status_t rv;
+    unsigned int n;
+
+    *pushed = 0;
+
+    if (queue->flags & APR_QUEUE_LOCKFREE) {
+        apr_uint32_t done;
+        if (nelts == 0) {
+            return APR_SUCCESS;
+        }
+        rv = lf_transfer(queue, data, nelts, &done, 1, 1);
+        *pushed = done;
+        return rv;
+    }
+
+    if (queue->terminated) {
+        return APR_EOF; /* no more elements ever again */
+    }
+    if (nelts == 0) {
+        return APR_SUCCESS;
+    }
+
+    rv = apr_thread_mutex_lock(queue->one_big_mutex);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    if (apr_queue_full(queue)) {
+        if (!queue->terminated) {
+            queue->full_waiters++;
+            rv = apr_thread_cond_wait(queue->not_full, queue->one_big_mutex);
+            queue->full_waiters--;
+            if (rv != APR_SUCCESS) {
+                apr_thread_mutex_unlock(queue->one_big_mutex);
+                return rv;
+            }
+        }
+        /* If we wake up and it's still full, then we were interrupted */
+        if (apr_queue_full(queue)) {
+            Q_DBG("queue full (intr)", queue);
+            rv = apr_thread_mutex_unlock(queue->one_big_mutex);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            if (queue->terminated) {
+                return APR_EOF; /* no more elements ever again */
+            }
+            else {
+                return APR_EINTR;
+            }
+        }
+    }
+
+    for (n = 0; n < nelts && !apr_queue_full(queue); n++) {
+        queue->data[queue->in] = data[n];
+        queue->in++;
+        if (queue->in >= queue->bounds)
+            queue->in -= queue->bounds;
+        queue->nelts++;
+    }
+    *pushed = n;
+
+    if (queue->empty_waiters) {
+        Q_DBG("sig !empty", queue);
+        if (n > 1) {
+            rv = apr_thread_cond_broadcast(queue->not_empty);
+        }
+        else {
+            rv = apr_thread_cond_signal(queue->not_empty);
+        }
+        if (rv != APR_SUCCESS) {
+            apr_thread_mutex_unlock(queue->one_big_mutex);
+            return rv;
+        }
+    }
+
+    rv = apr_thread_mutex_unlock(queue->one_big_mutex);
+    return rv;
+}
+
+/**
+ * Retrieves up to nelts items from the queue, blocking only if there are
+ * no items available.  Once retrieved, the items are placed into the
+ * array specified by 'data'.
+ */
+APU_DECLARE(apr_status_t) apr_queue_pop_batch(apr_queue_t *queue,
+                                              void **data,
+                                              unsigned int nelts,
+                                              unsigned int *popped)
+{
+    apr_status_t rv;
+    unsigned int n;
+
+    *popped = 0;
+
+    if (queue->flags & APR_QUEUE_LOCKFREE) {
+        apr_uint32_t done;
+        if (nelts == 0) {
+            return APR_SUCCESS;
+        }
+        rv = lf_transfer(queue, data, nelts, &done, 0, 1);
+        *popped = done;
+        return rv;
+    }
+
+    if (queue->terminated) {
+        return APR_EOF; /* no more elements ever again */
+    }
+    if (nelts == 0) {
+        return APR_SUCCESS;
+    }
+
+    rv = apr_thread_mutex_lock(queue->one_big_mutex);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+
+    if (apr_queue_empty(queue)) {
+        if (!queue->terminated) {
+            queue->empty_waiters++;
+            rv = apr_thread_cond_wait(queue->not_empty, queue->one_big_mutex);
+            queue->empty_waiters--;
+            if (rv != APR_SUCCESS) {
+                apr_thread_mutex_unlock(queue->one_big_mutex);
+                return rv;
+            }
+        }
+        /* If we wake up and it's still empty, then we were interrupted */
+        if (apr_queue_empty(queue)) {
+            Q_DBG("queue empty (intr)", queue);
+            rv = apr_thread_mutex_unlock(queue->one_big_mutex);
+            if (rv != APR_SUCCESS) {
+                return rv;
+            }
+            if (queue->terminated) {
+                return APR_EOF; /* no more elements ever again */
+            }
+            else {
+                return APR_EINTR;
+            }
+        }
+    }
+
+    for (n = 0; n < nelts && !apr_queue_empty(queue); n++) {
+        data[n] = queue->data[queue->out];
+        queue->nelts--;
+
+        queue->out++;
+        if (queue->out >= queue->bounds)
+            queue->out -= queue->bounds;
+    }
+    *popped = n;
+
+    if (queue->full_waiters) {
+        Q_DBG("signal !full", queue);
+        if (n > 1) {
+            rv = apr_thread_cond_broadcast(queue->not_full);
+        }
+        else {
+            rv = apr_thread_cond_signal(queue->not_full);
+        }
+        if (rv != APR_SUCCESS) {
+            apr_thread_mutex_unlock(queue->one_big_mutex);
+            return rv;
+        }
+    }
+
+    rv = apr_thread_mutex_unlock(queue->one_big_mutex);
+    return rv;
+}
+
 APU_DECLARE(apr_status_t) apr_queue_interrupt_all(apr_queue_t *queue)
 {
     apr_status_t rv;
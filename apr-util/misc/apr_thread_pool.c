@@ -21,6 +21,8 @@
 #include "apr_ring.h"
 #include "apr_thread_cond.h"
 #include "apr_portable.h"
+#include "apr_atomic.h"
+#include "apr_tables.h"
 
 #if APR_HAS_THREADS
 
@@ -38,6 +40,7 @@ typedef struct apr_thread_pool_task
         apr_byte_t priority;
         apr_time_t time;
     } dispatch;
+    apr_uint64_t seq;           /* scheduling order, for same time tasks */
 } apr_thread_pool_task_t;
 
 APR_RING_HEAD(apr_thread_pool_tasks, apr_thread_pool_task);
@@ -49,6 +52,18 @@ struct apr_thread_list_elt
     void *current_owner;
     enum { TH_RUN, TH_STOP, TH_PROBATION } state;
     int signal_work_done;
+    /* APR_THREAD_POOL_WORK_STEALING: the worker's own deque, where the
+     * tasks it pushes land and from which the other workers steal.
+     * The deque_lock also protects current_owner and signal_work_done.
+     */
+    apr_thread_mutex_t *deque_lock;
+    struct apr_thread_pool_tasks *deque;
+    apr_thread_pool_task_t *deque_idx[TASK_PRIORITY_SEGS];
+    volatile apr_size_t deque_cnt;
+    struct apr_thread_pool_tasks *recycled; /* used by this worker only */
+    volatile apr_size_t tasks_run;
+    struct apr_thread_list_elt *ws_next;    /* all the workers, ever */
+    apr_uint32_t ws_seed;
 };
 
 APR_RING_HEAD(apr_thread_list, apr_thread_list_elt);
@@ -70,7 +85,9 @@ struct apr_thread_pool
     volatile apr_size_t thd_high;
     volatile apr_size_t thd_timed_out;
     struct apr_thread_pool_tasks *tasks;
-    struct apr_thread_pool_tasks *scheduled_tasks;
+    apr_array_header_t *scheduled_tasks;    /* min-heap by time */
+    apr_uint64_t scheduled_seq;
+    volatile apr_time_t now;    /* last apr_time_now(), for scheduled tasks */
     struct apr_thread_list *busy_thds;
     struct apr_thread_list *idle_thds;
     struct apr_thread_list *dead_thds;
@@ -82,11 +99,18 @@ struct apr_thread_pool
     struct apr_thread_pool_tasks *recycled_tasks;
     struct apr_thread_list *recycled_thds;
     apr_thread_pool_task_t *task_idx[TASK_PRIORITY_SEGS];
+    /* APR_THREAD_POOL_WORK_STEALING */
+    apr_threadkey_t *ws_key;            /* the current thread's elt */
+    struct apr_thread_list_elt *volatile ws_elts;
+    volatile apr_uint32_t ws_nelts;
+    volatile apr_uint32_t ws_task_cnt;  /* # tasks in the workers' deques */
+    volatile apr_time_t scheduled_due;  /* time of the first scheduled task */
 };
 
 static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
                                           apr_size_t init_threads,
                                           apr_size_t max_threads,
+                                          unsigned int flags,
                                           apr_pool_t *pool)
 {
     apr_status_t rv;
@@ -135,11 +159,11 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
         goto CATCH_ENOMEM;
     }
     APR_RING_INIT(me->tasks, apr_thread_pool_task, link);
-    me->scheduled_tasks = apr_palloc(me->pool, sizeof(*me->scheduled_tasks));
+    me->scheduled_tasks = apr_array_make(me->pool, 16,
+                                         sizeof(apr_thread_pool_task_t *));
     if (!me->scheduled_tasks) {
         goto CATCH_ENOMEM;
     }
-    APR_RING_INIT(me->scheduled_tasks, apr_thread_pool_task, link);
     me->recycled_tasks = apr_palloc(me->pool, sizeof(*me->recycled_tasks));
     if (!me->recycled_tasks) {
         goto CATCH_ENOMEM;
@@ -165,6 +189,16 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
         goto CATCH_ENOMEM;
     }
     APR_RING_INIT(me->recycled_thds, apr_thread_list_elt, link);
+    if (flags & APR_THREAD_POOL_WORK_STEALING) {
+        rv = apr_threadkey_private_create(&me->ws_key, NULL, me->pool);
+        if (APR_SUCCESS != rv) {
+            apr_thread_cond_destroy(me->all_done);
+            apr_thread_cond_destroy(me->work_done);
+            apr_thread_cond_destroy(me->more_work);
+            apr_thread_mutex_destroy(me->lock);
+            return rv;
+        }
+    }
     goto FINAL_EXIT;
   CATCH_ENOMEM:
     rv = APR_ENOMEM;
@@ -176,26 +210,237 @@ static apr_status_t thread_pool_construct(apr_thread_pool_t **tp,
     return rv;
 }
 
+/*
+ * Remove and return the first (highest priority) task of a non-empty
+ * priority ring, maintaining its segments index.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_thread_pool_task_t *pop_first_task(struct apr_thread_pool_tasks *tasks,
+                                              apr_thread_pool_task_t **task_idx)
+{
+    apr_thread_pool_task_t *task;
+    int seg;
+
+    task = APR_RING_FIRST(tasks);
+    assert(task != NULL);
+    assert(task != APR_RING_SENTINEL(tasks, apr_thread_pool_task, link));
+    seg = TASK_PRIORITY_SEG(task);
+    if (task == task_idx[seg]) {
+        task_idx[seg] = APR_RING_NEXT(task, link);
+        if (task_idx[seg] == APR_RING_SENTINEL(tasks,
+                                               apr_thread_pool_task, link)
+            || TASK_PRIORITY_SEG(task_idx[seg]) != seg) {
+            task_idx[seg] = NULL;
+        }
+    }
+    APR_RING_REMOVE(task, link);
+    return task;
+}
+
+/*
+ * Insert the task in a priority ring, after (push) or before (top) the
+ * tasks of the same priority, maintaining its segments index.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void insert_task(struct apr_thread_pool_tasks *tasks,
+                        apr_thread_pool_task_t **task_idx,
+                        apr_thread_pool_task_t * const t, int push)
+{
+    int seg;
+    int next;
+    apr_thread_pool_task_t *t_loc;
+
+    seg = TASK_PRIORITY_SEG(t);
+    if (!task_idx[seg]) {
+        /* The only one within the priority segment */
+        for (next = seg - 1; next >= 0; next--) {
+            if (task_idx[next]) {
+                APR_RING_INSERT_BEFORE(task_idx[next], t, link);
+                break;
+            }
+        }
+        if (0 > next) {
+            APR_RING_INSERT_TAIL(tasks, t, apr_thread_pool_task, link);
+        }
+        task_idx[seg] = t;
+        return;
+    }
+
+    /* Find the first element with same or lower priority */
+    assert(APR_RING_SENTINEL(tasks, apr_thread_pool_task, link) !=
+           task_idx[seg]);
+    t_loc = task_idx[seg];
+    while (APR_RING_SENTINEL(tasks, apr_thread_pool_task, link) != t_loc
+           && t_loc->dispatch.priority > t->dispatch.priority) {
+        t_loc = APR_RING_NEXT(t_loc, link);
+    }
+
+    if (push) {
+        while (APR_RING_SENTINEL(tasks, apr_thread_pool_task, link) !=
+               t_loc && t_loc->dispatch.priority >= t->dispatch.priority) {
+            t_loc = APR_RING_NEXT(t_loc, link);
+        }
+    }
+    APR_RING_INSERT_BEFORE(t_loc, t, link);
+    if (!push) {
+        if (t_loc == task_idx[seg]) {
+            task_idx[seg] = t;
+        }
+    }
+}
+
+/*
+ * Remove the tasks of the owner (or all of them if NULL) from a priority
+ * ring, maintaining its segments index, and return how many.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_size_t remove_owner_tasks(struct apr_thread_pool_tasks *tasks,
+                                     apr_thread_pool_task_t **task_idx,
+                                     void *owner)
+{
+    apr_thread_pool_task_t *t_loc;
+    apr_thread_pool_task_t *next;
+    apr_size_t cnt = 0;
+    int seg;
+
+    t_loc = APR_RING_FIRST(tasks);
+    while (t_loc != APR_RING_SENTINEL(tasks, apr_thread_pool_task, link)) {
+        next = APR_RING_NEXT(t_loc, link);
+        if (!owner || t_loc->owner == owner) {
+            ++cnt;
+            seg = TASK_PRIORITY_SEG(t_loc);
+            if (t_loc == task_idx[seg]) {
+                task_idx[seg] = APR_RING_NEXT(t_loc, link);
+                if (task_idx[seg] == APR_RING_SENTINEL(tasks,
+                                                       apr_thread_pool_task,
+                                                       link)
+                    || TASK_PRIORITY_SEG(task_idx[seg]) != seg) {
+                    task_idx[seg] = NULL;
+                }
+            }
+            APR_RING_REMOVE(t_loc, link);
+        }
+        t_loc = next;
+    }
+    return cnt;
+}
+
+/*
+ * Scheduled tasks are kept in a binary min-heap ordered by time (then by
+ * scheduling order), so that adding and taking the first one is O(log n).
+ */
+#define SCHEDULED_TASKS(me) \
+    ((apr_thread_pool_task_t **)(me)->scheduled_tasks->elts)
+
+static APR_INLINE int scheduled_before(const apr_thread_pool_task_t *a,
+                                       const apr_thread_pool_task_t *b)
+{
+    return a->dispatch.time < b->dispatch.time
+           || (a->dispatch.time == b->dispatch.time && a->seq < b->seq);
+}
+
+static void scheduled_sift_up(apr_thread_pool_task_t **heap, apr_size_t i)
+{
+    apr_thread_pool_task_t *t = heap[i];
+
+    while (i > 0) {
+        apr_size_t parent = (i - 1) / 2;
+        if (!scheduled_before(t, heap[parent])) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = t;
+}
+
+static void scheduled_sift_down(apr_thread_pool_task_t **heap, apr_size_t n,
+                                apr_size_t i)
+{
+    apr_thread_pool_task_t *t = heap[i];
+
+    for (;;) {
+        apr_size_t child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && scheduled_before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!scheduled_before(heap[child], t)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = t;
+}
+
+/*
+ * Update the due time hint of the first scheduled task.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void scheduled_due_update(apr_thread_pool_t *me)
+{
+    if (me->scheduled_task_cnt > 0) {
+        me->scheduled_due = SCHEDULED_TASKS(me)[0]->dispatch.time;
+    }
+}
+
+/*
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void scheduled_task_add(apr_thread_pool_t *me,
+                               apr_thread_pool_task_t *t)
+{
+    t->seq = me->scheduled_seq++;
+    *(apr_thread_pool_task_t **)apr_array_push(me->scheduled_tasks) = t;
+    scheduled_sift_up(SCHEDULED_TASKS(me), me->scheduled_tasks->nelts - 1);
+    ++me->scheduled_task_cnt;
+    scheduled_due_update(me);
+}
+
+/*
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_thread_pool_task_t *scheduled_task_pop(apr_thread_pool_t *me)
+{
+    apr_thread_pool_task_t **heap = SCHEDULED_TASKS(me);
+    apr_thread_pool_task_t *task = heap[0];
+    int n = --me->scheduled_tasks->nelts;
+
+    if (n > 0) {
+        heap[0] = heap[n];
+        scheduled_sift_down(heap, n, 0);
+    }
+    --me->scheduled_task_cnt;
+    scheduled_due_update(me);
+    return task;
+}
+
 /*
  * NOTE: This function is not thread safe by itself. Caller should hold the lock
  */
 static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
 {
     apr_thread_pool_task_t *task = NULL;
-    int seg;
 
     /* check for scheduled tasks */
     if (me->scheduled_task_cnt > 0) {
-        task = APR_RING_FIRST(me->scheduled_tasks);
+        task = SCHEDULED_TASKS(me)[0];
         assert(task != NULL);
-        assert(task !=
-               APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                 link));
-        /* if it's time */
-        if (task->dispatch.time <= apr_time_now()) {
-            --me->scheduled_task_cnt;
-            APR_RING_REMOVE(task, link);
-            return task;
+        /* if it's time, reading the clock only if it's not with the last
+         * value (so that the tasks due at once don't read it each)
+         */
+        if (task->dispatch.time > me->now) {
+            me->now = apr_time_now();
+        }
+        if (task->dispatch.time <= me->now) {
+            return scheduled_task_pop(me);
         }
     }
     /* check for normal tasks if we're not returning a scheduled task */
@@ -203,33 +448,307 @@ static apr_thread_pool_task_t *pop_task(apr_thread_pool_t * me)
         return NULL;
     }
 
-    task = APR_RING_FIRST(me->tasks);
-    assert(task != NULL);
-    assert(task != APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link));
     --me->task_cnt;
-    seg = TASK_PRIORITY_SEG(task);
-    if (task == me->task_idx[seg]) {
-        me->task_idx[seg] = APR_RING_NEXT(task, link);
-        if (me->task_idx[seg] == APR_RING_SENTINEL(me->tasks,
-                                                   apr_thread_pool_task, link)
-            || TASK_PRIORITY_SEG(me->task_idx[seg]) != seg) {
-            me->task_idx[seg] = NULL;
+    return pop_first_task(me->tasks, me->task_idx);
+}
+
+static apr_interval_time_t waiting_time(apr_thread_pool_t * me)
+{
+    apr_thread_pool_task_t *task = NULL;
+
+    task = SCHEDULED_TASKS(me)[0];
+    assert(task != NULL);
+    me->now = apr_time_now();
+    if (task->dispatch.time < me->now) {
+        /* due already, don't wait forever */
+        return 0;
+    }
+    return task->dispatch.time - me->now;
+}
+
+/*
+ * Work stealing (APR_THREAD_POOL_WORK_STEALING)
+ *
+ * Each worker has its own deque, a priority ring like me->tasks protected
+ * by the worker's deque_lock, where the tasks pushed from within the worker
+ * land.  A worker runs the tasks of its deque, then steals from the deques
+ * of the other workers (starting at a random one), then takes from the
+ * shared (scheduled and normal) tasks under me->lock.  The shared tasks
+ * come first still if they have a higher priority (segment) or are due.
+ *
+ * Lock order: me->lock, then deque_lock(s) by increasing address.
+ */
+
+/*
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_status_t ws_elt_init(apr_thread_pool_t *me,
+                                struct apr_thread_list_elt *elt)
+{
+    apr_status_t rv;
+
+    rv = apr_thread_mutex_create(&elt->deque_lock, APR_THREAD_MUTEX_DEFAULT,
+                                 me->pool);
+    if (APR_SUCCESS != rv) {
+        return rv;
+    }
+    elt->deque = apr_palloc(me->pool, sizeof(*elt->deque));
+    elt->recycled = apr_palloc(me->pool, sizeof(*elt->recycled));
+    if (!elt->deque || !elt->recycled) {
+        apr_thread_mutex_destroy(elt->deque_lock);
+        return APR_ENOMEM;
+    }
+    APR_RING_INIT(elt->deque, apr_thread_pool_task, link);
+    APR_RING_INIT(elt->recycled, apr_thread_pool_task, link);
+    memset(elt->deque_idx, 0, sizeof(elt->deque_idx));
+    elt->deque_cnt = 0;
+    elt->tasks_run = 0;
+    elt->ws_seed = ((apr_uint32_t)apr_time_now() ^ me->ws_nelts) | 1;
+
+    /* Publish it for the thieves, elts are never freed (but recycled) */
+    elt->ws_next = me->ws_elts;
+    apr_atomic_xchgptr((volatile void **)&me->ws_elts, elt);
+    apr_atomic_inc32(&me->ws_nelts);
+
+    return APR_SUCCESS;
+}
+
+static apr_uint32_t ws_random(struct apr_thread_list_elt *elt)
+{
+    /* xorshift32 */
+    apr_uint32_t x = elt->ws_seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    elt->ws_seed = x;
+    return x;
+}
+
+/*
+ * NOTE: This function is not thread safe by itself. Caller should hold the
+ * deque_lock of elt
+ */
+static apr_thread_pool_task_t *ws_take(apr_thread_pool_t *me,
+                                       struct apr_thread_list_elt *elt)
+{
+    --elt->deque_cnt;
+    apr_atomic_dec32(&me->ws_task_cnt);
+    return pop_first_task(elt->deque, elt->deque_idx);
+}
+
+/*
+ * Whether the shared tasks should be run before the worker's own, that
+ * is if one is due or has a higher priority (segment).  Unlocked hints.
+ */
+static int ws_prefer_shared(apr_thread_pool_t *me,
+                            struct apr_thread_list_elt *elt)
+{
+    int seg;
+
+    if (me->scheduled_task_cnt && (me->scheduled_due <= me->now
+                                   || me->scheduled_due <= apr_time_now())) {
+        return 1;
+    }
+    if (me->task_cnt) {
+        for (seg = TASK_PRIORITY_SEGS - 1; seg >= 0; seg--) {
+            if (me->task_idx[seg]) {
+                return 1;
+            }
+            if (elt->deque_idx[seg]) {
+                return 0;
+            }
         }
     }
-    APR_RING_REMOVE(task, link);
+    return 0;
+}
+
+/*
+ * Steal the first task of another worker's deque, or return NULL.
+ */
+static apr_thread_pool_task_t *ws_steal(apr_thread_pool_t *me,
+                                        struct apr_thread_list_elt *elt)
+{
+    struct apr_thread_list_elt *first, *victim;
+    apr_thread_mutex_t *lock1, *lock2;
+    apr_thread_pool_task_t *task = NULL;
+    apr_uint32_t n, i;
+
+    n = apr_atomic_read32(&me->ws_nelts);
+    first = apr_atomic_casptr((volatile void **)&me->ws_elts, NULL, NULL);
+    if (n < 2 || !first) {
+        return NULL;
+    }
+
+    for (victim = first, i = ws_random(elt) % n; i && victim; i--) {
+        victim = victim->ws_next;
+    }
+    for (i = 0; i < n && !task; i++, victim = victim->ws_next) {
+        if (!victim) {
+            victim = first;
+        }
+        if (victim == elt || !victim->deque_cnt) {
+            continue;
+        }
+
+        /* The task must be ours before it's not theirs, for
+         * apr_thread_pool_tasks_cancel() to see it.
+         */
+        if (victim < elt) {
+            lock1 = victim->deque_lock;
+            lock2 = elt->deque_lock;
+        }
+        else {
+            lock1 = elt->deque_lock;
+            lock2 = victim->deque_lock;
+        }
+        apr_thread_mutex_lock(lock1);
+        apr_thread_mutex_lock(lock2);
+        if (victim->deque_cnt) {
+            task = ws_take(me, victim);
+            elt->current_owner = task->owner;
+        }
+        apr_thread_mutex_unlock(lock2);
+        apr_thread_mutex_unlock(lock1);
+    }
+
     return task;
 }
 
-static apr_interval_time_t waiting_time(apr_thread_pool_t * me)
+/*
+ * Take the next task for the worker, from the shared tasks, its own deque
+ * or another's, or return NULL if there is none.
+ */
+static apr_thread_pool_task_t *ws_pop_task(apr_thread_pool_t *me,
+                                           struct apr_thread_list_elt *elt)
 {
     apr_thread_pool_task_t *task = NULL;
+    int shared_first = ws_prefer_shared(me, elt);
 
-    task = APR_RING_FIRST(me->scheduled_tasks);
-    assert(task != NULL);
-    assert(task !=
-           APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                             link));
-    return task->dispatch.time - apr_time_now();
+    if (!shared_first) {
+        apr_thread_mutex_lock(elt->deque_lock);
+        if (elt->deque_cnt) {
+            task = ws_take(me, elt);
+            elt->current_owner = task->owner;
+        }
+        apr_thread_mutex_unlock(elt->deque_lock);
+        if (task) {
+            return task;
+        }
+    }
+
+    apr_thread_mutex_lock(me->lock);
+    task = pop_task(me);
+    if (task) {
+        apr_thread_mutex_lock(elt->deque_lock);
+        elt->current_owner = task->owner;
+        apr_thread_mutex_unlock(elt->deque_lock);
+    }
+    apr_thread_mutex_unlock(me->lock);
+    if (task) {
+        return task;
+    }
+
+    if (shared_first) {
+        apr_thread_mutex_lock(elt->deque_lock);
+        if (elt->deque_cnt) {
+            task = ws_take(me, elt);
+            elt->current_owner = task->owner;
+        }
+        apr_thread_mutex_unlock(elt->deque_lock);
+        if (task) {
+            return task;
+        }
+    }
+
+    return ws_steal(me, elt);
+}
+
+/*
+ * Run the tasks available to the worker, without holding me->lock (which
+ * the caller holds on entry and exit).
+ */
+static void ws_run_tasks(apr_thread_pool_t *me,
+                         struct apr_thread_list_elt *elt, apr_thread_t *t)
+{
+    apr_thread_pool_task_t *task;
+    int signal_work_done;
+
+    apr_thread_mutex_unlock(me->lock);
+
+    do {
+        task = ws_pop_task(me, elt);
+        if (!task) {
+            break;
+        }
+        ++elt->tasks_run;
+
+        /* Run the task (or drop it if terminated already) */
+        if (!me->terminated) {
+            apr_thread_data_set(task, "apr_thread_pool_task", NULL, t);
+            task->func(t, task->param);
+        }
+
+        APR_RING_INSERT_TAIL(elt->recycled, task, apr_thread_pool_task, link);
+
+        apr_thread_mutex_lock(elt->deque_lock);
+        elt->current_owner = NULL;
+        signal_work_done = elt->signal_work_done;
+        elt->signal_work_done = 0;
+        apr_thread_mutex_unlock(elt->deque_lock);
+
+        if (signal_work_done) {
+            apr_thread_mutex_lock(me->lock);
+            apr_thread_cond_signal(me->work_done);
+            apr_thread_mutex_unlock(me->lock);
+        }
+    } while (elt->state != TH_STOP);
+
+    apr_thread_mutex_lock(me->lock);
+}
+
+/*
+ * Whether any worker has tasks in its deque.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static int ws_has_tasks(apr_thread_pool_t *me)
+{
+    struct apr_thread_list_elt *elt;
+    apr_size_t n = 0;
+
+    for (elt = me->ws_elts; elt && !n; elt = elt->ws_next) {
+        apr_thread_mutex_lock(elt->deque_lock);
+        n = elt->deque_cnt;
+        apr_thread_mutex_unlock(elt->deque_lock);
+    }
+    return n != 0;
+}
+
+/*
+ * Give the tasks of a dying worker to the shared queue.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static void ws_elt_release(apr_thread_pool_t *me,
+                           struct apr_thread_list_elt *elt)
+{
+    apr_thread_pool_task_t *task;
+    int moved = 0;
+
+    apr_thread_mutex_lock(elt->deque_lock);
+    while (elt->deque_cnt) {
+        task = ws_take(me, elt);
+        insert_task(me->tasks, me->task_idx, task, 1);
+        me->task_cnt++;
+        moved = 1;
+    }
+    apr_thread_mutex_unlock(elt->deque_lock);
+
+    APR_RING_CONCAT(me->recycled_tasks, elt->recycled,
+                    apr_thread_pool_task, link);
+    if (moved) {
+        apr_thread_cond_broadcast(me->more_work);
+    }
 }
 
 /*
@@ -245,6 +764,10 @@ static struct apr_thread_list_elt *elt_new(apr_thread_pool_t * me,
         if (NULL == elt) {
             return NULL;
         }
+        elt->deque_lock = NULL;
+        if (me->ws_key && APR_SUCCESS != ws_elt_init(me, elt)) {
+            return NULL;
+        }
     }
     else {
         elt = APR_RING_FIRST(me->recycled_thds);
@@ -281,6 +804,9 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
         apr_thread_mutex_unlock(me->lock);
         apr_thread_exit(t, APR_ENOMEM);
     }
+    if (me->ws_key) {
+        apr_threadkey_private_set(elt, me->ws_key);
+    }
 
     for (;;) {
         /* Test if not new element, it is awakened from idle */
@@ -293,7 +819,10 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
             ++me->busy_cnt;
             APR_RING_INSERT_TAIL(me->busy_thds, elt,
                                  apr_thread_list_elt, link);
-            do {
+            if (me->ws_key) {
+                ws_run_tasks(me, elt, t);
+            }
+            else do {
                 task = pop_task(me);
                 if (!task) {
                     break;
@@ -337,6 +866,11 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
         ++me->idle_cnt;
         APR_RING_INSERT_TAIL(me->idle_thds, elt, apr_thread_list_elt, link);
 
+        /* Don't wait for tasks pushed to the deques (see ws_add_task()) */
+        if (me->ws_key && ws_has_tasks(me)) {
+            continue;
+        }
+
         /* 
          * If there is a scheduled task, always scheduled to perform that task.
          * Since there is no guarantee that current idle threads are scheduled
@@ -360,6 +894,10 @@ static void *APR_THREAD_FUNC thread_pool_func(apr_thread_t * t, void *param)
     }
 
     /* Dead thread, to be joined */
+    if (me->ws_key) {
+        ws_elt_release(me, elt);
+        apr_threadkey_private_set(NULL, me->ws_key);
+    }
     APR_RING_INSERT_TAIL(me->dead_thds, elt, apr_thread_list_elt, link);
     if (--me->thd_cnt == 0 && me->terminated) {
         apr_thread_cond_signal(me->all_done);
@@ -414,6 +952,15 @@ APU_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t ** me,
                                                  apr_size_t init_threads,
                                                  apr_size_t max_threads,
                                                  apr_pool_t * pool)
+{
+    return apr_thread_pool_create_ex(me, init_threads, max_threads, 0, pool);
+}
+
+APU_DECLARE(apr_status_t) apr_thread_pool_create_ex(apr_thread_pool_t ** me,
+                                                    apr_size_t init_threads,
+                                                    apr_size_t max_threads,
+                                                    unsigned int flags,
+                                                    apr_pool_t * pool)
 {
     apr_thread_t *t;
     apr_status_t rv = APR_SUCCESS;
@@ -421,7 +968,7 @@ APU_DECLARE(apr_status_t) apr_thread_pool_create(apr_thread_pool_t ** me,
 
     *me = NULL;
 
-    rv = thread_pool_construct(&tp, init_threads, max_threads, pool);
+    rv = thread_pool_construct(&tp, init_threads, max_threads, flags, pool);
     if (APR_SUCCESS != rv)
         return rv;
     apr_pool_pre_cleanup_register(tp->pool, tp, thread_pool_cleanup);
@@ -490,7 +1037,8 @@ static apr_thread_pool_task_t *task_new(apr_thread_pool_t * me,
     t->param = param;
     t->owner = owner;
     if (time > 0) {
-        t->dispatch.time = apr_time_now() + time;
+        me->now = apr_time_now();
+        t->dispatch.time = me->now + time;
     }
     else {
         t->dispatch.priority = priority;
@@ -498,48 +1046,6 @@ static apr_thread_pool_task_t *task_new(apr_thread_pool_t * me,
     return t;
 }
 
-/*
- * Test it the task is the only one within the priority segment. 
- * If it is not, return the first element with same or lower priority. 
- * Otherwise, add the task into the queue and return NULL.
- *
- * NOTE: This function is not thread safe by itself. Caller should hold the lock
- */
-static apr_thread_pool_task_t *add_if_empty(apr_thread_pool_t * me,
-                                            apr_thread_pool_task_t * const t)
-{
-    int seg;
-    int next;
-    apr_thread_pool_task_t *t_next;
-
-    seg = TASK_PRIORITY_SEG(t);
-    if (me->task_idx[seg]) {
-        assert(APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) !=
-               me->task_idx[seg]);
-        t_next = me->task_idx[seg];
-        while (t_next->dispatch.priority > t->dispatch.priority) {
-            t_next = APR_RING_NEXT(t_next, link);
-            if (APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) ==
-                t_next) {
-                return t_next;
-            }
-        }
-        return t_next;
-    }
-
-    for (next = seg - 1; next >= 0; next--) {
-        if (me->task_idx[next]) {
-            APR_RING_INSERT_BEFORE(me->task_idx[next], t, link);
-            break;
-        }
-    }
-    if (0 > next) {
-        APR_RING_INSERT_TAIL(me->tasks, t, apr_thread_pool_task, link);
-    }
-    me->task_idx[seg] = t;
-    return NULL;
-}
-
 /*
 *   schedule a task to run in "time" microseconds. Find the spot in the ring where
 *   the time fits. Adjust the short_time so the thread wakes up when the time is reached.
@@ -549,7 +1055,6 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
                                   void *owner, apr_interval_time_t time)
 {
     apr_thread_pool_task_t *t;
-    apr_thread_pool_task_t *t_loc;
     apr_thread_t *thd;
     apr_status_t rv = APR_SUCCESS;
 
@@ -569,26 +1074,7 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
         apr_thread_mutex_unlock(me->lock);
         return APR_ENOMEM;
     }
-    t_loc = APR_RING_FIRST(me->scheduled_tasks);
-    while (NULL != t_loc) {
-        /* if the time is less than the entry insert ahead of it */
-        if (t->dispatch.time < t_loc->dispatch.time) {
-            ++me->scheduled_task_cnt;
-            APR_RING_INSERT_BEFORE(t_loc, t, link);
-            break;
-        }
-        else {
-            t_loc = APR_RING_NEXT(t_loc, link);
-            if (t_loc ==
-                APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                                  link)) {
-                ++me->scheduled_task_cnt;
-                APR_RING_INSERT_TAIL(me->scheduled_tasks, t,
-                                     apr_thread_pool_task, link);
-                break;
-            }
-        }
-    }
+    scheduled_task_add(me, t);
     /* there should be at least one thread for scheduled tasks */
     if (0 == me->thd_cnt) {
         rv = apr_thread_create(&thd, NULL, thread_pool_func, me, me->pool);
@@ -598,7 +1084,78 @@ static apr_status_t schedule_task(apr_thread_pool_t *me,
                 me->thd_high = me->thd_cnt;
         }
     }
-    apr_thread_cond_signal(me->more_work);
+    /* The idle threads wait for the first scheduled task only */
+    if (SCHEDULED_TASKS(me)[0] == t) {
+        apr_thread_cond_signal(me->more_work);
+    }
+    apr_thread_mutex_unlock(me->lock);
+
+    return rv;
+}
+
+/*
+ * Add a task pushed from a worker to its own deque.
+ */
+static apr_status_t ws_add_task(apr_thread_pool_t *me,
+                                struct apr_thread_list_elt *elt,
+                                apr_thread_start_t func, void *param,
+                                apr_byte_t priority, int push, void *owner)
+{
+    apr_thread_pool_task_t *t;
+    apr_thread_t *thd;
+    apr_size_t cnt;
+    apr_status_t rv = APR_SUCCESS;
+
+    if (me->terminated) {
+        /* Let the caller know that we are done */
+        return APR_NOTFOUND;
+    }
+
+    if (APR_RING_EMPTY(elt->recycled, apr_thread_pool_task, link)) {
+        apr_thread_mutex_lock(me->lock);
+        t = task_new(me, func, param, priority, owner, 0);
+        apr_thread_mutex_unlock(me->lock);
+        if (NULL == t) {
+            return APR_ENOMEM;
+        }
+    }
+    else {
+        t = APR_RING_FIRST(elt->recycled);
+        APR_RING_REMOVE(t, link);
+        APR_RING_ELEM_INIT(t, link);
+        t->func = func;
+        t->param = param;
+        t->owner = owner;
+        t->dispatch.priority = priority;
+    }
+
+    apr_thread_mutex_lock(elt->deque_lock);
+    insert_task(elt->deque, elt->deque_idx, t, push);
+    ++elt->deque_cnt;
+    apr_thread_mutex_unlock(elt->deque_lock);
+
+    apr_atomic_inc32(&me->ws_task_cnt);
+
+    /* Wake up an idle worker to steal the task, or start one. An idle
+     * worker checks the deques after being accounted idle (under me->lock)
+     * and before waiting, so either it sees the task or we see it idle.
+     */
+    apr_thread_mutex_lock(me->lock);
+    cnt = me->task_cnt + apr_atomic_read32(&me->ws_task_cnt);
+    if (cnt > me->tasks_high) {
+        me->tasks_high = cnt;
+    }
+    if (me->idle_cnt || (me->thd_cnt < me->thd_max && cnt > me->threshold)) {
+        if (0 == me->idle_cnt && !me->terminated) {
+            rv = apr_thread_create(&thd, NULL, thread_pool_func, me, me->pool);
+            if (APR_SUCCESS == rv) {
+                ++me->thd_cnt;
+                if (me->thd_cnt > me->thd_high)
+                    me->thd_high = me->thd_cnt;
+            }
+        }
+        apr_thread_cond_signal(me->more_work);
+    }
     apr_thread_mutex_unlock(me->lock);
 
     return rv;
@@ -609,10 +1166,19 @@ static apr_status_t add_task(apr_thread_pool_t *me, apr_thread_start_t func,
                              void *owner)
 {
     apr_thread_pool_task_t *t;
-    apr_thread_pool_task_t *t_loc;
     apr_thread_t *thd;
     apr_status_t rv = APR_SUCCESS;
 
+    if (me->ws_key) {
+        struct apr_thread_list_elt *elt = NULL;
+
+        /* Pushed from a worker of this pool? */
+        apr_threadkey_private_get((void **)&elt, me->ws_key);
+        if (elt) {
+            return ws_add_task(me, elt, func, param, priority, push, owner);
+        }
+    }
+
     apr_thread_mutex_lock(me->lock);
 
     if (me->terminated) {
@@ -630,25 +1196,8 @@ static apr_status_t add_task(apr_thread_pool_t *me, apr_thread_start_t func,
         return APR_ENOMEM;
     }
 
-    t_loc = add_if_empty(me, t);
-    if (NULL == t_loc) {
-        goto FINAL_EXIT;
-    }
-
-    if (push) {
-        while (APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link) !=
-               t_loc && t_loc->dispatch.priority >= t->dispatch.priority) {
-            t_loc = APR_RING_NEXT(t_loc, link);
-        }
-    }
-    APR_RING_INSERT_BEFORE(t_loc, t, link);
-    if (!push) {
-        if (t_loc == me->task_idx[TASK_PRIORITY_SEG(t)]) {
-            me->task_idx[TASK_PRIORITY_SEG(t)] = t;
-        }
-    }
+    insert_task(me->tasks, me->task_idx, t, push);
 
-  FINAL_EXIT:
     me->task_cnt++;
     if (me->task_cnt > me->tasks_high)
         me->tasks_high = me->task_cnt;
@@ -698,48 +1247,53 @@ APU_DECLARE(apr_status_t) apr_thread_pool_top(apr_thread_pool_t *me,
 static apr_status_t remove_scheduled_tasks(apr_thread_pool_t *me,
                                            void *owner)
 {
-    apr_thread_pool_task_t *t_loc;
-    apr_thread_pool_task_t *next;
+    apr_thread_pool_task_t **heap = SCHEDULED_TASKS(me);
+    apr_size_t i, n = 0;
 
-    t_loc = APR_RING_FIRST(me->scheduled_tasks);
-    while (t_loc !=
-           APR_RING_SENTINEL(me->scheduled_tasks, apr_thread_pool_task,
-                             link)) {
-        next = APR_RING_NEXT(t_loc, link);
+    /* Keep the others in place and rebuild the heap, in linear time */
+    for (i = 0; i < (apr_size_t)me->scheduled_tasks->nelts; i++) {
         /* if this is the owner remove it */
-        if (!owner || t_loc->owner == owner) {
-            --me->scheduled_task_cnt;
-            APR_RING_REMOVE(t_loc, link);
+        if (!owner || heap[i]->owner == owner) {
+            APR_RING_INSERT_TAIL(me->recycled_tasks, heap[i],
+                                 apr_thread_pool_task, link);
         }
-        t_loc = next;
+        else {
+            heap[n++] = heap[i];
+        }
+    }
+    me->scheduled_tasks->nelts = (int)n;
+    me->scheduled_task_cnt = n;
+    for (i = n / 2; i-- > 0;) {
+        scheduled_sift_down(heap, n, i);
     }
+    scheduled_due_update(me);
     return APR_SUCCESS;
 }
 
 static apr_status_t remove_tasks(apr_thread_pool_t *me, void *owner)
 {
-    apr_thread_pool_task_t *t_loc;
-    apr_thread_pool_task_t *next;
-    int seg;
+    me->task_cnt -= remove_owner_tasks(me->tasks, me->task_idx, owner);
+    return APR_SUCCESS;
+}
 
-    t_loc = APR_RING_FIRST(me->tasks);
-    while (t_loc != APR_RING_SENTINEL(me->tasks, apr_thread_pool_task, link)) {
-        next = APR_RING_NEXT(t_loc, link);
-        if (!owner || t_loc->owner == owner) {
-            --me->task_cnt;
-            seg = TASK_PRIORITY_SEG(t_loc);
-            if (t_loc == me->task_idx[seg]) {
-                me->task_idx[seg] = APR_RING_NEXT(t_loc, link);
-                if (me->task_idx[seg] == APR_RING_SENTINEL(me->tasks,
-                                                           apr_thread_pool_task,
-                                                           link)
-                    || TASK_PRIORITY_SEG(me->task_idx[seg]) != seg) {
-                    me->task_idx[seg] = NULL;
-                }
-            }
-            APR_RING_REMOVE(t_loc, link);
+/*
+ * Remove the tasks of the owner from the workers' deques.
+ *
+ * NOTE: This function is not thread safe by itself. Caller should hold the lock
+ */
+static apr_status_t ws_remove_tasks(apr_thread_pool_t *me, void *owner)
+{
+    struct apr_thread_list_elt *elt;
+    apr_size_t cnt;
+
+    for (elt = me->ws_elts; elt; elt = elt->ws_next) {
+        apr_thread_mutex_lock(elt->deque_lock);
+        if (elt->deque_cnt) {
+            cnt = remove_owner_tasks(elt->deque, elt->deque_idx, owner);
+            elt->deque_cnt -= cnt;
+            apr_atomic_sub32(&me->ws_task_cnt, (apr_uint32_t)cnt);
         }
-        t_loc = next;
+        apr_thread_mutex_unlock(elt->deque_lock);
     }
     return APR_SUCCESS;
 }
@@ -754,7 +1308,20 @@ static void wait_on_busy_threads(apr_thread_pool_t *me, void *owner)
 
     elt = APR_RING_FIRST(me->busy_thds);
     while (elt != APR_RING_SENTINEL(me->busy_thds, apr_thread_list_elt, link)) {
-        if (owner ? owner != elt->current_owner : !elt->current_owner) {
+        int busy;
+
+        if (me->ws_key) {
+            /* The worker runs its tasks without me->lock */
+            apr_thread_mutex_lock(elt->deque_lock);
+        }
+        busy = owner ? owner == elt->current_owner : !!elt->current_owner;
+        if (busy) {
+            elt->signal_work_done = 1;
+        }
+        if (me->ws_key) {
+            apr_thread_mutex_unlock(elt->deque_lock);
+        }
+        if (!busy) {
             elt = APR_RING_NEXT(elt, link);
             continue;
         }
@@ -770,7 +1337,6 @@ static void wait_on_busy_threads(apr_thread_pool_t *me, void *owner)
 #endif
 #endif
 
-        elt->signal_work_done = 1;
         apr_thread_cond_wait(me->work_done, me->lock);
 
         /* Restart */
@@ -794,6 +1360,9 @@ APU_DECLARE(apr_status_t) apr_thread_pool_tasks_cancel(apr_thread_pool_t *me,
     if (me->scheduled_task_cnt > 0) {
         rv = remove_scheduled_tasks(me, owner);
     }
+    if (me->ws_task_cnt > 0) {
+        rv = ws_remove_tasks(me, owner);
+    }
 
     wait_on_busy_threads(me, owner);
 
@@ -804,7 +1373,7 @@ APU_DECLARE(apr_status_t) apr_thread_pool_tasks_cancel(apr_thread_pool_t *me,
 
 APU_DECLARE(apr_size_t) apr_thread_pool_tasks_count(apr_thread_pool_t *me)
 {
-    return me->task_cnt;
+    return me->task_cnt + me->ws_task_cnt;
 }
 
 APU_DECLARE(apr_size_t)
@@ -831,7 +1400,13 @@ APU_DECLARE(apr_size_t) apr_thread_pool_idle_count(apr_thread_pool_t *me)
 APU_DECLARE(apr_size_t)
     apr_thread_pool_tasks_run_count(apr_thread_pool_t * me)
 {
-    return me->tasks_run;
+    struct apr_thread_list_elt *elt;
+    apr_size_t cnt = me->tasks_run;
+
+    for (elt = me->ws_elts; elt; elt = elt->ws_next) {
+        cnt += elt->tasks_run;
+    }
+    return cnt;
 }
 
 APU_DECLARE(apr_size_t)
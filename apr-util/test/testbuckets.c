@@ -18,6 +18,8 @@
 #include "testutil.h"
 #include "apr_buckets.h"
 #include "apr_strings.h"
+#include "apr_queue.h"
+#include "apr_thread_proc.h"
 
 static void test_create(abts_case *tc, void *data)
 {
@@ -439,6 +441,141 @@ static void test_truncfile(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+#if APR_HAS_MMAP
+
+#define CACHE_FNAME "mmapcache.bin"
+#define CACHE_FSIZE (64 * 1024)
+
+/* Reads the first bucket of a brigade of the file, which gets mapped */
+static apr_mmap_t *read_mapped(abts_case *tc, apr_bucket_brigade *bb,
+                               apr_file_t *f, apr_off_t offset,
+                               apr_size_t len, const char *contents)
+{
+    apr_bucket *e;
+    const char *data;
+    apr_size_t n;
+
+    apr_brigade_insert_file(bb, f, offset, len, bb->p);
+    e = APR_BRIGADE_FIRST(bb);
+    apr_assert_success(tc, "read file bucket",
+                       apr_bucket_read(e, &data, &n, APR_BLOCK_READ));
+    ABTS_ASSERT(tc, "file bucket mapped", APR_BUCKET_IS_MMAP(e));
+    ABTS_ASSERT(tc, "mapped length", n == len);
+    ABTS_ASSERT(tc, "mapped contents",
+                memcmp(data, contents + offset, n) == 0);
+    return ((apr_bucket_mmap *)e->data)->mmap;
+}
+
+static void test_mmap_cache(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb1, *bb2;
+    apr_pool_t *cp, *sp;
+    apr_file_t *f1, *f2;
+    apr_mmap_t *mm1, *mm2;
+    apr_finfo_t finfo;
+    char *contents;
+    int i;
+
+    contents = apr_palloc(p, CACHE_FSIZE + 1);
+    for (i = 0; i < CACHE_FSIZE; i++) {
+        contents[i] = 'a' + i % 26;
+    }
+    contents[CACHE_FSIZE] = '\0';
+    f1 = make_test_file(tc, CACHE_FNAME, contents);
+    apr_file_close(f1);
+
+    apr_pool_create(&cp, p);
+    apr_pool_create(&sp, p);
+    apr_assert_success(tc, "enable mmap cache",
+                       apr_bucket_mmap_cache_enable(cp, 4 * CACHE_FSIZE));
+    ABTS_INT_EQUAL(tc, APR_EEXIST,
+                   apr_bucket_mmap_cache_enable(cp, 4 * CACHE_FSIZE));
+
+    /* Two opens of the file, sharing the same mapping */
+    apr_assert_success(tc, "open file",
+                       apr_file_open(&f1, CACHE_FNAME, APR_FOPEN_READ,
+                                     APR_OS_DEFAULT, p));
+    apr_assert_success(tc, "open file again",
+                       apr_file_open(&f2, CACHE_FNAME, APR_FOPEN_READ,
+                                     APR_OS_DEFAULT, p));
+    apr_file_info_get(&finfo, APR_FINFO_IDENT, f1);
+    if (!(finfo.valid & APR_FINFO_IDENT)) {
+        ABTS_NOT_IMPL(tc, "file identity not available");
+    }
+    else {
+        bb1 = apr_brigade_create(p, ba);
+        bb2 = apr_brigade_create(p, ba);
+        mm1 = read_mapped(tc, bb1, f1, 0, CACHE_FSIZE, contents);
+        mm2 = read_mapped(tc, bb2, f2, 1000, 20000, contents);
+        ABTS_PTR_EQUAL(tc, mm1, mm2);
+
+        /* the mapping outlives the pools of its users */
+        apr_assert_success(tc, "setaside mapped bucket",
+                           apr_bucket_setaside(APR_BRIGADE_FIRST(bb2), sp));
+        ABTS_PTR_EQUAL(tc, mm1, ((apr_bucket_mmap *)
+                                 APR_BRIGADE_FIRST(bb2)->data)->mmap);
+
+        /* and is kept once idle */
+        apr_brigade_cleanup(bb1);
+        apr_brigade_cleanup(bb2);
+        mm2 = read_mapped(tc, bb2, f2, 30000, 10000, contents);
+        ABTS_PTR_EQUAL(tc, mm1, mm2);
+        apr_brigade_destroy(bb1);
+        apr_brigade_destroy(bb2);
+    }
+
+    apr_file_close(f1);
+    apr_file_close(f2);
+    apr_pool_destroy(sp);
+    apr_pool_destroy(cp);
+    apr_bucket_alloc_destroy(ba);
+    apr_file_remove(CACHE_FNAME, p);
+}
+
+#endif /* APR_HAS_MMAP */
+
+static void test_readahead(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_off_t pos = 0;
+    apr_bucket *e;
+    apr_file_t *f;
+    char *contents;
+    int i;
+
+    contents = apr_palloc(p, 100000 + 1);
+    for (i = 0; i < 100000; i++) {
+        contents[i] = 'a' + i % 26;
+    }
+    contents[100000] = '\0';
+    f = make_test_file(tc, "readahead.bin", contents);
+    apr_file_seek(f, APR_SET, &pos);
+
+    e = apr_brigade_insert_file(bb, f, 10, 99990, p);
+    apr_bucket_file_enable_mmap(e, 0);
+    apr_assert_success(tc, "set read-ahead",
+                       apr_bucket_file_set_readahead(e, 32768));
+
+    flatten_match(tc, "read ahead", bb, contents + 10);
+
+    /* the reads were positional, where supported */
+    pos = 0;
+    apr_file_seek(f, APR_CUR, &pos);
+    ABTS_ASSERT(tc, "file position unchanged", pos == 0 || pos == 100000);
+
+    /* only FILE buckets read ahead */
+    e = apr_bucket_immortal_create("hello", 5, ba);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_bucket_file_set_readahead(e, 32768));
+    apr_bucket_destroy(e);
+
+    apr_file_close(f);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    apr_file_remove("readahead.bin", p);
+}
+
 static const char hello[] = "hello, world";
 
 static void test_partition(abts_case *tc, void *data)
@@ -511,6 +648,398 @@ static void test_write_putstrs(abts_case *tc, void *data)
     apr_bucket_alloc_destroy(ba);
 }
 
+/* Connects client to server over the loopback, with small socket buffers
+ * if bufsize is not 0, so that the sends have to wait.
+ */
+static void make_socket_pair(abts_case *tc, apr_socket_t **client,
+                             apr_socket_t **server, apr_int32_t bufsize)
+{
+    apr_socket_t *listener;
+    apr_sockaddr_t *sa;
+
+    apr_assert_success(tc, "get loopback address",
+                       apr_sockaddr_info_get(&sa, "127.0.0.1", APR_INET, 0,
+                                             0, p));
+    apr_assert_success(tc, "create listener",
+                       apr_socket_create(&listener, APR_INET, SOCK_STREAM,
+                                         APR_PROTO_TCP, p));
+    if (bufsize) {
+        apr_socket_opt_set(listener, APR_SO_RCVBUF, bufsize);
+    }
+    apr_assert_success(tc, "bind listener", apr_socket_bind(listener, sa));
+    apr_assert_success(tc, "listen", apr_socket_listen(listener, 1));
+    apr_assert_success(tc, "get listener address",
+                       apr_socket_addr_get(&sa, APR_LOCAL, listener));
+
+    apr_assert_success(tc, "create client",
+                       apr_socket_create(client, APR_INET, SOCK_STREAM,
+                                         APR_PROTO_TCP, p));
+    if (bufsize) {
+        apr_socket_opt_set(*client, APR_SO_SNDBUF, bufsize);
+    }
+    apr_assert_success(tc, "connect", apr_socket_connect(*client, sa));
+    apr_assert_success(tc, "accept", apr_socket_accept(server, listener, p));
+    apr_socket_close(listener);
+}
+
+/* Appends what is available on sock to buf, up to size in all */
+static void recv_available(abts_case *tc, apr_socket_t *sock, char *buf,
+                           apr_size_t *received, apr_size_t size)
+{
+    apr_status_t rv;
+    apr_size_t len;
+
+    apr_socket_timeout_set(sock, 0);
+    while (*received < size) {
+        len = size - *received;
+        rv = apr_socket_recv(sock, buf + *received, &len);
+        *received += len;
+        if (APR_STATUS_IS_EAGAIN(rv)) {
+            break;
+        }
+        apr_assert_success(tc, "receive", rv);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+}
+
+#define SEND_FNAME "testsend.txt"
+
+/* A brigade of memory, file and metadata buckets, as expected[] */
+static apr_bucket_brigade *make_send_brigade(abts_case *tc,
+                                             apr_bucket_alloc_t *ba,
+                                             apr_size_t file_size,
+                                             char **expected,
+                                             apr_size_t *size)
+{
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_file_t *f;
+    char *contents;
+    apr_size_t i;
+
+    contents = apr_palloc(p, file_size + 1);
+    for (i = 0; i < file_size; i++) {
+        contents[i] = 'a' + (char)(i % 26) + (char)(i / 1000 % 2);
+    }
+    contents[file_size] = '\0';
+    f = make_test_file(tc, SEND_FNAME, contents);
+
+    apr_brigade_puts(bb, NULL, NULL, hello);
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_file_create(f, 0, file_size,
+                                                       p, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_transient_create(hello, 5, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_flush_create(ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_file_create(f, 10, 10, p, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_immortal_create(hello, 1, ba));
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(ba));
+
+    *expected = apr_pstrcat(p, hello, contents, "hello",
+                            apr_pstrndup(p, contents + 10, 10), "h", NULL);
+    *size = strlen(*expected);
+    return bb;
+}
+
+static void test_send(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb;
+    apr_socket_t *client, *server;
+    apr_size_t size, sent, received = 0;
+    char *expected, *buf;
+
+    /* Small enough for the socket buffers to take it all, with no one
+     * receiving until it is sent.
+     */
+    make_socket_pair(tc, &client, &server, 0);
+    bb = make_send_brigade(tc, ba, 32768, &expected, &size);
+    buf = apr_palloc(p, size);
+
+    apr_socket_timeout_set(client, apr_time_from_sec(10));
+    apr_assert_success(tc, "send brigade",
+                       apr_brigade_send(client, bb, 0, &sent));
+    ABTS_ASSERT(tc, "all bytes sent", sent == size);
+    ABTS_ASSERT(tc, "brigade emptied", APR_BRIGADE_EMPTY(bb));
+
+    while (received < size) {
+        apr_size_t before = received;
+
+        recv_available(tc, server, buf, &received, size);
+        if (received == before) {
+            apr_sleep(apr_time_from_msec(10));
+        }
+    }
+    ABTS_ASSERT(tc, "received data", memcmp(buf, expected, size) == 0);
+
+    apr_socket_close(client);
+    apr_socket_close(server);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    apr_file_remove(SEND_FNAME, p);
+}
+
+static void test_send_nonblock(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb;
+    apr_socket_t *client, *server;
+    apr_size_t size, sent, total = 0, received = 0;
+    apr_status_t rv;
+    char *expected, *buf;
+    int would_block = 0;
+
+    make_socket_pair(tc, &client, &server, 16384);
+    bb = make_send_brigade(tc, ba, 1024 * 1024, &expected, &size);
+    buf = apr_palloc(p, size);
+
+    /* Sending what the socket takes, receiving what came through */
+    do {
+        rv = apr_brigade_send(client, bb, APR_BRIGADE_SEND_NONBLOCK, &sent);
+        total += sent;
+        if (APR_STATUS_IS_EAGAIN(rv)) {
+            would_block++;
+            ABTS_ASSERT(tc, "remainder left", !APR_BRIGADE_EMPTY(bb));
+            recv_available(tc, server, buf, &received, size);
+        }
+        else {
+            apr_assert_success(tc, "send brigade", rv);
+        }
+    } while (APR_STATUS_IS_EAGAIN(rv));
+
+    ABTS_ASSERT(tc, "all bytes sent", total == size);
+    ABTS_ASSERT(tc, "brigade emptied", APR_BRIGADE_EMPTY(bb));
+    ABTS_ASSERT(tc, "socket would block", would_block > 0);
+
+    while (received < size) {
+        apr_size_t before = received;
+
+        recv_available(tc, server, buf, &received, size);
+        if (received == before) {
+            apr_sleep(apr_time_from_msec(10));
+        }
+    }
+    ABTS_ASSERT(tc, "received data", memcmp(buf, expected, size) == 0);
+
+    apr_socket_close(client);
+    apr_socket_close(server);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+    apr_file_remove(SEND_FNAME, p);
+}
+
+#define SOCKET_EX_CHUNK  50000
+#define SOCKET_EX_CHUNKS 4
+
+static void test_socket_ex(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bb = apr_brigade_create(p, ba);
+    apr_socket_t *client, *server;
+    apr_interval_time_t timeout;
+    apr_size_t len, received = 0;
+    const char *str;
+    char *expected, *buf;
+    apr_status_t rv;
+    apr_bucket *e;
+    int i, several = 0;
+
+    make_socket_pair(tc, &client, &server, 0);
+    apr_socket_timeout_set(server, -1);
+    /* a cap that is no power of two of the buffers */
+    APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_socket_create_ex(server, 100000,
+                                                            ba));
+
+    /* No data yet, the socket staying blocking */
+    e = APR_BRIGADE_FIRST(bb);
+    ABTS_ASSERT(tc, "SOCKET_EX bucket", APR_BUCKET_IS_SOCKET_EX(e));
+    rv = apr_bucket_read(e, &str, &len, APR_NONBLOCK_READ);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(rv));
+    apr_socket_timeout_get(server, &timeout);
+    ABTS_ASSERT(tc, "socket still blocking", timeout < 0);
+
+    expected = apr_palloc(p, SOCKET_EX_CHUNK * SOCKET_EX_CHUNKS);
+    buf = apr_palloc(p, SOCKET_EX_CHUNK * SOCKET_EX_CHUNKS);
+    for (i = 0; i < SOCKET_EX_CHUNK * SOCKET_EX_CHUNKS; i++) {
+        expected[i] = (char)(i * 7);
+    }
+
+    for (i = 0; i < SOCKET_EX_CHUNKS; i++) {
+        len = SOCKET_EX_CHUNK;
+        apr_assert_success(tc, "send chunk",
+                           apr_socket_send(client,
+                                           expected + i * SOCKET_EX_CHUNK,
+                                           &len));
+        while (received < (apr_size_t)(i + 1) * SOCKET_EX_CHUNK) {
+            int from_socket;
+
+            e = APR_BRIGADE_FIRST(bb);
+            from_socket = APR_BUCKET_IS_SOCKET_EX(e);
+            rv = apr_bucket_read(e, &str, &len, APR_BLOCK_READ);
+            if (from_socket && APR_BUCKET_IS_HEAP(APR_BUCKET_NEXT(e))) {
+                several = 1;
+            }
+            apr_assert_success(tc, "read bucket", rv);
+            if (rv != APR_SUCCESS) {
+                break;
+            }
+            memcpy(buf + received, str, len);
+            received += len;
+            apr_bucket_delete(e);
+        }
+    }
+    ABTS_ASSERT(tc, "several buffers filled at once", several);
+
+    /* Small reads shrink the reads down to one buffer, not to none */
+    for (i = 0; i < 16; i++) {
+        len = 100;
+        apr_assert_success(tc, "send small chunk",
+                           apr_socket_send(client, expected, &len));
+        e = APR_BRIGADE_FIRST(bb);
+        rv = apr_bucket_read(e, &str, &len, APR_BLOCK_READ);
+        apr_assert_success(tc, "read small chunk", rv);
+        ABTS_ASSERT(tc, "small chunk read", len > 0 && len <= 100);
+        if (rv != APR_SUCCESS || len == 0) {
+            break;
+        }
+        ABTS_ASSERT(tc, "small chunk data", memcmp(str, expected, len) == 0);
+        apr_bucket_delete(e);
+        /* the rest of it, if it came apart */
+        for (received = len; received < 100; received += len) {
+            e = APR_BRIGADE_FIRST(bb);
+            apr_assert_success(tc, "read rest of small chunk",
+                               apr_bucket_read(e, &str, &len,
+                                               APR_BLOCK_READ));
+            apr_bucket_delete(e);
+            if (!len) {
+                break;
+            }
+        }
+        ABTS_ASSERT(tc, "socket bucket still there",
+                    APR_BUCKET_IS_SOCKET_EX(APR_BRIGADE_FIRST(bb)));
+    }
+    ABTS_ASSERT(tc, "received data",
+                memcmp(buf, expected, SOCKET_EX_CHUNK * SOCKET_EX_CHUNKS) == 0);
+
+    /* At EOF the bucket turns empty, with nothing after it */
+    apr_socket_close(client);
+    e = APR_BRIGADE_FIRST(bb);
+    apr_assert_success(tc, "read at EOF",
+                       apr_bucket_read(e, &str, &len, APR_BLOCK_READ));
+    ABTS_ASSERT(tc, "nothing read at EOF", len == 0);
+    ABTS_PTR_EQUAL(tc, APR_BRIGADE_SENTINEL(bb), APR_BUCKET_NEXT(e));
+
+    apr_socket_close(server);
+    apr_brigade_destroy(bb);
+    apr_bucket_alloc_destroy(ba);
+}
+
+#if APR_HAS_THREADS
+
+#define XTHREAD_BRIGADES 1000
+#define XTHREAD_BUCKETS  10
+
+struct xthread_ctx {
+    apr_queue_t *queue;
+    apr_size_t received;
+};
+
+/* Reads and destroys the buckets of the brigades handed over */
+static void * APR_THREAD_FUNC xthread_consumer(apr_thread_t *thd, void *data)
+{
+    struct xthread_ctx *ctx = data;
+    apr_bucket_brigade *bb;
+    apr_off_t len;
+    void *v;
+
+    while (apr_queue_pop(ctx->queue, &v) == APR_SUCCESS && v) {
+        bb = v;
+        apr_brigade_length(bb, 1, &len);
+        ctx->received += (apr_size_t)len;
+        apr_brigade_cleanup(bb);
+    }
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC xthread_free(apr_thread_t *thd, void *data)
+{
+    void **mem = data;
+
+    apr_bucket_free(mem[0]);
+    apr_bucket_free(mem[1]);
+    return NULL;
+}
+
+static void test_alloc_xthread(abts_case *tc, void *data)
+{
+    apr_bucket_alloc_t *ba = apr_bucket_alloc_create(p);
+    apr_bucket_brigade *bbs[XTHREAD_BRIGADES];
+    struct xthread_ctx ctx;
+    apr_thread_t *thread;
+    apr_status_t rv;
+    char *big;
+    void *mem[3];
+    int i, j;
+
+    apr_assert_success(tc, "set cross-thread flag",
+                       apr_bucket_alloc_flags_set(ba,
+                                                  APR_BUCKET_ALLOC_XTHREAD));
+    ABTS_INT_EQUAL(tc, APR_EINVAL, apr_bucket_alloc_flags_set(ba, 0x100));
+
+    ctx.received = 0;
+    apr_assert_success(tc, "create queue",
+                       apr_queue_create(&ctx.queue, 16, p));
+    apr_assert_success(tc, "create consumer",
+                       apr_thread_create(&thread, NULL, xthread_consumer,
+                                         &ctx, p));
+
+    /* Small and large buckets created here, destroyed there */
+    big = apr_pcalloc(p, 20000);
+    for (i = 0; i < XTHREAD_BRIGADES; i++) {
+        bbs[i] = apr_brigade_create(p, ba);
+        for (j = 0; j < XTHREAD_BUCKETS; j++) {
+            APR_BRIGADE_INSERT_TAIL(bbs[i],
+                apr_bucket_heap_create(hello, sizeof(hello) - 1, NULL, ba));
+        }
+        APR_BRIGADE_INSERT_TAIL(bbs[i],
+            apr_bucket_heap_create(big, 20000, NULL, ba));
+        apr_assert_success(tc, "hand brigade over",
+                           apr_queue_push(ctx.queue, bbs[i]));
+    }
+    apr_queue_push(ctx.queue, NULL);
+    apr_thread_join(&rv, thread);
+
+    ABTS_ASSERT(tc, "all the data received",
+                ctx.received == XTHREAD_BRIGADES
+                                * (XTHREAD_BUCKETS * (sizeof(hello) - 1)
+                                   + 20000));
+
+    for (i = 0; i < XTHREAD_BRIGADES; i++) {
+        apr_brigade_destroy(bbs[i]);
+    }
+    apr_bucket_alloc_destroy(ba);
+
+    /* What another thread freed is taken back by the owner */
+    ba = apr_bucket_alloc_create(p);
+    apr_bucket_alloc_flags_set(ba, APR_BUCKET_ALLOC_XTHREAD);
+    mem[0] = apr_bucket_alloc(64, ba);
+    mem[1] = apr_bucket_alloc(20000, ba);
+    apr_assert_success(tc, "create freeing thread",
+                       apr_thread_create(&thread, NULL, xthread_free,
+                                         mem, p));
+    apr_thread_join(&rv, thread);
+
+    /* by any allocation, even a large one */
+    mem[2] = apr_bucket_alloc(20000, ba);
+    ABTS_PTR_EQUAL(tc, mem[1], mem[2]);
+    apr_bucket_free(mem[2]);
+    mem[2] = apr_bucket_alloc(64, ba);
+    ABTS_PTR_EQUAL(tc, mem[0], mem[2]);
+    apr_bucket_free(mem[2]);
+    apr_bucket_alloc_destroy(ba);
+}
+
+#endif /* APR_HAS_THREADS */
+
 abts_suite *testbuckets(abts_suite *suite)
 {
     suite = ADD_SUITE(suite);
@@ -528,6 +1057,16 @@ abts_suite *testbuckets(abts_suite *suite)
     abts_run_test(suite, test_partition, NULL);
     abts_run_test(suite, test_write_split, NULL);
     abts_run_test(suite, test_write_putstrs, NULL);
+    abts_run_test(suite, test_send, NULL);
+    abts_run_test(suite, test_send_nonblock, NULL);
+    abts_run_test(suite, test_socket_ex, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_alloc_xthread, NULL);
+#endif
+#if APR_HAS_MMAP
+    abts_run_test(suite, test_mmap_cache, NULL);
+#endif
+    abts_run_test(suite, test_readahead, NULL);
 
     return suite;
 }
@@ -17,6 +17,8 @@
 #include "apu.h"
 #include "apr_queue.h"
 #include "apr_thread_pool.h"
+#include "apr_thread_proc.h"
+#include "apr_atomic.h"
 #include "apr_time.h"
 #include "abts.h"
 #include "testutil.h"
@@ -121,6 +123,404 @@ static void test_queue_producer_consumer(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
 }
 
+/*
+ * Many producers and consumers, with and without APR_QUEUE_LOCKFREE and
+ * batching: every item pushed is popped once.  See testqueueperf for the
+ * throughput.
+ */
+
+#define MANY_PRODUCERS     4
+#define MANY_CONSUMERS     4
+#define MANY_ITEMS         100000
+#define MANY_BATCH         16
+#define MANY_QUEUE_SIZE    1024
+
+typedef struct many_t {
+    apr_queue_t *queue;
+    int batch;
+    volatile apr_uint32_t consumed;
+    volatile apr_uint32_t sum;
+} many_t;
+
+static void * APR_THREAD_FUNC many_producer(apr_thread_t *thd, void *data)
+{
+    many_t *many = data;
+    void *items[MANY_BATCH];
+    apr_uintptr_t n = 1;
+    unsigned int i, pushed;
+    apr_status_t rv;
+
+    while (n <= MANY_ITEMS) {
+        if (many->batch) {
+            for (i = 0; i < MANY_BATCH && n + i <= MANY_ITEMS; i++) {
+                items[i] = (void *)(n + i);
+            }
+            rv = apr_queue_push_batch(many->queue, items, i, &pushed);
+        }
+        else {
+            rv = apr_queue_push(many->queue, (void *)n);
+            pushed = 1;
+        }
+        if (rv == APR_EINTR) {
+            continue;
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        n += pushed;
+    }
+
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC many_consumer(apr_thread_t *thd, void *data)
+{
+    many_t *many = data;
+    void *items[MANY_BATCH];
+    apr_uint32_t sum;
+    unsigned int i, popped;
+    apr_status_t rv;
+
+    for (;;) {
+        if (many->batch) {
+            rv = apr_queue_pop_batch(many->queue, items, MANY_BATCH,
+                                     &popped);
+        }
+        else {
+            rv = apr_queue_pop(many->queue, items);
+            popped = 1;
+        }
+        if (rv == APR_EINTR) {
+            continue;
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        for (sum = 0, i = 0; i < popped; i++) {
+            sum += (apr_uint32_t)(apr_uintptr_t)items[i];
+        }
+        apr_atomic_add32(&many->sum, sum);
+        apr_atomic_add32(&many->consumed, popped);
+    }
+
+    return NULL;
+}
+
+static void run_many(abts_case *tc, unsigned int flags, int batch)
+{
+    apr_thread_t *producers[MANY_PRODUCERS];
+    apr_thread_t *consumers[MANY_CONSUMERS];
+    apr_uint32_t total = MANY_PRODUCERS * MANY_ITEMS;
+    apr_uint32_t sum = MANY_PRODUCERS
+                       * ((apr_uint32_t)MANY_ITEMS * (MANY_ITEMS + 1) / 2);
+    apr_status_t rv, retval;
+    many_t many;
+    int i;
+
+    rv = apr_queue_create_ex(&many.queue, MANY_QUEUE_SIZE, flags, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    many.batch = batch;
+    many.consumed = 0;
+    many.sum = 0;
+
+    for (i = 0; i < MANY_CONSUMERS; i++) {
+        rv = apr_thread_create(&consumers[i], NULL, many_consumer, &many, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < MANY_PRODUCERS; i++) {
+        rv = apr_thread_create(&producers[i], NULL, many_producer, &many, p);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    for (i = 0; i < MANY_PRODUCERS; i++) {
+        apr_thread_join(&retval, producers[i]);
+    }
+    /* terminating drops what's left, so wait for the consumers first */
+    while (apr_atomic_read32(&many.consumed) < total) {
+        apr_sleep(1000);
+    }
+    rv = apr_queue_term(many.queue);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    for (i = 0; i < MANY_CONSUMERS; i++) {
+        apr_thread_join(&retval, consumers[i]);
+    }
+
+    ABTS_INT_EQUAL(tc, total, apr_atomic_read32(&many.consumed));
+    ABTS_INT_EQUAL(tc, sum, apr_atomic_read32(&many.sum));
+    ABTS_INT_EQUAL(tc, 0, apr_queue_size(many.queue));
+}
+
+static void test_queue_many(abts_case *tc, void *data)
+{
+    run_many(tc, 0, 0);
+    run_many(tc, 0, 1);
+    run_many(tc, APR_QUEUE_LOCKFREE, 0);
+    run_many(tc, APR_QUEUE_LOCKFREE, 1);
+}
+
+static void test_queue_lockfree(abts_case *tc, void *data)
+{
+    apr_queue_t *q;
+    apr_status_t rv;
+    void *items[8], *v;
+    unsigned int n;
+    apr_uintptr_t i;
+
+    /* capacity is rounded up to 8 */
+    rv = apr_queue_create_ex(&q, 5, APR_QUEUE_LOCKFREE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < 8; i++) {
+        rv = apr_queue_trypush(q, (void *)(i + 1));
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_queue_trypush(q, NULL);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+    ABTS_INT_EQUAL(tc, 8, apr_queue_size(q));
+
+    rv = apr_queue_pop_batch(q, items, 3, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 3, n);
+    ABTS_PTR_EQUAL(tc, (void *)1, items[0]);
+    ABTS_PTR_EQUAL(tc, (void *)3, items[2]);
+
+    /* wraps around the ring, and only fills what's free */
+    items[0] = (void *)9;
+    items[1] = (void *)10;
+    items[2] = (void *)11;
+    items[3] = (void *)12;
+    rv = apr_queue_push_batch(q, items, 4, &n);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 3, n);
+
+    for (i = 4; i <= 11; i++) {
+        rv = apr_queue_trypop(q, &v);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_PTR_EQUAL(tc, (void *)i, v);
+    }
+    rv = apr_queue_trypop(q, &v);
+    ABTS_INT_EQUAL(tc, APR_EAGAIN, rv);
+
+    rv = apr_queue_term(q);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_queue_pop(q, &v);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+}
+
+#define WS_DEPTH 10
+
+static apr_thread_pool_t *ws_pool;
+static apr_uint32_t ws_done;
+static apr_uint32_t ws_order_ok;
+
+static void * APR_THREAD_FUNC ws_fanout(apr_thread_t *thd, void *data)
+{
+    apr_uintptr_t depth = (apr_uintptr_t)data;
+
+    if (depth < WS_DEPTH) {
+        apr_thread_pool_push(ws_pool, ws_fanout, (void *)(depth + 1),
+                             APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+        apr_thread_pool_push(ws_pool, ws_fanout, (void *)(depth + 1),
+                             APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+    }
+    apr_atomic_inc32(&ws_done);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC ws_low(apr_thread_t *thd, void *data)
+{
+    /* the high priority task ran first */
+    if (apr_atomic_read32(&ws_done) == 1) {
+        apr_atomic_inc32(&ws_order_ok);
+    }
+    apr_atomic_inc32(&ws_done);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC ws_high(apr_thread_t *thd, void *data)
+{
+    apr_atomic_inc32(&ws_done);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC ws_priorities(apr_thread_t *thd, void *data)
+{
+    apr_thread_pool_push(ws_pool, ws_low, NULL,
+                         APR_THREAD_TASK_PRIORITY_LOW, NULL);
+    apr_thread_pool_push(ws_pool, ws_high, NULL,
+                         APR_THREAD_TASK_PRIORITY_HIGH, NULL);
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC ws_sleeper(apr_thread_t *thd, void *data)
+{
+    apr_uintptr_t n = (apr_uintptr_t)data;
+
+    /* push all the (owned) tasks from a worker, then run some of them */
+    while (n--) {
+        apr_thread_pool_push(ws_pool, ws_sleeper, NULL, 0, &ws_pool);
+    }
+    apr_sleep(apr_time_from_msec(1));
+    apr_atomic_inc32(&ws_done);
+    return NULL;
+}
+
+static void ws_wait_done(apr_uint32_t total)
+{
+    int i;
+
+    for (i = 0; i < 1000 && apr_atomic_read32(&ws_done) < total; i++) {
+        apr_sleep(apr_time_from_msec(10));
+    }
+}
+
+static void test_thread_pool_work_stealing(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_uint32_t done;
+
+    rv = apr_thread_pool_create_ex(&ws_pool, 2, 4,
+                                   APR_THREAD_POOL_WORK_STEALING, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* every task pushes two more from within the pool */
+    apr_atomic_set32(&ws_done, 0);
+    rv = apr_thread_pool_push(ws_pool, ws_fanout, (void *)0, 0, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ws_wait_done((1 << (WS_DEPTH + 1)) - 1);
+    ABTS_INT_EQUAL(tc, (1 << (WS_DEPTH + 1)) - 1, apr_atomic_read32(&ws_done));
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_tasks_count(ws_pool));
+    ABTS_TRUE(tc, apr_thread_pool_tasks_run_count(ws_pool)
+                  >= (1 << (WS_DEPTH + 1)) - 1);
+
+
+    /* owned tasks in the deques are canceled */
+    apr_atomic_set32(&ws_done, 0);
+    rv = apr_thread_pool_push(ws_pool, ws_sleeper, (void *)1000, 0, &ws_pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_sleep(apr_time_from_msec(20));
+    rv = apr_thread_pool_tasks_cancel(ws_pool, &ws_pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_tasks_count(ws_pool));
+    done = apr_atomic_read32(&ws_done);
+    ABTS_TRUE(tc, done < 1001);
+    apr_sleep(apr_time_from_msec(20));
+    ABTS_INT_EQUAL(tc, done, apr_atomic_read32(&ws_done));
+
+    rv = apr_thread_pool_destroy(ws_pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* priorities hold within a deque (single worker, no stealing) */
+    rv = apr_thread_pool_create_ex(&ws_pool, 1, 1,
+                                   APR_THREAD_POOL_WORK_STEALING, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    apr_atomic_set32(&ws_done, 0);
+    apr_atomic_set32(&ws_order_ok, 0);
+    rv = apr_thread_pool_push(ws_pool, ws_priorities, NULL, 0, NULL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ws_wait_done(2);
+    ABTS_INT_EQUAL(tc, 2, apr_atomic_read32(&ws_done));
+    ABTS_INT_EQUAL(tc, 1, apr_atomic_read32(&ws_order_ok));
+
+    rv = apr_thread_pool_destroy(ws_pool);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static int sched_order[5];
+static apr_uint32_t sched_ran;
+
+static void * APR_THREAD_FUNC sched_task(apr_thread_t *thd, void *data)
+{
+    sched_order[apr_atomic_inc32(&sched_ran)] = (int)(apr_uintptr_t)data;
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC sched_never(apr_thread_t *thd, void *data)
+{
+    return NULL;
+}
+
+static void test_thread_pool_schedule(abts_case *tc, void *data)
+{
+    static const int msecs[5] = { 40, 10, 30, 10, 20 };
+    apr_thread_pool_t *thrp;
+    apr_status_t rv;
+    int i;
+
+    /* a single thread runs them in time order, same times in order */
+    rv = apr_thread_pool_create(&thrp, 0, 1, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    apr_atomic_set32(&sched_ran, 0);
+    for (i = 0; i < 5; i++) {
+        rv = apr_thread_pool_schedule(thrp, sched_task,
+                                      (void *)(apr_uintptr_t)(i + 1),
+                                      apr_time_from_msec(msecs[i]), NULL);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_thread_pool_schedule(thrp, sched_never, NULL,
+                                  apr_time_from_sec(3600), &thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < 100 && apr_atomic_read32(&sched_ran) < 5; i++) {
+        apr_sleep(apr_time_from_msec(10));
+    }
+    ABTS_INT_EQUAL(tc, 5, apr_atomic_read32(&sched_ran));
+    ABTS_INT_EQUAL(tc, 2, sched_order[0]);
+    ABTS_INT_EQUAL(tc, 4, sched_order[1]);
+    ABTS_INT_EQUAL(tc, 5, sched_order[2]);
+    ABTS_INT_EQUAL(tc, 3, sched_order[3]);
+    ABTS_INT_EQUAL(tc, 1, sched_order[4]);
+
+    ABTS_INT_EQUAL(tc, 1, apr_thread_pool_scheduled_tasks_count(thrp));
+    rv = apr_thread_pool_tasks_cancel(thrp, &thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 0, apr_thread_pool_scheduled_tasks_count(thrp));
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+/*
+ * Many pending timers (half of them per owner), canceling one owner's.
+ * See testqueueperf for the cost.
+ */
+static void run_schedule_many(abts_case *tc, apr_size_t ntimers)
+{
+    apr_thread_pool_t *thrp;
+    apr_status_t rv;
+    apr_size_t i;
+    int owners[2];
+
+    rv = apr_thread_pool_create(&thrp, 0, 1, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    for (i = 0; i < ntimers; i++) {
+        /* far away and scattered */
+        rv = apr_thread_pool_schedule(thrp, sched_never, NULL,
+                                      apr_time_from_sec(3600)
+                                      + (i * 7919) % ntimers,
+                                      &owners[i & 1]);
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, ntimers, apr_thread_pool_scheduled_tasks_count(thrp));
+    rv = apr_thread_pool_tasks_cancel(thrp, &owners[0]);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, ntimers / 2,
+                   apr_thread_pool_scheduled_tasks_count(thrp));
+
+    rv = apr_thread_pool_destroy(thrp);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void test_thread_pool_schedule_many(abts_case *tc, void *data)
+{
+    run_schedule_many(tc, 1000);
+    run_schedule_many(tc, 100000);
+}
+
 #endif /* APR_HAS_THREADS */
 
 abts_suite *testqueue(abts_suite *suite)
@@ -129,6 +529,11 @@ abts_suite *testqueue(abts_suite *suite)
 
 #if APR_HAS_THREADS
     abts_run_test(suite, test_queue_producer_consumer, NULL);
+    abts_run_test(suite, test_queue_lockfree, NULL);
+    abts_run_test(suite, test_queue_many, NULL);
+    abts_run_test(suite, test_thread_pool_work_stealing, NULL);
+    abts_run_test(suite, test_thread_pool_schedule, NULL);
+    abts_run_test(suite, test_thread_pool_schedule_many, NULL);
 #endif /* APR_HAS_THREADS */
 
     return suite;
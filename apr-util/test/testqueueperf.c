@@ -0,0 +1,297 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apu.h"
+#include "apr_queue.h"
+#include "apr_thread_pool.h"
+#include "apr_thread_proc.h"
+#include "apr_atomic.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !APR_HAS_THREADS
+int main(void)
+{
+    printf("This program won't work on this platform because there is no "
+           "support for threads.\n");
+    return 0;
+}
+#else /* !APR_HAS_THREADS */
+
+/* Throughput benchmark for apr_queue_t, with a few producers and consumers
+ * pushing and popping one item or a batch at a time, with the mutex based
+ * queue and with APR_QUEUE_LOCKFREE.  Then the cost of scheduling many
+ * timers with apr_thread_pool_schedule(), and of canceling half of them.
+ */
+
+#define DEFAULT_MAX_COUNTER 1000000
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define BATCH_SIZE 16
+#define QUEUE_SIZE 1024
+#define MAX_TIMERS 1000000
+
+static long max_counter = DEFAULT_MAX_COUNTER;
+
+static apr_pool_t *pool;
+
+typedef struct bench_t {
+    apr_queue_t *queue;
+    int batch;
+    apr_uint32_t consumed;
+} bench_t;
+
+static void * APR_THREAD_FUNC producer(apr_thread_t *thd, void *data)
+{
+    bench_t *bench = data;
+    void *items[BATCH_SIZE];
+    apr_uintptr_t n = 1;
+    unsigned int i, pushed;
+    apr_status_t rv;
+
+    while (n <= (apr_uintptr_t)max_counter) {
+        if (bench->batch) {
+            for (i = 0; i < BATCH_SIZE
+                        && n + i <= (apr_uintptr_t)max_counter; i++) {
+                items[i] = (void *)(n + i);
+            }
+            rv = apr_queue_push_batch(bench->queue, items, i, &pushed);
+        }
+        else {
+            rv = apr_queue_push(bench->queue, (void *)n);
+            pushed = 1;
+        }
+        if (rv == APR_EINTR) {
+            continue;
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        n += pushed;
+    }
+
+    return NULL;
+}
+
+static void * APR_THREAD_FUNC consumer(apr_thread_t *thd, void *data)
+{
+    bench_t *bench = data;
+    void *items[BATCH_SIZE];
+    unsigned int popped;
+    apr_status_t rv;
+
+    for (;;) {
+        if (bench->batch) {
+            rv = apr_queue_pop_batch(bench->queue, items, BATCH_SIZE,
+                                     &popped);
+        }
+        else {
+            rv = apr_queue_pop(bench->queue, items);
+            popped = 1;
+        }
+        if (rv == APR_EINTR) {
+            continue;
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+        apr_atomic_add32(&bench->consumed, popped);
+    }
+
+    return NULL;
+}
+
+static apr_status_t test_queue(unsigned int flags, int batch,
+                               apr_time_t *elapsed)
+{
+    apr_thread_t *producers[NUM_PRODUCERS];
+    apr_thread_t *consumers[NUM_CONSUMERS];
+    apr_uint32_t total = NUM_PRODUCERS * (apr_uint32_t)max_counter;
+    apr_status_t rv, s;
+    apr_pool_t *subpool;
+    apr_time_t time_start;
+    bench_t bench;
+    int i;
+
+    if ((rv = apr_pool_create(&subpool, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    rv = apr_queue_create_ex(&bench.queue, QUEUE_SIZE, flags, subpool);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    bench.batch = batch;
+    bench.consumed = 0;
+
+    time_start = apr_time_now();
+
+    for (i = 0; i < NUM_CONSUMERS; i++) {
+        rv = apr_thread_create(&consumers[i], NULL, consumer, &bench,
+                               subpool);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        rv = apr_thread_create(&producers[i], NULL, producer, &bench,
+                               subpool);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    for (i = 0; i < NUM_PRODUCERS; i++) {
+        apr_thread_join(&s, producers[i]);
+    }
+    /* terminating drops what's left, so wait for the consumers first */
+    while (apr_atomic_read32(&bench.consumed) < total) {
+        apr_sleep(1000);
+    }
+    *elapsed = apr_time_now() - time_start;
+
+    apr_queue_term(bench.queue);
+    for (i = 0; i < NUM_CONSUMERS; i++) {
+        apr_thread_join(&s, consumers[i]);
+    }
+    apr_pool_destroy(subpool);
+
+    return APR_SUCCESS;
+}
+
+static void * APR_THREAD_FUNC never_run(apr_thread_t *thd, void *data)
+{
+    return NULL;
+}
+
+static apr_status_t test_schedule(apr_size_t ntimers, apr_time_t *schedule,
+                                  apr_time_t *cancel)
+{
+    apr_thread_pool_t *thrp;
+    apr_time_t time_start;
+    apr_status_t rv;
+    apr_size_t i;
+    int owners[2];
+
+    if ((rv = apr_thread_pool_create(&thrp, 0, 1, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    time_start = apr_time_now();
+    for (i = 0; i < ntimers; i++) {
+        /* far away and scattered, half of them per owner */
+        rv = apr_thread_pool_schedule(thrp, never_run, NULL,
+                                      apr_time_from_sec(3600)
+                                      + (i * 7919) % ntimers,
+                                      &owners[i & 1]);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    *schedule = apr_time_now() - time_start;
+
+    time_start = apr_time_now();
+    if ((rv = apr_thread_pool_tasks_cancel(thrp, &owners[0]))
+            != APR_SUCCESS) {
+        return rv;
+    }
+    *cancel = apr_time_now() - time_start;
+
+    return apr_thread_pool_destroy(thrp);
+}
+
+int main(int argc, const char * const *argv)
+{
+    static const struct {
+        const char *name;
+        unsigned int flags;
+        int batch;
+    } modes[] = {
+        { "mutex",              0,                  0 },
+        { "mutex (batch)",      0,                  1 },
+        { "lock-free",          APR_QUEUE_LOCKFREE, 0 },
+        { "lock-free (batch)",  APR_QUEUE_LOCKFREE, 1 }
+    };
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    apr_time_t elapsed, cancel;
+    apr_size_t ntimers;
+    int i;
+
+    printf("APR Queue Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "c:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'c') {
+            max_counter = atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    printf("%d producers and %d consumers, %ld items per producer\n\n",
+           NUM_PRODUCERS, NUM_CONSUMERS, max_counter);
+    printf("%-20s %16s %12s\n", "queue", "microseconds", "ns/item");
+
+    for (i = 0; i < (int)(sizeof(modes) / sizeof(modes[0])); i++) {
+        rv = test_queue(modes[i].flags, modes[i].batch, &elapsed);
+        if (rv != APR_SUCCESS) {
+            fprintf(stderr, "%s queue test failed : [%d] %s\n", modes[i].name,
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-3);
+        }
+        printf("%-20s %16" APR_INT64_T_FMT " %12.1f\n", modes[i].name,
+               elapsed, (double)elapsed * 1000.0
+                        / ((double)max_counter * NUM_PRODUCERS));
+    }
+
+    printf("\n%12s %16s %16s\n", "timers", "ns/schedule", "cancel half us");
+
+    for (ntimers = 1000; ntimers <= MAX_TIMERS; ntimers *= 10) {
+        if ((rv = test_schedule(ntimers, &elapsed, &cancel)) != APR_SUCCESS) {
+            fprintf(stderr, "schedule test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-4);
+        }
+        printf("%12" APR_SIZE_T_FMT " %16.1f %16" APR_INT64_T_FMT "\n",
+               ntimers, (double)elapsed * 1000.0 / (double)ntimers, cancel);
+    }
+
+    return 0;
+}
+
+#endif /* !APR_HAS_THREADS */
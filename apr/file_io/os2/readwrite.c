@@ -219,6 +219,42 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iove
 
 
 
+/* Positional I/O is not implemented here, see apr_file_pread() */
+APR_DECLARE(apr_status_t) apr_file_pread(apr_file_t *thefile, void *buf,
+                                         apr_size_t *nbytes,
+                                         apr_off_t offset)
+{
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwrite(apr_file_t *thefile,
+                                          const void *buf,
+                                          apr_size_t *nbytes,
+                                          apr_off_t offset)
+{
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_preadv(apr_file_t *thefile,
+                                          const struct iovec *vec,
+                                          apr_size_t nvec, apr_off_t offset,
+                                          apr_size_t *nbytes)
+{
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwritev(apr_file_t *thefile,
+                                           const struct iovec *vec,
+                                           apr_size_t nvec, apr_off_t offset,
+                                           apr_size_t *nbytes)
+{
+    *nbytes = 0;
+    return APR_ENOTIMPL;
+}
+
 APR_DECLARE(apr_status_t) apr_file_putc(char ch, apr_file_t *thefile)
 {
     ULONG rc;
@@ -314,6 +350,25 @@ APR_DECLARE(apr_status_t) apr_file_datasync(apr_file_t *thefile)
     return APR_ENOTIMPL;
 }
 
+/* Access pattern hints and preallocation are not supported here, both are
+ * documented as no-ops then.
+ */
+APR_DECLARE(apr_status_t) apr_file_advise(apr_file_t *thefile,
+                                          apr_off_t offset, apr_off_t len,
+                                          int advice)
+{
+    if (advice < APR_FADVISE_NORMAL || advice > APR_FADVISE_NOREUSE) {
+        return APR_EINVAL;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_allocate(apr_file_t *thefile,
+                                            apr_off_t offset, apr_off_t len)
+{
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
 {
     apr_size_t readlen;
@@ -348,6 +403,15 @@ APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
     return rv;
 }
 
+APR_DECLARE(apr_status_t) apr_file_getline_span(apr_file_t *thefile,
+                                                const char **line,
+                                                apr_size_t *len)
+{
+    *line = NULL;
+    *len = 0;
+    return APR_ENOTIMPL;
+}
+
 
 
 APR_DECLARE_NONSTD(int) apr_file_printf(apr_file_t *fptr, 
@@ -16,6 +16,85 @@
 
 #include "apr_arch_file_io.h"
 #include "apr_file_io.h"
+#include "apr_support.h"
+
+/* Linux moves the bytes in the kernel: copy_file_range(2) (which may
+ * share the extents on XFS and btrfs) and sendfile(2) between files,
+ * splice(2) when a pipe is involved.
+ */
+#if defined(__linux__)
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#ifdef __NR_copy_file_range
+#define HAVE_COPY_FILE_RANGE 1
+#endif
+#if defined(HAVE_SENDFILE) && APR_HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#define HAVE_LINUX_SENDFILE 1
+#endif
+#ifdef SPLICE_F_MOVE
+#define HAVE_SPLICE 1
+#endif
+/* At most this much per system call, below what sendfile(2) accepts */
+#define KERNEL_CHUNK 0x40000000
+#endif
+
+#if BUFSIZ > APR_FILE_DEFAULT_BUFSIZE
+#define COPY_BUFSIZ BUFSIZ
+#else
+#define COPY_BUFSIZ APR_FILE_DEFAULT_BUFSIZE
+#endif
+
+#if defined(HAVE_COPY_FILE_RANGE) || defined(HAVE_LINUX_SENDFILE)
+
+/* Is this the kernel refusing the operation for these files, rather
+ * than an I/O error?
+ */
+#define KERNEL_REFUSED(e) ((e) == EXDEV || (e) == EINVAL || (e) == ENOSYS \
+                           || (e) == EOPNOTSUPP || (e) == EBADF \
+                           || (e) == ETXTBSY)
+
+/* Moves what remains of s to the end of d in the kernel, from and to
+ * their current offsets.  Whatever was not moved when the kernel refuses
+ * is left to the caller's buffered loop, which then picks up at the
+ * offsets reached here (nothing is lost since both files are opened
+ * unbuffered).
+ */
+static apr_status_t transfer_in_kernel(apr_file_t *s, apr_file_t *d)
+{
+    ssize_t rv;
+
+#ifdef HAVE_COPY_FILE_RANGE
+    /* Refused across filesystems before Linux 5.3, and for O_APPEND */
+    do {
+        rv = syscall(__NR_copy_file_range, s->filedes, NULL,
+                     d->filedes, NULL, (size_t)KERNEL_CHUNK, 0U);
+    } while (rv > 0 || (rv == -1 && errno == EINTR));
+    if (rv == 0) {
+        return APR_SUCCESS;
+    }
+    if (!KERNEL_REFUSED(errno)) {
+        return errno;
+    }
+#endif
+
+#ifdef HAVE_LINUX_SENDFILE
+    do {
+        rv = sendfile(d->filedes, s->filedes, NULL, KERNEL_CHUNK);
+    } while (rv > 0 || (rv == -1 && errno == EINTR));
+    if (rv == 0) {
+        return APR_SUCCESS;
+    }
+    if (!KERNEL_REFUSED(errno)) {
+        return errno;
+    }
+#endif
+
+    return APR_ENOTIMPL;
+}
+
+#endif /* HAVE_COPY_FILE_RANGE || HAVE_LINUX_SENDFILE */
 
 static apr_status_t apr_file_transfer_contents(const char *from_path,
                                                const char *to_path,
@@ -53,10 +132,17 @@ static apr_status_t apr_file_transfer_contents(const char *from_path,
         return status;
     }
 
-#if BUFSIZ > APR_FILE_DEFAULT_BUFSIZE
-#define COPY_BUFSIZ BUFSIZ
-#else
-#define COPY_BUFSIZ APR_FILE_DEFAULT_BUFSIZE
+#if defined(HAVE_COPY_FILE_RANGE) || defined(HAVE_LINUX_SENDFILE)
+    /* Let the kernel do it if it will; the loop below then just meets
+     * the end of the source, or copies what could not be moved (some
+     * pseudo filesystems even report an empty file to copy_file_range).
+     */
+    status = transfer_in_kernel(s, d);
+    if (status != APR_SUCCESS && status != APR_ENOTIMPL) {
+        apr_file_close(s);  /* toss any error */
+        apr_file_close(d);  /* toss any error */
+        return status;
+    }
 #endif
 
     /* Copy bytes till the cows come home. */
@@ -117,3 +203,116 @@ APR_DECLARE(apr_status_t) apr_file_append(const char *from_path,
                                       perms,
                                       pool);
 }
+
+#if defined(HAVE_SPLICE) || defined(HAVE_LINUX_SENDFILE)
+
+/* One kernel transfer from in to out, waiting for either file (whichever
+ * has a timeout) to become ready as apr_file_read() and apr_file_write()
+ * would.  Returns APR_ENOTIMPL when the kernel cannot do it for these
+ * files.
+ */
+static apr_status_t splice_in_kernel(apr_file_t *out, apr_file_t *in,
+                                     apr_size_t *len)
+{
+    int use_sendfile = 0, waited_in = 0, waited_out = 0;
+    ssize_t rv;
+
+#ifndef HAVE_SPLICE
+    use_sendfile = 1;
+#endif
+    for (;;) {
+        do {
+#ifdef HAVE_SPLICE
+            if (!use_sendfile) {
+                rv = splice(in->filedes, NULL, out->filedes, NULL, *len,
+                            SPLICE_F_MOVE);
+            }
+            else
+#endif
+            {
+#ifdef HAVE_LINUX_SENDFILE
+                rv = sendfile(out->filedes, in->filedes, NULL, *len);
+#else
+                rv = -1;
+                errno = ENOSYS;
+#endif
+            }
+        } while (rv == -1 && errno == EINTR);
+
+        if (rv >= 0) {
+            break;
+        }
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && !waited_out) {
+            apr_status_t arv;
+
+            /* Not knowing which side would block, wait for the input
+             * first and then for the output.
+             */
+            if (!waited_in && in->timeout != 0) {
+                arv = apr_wait_for_io_or_timeout(in, NULL, 1);
+                waited_in = 1;
+            }
+            else if (out->timeout != 0) {
+                arv = apr_wait_for_io_or_timeout(out, NULL, 0);
+                waited_out = 1;
+            }
+            else {
+                *len = 0;
+                return errno;
+            }
+            if (arv != APR_SUCCESS) {
+                *len = 0;
+                return arv;
+            }
+            continue;
+        }
+        if (!use_sendfile && errno == EINVAL) {
+            /* No pipe on either side */
+            use_sendfile = 1;
+            continue;
+        }
+        *len = 0;
+        return (errno == EINVAL || errno == ENOSYS) ? APR_ENOTIMPL : errno;
+    }
+
+    *len = rv;
+    if (rv == 0) {
+        in->eof_hit = 1;
+        return APR_EOF;
+    }
+    return APR_SUCCESS;
+}
+
+#endif /* HAVE_SPLICE || HAVE_LINUX_SENDFILE */
+
+APR_DECLARE(apr_status_t) apr_file_splice(apr_file_t *out, apr_file_t *in,
+                                          apr_size_t *len)
+{
+    char buf[COPY_BUFSIZ];
+    apr_size_t bytes_this_time;
+    apr_status_t rv;
+
+    if (*len == 0) {
+        return APR_SUCCESS;
+    }
+
+#if defined(HAVE_SPLICE) || defined(HAVE_LINUX_SENDFILE)
+    /* Buffered data (or a char given back) must go through user space */
+    if (!in->buffered && !out->buffered && in->ungetchar == -1) {
+        bytes_this_time = *len > KERNEL_CHUNK ? KERNEL_CHUNK : *len;
+        rv = splice_in_kernel(out, in, &bytes_this_time);
+        if (rv != APR_ENOTIMPL) {
+            *len = bytes_this_time;
+            return rv;
+        }
+    }
+#endif
+
+    bytes_this_time = *len > sizeof(buf) ? sizeof(buf) : *len;
+    rv = apr_file_read(in, buf, &bytes_this_time);
+    if (rv == APR_SUCCESS) {
+        rv = apr_file_write_full(out, buf, bytes_this_time, &bytes_this_time);
+    }
+    *len = bytes_this_time;
+    return rv;
+}
@@ -25,6 +25,24 @@
 #define USE_WAIT_FOR_IO
 #endif
 
+/* Refills the drained read buffer of thefile, in one read() */
+static apr_status_t file_fill_buffered(apr_file_t *thefile)
+{
+    int bytesread = read(thefile->filedes, thefile->buffer,
+                         thefile->bufsize);
+    if (bytesread == 0) {
+        thefile->eof_hit = TRUE;
+        return APR_EOF;
+    }
+    else if (bytesread == -1) {
+        return errno;
+    }
+    thefile->dataRead = bytesread;
+    thefile->filePtr += thefile->dataRead;
+    thefile->bufpos = 0;
+    return APR_SUCCESS;
+}
+
 static apr_status_t file_read_buffered(apr_file_t *thefile, void *buf,
                                        apr_size_t *nbytes)
 {
@@ -52,20 +70,10 @@ static apr_status_t file_read_buffered(apr_file_t *thefile, void *buf,
     }
     while (rv == 0 && size > 0) {
         if (thefile->bufpos >= thefile->dataRead) {
-            int bytesread = read(thefile->filedes, thefile->buffer, 
-                                 thefile->bufsize);
-            if (bytesread == 0) {
-                thefile->eof_hit = TRUE;
-                rv = APR_EOF;
-                break;
-            }
-            else if (bytesread == -1) {
-                rv = errno;
+            rv = file_fill_buffered(thefile);
+            if (rv) {
                 break;
             }
-            thefile->dataRead = bytesread;
-            thefile->filePtr += thefile->dataRead;
-            thefile->bufpos = 0;
         }
 
         blocksize = size > thefile->dataRead - thefile->bufpos ? thefile->dataRead - thefile->bufpos : size;
@@ -285,6 +293,108 @@ APR_DECLARE(apr_status_t) apr_file_writev(apr_file_t *thefile, const struct iove
 #endif
 }
 
+/* The positional functions below neither use nor move the file offset
+ * and buffer, hence they need no lock.
+ */
+
+APR_DECLARE(apr_status_t) apr_file_pread(apr_file_t *thefile, void *buf,
+                                         apr_size_t *nbytes,
+                                         apr_off_t offset)
+{
+    apr_ssize_t rv;
+
+    do {
+        rv = pread(thefile->filedes, buf, *nbytes, offset);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == -1) {
+        *nbytes = 0;
+        return errno;
+    }
+    *nbytes = rv;
+    if (rv == 0) {
+        return APR_EOF;
+    }
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwrite(apr_file_t *thefile,
+                                          const void *buf,
+                                          apr_size_t *nbytes,
+                                          apr_off_t offset)
+{
+    apr_ssize_t rv;
+
+    do {
+        rv = pwrite(thefile->filedes, buf, *nbytes, offset);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == -1) {
+        *nbytes = 0;
+        return errno;
+    }
+    *nbytes = rv;
+    return APR_SUCCESS;
+}
+
+APR_DECLARE(apr_status_t) apr_file_preadv(apr_file_t *thefile,
+                                          const struct iovec *vec,
+                                          apr_size_t nvec, apr_off_t offset,
+                                          apr_size_t *nbytes)
+{
+#ifdef HAVE_PREADV
+    apr_ssize_t rv;
+
+    if (nvec > APR_MAX_IOVEC_SIZE) {
+        nvec = APR_MAX_IOVEC_SIZE;
+    }
+    do {
+        rv = preadv(thefile->filedes, vec, nvec, offset);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == -1) {
+        *nbytes = 0;
+        return errno;
+    }
+    *nbytes = rv;
+    if (rv == 0) {
+        return APR_EOF;
+    }
+    return APR_SUCCESS;
+#else
+    /* As apr_file_writev() without writev(), only the first iovec */
+    *nbytes = vec[0].iov_len;
+    return apr_file_pread(thefile, vec[0].iov_base, nbytes, offset);
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_file_pwritev(apr_file_t *thefile,
+                                           const struct iovec *vec,
+                                           apr_size_t nvec, apr_off_t offset,
+                                           apr_size_t *nbytes)
+{
+#ifdef HAVE_PWRITEV
+    apr_ssize_t rv;
+
+    if (nvec > APR_MAX_IOVEC_SIZE) {
+        nvec = APR_MAX_IOVEC_SIZE;
+    }
+    do {
+        rv = pwritev(thefile->filedes, vec, nvec, offset);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == -1) {
+        *nbytes = 0;
+        return errno;
+    }
+    *nbytes = rv;
+    return APR_SUCCESS;
+#else
+    *nbytes = vec[0].iov_len;
+    return apr_file_pwrite(thefile, vec[0].iov_base, nbytes, offset);
+#endif
+}
+
 APR_DECLARE(apr_status_t) apr_file_putc(char ch, apr_file_t *thefile)
 {
     apr_size_t nbytes = 1;
@@ -410,6 +520,75 @@ APR_DECLARE(apr_status_t) apr_file_datasync(apr_file_t *thefile)
     return rv;
 }
 
+APR_DECLARE(apr_status_t) apr_file_advise(apr_file_t *thefile,
+                                          apr_off_t offset, apr_off_t len,
+                                          int advice)
+{
+#ifdef POSIX_FADV_SEQUENTIAL
+    int native_advice;
+#endif
+
+    switch (advice) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    case APR_FADVISE_NORMAL:
+        native_advice = POSIX_FADV_NORMAL;
+        break;
+    case APR_FADVISE_SEQUENTIAL:
+        native_advice = POSIX_FADV_SEQUENTIAL;
+        break;
+    case APR_FADVISE_RANDOM:
+        native_advice = POSIX_FADV_RANDOM;
+        break;
+    case APR_FADVISE_WILLNEED:
+        native_advice = POSIX_FADV_WILLNEED;
+        break;
+    case APR_FADVISE_DONTNEED:
+        native_advice = POSIX_FADV_DONTNEED;
+        break;
+    case APR_FADVISE_NOREUSE:
+        native_advice = POSIX_FADV_NOREUSE;
+        break;
+    default:
+        return APR_EINVAL;
+    }
+
+    /* Returns the error rather than setting errno */
+    return posix_fadvise(thefile->filedes, offset, len, native_advice);
+#else
+    case APR_FADVISE_NORMAL:
+    case APR_FADVISE_SEQUENTIAL:
+    case APR_FADVISE_RANDOM:
+    case APR_FADVISE_WILLNEED:
+    case APR_FADVISE_DONTNEED:
+    case APR_FADVISE_NOREUSE:
+        return APR_SUCCESS;
+    default:
+        return APR_EINVAL;
+    }
+#endif
+}
+
+APR_DECLARE(apr_status_t) apr_file_allocate(apr_file_t *thefile,
+                                            apr_off_t offset, apr_off_t len)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    int rv;
+
+    do {
+        rv = fallocate(thefile->filedes, FALLOC_FL_KEEP_SIZE, offset, len);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == -1) {
+        /* Not supported by this filesystem, or kernel */
+        if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            return APR_SUCCESS;
+        }
+        return errno;
+    }
+#endif
+    return APR_SUCCESS;
+}
+
 APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
 {
     apr_status_t rv = APR_SUCCESS; /* get rid of gcc warning */
@@ -442,23 +621,40 @@ APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
         }
 
         while (str < final) { /* leave room for trailing '\0' */
-            /* Force ungetc leftover to call apr_file_read. */
-            if (thefile->bufpos < thefile->dataRead &&
-                thefile->ungetchar == -1) {
-                *str = thefile->buffer[thefile->bufpos++];
+            apr_size_t avail;
+            char *start, *eol;
+
+            if (thefile->ungetchar != -1) {
+                *str = (char)thefile->ungetchar;
+                thefile->ungetchar = -1;
+                if (*str++ == '\n') {
+                    break;
+                }
+                continue;
             }
-            else {
-                nbytes = 1;
-                rv = file_read_buffered(thefile, str, &nbytes);
+            if (thefile->bufpos >= thefile->dataRead) {
+                rv = file_fill_buffered(thefile);
                 if (rv != APR_SUCCESS) {
                     break;
                 }
             }
-            if (*str == '\n') {
-                ++str;
+
+            /* Copy up to the end of the line, buffer or str at once */
+            start = thefile->buffer + thefile->bufpos;
+            avail = thefile->dataRead - thefile->bufpos;
+            if (avail > (apr_size_t)(final - str)) {
+                avail = final - str;
+            }
+            eol = memchr(start, '\n', avail);
+            if (eol) {
+                avail = eol - start + 1;
+            }
+            memcpy(str, start, avail);
+            thefile->bufpos += avail;
+            str += avail;
+            if (eol) {
                 break;
             }
-            ++str;
         }
         file_unlock(thefile);
     }
@@ -490,6 +686,103 @@ APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, apr_file_t *thefile)
     return rv;
 }
 
+APR_DECLARE(apr_status_t) apr_file_getline_span(apr_file_t *thefile,
+                                                const char **line,
+                                                apr_size_t *len)
+{
+    apr_status_t rv = APR_SUCCESS;
+    char *start, *eol;
+    int bytesread;
+
+    *line = NULL;
+    *len = 0;
+    if (!thefile->buffered) {
+        return APR_EINVAL;
+    }
+
+    file_lock(thefile);
+
+    if (thefile->direction == 1) {
+        rv = apr_file_flush_locked(thefile);
+        if (rv) {
+            file_unlock(thefile);
+            return rv;
+        }
+        thefile->direction = 0;
+        thefile->bufpos = 0;
+        thefile->dataRead = 0;
+    }
+
+    /* Put an ungetc leftover back in front of the buffered data, giving
+     * back the last byte read if there is no room.
+     */
+    if (thefile->ungetchar != -1) {
+        if (thefile->bufpos == 0) {
+            if (thefile->dataRead == thefile->bufsize) {
+                if (lseek(thefile->filedes, -1, SEEK_CUR) == -1) {
+                    file_unlock(thefile);
+                    return errno;
+                }
+                thefile->filePtr--;
+                thefile->dataRead--;
+            }
+            memmove(thefile->buffer + 1, thefile->buffer,
+                    thefile->dataRead);
+            thefile->dataRead++;
+            thefile->bufpos++;
+        }
+        thefile->buffer[--thefile->bufpos] = (char)thefile->ungetchar;
+        thefile->ungetchar = -1;
+    }
+
+    for (;;) {
+        start = thefile->buffer + thefile->bufpos;
+        eol = memchr(start, '\n', thefile->dataRead - thefile->bufpos);
+        if (eol) {
+            *len = eol - start + 1;
+            break;
+        }
+
+        /* Move the start of the line to the front, and read after it */
+        if (thefile->bufpos > 0) {
+            thefile->dataRead -= thefile->bufpos;
+            memmove(thefile->buffer, start, thefile->dataRead);
+            thefile->bufpos = 0;
+            start = thefile->buffer;
+        }
+        if (thefile->dataRead == thefile->bufsize) {
+            /* A line longer than the buffer, give it in pieces */
+            *len = thefile->dataRead;
+            break;
+        }
+
+        bytesread = read(thefile->filedes, thefile->buffer + thefile->dataRead,
+                         thefile->bufsize - thefile->dataRead);
+        if (bytesread == 0) {
+            thefile->eof_hit = TRUE;
+            *len = thefile->dataRead;
+            if (*len == 0) {
+                rv = APR_EOF;
+            }
+            break;
+        }
+        else if (bytesread == -1) {
+            rv = errno;
+            break;
+        }
+        thefile->dataRead += bytesread;
+        thefile->filePtr += bytesread;
+    }
+
+    if (*len) {
+        *line = start;
+        thefile->bufpos += *len;
+    }
+
+    file_unlock(thefile);
+    return rv;
+}
+
 struct apr_file_printf_data {
     apr_vformatter_buff_t vbuff;
     apr_file_t *fptr;
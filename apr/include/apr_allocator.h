@@ -74,6 +74,51 @@ struct apr_memnode_t {
 APR_DECLARE(apr_status_t) apr_allocator_create(apr_allocator_t **allocator)
                           __attribute__((nonnull(1)));
 
+/**
+ * @defgroup apr_allocator_attr Allocator attribute flags
+ * @{
+ */
+#define APR_ALLOCATOR_ARENAS      0x01 /**< Carve the nodes out of arenas */
+#define APR_ALLOCATOR_HUGE_PAGES  0x02 /**< Back the arenas with transparent
+                                        * huge pages (implies arenas) */
+#define APR_ALLOCATOR_NUMA_BIND   0x04 /**< Bind the arenas to a NUMA node
+                                        * (implies arenas) */
+/** @} */
+
+/** Allocator attributes, see apr_allocator_create_ex() */
+typedef struct apr_allocator_attr_t {
+    /** APR_ALLOCATOR_* flags */
+    unsigned int flags;
+    /** Size of the arenas, or 0 for the default (2MB) */
+    apr_size_t arena_size;
+    /** NUMA node to bind the arenas to, with APR_ALLOCATOR_NUMA_BIND */
+    int numa_node;
+} apr_allocator_attr_t;
+
+/**
+ * Create a new allocator with attributes
+ * @param allocator The allocator we have just created.
+ * @param attr The attributes, or NULL for the defaults (as
+ *        apr_allocator_create())
+ * @return APR_SUCCESS, APR_ENOTIMPL if an attribute is not supported on
+ *         this platform, APR_EINVAL for an invalid NUMA node, or the error
+ *         from mapping the first arena.
+ * @remark With arenas, the nodes of the common sizes (up to 20 times the
+ *         boundary size, i.e. 80KB on most platforms) are carved out of
+ *         big anonymous mappings, aligned on 2MB and advised to be backed
+ *         by huge pages with APR_ALLOCATOR_HUGE_PAGES, and bound to the
+ *         given NUMA node with APR_ALLOCATOR_NUMA_BIND.  Without the
+ *         latter, the pages are placed by the system on first touch, that
+ *         is usually on the node of the thread using the pool.
+ * @remark The arenas are only unmapped by apr_allocator_destroy(): the
+ *         nodes given back because of apr_allocator_max_free_set() have
+ *         their pages released but stay reserved for the next nodes of
+ *         the same size.
+ */
+APR_DECLARE(apr_status_t) apr_allocator_create_ex(apr_allocator_t **allocator,
+                                            const apr_allocator_attr_t *attr)
+                          __attribute__((nonnull(1)));
+
 /**
  * Destroy an allocator
  * @param allocator The allocator to be destroyed
@@ -148,6 +193,72 @@ APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
                                              apr_size_t size)
                   __attribute__((nonnull(1)));
 
+/** Number of free lists reported by apr_allocator_stats_get() */
+#define APR_ALLOCATOR_STATS_NINDEX 20
+
+/** Allocator statistics, see apr_allocator_stats_get() */
+typedef struct apr_allocator_stats_t {
+    /** Node sizes are multiples of this */
+    apr_size_t boundary_size;
+    /** Number of nodes on each free list: list i (i > 0) holds the nodes
+     * of (i + 1) * boundary_size bytes, list 0 the bigger ones */
+    apr_size_t free_nodes[APR_ALLOCATOR_STATS_NINDEX];
+    /** Total size of the nodes on the free lists */
+    apr_size_t free_bytes;
+    /** Number of free nodes held by the per-thread magazines */
+    apr_size_t magazine_nodes;
+    /** Number of standalone nodes currently obtained from the system with
+     * mmap() */
+    apr_size_t mmap_nodes;
+    /** Number of nodes currently obtained from the system with malloc() */
+    apr_size_t malloc_nodes;
+    /** Number of arenas, see apr_allocator_create_ex() */
+    apr_size_t arenas;
+    /** Number of nodes carved from the arenas */
+    apr_size_t arena_nodes;
+    /** Number of nodes given back to the system because of the threshold
+     * set by apr_allocator_max_free_set() */
+    apr_size_t evicted_nodes;
+} apr_allocator_stats_t;
+
+/**
+ * Get the allocator's statistics
+ * @param allocator The allocator
+ * @param stats The statistics to fill in
+ * @remark This walks the free lists with the allocator locked, it's meant
+ *         to be cheap enough to be called periodically in production.
+ */
+APR_DECLARE(void) apr_allocator_stats_get(apr_allocator_t *allocator,
+                                          apr_allocator_stats_t *stats)
+                  __attribute__((nonnull(1,2)));
+
+/** Arena statistics, see apr_allocator_arena_stats_get() */
+typedef struct apr_allocator_arena_stats_t {
+    /** Start of the arena */
+    void *base;
+    /** Size of the arena */
+    apr_size_t size;
+    /** Bytes carved from the arena so far */
+    apr_size_t used;
+    /** Number of nodes carved from the arena */
+    apr_size_t nodes;
+} apr_allocator_arena_stats_t;
+
+/**
+ * Get the statistics of each arena of the allocator
+ * @param allocator The allocator
+ * @param stats The array of statistics to fill in, one per arena
+ * @param nelts On input the number of elements of @a stats, on output
+ *        the number of elements filled in
+ * @return APR_SUCCESS, or APR_INCOMPLETE if @a stats is too small for
+ *         all the arenas
+ */
+APR_DECLARE(apr_status_t) apr_allocator_arena_stats_get(
+                                          apr_allocator_t *allocator,
+                                          apr_allocator_arena_stats_t *stats,
+                                          apr_size_t *nelts)
+                          __attribute__((nonnull(1,2,3)));
+
 #include "apr_thread_mutex.h"
 
 #if APR_HAS_THREADS
@@ -168,6 +279,26 @@ APR_DECLARE(apr_thread_mutex_t *) apr_allocator_mutex_get(
                                           apr_allocator_t *allocator)
                                   __attribute__((nonnull(1)));
 
+/**
+ * Enable (or disable) per-thread magazines for the allocator
+ * @param allocator The allocator
+ * @param depth The maximum number of free nodes each magazine keeps per
+ *        node size, or 0 to disable the magazines.
+ * @return APR_SUCCESS, or APR_ENOMEM if the magazines can't be allocated
+ * @remark Magazines keep small bounded stashes of free nodes of the
+ *         common sizes (up to five times the boundary size, i.e. 20KB
+ *         on most platforms) so that threads sharing the allocator can
+ *         recycle them without taking the allocator mutex.  The nodes
+ *         held by the magazines are accounted against the threshold set
+ *         by apr_allocator_max_free_set().
+ * @remark This must not be called while other threads use the allocator,
+ *         nor must apr_allocator_max_free_set() once the magazines are
+ *         enabled (it rebalances them against the new threshold).
+ */
+APR_DECLARE(apr_status_t) apr_allocator_magazine_set(apr_allocator_t *allocator,
+                                                     apr_size_t depth)
+                          __attribute__((nonnull(1)));
+
 #endif /* APR_HAS_THREADS */
 
 /** @} */
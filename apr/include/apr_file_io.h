@@ -160,6 +160,24 @@ extern "C" {
 #define APR_FILE_ATTR_HIDDEN     0x04          /**< File is hidden */
 /** @} */
 
+/**
+ * @defgroup apr_file_advise_flags File Access Pattern Hints
+ * @see apr_file_advise(), apr_mmap_advise()
+ * @{
+ */
+
+#define APR_FADVISE_NORMAL     0 /**< No particular access pattern */
+#define APR_FADVISE_SEQUENTIAL 1 /**< Read from lower to higher offsets;
+                                      read ahead more */
+#define APR_FADVISE_RANDOM     2 /**< Read in no particular order;
+                                      do not read ahead */
+#define APR_FADVISE_WILLNEED   3 /**< The data will be needed soon;
+                                      start reading it now */
+#define APR_FADVISE_DONTNEED   4 /**< The data will not be needed soon;
+                                      drop it from the cache */
+#define APR_FADVISE_NOREUSE    5 /**< The data will be accessed only once */
+/** @} */
+
 /**
  * @defgroup apr_file_writev{_full} max iovec size
  * @{
@@ -298,6 +316,8 @@ APR_DECLARE(apr_status_t) apr_file_link(const char *from_path,
  *     file's permissions are copied.
  * @param pool The pool to use.
  * @remark The new file does not need to exist, it will be created if required.
+ * @remark Where the platform allows it (copy_file_range() or sendfile() on
+ * Linux), the data does not go through user space.
  * @warning If the new file already exists, its contents will be overwritten.
  */
 APR_DECLARE(apr_status_t) apr_file_copy(const char *from_path, 
@@ -325,6 +345,25 @@ APR_DECLARE(apr_status_t) apr_file_append(const char *from_path,
                                           apr_fileperms_t perms,
                                           apr_pool_t *pool);
 
+/**
+ * Move data from one open file to another, without copying it through
+ * user space where the platform allows it.
+ * @param out The file to write to.
+ * @param in The file to read from.
+ * @param len On entry, the maximum number of bytes to move.  On exit, the
+ *     number of bytes moved.
+ * @remark On Linux the bytes are spliced in the kernel when either file
+ * is a pipe (the other one being a pipe, a regular file or a socket put
+ * with apr_os_pipe_put()), or sent from a regular file otherwise.  Where
+ * this is not possible, or when either file is buffered, they go through
+ * apr_file_read() and apr_file_write_full().
+ * @remark Like apr_file_read(), this may move fewer bytes than requested,
+ * and returns #APR_EOF when nothing is left to read from @a in.  The
+ * timeouts of both files are honoured.
+ */
+APR_DECLARE(apr_status_t) apr_file_splice(apr_file_t *out, apr_file_t *in,
+                                          apr_size_t *len);
+
 /**
  * Are we at the end of the file
  * @param fptr The apr file we are testing.
@@ -557,6 +596,82 @@ APR_DECLARE(apr_status_t) apr_file_writev_full(apr_file_t *thefile,
                                                const struct iovec *vec,
                                                apr_size_t nvec,
                                                apr_size_t *nbytes);
+
+/**
+ * Read data from the specified file at the given offset.
+ * @param thefile The file descriptor to read from.
+ * @param buf The buffer to store the data to.
+ * @param nbytes On entry, the number of bytes to read; on exit, the number
+ *               of bytes read.
+ * @param offset The offset in the file to read from.
+ *
+ * @remark Neither the file position nor the buffer of a buffered file are
+ * used or changed, so many threads may call this on the same file at once.
+ * Data still in the write buffer of a buffered file is not seen, flush it
+ * first with apr_file_flush().
+ *
+ * @remark Fewer bytes than requested may be read; #APR_EOF is returned
+ * when @a offset is at or beyond the end of the file.
+ *
+ * @remark Not supported on pipes, nor on Windows and OS/2, where
+ * #APR_ENOTIMPL is returned.
+ */
+APR_DECLARE(apr_status_t) apr_file_pread(apr_file_t *thefile, void *buf,
+                                         apr_size_t *nbytes,
+                                         apr_off_t offset);
+
+/**
+ * Write data to the specified file at the given offset.
+ * @param thefile The file descriptor to write to.
+ * @param buf The buffer which contains the data.
+ * @param nbytes On entry, the number of bytes to write; on exit, the number
+ *               of bytes written.
+ * @param offset The offset in the file to write at.
+ *
+ * @remark Like apr_file_pread(), this neither uses nor changes the file
+ * position or buffer, so the read buffer of a buffered file may still hold
+ * the data overwritten.  On Linux a file opened with #APR_FOPEN_APPEND is
+ * always appended to, whatever the offset.
+ */
+APR_DECLARE(apr_status_t) apr_file_pwrite(apr_file_t *thefile,
+                                          const void *buf,
+                                          apr_size_t *nbytes,
+                                          apr_off_t offset);
+
+/**
+ * Read data from the specified file at the given offset, to an iovec array.
+ * @param thefile The file descriptor to read from.
+ * @param vec The array of buffers to fill, in order.
+ * @param nvec The number of elements in the struct iovec array; no more
+ *             than #APR_MAX_IOVEC_SIZE are used.
+ * @param offset The offset in the file to read from.
+ * @param nbytes The number of bytes read.
+ *
+ * @remark See apr_file_pread().  Where the system has no preadv(), only the
+ * first iovec is filled.
+ */
+APR_DECLARE(apr_status_t) apr_file_preadv(apr_file_t *thefile,
+                                          const struct iovec *vec,
+                                          apr_size_t nvec, apr_off_t offset,
+                                          apr_size_t *nbytes);
+
+/**
+ * Write data from an iovec array to the specified file at the given offset.
+ * @param thefile The file descriptor to write to.
+ * @param vec The array from which to get the data to write to the file.
+ * @param nvec The number of elements in the struct iovec array; no more
+ *             than #APR_MAX_IOVEC_SIZE are used.
+ * @param offset The offset in the file to write at.
+ * @param nbytes The number of bytes written.
+ *
+ * @remark See apr_file_pwrite().  Where the system has no pwritev(), only
+ * the first iovec is written.
+ */
+APR_DECLARE(apr_status_t) apr_file_pwritev(apr_file_t *thefile,
+                                           const struct iovec *vec,
+                                           apr_size_t nvec, apr_off_t offset,
+                                           apr_size_t *nbytes);
+
 /**
  * Write a character into the specified file.
  * @param ch The character to write.
@@ -589,6 +704,25 @@ APR_DECLARE(apr_status_t) apr_file_ungetc(char ch, apr_file_t *thefile);
 APR_DECLARE(apr_status_t) apr_file_gets(char *str, int len, 
                                         apr_file_t *thefile);
 
+/**
+ * Read a line from the specified buffered file, without copying it.
+ * @param thefile The file descriptor to read from, opened with
+ *        #APR_FOPEN_BUFFERED
+ * @param line Set to the start of the line, in the buffer of the file
+ * @param len Set to the length of the line, including the newline
+ * @remark The line stays valid until the next operation on @a thefile; it
+ *         is not NUL-terminated, and the newline is not stripped.
+ * @remark A line longer than the buffer of the file (see
+ *         apr_file_buffer_set()) is returned in pieces of the buffer's
+ *         size, only the last one ending with a newline.  The last line
+ *         of the file may have no newline.
+ * @remark Returns #APR_EOF at the end of the file, and #APR_EINVAL if the
+ *         file is not buffered.  Not implemented on Windows and OS/2.
+ */
+APR_DECLARE(apr_status_t) apr_file_getline_span(apr_file_t *thefile,
+                                                const char **line,
+                                                apr_size_t *len);
+
 /**
  * Write the string into the specified file.
  * @param str The string to write. 
@@ -614,6 +748,35 @@ APR_DECLARE(apr_status_t) apr_file_sync(apr_file_t *thefile);
  */
 APR_DECLARE(apr_status_t) apr_file_datasync(apr_file_t *thefile);
 
+/**
+ * Tell the system how a range of the file will be accessed.
+ * @param thefile The file descriptor to advise about
+ * @param offset The start of the range
+ * @param len The length of the range, 0 for up to the end of the file
+ * @param advice One of the @ref apr_file_advise_flags
+ * @remark This is only a hint, which may be ignored: where it is not
+ * supported (posix_fadvise() being missing), this is a no-op which
+ * returns #APR_SUCCESS.  #APR_EINVAL is returned for an unknown hint.
+ */
+APR_DECLARE(apr_status_t) apr_file_advise(apr_file_t *thefile,
+                                          apr_off_t offset, apr_off_t len,
+                                          int advice);
+
+/**
+ * Reserve the disk space for a range of the file, so that writing to it
+ * later does not fail for lack of space or fragment the file.
+ * @param thefile The file descriptor to allocate space for
+ * @param offset The start of the range
+ * @param len The length of the range
+ * @remark The size of the file is not changed, even if the range goes
+ * beyond its end, so appending to the file then uses the space reserved.
+ * @remark Where it is not supported (only Linux's fallocate() is used, and
+ * not all filesystems support it), this is a no-op which returns
+ * #APR_SUCCESS.
+ */
+APR_DECLARE(apr_status_t) apr_file_allocate(apr_file_t *thefile,
+                                            apr_off_t offset, apr_off_t len);
+
 /**
  * Duplicate the specified file descriptor.
  * @param new_file The structure to duplicate into. 
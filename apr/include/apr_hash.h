@@ -70,6 +70,34 @@ typedef unsigned int (*apr_hashfunc_t)(const char *key, apr_ssize_t *klen);
 APR_DECLARE_NONSTD(unsigned int) apr_hashfunc_default(const char *key,
                                                       apr_ssize_t *klen);
 
+/**
+ * The hash function used by the hash tables not made with a custom one.
+ * @param key The key.
+ * @param klen The length of the key, or APR_HASH_KEY_STRING to use the string
+ *             length. If APR_HASH_KEY_STRING then returns the actual key length.
+ * @param seed The seed (each hash table has a random one).
+ * @remark This hashes a word at a time and, unlike apr_hashfunc_default(),
+ *         its values may change across APR versions and platforms, so they
+ *         should not be persisted.
+ */
+APR_DECLARE(unsigned int) apr_hashfunc_seeded(const char *key,
+                                              apr_ssize_t *klen,
+                                              apr_uint64_t seed);
+
+/**
+ * A key with its hash value precomputed for a given hash table, for the
+ * lookups of the same key in the same table (e.g. constant keys), see
+ * apr_hash_key_init().
+ */
+typedef struct apr_hash_key_t {
+    /** The key */
+    const void *key;
+    /** The key length (never APR_HASH_KEY_STRING) */
+    apr_ssize_t klen;
+    /** The hash value of the key for the table */
+    unsigned int hash;
+} apr_hash_key_t;
+
 /**
  * Create a hash table.
  * @param pool The pool to allocate the hash table out of
@@ -86,6 +114,28 @@ APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool);
 APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool, 
                                                apr_hashfunc_t hash_func);
 
+/**
+ * Store the entries of the hash table in its array (open addressing),
+ * rather than chaining them from it.  This saves an allocation per entry
+ * and a pointer chase per probe, which makes lookups in big tables more
+ * cache friendly.
+ */
+#define APR_HASH_OPEN_ADDRESSING 0x1
+
+/**
+ * Create a hash table with a custom hash function and/or flags
+ * @param pool The pool to allocate the hash table out of
+ * @param hash_func A custom hash function, or NULL for the default one.
+ * @param flags Zero or APR_HASH_OPEN_ADDRESSING
+ * @return The hash table just created
+ * @remark All the hash table functions work the same whatever the flags.
+ *         apr_hash_make(p) is apr_hash_make_ex(p, NULL, 0), and
+ *         apr_hash_make_custom(p, f) is apr_hash_make_ex(p, f, 0).
+ */
+APR_DECLARE(apr_hash_t *) apr_hash_make_ex(apr_pool_t *pool,
+                                           apr_hashfunc_t hash_func,
+                                           unsigned int flags);
+
 /**
  * Make a copy of a hash table
  * @param pool The pool from which to allocate the new hash table
@@ -188,6 +238,53 @@ APR_DECLARE(apr_ssize_t) apr_hash_this_key_len(apr_hash_index_t *hi);
  */
 APR_DECLARE(void*) apr_hash_this_val(apr_hash_index_t *hi);
 
+/**
+ * Initialize a prehashed key for a hash table.
+ * @param hk The prehashed key to initialize
+ * @param ht The hash table
+ * @param key Pointer to the key
+ * @param klen Length of the key. Can be APR_HASH_KEY_STRING to use the string length.
+ * @remark The prehashed key can be used with the hash table, and the tables
+ *         made by apr_hash_copy() of it, or apr_hash_overlay() and
+ *         apr_hash_merge() with it as the base, but no other (each hash
+ *         table has its own seed).  The key is referenced, not copied.
+ */
+APR_DECLARE(void) apr_hash_key_init(apr_hash_key_t *hk, const apr_hash_t *ht,
+                                    const void *key, apr_ssize_t klen);
+
+/**
+ * Look up the value associated with a prehashed key in a hash table.
+ * @param ht The hash table
+ * @param hk The prehashed key (see apr_hash_key_init())
+ * @return Returns NULL if the key is not present.
+ */
+APR_DECLARE(void *) apr_hash_get_prehashed(apr_hash_t *ht,
+                                           const apr_hash_key_t *hk);
+
+/**
+ * Associate a value with a prehashed key in a hash table.
+ * @param ht The hash table
+ * @param hk The prehashed key (see apr_hash_key_init())
+ * @param val Value to associate with the key
+ * @remark Same as apr_hash_set(), without hashing the key.
+ */
+APR_DECLARE(void) apr_hash_set_prehashed(apr_hash_t *ht,
+                                         const apr_hash_key_t *hk,
+                                         const void *val);
+
+/**
+ * Look up the values associated with several prehashed keys in a hash
+ * table, prefetching the table's memory for the keys before looking up
+ * each of them.
+ * @param ht The hash table
+ * @param hks The prehashed keys (see apr_hash_key_init())
+ * @param vals The values of the keys, or NULL for the ones not present
+ * @param nelts The number of keys (and values)
+ */
+APR_DECLARE(void) apr_hash_get_many(apr_hash_t *ht,
+                                    const apr_hash_key_t *hks,
+                                    void **vals, apr_size_t nelts);
+
 /**
  * Get the number of key/value pairs in the hash table.
  * @param ht The hash table
@@ -46,6 +46,10 @@ extern "C" {
 #define APR_MMAP_READ    1
 /** MMap opened for writing */
 #define APR_MMAP_WRITE   2
+/** MMap with its pages read in at once, rather than as they are
+ *  first accessed (Linux's MAP_POPULATE, or an #APR_FADVISE_WILLNEED
+ *  advice where available) */
+#define APR_MMAP_POPULATE 4
 
 /** @see apr_mmap_t */
 typedef struct apr_mmap_t            apr_mmap_t;
@@ -127,6 +131,7 @@ struct apr_mmap_t {
  * <PRE>
  *          APR_MMAP_READ       MMap opened for reading
  *          APR_MMAP_WRITE      MMap opened for writing
+ *          APR_MMAP_POPULATE   Read the pages in at once
  * </PRE>
  * @param cntxt The pool to use when creating the mmap.
  */
@@ -160,6 +165,20 @@ APR_DECLARE(apr_status_t) apr_mmap_delete(apr_mmap_t *mm);
 APR_DECLARE(apr_status_t) apr_mmap_offset(void **addr, apr_mmap_t *mm, 
                                           apr_off_t offset);
 
+/**
+ * Tell the system how a range of the mmap'ed file will be accessed.
+ * @param mm The mmap'ed file.
+ * @param offset The start of the range, relative to the start of the mmap.
+ * @param len The length of the range, 0 for up to the end of the mmap.
+ * @param advice One of the @ref apr_file_advise_flags
+ * @remark This is only a hint, which may be ignored: where it is not
+ * supported (madvise() being missing, or for #APR_FADVISE_NOREUSE), this is
+ * a no-op which returns #APR_SUCCESS.  #APR_EINVAL is returned for a range
+ * outside the mmap or an unknown hint.
+ */
+APR_DECLARE(apr_status_t) apr_mmap_advise(apr_mmap_t *mm, apr_off_t offset,
+                                          apr_size_t len, int advice);
+
 #endif /* APR_HAS_MMAP */
 
 /** @} */
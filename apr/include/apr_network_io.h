@@ -108,6 +108,12 @@ extern "C" {
 #define APR_SO_FREEBIND     131072 /**< Allow binding to addresses not owned
                                     * by any interface
                                     */
+#define APR_UDP_GRO         262144 /**< Receive bursts of datagrams coalesced
+                                    * by the kernel, see apr_socket_recvmmsg()
+                                    */
+#define APR_SO_ZEROCOPY     524288 /**< Allow sending without copying the
+                                    * data, see apr_socket_send_zc()
+                                    */
 
 /** @} */
 
@@ -289,6 +295,12 @@ struct apr_sockaddr_t {
 #define APR_SENDFILE_DISCONNECT_SOCKET      1
 #endif
 
+/**
+ * Don't wait for data, whatever the timeout of the socket.
+ * @remark Optional flag passed into apr_socket_recvv()
+ */
+#define APR_RECV_NONBLOCK                   1
+
 /** A structure to encapsulate headers and trailers for apr_socket_sendfile */
 struct apr_hdtr_t {
     /** An iovec to store the headers sent before the file. */
@@ -301,6 +313,25 @@ struct apr_hdtr_t {
     int numtrailers;
 };
 
+/** @see apr_socket_msg_t */
+typedef struct apr_socket_msg_t apr_socket_msg_t;
+
+/** A datagram for apr_socket_sendmmsg() and apr_socket_recvmmsg() */
+struct apr_socket_msg_t {
+    /** The destination (to send), or updated with the source (received),
+     *  may be NULL for connected sockets */
+    apr_sockaddr_t *addr;
+    /** The data to send, or the buffer to receive into */
+    char *buf;
+    /** The length of the data or buffer, updated with the number of
+     *  bytes sent or received */
+    apr_size_t len;
+    /** If not zero, buf holds several datagrams of this size (the last
+     *  one possibly shorter) sent at once with UDP segmentation offload,
+     *  or received at once with APR_UDP_GRO */
+    apr_uint16_t segment_size;
+};
+
 /* function definitions */
 
 /**
@@ -588,6 +619,48 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
                                            const struct iovec *vec,
                                            apr_int32_t nvec, apr_size_t *len);
 
+/**
+ * Send data over a network without copying it (MSG_ZEROCOPY), the buffer
+ * being left untouched until the send is reported completed by
+ * apr_socket_zc_reap().
+ * @param sock The socket to send the data over, with APR_SO_ZEROCOPY set
+ * @param buf The buffer which contains the data to be sent
+ * @param len On entry, the number of bytes to send; on exit, the number
+ *            of bytes sent
+ * @param id Updated with the completion id of this send, the ids of the
+ *           sends of a socket being consecutive (from zero)
+ * @remark This function acts like apr_socket_send() otherwise, and an
+ *         id is consumed only if some data is sent.  The system may fail
+ *         with ENOBUFS while too many completions are pending, they
+ *         should be reaped before trying again.
+ * @remark APR_EINVAL is returned if APR_SO_ZEROCOPY is not set, and
+ *         APR_ENOTIMPL where zero-copy sends are not supported (and
+ *         APR_SO_ZEROCOPY can't be set).
+ */
+APR_DECLARE(apr_status_t) apr_socket_send_zc(apr_socket_t *sock,
+                                             const char *buf,
+                                             apr_size_t *len,
+                                             apr_uint32_t *id);
+
+/**
+ * Reap a completion of apr_socket_send_zc(), without waiting.
+ * @param sock The socket which sent the data
+ * @param first Updated with the id of the first completed send
+ * @param last Updated with the id of the last completed send, all the
+ *             sends from @a first to @a last (inclusive, possibly
+ *             wrapping around) being completed
+ * @param copied If not NULL, updated with whether the system had to copy
+ *               the data anyway (in which case zero-copy sends may not
+ *               be worth it on this socket)
+ * @return APR_SUCCESS, or APR_EAGAIN if no completion is pending.
+ * @remark Pending completions make a pollset signal APR_POLLERR for the
+ *         socket, whatever the events requested.
+ */
+APR_DECLARE(apr_status_t) apr_socket_zc_reap(apr_socket_t *sock,
+                                             apr_uint32_t *first,
+                                             apr_uint32_t *last,
+                                             int *copied);
+
 /**
  * @param sock The socket to send from
  * @param where The apr_sockaddr_t describing where to send the data
@@ -617,6 +690,51 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
                                               apr_socket_t *sock,
                                               apr_int32_t flags, char *buf, 
                                               apr_size_t *len);
+
+/**
+ * Send several datagrams, in a single system call where supported
+ * (sendmmsg()).
+ * @param sock The socket to send from
+ * @param msgs The datagrams, whose len is updated with the number of
+ *             bytes sent
+ * @param nmsgs The number of datagrams
+ * @param flags The flags to use
+ * @param nsent Updated with the number of datagrams sent
+ * @remark This function waits (as apr_socket_sendto()) for the first
+ *         datagram only, and may send fewer datagrams than requested,
+ *         so the remaining ones should be sent by another call.  An error
+ *         is returned only if no datagram was sent.
+ * @remark A non-zero segment_size requires UDP segmentation offload
+ *         (Linux 4.18), APR_ENOTIMPL is returned otherwise.
+ */
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_size_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_size_t *nsent);
+
+/**
+ * Receive several datagrams, in a single system call where supported
+ * (recvmmsg()).
+ * @param sock The socket to receive from
+ * @param msgs The buffers, whose len is updated with the length of the
+ *             datagram received and addr (if any) with its source
+ * @param nmsgs The number of buffers
+ * @param flags The flags to use
+ * @param nrecv Updated with the number of datagrams received
+ * @remark This function waits (as apr_socket_recvfrom()) for the first
+ *         datagram only, then receives those already queued if the system
+ *         supports it (otherwise a single datagram is received).
+ * @remark With APR_UDP_GRO set on the socket, a buffer may receive
+ *         several datagrams from the same source at once, segment_size
+ *         then being the size of each (but the last); it is zero
+ *         otherwise.
+ */
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_size_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_size_t *nrecv);
  
 #if APR_HAS_SENDFILE || defined(DOXYGEN)
 
@@ -669,6 +787,32 @@ APR_DECLARE(apr_status_t) apr_socket_sendfile(apr_socket_t *sock,
 APR_DECLARE(apr_status_t) apr_socket_recv(apr_socket_t *sock, 
                                    char *buf, apr_size_t *len);
 
+/**
+ * Read data from a network into multiple buffers.
+ * @param sock The socket to read the data from.
+ * @param vec The buffers to fill, in order.
+ * @param nvec The number of buffers.
+ * @param flags Zero, or APR_RECV_NONBLOCK.
+ * @param len On exit, the number of bytes received.
+ * @remark
+ * <PRE>
+ * This function acts like apr_socket_recv(), filling each buffer before
+ * the next one.
+ *
+ * With APR_RECV_NONBLOCK, APR_EAGAIN is returned if no data is available
+ * right away, without changing the blocking mode or timeout of the
+ * socket where the system allows it (otherwise they are switched for the
+ * call).
+ *
+ * APR_EINTR is never returned.
+ * </PRE>
+ */
+APR_DECLARE(apr_status_t) apr_socket_recvv(apr_socket_t *sock,
+                                           const struct iovec *vec,
+                                           apr_int32_t nvec,
+                                           apr_int32_t flags,
+                                           apr_size_t *len);
+
 /**
  * Setup socket options for the specified socket
  * @param sock The socket to set up.
@@ -52,6 +52,25 @@ extern "C" {
 #define APR_POLLERR   0x010     /**< Pending error */
 #define APR_POLLHUP   0x020     /**< Hangup occurred */
 #define APR_POLLNVAL  0x040     /**< Descriptor invalid */
+#define APR_POLLIO    0x080     /**< Completion of apr_pollset_recv() or
+                                 *   apr_pollset_send()
+                                 */
+/** @} */
+
+/**
+ * @defgroup pollregflags Pollset Registration Flags
+ * @ingroup apr_poll
+ * To be or'ed into the reqevents of the descriptors passed to
+ * apr_pollset_add() and apr_pollset_rearm().
+ * @{
+ */
+#define APR_POLLSET_EDGE     0x100 /**< Signal the descriptor only when new
+                                    * events occur (edge-triggered), not as
+                                    * long as they are pending
+                                    */
+#define APR_POLLSET_ONESHOT  0x200 /**< Disable the descriptor once signalled,
+                                    * until apr_pollset_rearm()
+                                    */
 /** @} */
 
 /**
@@ -84,7 +103,8 @@ typedef enum {
     APR_POLLSET_PORT,           /**< Poll uses Solaris event port method */
     APR_POLLSET_EPOLL,          /**< Poll uses epoll method */
     APR_POLLSET_POLL,           /**< Poll uses poll method */
-    APR_POLLSET_AIO_MSGQ        /**< Poll uses z/OS asio method */
+    APR_POLLSET_AIO_MSGQ,       /**< Poll uses z/OS asio method */
+    APR_POLLSET_URING           /**< Poll uses Linux io_uring method */
 } apr_pollset_method_e;
 
 /** Used in apr_pollfd_t to determine what the apr_descriptor is */
@@ -182,11 +202,16 @@ APR_DECLARE(apr_status_t) apr_pollset_create(apr_pollset_t **pollset,
  *         structures passed to apr_pollset_add() are not copied and
  *         must have a lifetime at least as long as the pollset.
  * @remark Some poll methods (including APR_POLLSET_KQUEUE,
- *         APR_POLLSET_PORT, and APR_POLLSET_EPOLL) do not have a
- *         fixed limit on the size of the pollset. For these methods,
- *         the size parameter controls the maximum number of
+ *         APR_POLLSET_PORT, APR_POLLSET_EPOLL and APR_POLLSET_URING) do
+ *         not have a fixed limit on the size of the pollset. For these
+ *         methods, the size parameter controls the maximum number of
  *         descriptors that will be returned by a single call to
  *         apr_pollset_poll().
+ * @remark With APR_POLLSET_URING, apr_pollset_add() and apr_pollset_remove()
+ *         are queued and handed to the kernel by the next apr_pollset_poll()
+ *         in the same system call as the wait (unless APR_POLLSET_THREADSAFE
+ *         is used), so a descriptor the kernel refuses is reported there
+ *         with APR_POLLNVAL or APR_POLLERR rather than by apr_pollset_add().
  */
 APR_DECLARE(apr_status_t) apr_pollset_create_ex(apr_pollset_t **pollset,
                                                 apr_uint32_t size,
@@ -224,11 +249,35 @@ APR_DECLARE(apr_status_t) apr_pollset_destroy(apr_pollset_t *pollset);
  *         different calls to apr_pollset_add().  If the events of interest
  *         for a descriptor change, you must first remove the descriptor 
  *         from the pollset with apr_pollset_remove(), then add it again 
- *         specifying all requested events.
+ *         specifying all requested events, or use apr_pollset_rearm().
+ * @remark APR_POLLSET_EDGE and APR_POLLSET_ONESHOT in the reqevents are
+ *         honoured by the APR_POLLSET_EPOLL and APR_POLLSET_URING methods.
+ *         Other methods signal APR_POLLSET_EDGE descriptors like the others
+ *         (level-triggered), which an edge-triggered application handles
+ *         as well, and emulate APR_POLLSET_ONESHOT by removing the
+ *         descriptor when apr_pollset_poll() returns it.
  */
 APR_DECLARE(apr_status_t) apr_pollset_add(apr_pollset_t *pollset,
                                           const apr_pollfd_t *descriptor);
 
+/**
+ * Re-enable a descriptor of a pollset, possibly with other events
+ * @param pollset The pollset of the descriptor
+ * @param descriptor The descriptor, with the events now requested
+ * @remark This is meant for APR_POLLSET_ONESHOT descriptors once signalled,
+ *         say after a worker thread is done with them, and replaces the
+ *         apr_pollset_remove() and apr_pollset_add() pair otherwise needed
+ *         (it maps to a single EPOLL_CTL_MOD with APR_POLLSET_EPOLL).
+ * @remark With APR_POLLSET_NOCOPY, the descriptor must be the one which
+ *         was added (which apr_pollset_poll() returns); otherwise it is
+ *         copied again, and the client_data may change too.
+ * @remark If the descriptor is not in the pollset, APR_NOTFOUND is
+ *         returned, except with the methods emulating APR_POLLSET_ONESHOT
+ *         which can't tell it from a disabled one and add it.
+ */
+APR_DECLARE(apr_status_t) apr_pollset_rearm(apr_pollset_t *pollset,
+                                            const apr_pollfd_t *descriptor);
+
 /**
  * Remove a descriptor from a pollset
  * @param pollset The pollset from which to remove the descriptor
@@ -267,6 +316,9 @@ APR_DECLARE(apr_status_t) apr_pollset_remove(apr_pollset_t *pollset,
  * @remark Multiple signalled conditions for the same descriptor may be reported
  *         in one or more returned apr_pollfd_t structures, depending on the
  *         implementation.
+ * @remark Some methods wait for whole milliseconds only, rounding the
+ *         timeout up.  The APR_POLLSET_URING method, and APR_POLLSET_EPOLL
+ *         with Linux 5.11 or later (epoll_pwait2()), honour microseconds.
  */
 APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
                                            apr_interval_time_t timeout,
@@ -281,6 +333,48 @@ APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
  */
 APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset);
 
+/** Asynchronous socket operation, see apr_pollset_recv() */
+typedef struct apr_pollset_io_t {
+    apr_socket_t *sock;         /**< socket to receive from or send on */
+    char *buf;                  /**< buffer to receive into or send from */
+    apr_size_t len;             /**< length of buf on input, number of
+                                 *   bytes transferred on completion
+                                 */
+    apr_status_t status;        /**< status of the operation on completion */
+    void *client_data;          /**< allows app to associate context */
+} apr_pollset_io_t;
+
+/**
+ * Queue a receive on a socket, to be completed by the pollset
+ * @param pollset The pollset which performs the operation
+ * @param io The operation, which must remain valid (like its buffer) until
+ *           its completion is returned by apr_pollset_poll()
+ * @remark The completion is returned by apr_pollset_poll() as an
+ *         apr_pollfd_t with APR_POLLIN|APR_POLLIO in rtnevents, io->sock
+ *         in desc.s and io in client_data.  The number of bytes received
+ *         is then in io->len, and io->status is APR_EOF at the end of the
+ *         stream or any error, like with apr_socket_recv().
+ * @remark This saves the separate apr_socket_recv() after the socket has
+ *         been signalled, but is only implemented by the APR_POLLSET_URING
+ *         method; others return APR_ENOTIMPL.
+ * @remark Operations still queued when the pollset is destroyed are
+ *         cancelled.
+ */
+APR_DECLARE(apr_status_t) apr_pollset_recv(apr_pollset_t *pollset,
+                                           apr_pollset_io_t *io);
+
+/**
+ * Queue a send on a socket, to be completed by the pollset
+ * @param pollset The pollset which performs the operation
+ * @param io The operation, which must remain valid (like its buffer) until
+ *           its completion is returned by apr_pollset_poll()
+ * @remark Same as apr_pollset_recv(), with APR_POLLOUT|APR_POLLIO in the
+ *         rtnevents of the completion.  Like apr_socket_send(), the number
+ *         of bytes sent may be lower than requested.
+ */
+APR_DECLARE(apr_status_t) apr_pollset_send(apr_pollset_t *pollset,
+                                           apr_pollset_io_t *io);
+
 /**
  * Poll the descriptors in the poll structure
  * @param aprset The poll structure we will be using. 
@@ -536,6 +536,55 @@ APR_DECLARE(int) apr_pool_is_ancestor(apr_pool_t *a, apr_pool_t *b);
 APR_DECLARE(void) apr_pool_tag(apr_pool_t *pool, const char *tag)
                   __attribute__((nonnull(1)));
 
+/** Pool statistics, see apr_pool_stats_get() and apr_pool_stats_walk() */
+typedef struct apr_pool_stats_t {
+    /** The tag of the pool(s), see apr_pool_tag() */
+    const char *tag;
+    /** Number of pools accounted */
+    apr_size_t pools;
+    /** Bytes allocated since the pool was created or last cleared */
+    apr_size_t bytes_allocated;
+    /** Size of the memory currently held by the pool */
+    apr_size_t bytes_held;
+    /** Highest size of the memory held by the pool */
+    apr_size_t peak_size;
+    /** Number of memory nodes taken from the allocator */
+    apr_size_t nodes_acquired;
+    /** Number of times the pool was cleared */
+    apr_size_t clears;
+} apr_pool_stats_t;
+
+/**
+ * Get the statistics of a pool (not including its subpools)
+ * @param pool The pool
+ * @param stats The statistics to fill in
+ * @remark The statistics are always maintained, at the cost of a few
+ *         additions per allocation.  They can be read from another
+ *         thread than the one using the pool, but are then approximate.
+ */
+APR_DECLARE(void) apr_pool_stats_get(apr_pool_t *pool,
+                                     apr_pool_stats_t *stats)
+                  __attribute__((nonnull(1,2)));
+
+/**
+ * Get the statistics of a pool and all its subpools, summed by tag
+ * @param pool The pool to walk
+ * @param stats The array of statistics to fill in, one per distinct tag
+ *        (pools without a tag are accounted together with a NULL tag)
+ * @param nelts On input the number of elements of @a stats, on output
+ *        the number of elements filled in
+ * @return APR_SUCCESS, or APR_INCOMPLETE if @a stats is too small for
+ *         all the tags (the pools with the tags left out are ignored)
+ * @remark The peak_size of an element is the sum of its pools' peaks.
+ * @remark The tree of pools is locked while walked, so it can be called
+ *         from any thread (e.g. on the global pool, from a monitoring
+ *         thread).
+ */
+APR_DECLARE(apr_status_t) apr_pool_stats_walk(apr_pool_t *pool,
+                                              apr_pool_stats_t *stats,
+                                              apr_size_t *nelts)
+                          __attribute__((nonnull(1,2,3)));
+
 
 /*
  * User data management
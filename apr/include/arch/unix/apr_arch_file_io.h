@@ -137,6 +137,12 @@ struct apr_file_t {
 #define fstat(f,b) fstat64(f,b)
 #define lseek(f,o,w) lseek64(f,o,w)
 #define ftruncate(f,l) ftruncate64(f,l)
+#define pread(f,b,n,o) pread64(f,b,n,o)
+#define pwrite(f,b,n,o) pwrite64(f,b,n,o)
+#define preadv(f,v,n,o) preadv64(f,v,n,o)
+#define pwritev(f,v,n,o) pwritev64(f,v,n,o)
+#define posix_fadvise(f,o,l,a) posix_fadvise64(f,o,l,a)
+#define fallocate(f,m,o,l) fallocate64(f,m,o,l)
 typedef struct stat64 struct_stat;
 #else
 typedef struct stat struct_stat;
@@ -52,6 +52,9 @@
 #if APR_HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
 #endif
+#if defined(__linux__) && APR_HAVE_NETINET_IN_H
+#include <netinet/udp.h>        /* UDP_SEGMENT, UDP_GRO */
+#endif
 #if APR_HAVE_NETINET_SCTP_UIO_H
 #include <netinet/sctp_uio.h>
 #endif
@@ -82,6 +85,10 @@
 #if APR_HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
+/* Zero-copy sends (Linux 4.14), completed through the error queue */
+#ifdef HAVE_MSG_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
 /* End System Headers */
 
 #ifndef HAVE_POLLIN
@@ -120,6 +127,8 @@ struct apr_socket_t {
     apr_int32_t options;
     apr_int32_t inherit;
     sock_userdata_t *userdata;
+    /* Completion id of the next apr_socket_send_zc() */
+    apr_uint32_t zc_next;
 #ifndef WAITIO_USES_POLL
     /* if there is a timeout set, then this pollset is used */
     apr_pollset_t *pollset;
@@ -38,6 +38,22 @@
 #include <sys/epoll.h>
 #endif
 
+/* io_uring is used through raw system calls (no liburing), and only with
+ * kernel headers which know the extended wait argument (Linux 5.11), see
+ * configure.
+ */
+#ifdef HAVE_IO_URING
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+/* The wakeup of pollsets and pollcbs uses a single eventfd rather than a
+ * pipe where available.
+ */
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
 #ifdef NETWARE
 #define HAS_SOCKETS(dt) (dt == APR_POLL_SOCKET) ? 1 : 0
 #define HAS_PIPES(dt) (dt == APR_POLL_FILE) ? 1 : 0
@@ -81,7 +97,7 @@
 #endif
 #endif
 
-#if defined(POLLSET_USES_KQUEUE) || defined(POLLSET_USES_EPOLL) || defined(POLLSET_USES_PORT) || defined(POLLSET_USES_AIO_MSGQ)
+#if defined(POLLSET_USES_KQUEUE) || defined(POLLSET_USES_EPOLL) || defined(POLLSET_USES_PORT) || defined(POLLSET_USES_AIO_MSGQ) || defined(HAVE_IO_URING)
 
 #include "apr_ring.h"
 
@@ -120,7 +136,8 @@ struct apr_pollset_t
     apr_uint32_t nelts;
     apr_uint32_t nalloc;
     apr_uint32_t flags;
-    /* Pipe descriptors used for wakeup */
+    /* Pipe descriptors used for wakeup (the eventfd, if any, being
+     * wakeup_pipe[0] alone) */
     apr_file_t *wakeup_pipe[2];
     apr_pollfd_t wakeup_pfd;
     apr_pollset_private_t *p;
@@ -139,6 +156,9 @@ typedef union {
 #endif
 #if defined(HAVE_POLL)
     struct pollfd *ps;
+#endif
+#if defined(HAVE_IO_URING)
+    struct apr_pollcb_uring_t *uring;
 #endif
     void *undef;
 } apr_pollcb_pset;
@@ -148,7 +168,8 @@ struct apr_pollcb_t {
     apr_uint32_t nelts;
     apr_uint32_t nalloc;
     apr_uint32_t flags;
-    /* Pipe descriptors used for wakeup */
+    /* Pipe descriptors used for wakeup (the eventfd, if any, being
+     * wakeup_pipe[0] alone) */
     apr_file_t *wakeup_pipe[2];
     apr_pollfd_t wakeup_pfd;
     int fd;
@@ -164,6 +185,12 @@ struct apr_pollset_provider_t {
     apr_status_t (*poll)(apr_pollset_t *, apr_interval_time_t, apr_int32_t *, const apr_pollfd_t **);
     apr_status_t (*cleanup)(apr_pollset_t *);
     const char *name;
+    /* Optional, queues apr_pollset_recv() (APR_POLLIN) or
+     * apr_pollset_send() (APR_POLLOUT) */
+    apr_status_t (*io)(apr_pollset_t *, apr_pollset_io_t *, apr_int16_t);
+    /* Optional, native APR_POLLSET_EDGE and APR_POLLSET_ONESHOT support,
+     * which pollset.c emulates otherwise */
+    apr_status_t (*rearm)(apr_pollset_t *, const apr_pollfd_t *);
 };
 
 struct apr_pollcb_provider_t {
@@ -182,6 +209,21 @@ struct apr_pollcb_provider_t {
 apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd, 
                                          apr_file_t **wakeup_pipe);
 apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe);
+apr_status_t apr_poll_write_wakeup_pipe(apr_file_t **wakeup_pipe);
 void apr_poll_drain_wakeup_pipe(apr_file_t **wakeup_pipe);
 
+/* The client_data of the wakeup descriptor, which tells it from the
+ * others (and can be used as the user data of the kernel event directly).
+ */
+extern char apr_poll_wakeup_token;
+#define APR_POLL_WAKEUP_DATA ((void *)&apr_poll_wakeup_token)
+#define apr_poll_is_wakeup(pfd) ((pfd)->client_data == APR_POLL_WAKEUP_DATA)
+
+#if defined(HAVE_IO_URING)
+/* Closes the idle io_uring ring inherited from the parent process, if any,
+ * whatever the method of the pollset or pollcb being created.
+ */
+void apr_poll_uring_release_inherited(void);
+#endif
+
 #endif /* APR_ARCH_POLL_PRIVATE_H */
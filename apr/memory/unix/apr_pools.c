@@ -48,6 +48,34 @@
 #include <sys/mman.h>
 #endif
 
+/* Arenas (see apr_allocator_create_ex()) are mapped anonymously, they
+ * don't play well with guard pages though.
+ */
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H) \
+    && !APR_ALLOCATOR_GUARD_PAGES
+#include <sys/mman.h>
+#ifdef MAP_ANON
+#define ALLOCATOR_ARENAS 1
+#endif
+#endif
+#ifndef ALLOCATOR_ARENAS
+#define ALLOCATOR_ARENAS 0
+#endif
+
+/* NUMA binding of the arenas, with mbind(2) called directly to not
+ * depend on libnuma.
+ */
+#if ALLOCATOR_ARENAS && defined(__linux__) && defined(HAVE_SYS_SYSCALL_H)
+#include <sys/syscall.h>
+#ifdef SYS_mbind
+#define ALLOCATOR_NUMA 1
+#define ALLOCATOR_MPOL_BIND 2 /* MPOL_BIND in <linux/mempolicy.h> */
+#endif
+#endif
+#ifndef ALLOCATOR_NUMA
+#define ALLOCATOR_NUMA 0
+#endif
+
 #if HAVE_VALGRIND
 #include <valgrind.h>
 #include <memcheck.h>
@@ -85,6 +113,10 @@ int apr_running_on_valgrind = 0;
 #define MIN_ALLOC (2 * BOUNDARY_SIZE)
 #define MAX_INDEX   20
 
+#if MAX_INDEX != APR_ALLOCATOR_STATS_NINDEX
+#error APR_ALLOCATOR_STATS_NINDEX does not match MAX_INDEX
+#endif
+
 #if APR_ALLOCATOR_USES_MMAP && defined(_SC_PAGESIZE)
 static unsigned int boundary_index;
 static unsigned int boundary_size;
@@ -115,6 +147,24 @@ static unsigned int boundary_size;
 #define TIMEOUT_USECS    3000000
 #define TIMEOUT_INTERVAL   46875
 
+/*
+ * Arenas
+ *
+ * Big (ARENA_ALIGN aligned with huge pages) mappings which the nodes of
+ * the common sizes are carved from.  They are only unmapped when the
+ * allocator is destroyed: a node given back to the system gets its pages
+ * released and is kept as a spare for the next node of its size.
+ */
+#define ARENA_ALIGN         (2 * 1024 * 1024) /* usual huge page size */
+#define ARENA_NUMA_NODES    1024
+
+typedef struct allocator_arena_t {
+    char       *base;
+    apr_size_t  size;
+    apr_size_t  used;
+    apr_size_t  nodes;
+} allocator_arena_t;
+
 /*
  * Allocator
  *
@@ -151,10 +201,69 @@ struct apr_allocator_t {
      * slot 19: size 81920
      */
     apr_memnode_t      *free[MAX_INDEX];
+    /** Number of nodes currently obtained from the system (malloc()ed or
+     * mmap()ed), and number of nodes given back because of max_free_index.
+     * Both are updated with the allocator locked, not with apr_atomic_*()
+     * since the global allocator is used before apr_atomic_init().
+     */
+    apr_size_t          sys_nodes;
+    apr_size_t          evicted_nodes;
+#if ALLOCATOR_ARENAS
+    /** The arenas (sorted by address), the one being carved and the
+     * spare nodes, all protected by the allocator lock.  arena_flags
+     * is zero unless enabled with apr_allocator_create_ex().
+     */
+    unsigned int        arena_flags;
+    int                 numa_node;
+    apr_size_t          arena_size;
+    allocator_arena_t  *arenas;
+    apr_size_t          narenas;
+    apr_size_t          arenas_alloc;
+    char               *arena_avail;
+    char               *arena_end;
+    apr_memnode_t      *arena_spare;
+#endif /* ALLOCATOR_ARENAS */
+#if APR_HAS_THREADS
+    /** Per-thread magazines (MAGAZINE_SLOTS of them), NULL unless
+     * enabled with apr_allocator_magazine_set().
+     */
+    char               *magazines;
+    /** Maximum number of nodes kept per magazine and size */
+    apr_uint32_t        magazine_depth;
+    /** Memory size (in BOUNDARY_SIZE multiples) held in the magazines,
+     * accounted against max_free_index along with the free[] lists.
+     */
+    volatile apr_uint32_t magazine_free_index;
+#endif /* APR_HAS_THREADS */
 };
 
 #define SIZEOF_ALLOCATOR_T  APR_ALIGN_DEFAULT(sizeof(apr_allocator_t))
 
+#if APR_HAS_THREADS
+/*
+ * Magazines
+ *
+ * A magazine is a small stash of free nodes of the common sizes
+ * (indexes 1..MAGAZINE_MAX_INDEX) which a thread can recycle without
+ * taking the allocator mutex.  Threads are spread over MAGAZINE_SLOTS
+ * magazines by their thread id, and a magazine is claimed with a single
+ * compare-and-swap; when it is busy the shared free[] lists are used.
+ */
+#define MAGAZINE_SLOTS_LOG2 5
+#define MAGAZINE_SLOTS      (1 << MAGAZINE_SLOTS_LOG2)
+#define MAGAZINE_MAX_INDEX  4
+#define MAGAZINE_MAX_DEPTH  256
+
+typedef struct allocator_magazine_t {
+    volatile apr_uint32_t busy;
+    apr_uint32_t          count[MAGAZINE_MAX_INDEX + 1];
+    apr_memnode_t        *nodes[MAGAZINE_MAX_INDEX + 1];
+} allocator_magazine_t;
+
+/* Keep each magazine on its own cache line(s) */
+#define SIZEOF_MAGAZINE_T   APR_ALIGN(sizeof(allocator_magazine_t), 64)
+#endif /* APR_HAS_THREADS */
+
 
 /*
  * Allocator
@@ -178,6 +287,382 @@ void allocator_unlock(apr_allocator_t *allocator)
 #endif /* APR_HAS_THREADS */
 }
 
+#if APR_HAS_THREADS
+
+static APR_INLINE
+allocator_magazine_t *magazine_at(apr_allocator_t *allocator, apr_size_t slot)
+{
+    return (allocator_magazine_t *)(allocator->magazines
+                                    + slot * SIZEOF_MAGAZINE_T);
+}
+
+/* Try to claim the calling thread's magazine, NULL if it is busy. */
+static APR_INLINE
+allocator_magazine_t *magazine_claim(apr_allocator_t *allocator)
+{
+    allocator_magazine_t *magazine;
+    apr_uint64_t tid;
+    apr_uint32_t hash;
+
+    tid = (apr_uint64_t)(apr_uintptr_t)apr_os_thread_current();
+    hash = (apr_uint32_t)(tid ^ (tid >> 32));
+    hash ^= hash >> 12;
+    hash *= 0x9e3779b1;
+
+    magazine = magazine_at(allocator, hash >> (32 - MAGAZINE_SLOTS_LOG2));
+    if (apr_atomic_cas32(&magazine->busy, 1, 0) != 0) {
+        return NULL;
+    }
+
+    return magazine;
+}
+
+static APR_INLINE
+void magazine_release(allocator_magazine_t *magazine)
+{
+    apr_atomic_set32(&magazine->busy, 0);
+}
+
+/* The memory held by the magazines only needs accounting (against
+ * max_free_index) when a threshold is set.
+ */
+static APR_INLINE
+void magazine_charge(apr_allocator_t *allocator, apr_size_t free_index)
+{
+    if (allocator->max_free_index != APR_ALLOCATOR_MAX_FREE_UNLIMITED) {
+        apr_atomic_add32(&allocator->magazine_free_index,
+                         (apr_uint32_t)free_index);
+    }
+}
+
+static APR_INLINE
+void magazine_discharge(apr_allocator_t *allocator, apr_size_t free_index)
+{
+    if (allocator->max_free_index != APR_ALLOCATOR_MAX_FREE_UNLIMITED) {
+        apr_atomic_sub32(&allocator->magazine_free_index,
+                         (apr_uint32_t)free_index);
+    }
+}
+
+/* Move up to half the magazine depth worth of nodes of the given index
+ * from the shared free list to the magazine, under a single lock.
+ */
+static void magazine_refill(apr_allocator_t *allocator,
+                            allocator_magazine_t *magazine,
+                            apr_size_t index)
+{
+    apr_memnode_t *node, **ref;
+    apr_size_t max_index;
+    apr_uint32_t count = 0, want;
+
+    want = (allocator->magazine_depth + 1) / 2;
+
+    allocator_lock(allocator);
+
+    ref = &allocator->free[index];
+    while (count < want && (node = *ref) != NULL) {
+        *ref = node->next;
+        node->next = magazine->nodes[index];
+        magazine->nodes[index] = node;
+        count++;
+    }
+    if (count) {
+        max_index = allocator->max_index;
+        if (*ref == NULL && index >= max_index) {
+            do {
+                ref--;
+                max_index--;
+            }
+            while (*ref == NULL && max_index);
+
+            allocator->max_index = max_index;
+        }
+
+        allocator->current_free_index += count * (index + 1);
+        if (allocator->current_free_index > allocator->max_free_index)
+            allocator->current_free_index = allocator->max_free_index;
+
+        magazine->count[index] += count;
+        magazine_charge(allocator, count * (index + 1));
+    }
+
+    allocator_unlock(allocator);
+}
+
+static APR_INLINE
+apr_memnode_t *magazine_alloc(apr_allocator_t *allocator, apr_size_t index)
+{
+    allocator_magazine_t *magazine;
+    apr_memnode_t *node;
+
+    if ((magazine = magazine_claim(allocator)) == NULL) {
+        return NULL;
+    }
+
+    if (magazine->nodes[index] == NULL
+        && index <= allocator->max_index && allocator->free[index]) {
+        magazine_refill(allocator, magazine, index);
+    }
+
+    if ((node = magazine->nodes[index]) != NULL) {
+        magazine->nodes[index] = node->next;
+        magazine->count[index]--;
+        magazine_discharge(allocator, index + 1);
+    }
+
+    magazine_release(magazine);
+
+    return node;
+}
+
+/* Stash the given list of nodes in the calling thread's magazine, and
+ * return those which did not fit (to be given to the shared free lists).
+ */
+static APR_INLINE
+apr_memnode_t *magazine_free(apr_allocator_t *allocator, apr_memnode_t *node)
+{
+    allocator_magazine_t *magazine;
+    apr_memnode_t *next, *rest = NULL, **ref;
+    apr_size_t index;
+    apr_uint32_t keep, held;
+
+    if ((magazine = magazine_claim(allocator)) == NULL) {
+        return node;
+    }
+
+    do {
+        next = node->next;
+        index = node->index;
+
+        if (index == 0 || index > MAGAZINE_MAX_INDEX) {
+            node->next = rest;
+            rest = node;
+            continue;
+        }
+
+        /* When the magazine is full, rebalance by handing its older
+         * half back to the shared free lists.
+         */
+        if (magazine->count[index] >= allocator->magazine_depth) {
+            keep = allocator->magazine_depth / 2;
+            ref = &magazine->nodes[index];
+            while (keep--) {
+                ref = &(*ref)->next;
+            }
+            held = magazine->count[index] - allocator->magazine_depth / 2;
+            magazine->count[index] -= held;
+            magazine_discharge(allocator, held * (index + 1));
+            while (*ref) {
+                apr_memnode_t *old = *ref;
+                *ref = old->next;
+                old->next = rest;
+                rest = old;
+            }
+        }
+
+        /* Magazines are accounted against max_free too, past which the
+         * node goes to the shared free lists to be given back.
+         */
+        if (allocator->max_free_index != APR_ALLOCATOR_MAX_FREE_UNLIMITED
+            && apr_atomic_read32(&allocator->magazine_free_index) + index + 1
+               > allocator->current_free_index) {
+            node->next = rest;
+            rest = node;
+            continue;
+        }
+
+        APR_VALGRIND_NOACCESS((char *)node + APR_MEMNODE_T_SIZE,
+                              (node->index+1) << BOUNDARY_INDEX);
+
+        node->next = magazine->nodes[index];
+        magazine->nodes[index] = node;
+        magazine->count[index]++;
+        magazine_charge(allocator, index + 1);
+    } while ((node = next) != NULL);
+
+    magazine_release(magazine);
+
+    return rest;
+}
+
+/* Empty all the magazines, returning the list of their nodes.
+ * The allocator must not be used concurrently.
+ */
+static apr_memnode_t *magazine_drain(apr_allocator_t *allocator)
+{
+    allocator_magazine_t *magazine;
+    apr_memnode_t *node, *list = NULL;
+    apr_size_t slot, index;
+
+    for (slot = 0; slot < MAGAZINE_SLOTS; slot++) {
+        magazine = magazine_at(allocator, slot);
+        while (apr_atomic_cas32(&magazine->busy, 1, 0) != 0) {
+            apr_thread_yield();
+        }
+        for (index = 1; index <= MAGAZINE_MAX_INDEX; index++) {
+            while ((node = magazine->nodes[index]) != NULL) {
+                magazine->nodes[index] = node->next;
+                node->next = list;
+                list = node;
+            }
+            magazine->count[index] = 0;
+        }
+        magazine_release(magazine);
+    }
+    apr_atomic_set32(&allocator->magazine_free_index, 0);
+
+    return list;
+}
+
+static void allocator_free_shared(apr_allocator_t *allocator,
+                                  apr_memnode_t *node);
+
+#endif /* APR_HAS_THREADS */
+
+#if ALLOCATOR_ARENAS
+/* Index of the arena holding node, or narenas if none does */
+static apr_size_t arena_find(const apr_allocator_t *allocator,
+                             const apr_memnode_t *node)
+{
+    apr_size_t lo = 0, hi = allocator->narenas, i;
+
+    while (lo < hi) {
+        const allocator_arena_t *arena;
+
+        i = lo + (hi - lo) / 2;
+        arena = &allocator->arenas[i];
+        if ((const char *)node < arena->base) {
+            hi = i;
+        }
+        else if ((const char *)node >= arena->base + arena->size) {
+            lo = i + 1;
+        }
+        else {
+            return i;
+        }
+    }
+
+    return allocator->narenas;
+}
+
+#define IS_ARENA_NODE(allocator, node) \
+    ((allocator)->narenas && arena_find(allocator, node) < (allocator)->narenas)
+
+/* Map a new arena and make it the one being carved, with the allocator
+ * locked.
+ */
+static apr_status_t arena_create(apr_allocator_t *allocator)
+{
+    allocator_arena_t *arenas;
+    apr_size_t size = allocator->arena_size;
+    apr_size_t map_size = size;
+    apr_size_t i;
+    char *base;
+
+    if (allocator->narenas == allocator->arenas_alloc) {
+        i = allocator->arenas_alloc ? allocator->arenas_alloc * 2 : 8;
+        arenas = realloc(allocator->arenas, i * sizeof(allocator_arena_t));
+        if (arenas == NULL) {
+            return APR_ENOMEM;
+        }
+        allocator->arenas = arenas;
+        allocator->arenas_alloc = i;
+    }
+
+    if (allocator->arena_flags & APR_ALLOCATOR_HUGE_PAGES) {
+        map_size += ARENA_ALIGN;
+    }
+    base = mmap(NULL, map_size, PROT_READ|PROT_WRITE,
+                MAP_PRIVATE|MAP_ANON, -1, 0);
+    if (base == MAP_FAILED) {
+        return errno;
+    }
+    if (allocator->arena_flags & APR_ALLOCATOR_HUGE_PAGES) {
+        /* Trim the mapping down to the huge page aligned part */
+        char *aligned = (char *)APR_ALIGN((apr_uintptr_t)base, ARENA_ALIGN);
+
+        if (aligned != base) {
+            munmap(base, aligned - base);
+        }
+        if (aligned + size != base + map_size) {
+            munmap(aligned + size, base + map_size - (aligned + size));
+        }
+        base = aligned;
+#ifdef MADV_HUGEPAGE
+        /* Best effort, transparent huge pages may be disabled */
+        madvise(base, size, MADV_HUGEPAGE);
+#endif
+    }
+#if ALLOCATOR_NUMA
+    if (allocator->arena_flags & APR_ALLOCATOR_NUMA_BIND) {
+        unsigned long nodemask[ARENA_NUMA_NODES / (8 * sizeof(unsigned long))];
+        const int bits = 8 * sizeof(unsigned long);
+
+        memset(nodemask, 0, sizeof(nodemask));
+        nodemask[allocator->numa_node / bits] |=
+            1UL << (allocator->numa_node % bits);
+        if (syscall(SYS_mbind, base, size, ALLOCATOR_MPOL_BIND, nodemask,
+                    (unsigned long)ARENA_NUMA_NODES + 1, 0) != 0) {
+            apr_status_t rv = errno;
+            munmap(base, size);
+            return rv;
+        }
+    }
+#endif /* ALLOCATOR_NUMA */
+
+    for (i = allocator->narenas; i > 0; i--) {
+        if (allocator->arenas[i - 1].base < base) {
+            break;
+        }
+        allocator->arenas[i] = allocator->arenas[i - 1];
+    }
+    allocator->arenas[i].base = base;
+    allocator->arenas[i].size = size;
+    allocator->arenas[i].used = 0;
+    allocator->arenas[i].nodes = 0;
+    allocator->narenas++;
+
+    allocator->arena_avail = base;
+    allocator->arena_end = base + size;
+
+    return APR_SUCCESS;
+}
+
+/* Carve a node out of the arenas (or reuse a spare one), with the
+ * allocator locked.
+ */
+static apr_memnode_t *arena_alloc(apr_allocator_t *allocator,
+                                  apr_size_t index, apr_size_t size)
+{
+    apr_memnode_t *node, **ref;
+    allocator_arena_t *arena;
+
+    for (ref = &allocator->arena_spare; (node = *ref) != NULL;
+         ref = &node->next) {
+        if (node->index == index) {
+            *ref = node->next;
+            return node;
+        }
+    }
+
+    if ((apr_size_t)(allocator->arena_end - allocator->arena_avail) < size
+        && arena_create(allocator) != APR_SUCCESS) {
+        return NULL;
+    }
+    node = (apr_memnode_t *)allocator->arena_avail;
+    allocator->arena_avail += size;
+
+    arena = &allocator->arenas[arena_find(allocator, node)];
+    arena->used += size;
+    arena->nodes++;
+
+    node->index = (apr_uint32_t)index;
+    node->endp = (char *)node + size;
+
+    return node;
+}
+#endif /* ALLOCATOR_ARENAS */
+
 APR_DECLARE(apr_status_t) apr_allocator_create(apr_allocator_t **allocator)
 {
     apr_allocator_t *new_allocator;
@@ -195,15 +680,84 @@ APR_DECLARE(apr_status_t) apr_allocator_create(apr_allocator_t **allocator)
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_allocator_create_ex(apr_allocator_t **allocator,
+                                            const apr_allocator_attr_t *attr)
+{
+    apr_status_t rv;
+
+    if ((rv = apr_allocator_create(allocator)) != APR_SUCCESS)
+        return rv;
+    if (!attr || !attr->flags)
+        return APR_SUCCESS;
+
+#if ALLOCATOR_ARENAS
+    if (attr->flags & APR_ALLOCATOR_NUMA_BIND) {
+#if ALLOCATOR_NUMA
+        if (attr->numa_node < 0 || attr->numa_node >= ARENA_NUMA_NODES)
+            rv = APR_EINVAL;
+#else
+        rv = APR_ENOTIMPL;
+#endif
+    }
+    if (rv == APR_SUCCESS) {
+        apr_allocator_t *new_allocator = *allocator;
+        apr_size_t size = attr->arena_size ? attr->arena_size : ARENA_ALIGN;
+
+        /* Room for the biggest nodes carved from the arenas at least */
+        if (size < ((apr_size_t)MAX_INDEX << BOUNDARY_INDEX))
+            size = (apr_size_t)MAX_INDEX << BOUNDARY_INDEX;
+        if (attr->flags & APR_ALLOCATOR_HUGE_PAGES)
+            size = APR_ALIGN(size, ARENA_ALIGN);
+        else
+            size = APR_ALIGN(size, BOUNDARY_SIZE);
+
+        new_allocator->arena_flags = attr->flags;
+        new_allocator->numa_node = attr->numa_node;
+        new_allocator->arena_size = size;
+
+        /* Map the first arena now, to report the errors early */
+        rv = arena_create(new_allocator);
+    }
+#else
+    rv = APR_ENOTIMPL;
+#endif /* ALLOCATOR_ARENAS */
+
+    if (rv != APR_SUCCESS) {
+        apr_allocator_destroy(*allocator);
+        *allocator = NULL;
+    }
+
+    return rv;
+}
+
 APR_DECLARE(void) apr_allocator_destroy(apr_allocator_t *allocator)
 {
     apr_size_t index;
     apr_memnode_t *node, **ref;
 
+#if APR_HAS_THREADS
+    if (allocator->magazines) {
+        /* Hand the magazines' nodes to the sink, freed below */
+        if ((node = magazine_drain(allocator)) != NULL) {
+            ref = &node->next;
+            while (*ref) {
+                ref = &(*ref)->next;
+            }
+            *ref = allocator->free[0];
+            allocator->free[0] = node;
+        }
+        free(allocator->magazines);
+    }
+#endif /* APR_HAS_THREADS */
+
     for (index = 0; index < MAX_INDEX; index++) {
         ref = &allocator->free[index];
         while ((node = *ref) != NULL) {
             *ref = node->next;
+#if ALLOCATOR_ARENAS
+            if (IS_ARENA_NODE(allocator, node))
+                continue;
+#endif
 #if APR_ALLOCATOR_USES_MMAP
             munmap((char *)node - GUARDPAGE_SIZE,
                    2 * GUARDPAGE_SIZE + ((node->index+1) << BOUNDARY_INDEX));
@@ -213,6 +767,13 @@ APR_DECLARE(void) apr_allocator_destroy(apr_allocator_t *allocator)
         }
     }
 
+#if ALLOCATOR_ARENAS
+    for (index = 0; index < allocator->narenas; index++) {
+        munmap(allocator->arenas[index].base, allocator->arenas[index].size);
+    }
+    free(allocator->arenas);
+#endif /* ALLOCATOR_ARENAS */
+
     free(allocator);
 }
 
@@ -257,6 +818,16 @@ APR_DECLARE(void) apr_allocator_max_free_set(apr_allocator_t *allocator,
         allocator->current_free_index = max_free_index;
 
     allocator_unlock(allocator);
+
+#if APR_HAS_THREADS
+    /* Rebalance the magazines against the new threshold */
+    if (allocator->magazines) {
+        apr_memnode_t *node = magazine_drain(allocator);
+        if (node) {
+            allocator_free_shared(allocator, node);
+        }
+    }
+#endif /* APR_HAS_THREADS */
 }
 
 static APR_INLINE
@@ -309,6 +880,14 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
         return NULL;
     }
 
+#if APR_HAS_THREADS
+    /* Try the calling thread's magazine first, without locking */
+    if (allocator->magazines && index <= MAGAZINE_MAX_INDEX
+        && (node = magazine_alloc(allocator, index)) != NULL) {
+        goto have_node;
+    }
+#endif /* APR_HAS_THREADS */
+
     /* First see if there are any nodes in the area we know
      * our node will fit into.
      */
@@ -389,6 +968,20 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
         allocator_unlock(allocator);
     }
 
+#if ALLOCATOR_ARENAS
+    /* Carve the node out of an arena if enabled, otherwise (or if that
+     * fails) fall through to a standalone node.
+     */
+    if (allocator->arena_flags && index < MAX_INDEX) {
+        allocator_lock(allocator);
+        node = arena_alloc(allocator, index, size);
+        allocator_unlock(allocator);
+        if (node) {
+            goto have_node;
+        }
+    }
+#endif /* ALLOCATOR_ARENAS */
+
     /* If we haven't got a suitable node, malloc a new one
      * and initialize it.
      */
@@ -413,6 +1006,10 @@ apr_memnode_t *allocator_alloc(apr_allocator_t *allocator, apr_size_t in_size)
     node->index = (apr_uint32_t)index;
     node->endp = (char *)node + size;
 
+    allocator_lock(allocator);
+    allocator->sys_nodes++;
+    allocator_unlock(allocator);
+
 have_node:
     node->next = NULL;
     node->first_avail = (char *)node + APR_MEMNODE_T_SIZE;
@@ -422,18 +1019,27 @@ have_node:
     return node;
 }
 
-static APR_INLINE
-void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
+static void allocator_free_shared(apr_allocator_t *allocator,
+                                  apr_memnode_t *node)
 {
     apr_memnode_t *next, *freelist = NULL;
+#if ALLOCATOR_ARENAS
+    apr_memnode_t *arena_freelist = NULL;
+#endif
     apr_size_t index, max_index;
     apr_size_t max_free_index, current_free_index;
+    apr_size_t magazine_free_index = 0;
 
     allocator_lock(allocator);
 
     max_index = allocator->max_index;
     max_free_index = allocator->max_free_index;
     current_free_index = allocator->current_free_index;
+#if APR_HAS_THREADS
+    if (allocator->magazines) {
+        magazine_free_index = apr_atomic_read32(&allocator->magazine_free_index);
+    }
+#endif /* APR_HAS_THREADS */
 
     /* Walk the list of submitted nodes and free them one by one,
      * shoving them in the right 'size' buckets as we go.
@@ -446,9 +1052,20 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
                               (node->index+1) << BOUNDARY_INDEX);
 
         if (max_free_index != APR_ALLOCATOR_MAX_FREE_UNLIMITED
-            && index + 1 > current_free_index) {
-            node->next = freelist;
-            freelist = node;
+            && index + 1 + magazine_free_index > current_free_index) {
+#if ALLOCATOR_ARENAS
+            if (IS_ARENA_NODE(allocator, node)) {
+                node->next = arena_freelist;
+                arena_freelist = node;
+            }
+            else
+#endif
+            {
+                node->next = freelist;
+                freelist = node;
+                allocator->sys_nodes--;
+            }
+            allocator->evicted_nodes++;
         }
         else if (index < MAX_INDEX) {
             /* Add the node to the appropriate 'size' bucket.  Adjust
@@ -492,6 +1109,43 @@ void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
         free(node);
 #endif
     }
+
+#if ALLOCATOR_ARENAS
+    if (arena_freelist != NULL) {
+        apr_memnode_t **ref = &arena_freelist;
+
+        /* Release the pages of the nodes but their headers, before they
+         * can be reused from the spares.
+         */
+        while ((node = *ref) != NULL) {
+#ifdef MADV_DONTNEED
+            madvise((char *)node + BOUNDARY_SIZE,
+                    ((node->index + 1) << BOUNDARY_INDEX) - BOUNDARY_SIZE,
+                    MADV_DONTNEED);
+#endif
+            ref = &node->next;
+        }
+
+        allocator_lock(allocator);
+        *ref = allocator->arena_spare;
+        allocator->arena_spare = arena_freelist;
+        allocator_unlock(allocator);
+    }
+#endif /* ALLOCATOR_ARENAS */
+}
+
+static APR_INLINE
+void allocator_free(apr_allocator_t *allocator, apr_memnode_t *node)
+{
+#if APR_HAS_THREADS
+    /* Stash what fits in the calling thread's magazine */
+    if (allocator->magazines
+        && (node = magazine_free(allocator, node)) == NULL) {
+        return;
+    }
+#endif /* APR_HAS_THREADS */
+
+    allocator_free_shared(allocator, node);
 }
 
 APR_DECLARE(apr_memnode_t *) apr_allocator_alloc(apr_allocator_t *allocator,
@@ -500,12 +1154,127 @@ APR_DECLARE(apr_memnode_t *) apr_allocator_alloc(apr_allocator_t *allocator,
     return allocator_alloc(allocator, size);
 }
 
+APR_DECLARE(void) apr_allocator_stats_get(apr_allocator_t *allocator,
+                                          apr_allocator_stats_t *stats)
+{
+    apr_memnode_t *node;
+    apr_size_t index;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->boundary_size = BOUNDARY_SIZE;
+
+    allocator_lock(allocator);
+
+    for (index = 0; index < MAX_INDEX; index++) {
+        for (node = allocator->free[index]; node; node = node->next) {
+            stats->free_nodes[index]++;
+            stats->free_bytes += (apr_size_t)(node->index + 1) << BOUNDARY_INDEX;
+        }
+    }
+#if APR_ALLOCATOR_USES_MMAP
+    stats->mmap_nodes = allocator->sys_nodes;
+#else
+    stats->malloc_nodes = allocator->sys_nodes;
+#endif
+    stats->evicted_nodes = allocator->evicted_nodes;
+#if ALLOCATOR_ARENAS
+    stats->arenas = allocator->narenas;
+    for (index = 0; index < allocator->narenas; index++) {
+        stats->arena_nodes += allocator->arenas[index].nodes;
+    }
+#endif /* ALLOCATOR_ARENAS */
+
+    allocator_unlock(allocator);
+
+#if APR_HAS_THREADS
+    /* The magazines are only read, so the counts may be slightly off
+     * while other threads use them.
+     */
+    if (allocator->magazines) {
+        apr_size_t slot;
+        for (slot = 0; slot < MAGAZINE_SLOTS; slot++) {
+            allocator_magazine_t *magazine = (allocator_magazine_t *)
+                (allocator->magazines + slot * SIZEOF_MAGAZINE_T);
+            for (index = 1; index <= MAGAZINE_MAX_INDEX; index++) {
+                stats->magazine_nodes += magazine->count[index];
+            }
+        }
+    }
+#endif /* APR_HAS_THREADS */
+}
+
 APR_DECLARE(void) apr_allocator_free(apr_allocator_t *allocator,
                                      apr_memnode_t *node)
 {
     allocator_free(allocator, node);
 }
 
+APR_DECLARE(apr_status_t) apr_allocator_arena_stats_get(
+                                          apr_allocator_t *allocator,
+                                          apr_allocator_arena_stats_t *stats,
+                                          apr_size_t *nelts)
+{
+    apr_status_t rv = APR_SUCCESS;
+#if ALLOCATOR_ARENAS
+    apr_size_t i;
+
+    allocator_lock(allocator);
+
+    if (*nelts > allocator->narenas) {
+        *nelts = allocator->narenas;
+    }
+    else if (*nelts < allocator->narenas) {
+        rv = APR_INCOMPLETE;
+    }
+    for (i = 0; i < *nelts; i++) {
+        stats[i].base = allocator->arenas[i].base;
+        stats[i].size = allocator->arenas[i].size;
+        stats[i].used = allocator->arenas[i].used;
+        stats[i].nodes = allocator->arenas[i].nodes;
+    }
+
+    allocator_unlock(allocator);
+#else
+    *nelts = 0;
+#endif /* ALLOCATOR_ARENAS */
+
+    return rv;
+}
+
+#if APR_HAS_THREADS
+APR_DECLARE(apr_status_t) apr_allocator_magazine_set(apr_allocator_t *allocator,
+                                                     apr_size_t depth)
+{
+    apr_memnode_t *node;
+
+    if (depth == 0) {
+        if (allocator->magazines) {
+            if ((node = magazine_drain(allocator)) != NULL) {
+                allocator_free_shared(allocator, node);
+            }
+            free(allocator->magazines);
+            allocator->magazines = NULL;
+        }
+        allocator->magazine_depth = 0;
+        return APR_SUCCESS;
+    }
+
+    if (depth > MAGAZINE_MAX_DEPTH) {
+        depth = MAGAZINE_MAX_DEPTH;
+    }
+
+    if (!allocator->magazines) {
+        if ((allocator->magazines = calloc(MAGAZINE_SLOTS,
+                                           SIZEOF_MAGAZINE_T)) == NULL) {
+            return APR_ENOMEM;
+        }
+    }
+    allocator->magazine_depth = (apr_uint32_t)depth;
+
+    return APR_SUCCESS;
+}
+#endif /* APR_HAS_THREADS */
+
 
 
 /*
@@ -576,6 +1345,12 @@ struct apr_pool_t {
     apr_memnode_t        *active;
     apr_memnode_t        *self; /* The node containing the pool itself */
     char                 *self_first_avail;
+    /* Statistics, see apr_pool_stats_get() */
+    apr_size_t            stat_bytes;   /* allocated since created/cleared */
+    apr_size_t            stat_held;    /* size of the nodes held */
+    apr_size_t            stat_peak;    /* high-water mark of stat_held */
+    apr_size_t            stat_nodes;   /* nodes taken from the allocator */
+    apr_size_t            stat_clear;
 
 #else /* APR_POOL_DEBUG */
     apr_pool_t           *joined; /* the caller has guaranteed that this pool
@@ -803,6 +1578,35 @@ static APR_INLINE void pool_concurrency_set_idle(apr_pool_t *pool)      { }
 static APR_INLINE void pool_concurrency_set_destroyed(apr_pool_t *pool) { }
 #endif /* APR_POOL_CONCURRENCY_CHECK */
 
+/*
+ * Statistics
+ */
+
+static APR_INLINE void pool_stat_node_add(apr_pool_t *pool,
+                                          apr_memnode_t *node)
+{
+    pool->stat_nodes++;
+    pool->stat_held += node->endp - (char *)node;
+    if (pool->stat_peak < pool->stat_held)
+        pool->stat_peak = pool->stat_held;
+}
+
+static APR_INLINE void pool_stat_node_remove(apr_pool_t *pool,
+                                             apr_memnode_t *node)
+{
+    pool->stat_held -= node->endp - (char *)node;
+}
+
+static void pool_stat_init(apr_pool_t *pool)
+{
+    pool->stat_bytes = 0;
+    pool->stat_held = 0;
+    pool->stat_peak = 0;
+    pool->stat_nodes = 0;
+    pool->stat_clear = 0;
+    pool_stat_node_add(pool, pool->self);
+}
+
 /*
  * Memory allocation
  */
@@ -847,6 +1651,7 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
 
             return NULL;
         }
+        pool_stat_node_add(pool, node);
     }
 
     node->free_index = 0;
@@ -875,6 +1680,7 @@ APR_DECLARE(void *) apr_palloc(apr_pool_t *pool, apr_size_t in_size)
     list_insert(active, node);
 
 have_mem:
+    pool->stat_bytes += size;
 #if HAVE_VALGRIND
     if (!apr_running_on_valgrind) {
         pool_concurrency_set_idle(pool);
@@ -954,6 +1760,10 @@ APR_DECLARE(void) apr_pool_clear(apr_pool_t *pool)
     active = pool->active = pool->self;
     active->first_avail = pool->self_first_avail;
 
+    pool->stat_bytes = 0;
+    pool->stat_held = active->endp - (char *)active;
+    pool->stat_clear++;
+
     APR_IF_VALGRIND(VALGRIND_MEMPOOL_TRIM(pool, pool, 1));
 
     if (active->next == active) {
@@ -1098,6 +1908,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_ex(apr_pool_t **newpool,
     pool->subprocesses = NULL;
     pool->user_data = NULL;
     pool->tag = NULL;
+    pool_stat_init(pool);
 
 #ifdef NETWARE
     pool->owner_proc = (apr_os_proc_t)getnlmhandle();
@@ -1184,6 +1995,7 @@ APR_DECLARE(apr_status_t) apr_pool_create_unmanaged_ex(apr_pool_t **newpool,
     pool->parent = NULL;
     pool->sibling = NULL;
     pool->ref = NULL;
+    pool_stat_init(pool);
 
 #ifdef NETWARE
     pool->owner_proc = (apr_os_proc_t)getnlmhandle();
@@ -1278,10 +2090,12 @@ static int psprintf_flush(apr_vformatter_buff_t *vbuff)
     else {
         if ((node = allocator_alloc(pool->allocator, size)) == NULL)
             return -1;
+        pool_stat_node_add(pool, node);
 
         if (ps->got_a_new_node) {
             active->next = ps->free;
             ps->free = active;
+            pool_stat_node_remove(pool, active);
         }
 
         ps->got_a_new_node = 1;
@@ -1393,6 +2207,7 @@ APR_DECLARE(char *) apr_pvsprintf(apr_pool_t *pool, const char *fmt, va_list ap)
     size = ps.vbuff.curpos - ps.node->first_avail;
     size = APR_ALIGN_DEFAULT(size);
     ps.node->first_avail += size;
+    pool->stat_bytes += size;
 
     if (ps.free)
         allocator_free(pool->allocator, ps.free);
@@ -1441,6 +2256,7 @@ error:
     if (pool->abort_fn)
         pool->abort_fn(APR_ENOMEM);
     if (ps.got_a_new_node) {
+        pool_stat_node_remove(pool, ps.node);
         ps.node->next = ps.free;
         allocator_free(pool->allocator, ps.node);
     }
@@ -1449,6 +2265,17 @@ error:
     return NULL;
 }
 
+APR_DECLARE(void) apr_pool_stats_get(apr_pool_t *pool, apr_pool_stats_t *stats)
+{
+    stats->tag = pool->tag;
+    stats->pools = 1;
+    stats->bytes_allocated = pool->stat_bytes;
+    stats->bytes_held = pool->stat_held;
+    stats->peak_size = pool->stat_peak;
+    stats->nodes_acquired = pool->stat_nodes;
+    stats->clears = pool->stat_clear;
+}
+
 
 #else /* APR_POOL_DEBUG */
 /*
@@ -2322,6 +3149,18 @@ APR_DECLARE(void) apr_pool_lock(apr_pool_t *pool, int flag)
 {
 }
 
+APR_DECLARE(void) apr_pool_stats_get(apr_pool_t *pool, apr_pool_stats_t *stats)
+{
+    /* Debug pools have no nodes, each allocation is malloc()ed */
+    stats->tag = pool->tag;
+    stats->pools = 1;
+    stats->bytes_allocated = apr_pool_num_bytes(pool, 0);
+    stats->bytes_held = stats->bytes_allocated;
+    stats->peak_size = stats->bytes_allocated;
+    stats->nodes_acquired = pool->stat_total_alloc;
+    stats->clears = pool->stat_clear;
+}
+
 #endif /* !APR_POOL_DEBUG */
 
 #ifdef NETWARE
@@ -2422,6 +3261,106 @@ APR_DECLARE(void) apr_pool_tag(apr_pool_t *pool, const char *tag)
     pool->tag = tag;
 }
 
+typedef struct pool_stats_walk_t {
+    apr_pool_stats_t *stats;
+    apr_size_t nelts;
+    apr_size_t nalloc;
+    int incomplete;
+} pool_stats_walk_t;
+
+static int pool_stats_walk_add(apr_pool_t *pool, void *data)
+{
+    pool_stats_walk_t *walk = data;
+    apr_pool_stats_t *stats;
+    apr_pool_stats_t pool_stats;
+    apr_size_t i;
+
+    apr_pool_stats_get(pool, &pool_stats);
+
+    for (i = 0; i < walk->nelts; i++) {
+        stats = &walk->stats[i];
+        if (stats->tag == pool_stats.tag
+            || (stats->tag && pool_stats.tag
+                && !strcmp(stats->tag, pool_stats.tag))) {
+            stats->pools++;
+            stats->bytes_allocated += pool_stats.bytes_allocated;
+            stats->bytes_held += pool_stats.bytes_held;
+            stats->peak_size += pool_stats.peak_size;
+            stats->nodes_acquired += pool_stats.nodes_acquired;
+            stats->clears += pool_stats.clears;
+            return 0;
+        }
+    }
+    if (walk->nelts < walk->nalloc) {
+        walk->stats[walk->nelts++] = pool_stats;
+    }
+    else {
+        walk->incomplete = 1;
+    }
+
+    return 0;
+}
+
+#if !APR_POOL_DEBUG
+/* The allocators whose lock is held by the walk, so that the children
+ * of pools sharing an allocator don't lock it again.
+ */
+typedef struct pool_stats_held_t {
+    apr_allocator_t *allocator;
+    const struct pool_stats_held_t *next;
+} pool_stats_held_t;
+
+static void pool_stats_walk_tree(apr_pool_t *pool, pool_stats_walk_t *walk,
+                                 const pool_stats_held_t *held)
+{
+    pool_stats_held_t me;
+    const pool_stats_held_t *h;
+    apr_pool_t *child;
+
+    pool_stats_walk_add(pool, walk);
+
+    /* The list of children is protected by the pool's allocator lock,
+     * see apr_pool_create_ex() and apr_pool_destroy().
+     */
+    for (h = held; h && h->allocator != pool->allocator; h = h->next)
+        ;
+    if (!h) {
+        allocator_lock(pool->allocator);
+    }
+    me.allocator = pool->allocator;
+    me.next = held;
+
+    for (child = pool->child; child; child = child->sibling) {
+        pool_stats_walk_tree(child, walk, &me);
+    }
+
+    if (!h) {
+        allocator_unlock(pool->allocator);
+    }
+}
+#endif /* !APR_POOL_DEBUG */
+
+APR_DECLARE(apr_status_t) apr_pool_stats_walk(apr_pool_t *pool,
+                                              apr_pool_stats_t *stats,
+                                              apr_size_t *nelts)
+{
+    pool_stats_walk_t walk;
+
+    walk.stats = stats;
+    walk.nelts = 0;
+    walk.nalloc = *nelts;
+    walk.incomplete = 0;
+
+#if !APR_POOL_DEBUG
+    pool_stats_walk_tree(pool, &walk, NULL);
+#else
+    apr_pool_walk_tree(pool, pool_stats_walk_add, &walk);
+#endif /* !APR_POOL_DEBUG */
+
+    *nelts = walk.nelts;
+    return walk.incomplete ? APR_INCOMPLETE : APR_SUCCESS;
+}
+
 
 /*
  * User data management
@@ -28,6 +28,13 @@
 #include "apr_mmap.h"
 #include "apr_errno.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#if APR_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #if APR_HAS_MMAP || defined(BEOS)
 
 APR_DECLARE(apr_status_t) apr_mmap_offset(void **addr, apr_mmap_t *mmap,
@@ -40,4 +47,63 @@ APR_DECLARE(apr_status_t) apr_mmap_offset(void **addr, apr_mmap_t *mmap,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_mmap_advise(apr_mmap_t *mmap, apr_off_t offset,
+                                          apr_size_t len, int advice)
+{
+#ifdef MADV_WILLNEED
+    int native_advice;
+    apr_size_t misalign;
+    char *start;
+#endif
+
+    if (offset < 0 || (apr_size_t)offset > mmap->size
+        || len > mmap->size - (apr_size_t)offset)
+        return APR_EINVAL;
+    if (len == 0)
+        len = mmap->size - (apr_size_t)offset;
+
+    switch (advice) {
+#ifdef MADV_WILLNEED
+    case APR_FADVISE_NORMAL:
+        native_advice = MADV_NORMAL;
+        break;
+    case APR_FADVISE_SEQUENTIAL:
+        native_advice = MADV_SEQUENTIAL;
+        break;
+    case APR_FADVISE_RANDOM:
+        native_advice = MADV_RANDOM;
+        break;
+    case APR_FADVISE_WILLNEED:
+        native_advice = MADV_WILLNEED;
+        break;
+    case APR_FADVISE_DONTNEED:
+        native_advice = MADV_DONTNEED;
+        break;
+    case APR_FADVISE_NOREUSE:
+        /* madvise() has no equivalent */
+        return APR_SUCCESS;
+    default:
+        return APR_EINVAL;
+    }
+
+    /* madvise() wants a page aligned start */
+    start = (char *)mmap->mm + offset;
+    misalign = (apr_size_t)start % (apr_size_t)sysconf(_SC_PAGESIZE);
+    if (madvise(start - misalign, len + misalign, native_advice) == -1)
+        return errno;
+    return APR_SUCCESS;
+#else
+    case APR_FADVISE_NORMAL:
+    case APR_FADVISE_SEQUENTIAL:
+    case APR_FADVISE_RANDOM:
+    case APR_FADVISE_WILLNEED:
+    case APR_FADVISE_DONTNEED:
+    case APR_FADVISE_NOREUSE:
+        return APR_SUCCESS;
+    default:
+        return APR_EINVAL;
+    }
+#endif
+}
+
 #endif
@@ -153,3 +153,49 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
     *len = rv;
     return APR_SUCCESS;
 }
+
+APR_DECLARE(apr_status_t) apr_socket_recvv(apr_socket_t *sock,
+                                           const struct iovec *vec,
+                                           apr_int32_t nvec,
+                                           apr_int32_t flags,
+                                           apr_size_t *len)
+{
+    apr_interval_time_t timeout;
+    apr_status_t rv;
+
+    if (flags & APR_RECV_NONBLOCK) {
+        apr_socket_timeout_get(sock, &timeout);
+        apr_socket_timeout_set(sock, 0);
+    }
+    if (nvec < 1) {
+        *len = 0;
+        rv = APR_SUCCESS;
+    }
+    else {
+        *len = vec[0].iov_len;
+        rv = apr_socket_recv(sock, vec[0].iov_base, len);
+    }
+    if (flags & APR_RECV_NONBLOCK) {
+        apr_socket_timeout_set(sock, timeout);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_send_zc(apr_socket_t *sock,
+                                             const char *buf,
+                                             apr_size_t *len,
+                                             apr_uint32_t *id)
+{
+    *len = 0;
+    return APR_ENOTIMPL;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_zc_reap(apr_socket_t *sock,
+                                             apr_uint32_t *first,
+                                             apr_uint32_t *last,
+                                             int *copied)
+{
+    return APR_ENOTIMPL;
+}
+
@@ -102,3 +102,56 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
 
     return APR_SUCCESS;
 }
+
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_size_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_size_t *nsent)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t i;
+
+    for (i = 0; i < nmsgs; i++) {
+        if (msgs[i].segment_size) {
+            rv = APR_ENOTIMPL;
+        }
+        else if (msgs[i].addr) {
+            rv = apr_socket_sendto(sock, msgs[i].addr, flags, msgs[i].buf,
+                                   &msgs[i].len);
+        }
+        else {
+            rv = apr_socket_send(sock, msgs[i].buf, &msgs[i].len);
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    *nsent = i;
+    return i ? APR_SUCCESS : rv;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_size_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_size_t *nrecv)
+{
+    apr_sockaddr_t sa;
+    apr_status_t rv;
+
+    /* A single one, since waiting for the next one is not wanted */
+    *nrecv = 0;
+    if (!nmsgs) {
+        return APR_SUCCESS;
+    }
+    msgs[0].segment_size = 0;
+    rv = apr_socket_recvfrom(msgs[0].addr ? msgs[0].addr : &sa, sock, flags,
+                             msgs[0].buf, &msgs[0].len);
+    if (rv == APR_SUCCESS) {
+        *nrecv = 1;
+    }
+    return rv;
+}
+
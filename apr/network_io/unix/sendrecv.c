@@ -191,6 +191,227 @@ apr_status_t apr_socket_recvfrom(apr_sockaddr_t *from, apr_socket_t *sock,
     return APR_SUCCESS;
 }
 
+/* sendmmsg() and recvmmsg() came along with MSG_WAITFORONE (Linux, BSDs) */
+#ifdef MSG_WAITFORONE
+#define HAVE_SENDMMSG 1
+
+/* Datagrams per system call, the caller loops for more */
+#define MMSG_BATCH 64
+
+#if defined(UDP_SEGMENT) || defined(UDP_GRO)
+typedef union {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+} mmsg_cmsg_t;
+#endif
+
+static void mmsg_prepare(struct mmsghdr *hdrs, struct iovec *iovs,
+                         apr_socket_msg_t *msgs, unsigned int n, int recv)
+{
+    unsigned int i;
+
+    memset(hdrs, 0, n * sizeof(*hdrs));
+    for (i = 0; i < n; i++) {
+        struct msghdr *mh = &hdrs[i].msg_hdr;
+
+        iovs[i].iov_base = msgs[i].buf;
+        iovs[i].iov_len = msgs[i].len;
+        mh->msg_iov = &iovs[i];
+        mh->msg_iovlen = 1;
+        if (msgs[i].addr) {
+            mh->msg_name = &msgs[i].addr->sa;
+            mh->msg_namelen = recv ? sizeof(msgs[i].addr->sa)
+                                   : msgs[i].addr->salen;
+        }
+    }
+}
+#endif
+
+apr_status_t apr_socket_sendmmsg(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                 apr_size_t nmsgs, apr_int32_t flags,
+                                 apr_size_t *nsent)
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr hdrs[MMSG_BATCH];
+    struct iovec iovs[MMSG_BATCH];
+#ifdef UDP_SEGMENT
+    mmsg_cmsg_t cmsgs[MMSG_BATCH];
+#endif
+    unsigned int i, n = (nmsgs > MMSG_BATCH) ? MMSG_BATCH : nmsgs;
+    int rv;
+
+    *nsent = 0;
+    if (!n) {
+        return APR_SUCCESS;
+    }
+
+    mmsg_prepare(hdrs, iovs, msgs, n, 0);
+    for (i = 0; i < n; i++) {
+        if (msgs[i].segment_size) {
+#ifdef UDP_SEGMENT
+            struct msghdr *mh = &hdrs[i].msg_hdr;
+            struct cmsghdr *cm;
+            apr_uint16_t size = msgs[i].segment_size;
+
+            mh->msg_control = cmsgs[i].buf;
+            mh->msg_controllen = CMSG_SPACE(sizeof(size));
+            cm = CMSG_FIRSTHDR(mh);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(size));
+            memcpy(CMSG_DATA(cm), &size, sizeof(size));
+#else
+            return APR_ENOTIMPL;
+#endif
+        }
+    }
+
+    do {
+        rv = sendmmsg(sock->socketdes, hdrs, n, flags);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && (sock->timeout > 0)) {
+        apr_status_t arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        if (arv != APR_SUCCESS) {
+            return arv;
+        }
+        do {
+            rv = sendmmsg(sock->socketdes, hdrs, n, flags);
+        } while (rv == -1 && errno == EINTR);
+    }
+    if (rv == -1) {
+        return errno;
+    }
+
+    for (i = 0; i < (unsigned int)rv; i++) {
+        msgs[i].len = hdrs[i].msg_len;
+    }
+    *nsent = rv;
+    return APR_SUCCESS;
+#else
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t i;
+
+    *nsent = 0;
+    for (i = 0; i < nmsgs; i++) {
+        if (msgs[i].segment_size) {
+            rv = APR_ENOTIMPL;
+        }
+        else if (msgs[i].addr) {
+            rv = apr_socket_sendto(sock, msgs[i].addr, flags, msgs[i].buf,
+                                   &msgs[i].len);
+        }
+        else {
+            rv = apr_socket_send(sock, msgs[i].buf, &msgs[i].len);
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    *nsent = i;
+    return i ? APR_SUCCESS : rv;
+#endif
+}
+
+apr_status_t apr_socket_recvmmsg(apr_socket_t *sock, apr_socket_msg_t *msgs,
+                                 apr_size_t nmsgs, apr_int32_t flags,
+                                 apr_size_t *nrecv)
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr hdrs[MMSG_BATCH];
+    struct iovec iovs[MMSG_BATCH];
+#ifdef UDP_GRO
+    mmsg_cmsg_t cmsgs[MMSG_BATCH];
+    int gro = apr_is_option_set(sock, APR_UDP_GRO);
+#endif
+    unsigned int i, n = (nmsgs > MMSG_BATCH) ? MMSG_BATCH : nmsgs;
+    int rv;
+
+    *nrecv = 0;
+    if (!n) {
+        return APR_SUCCESS;
+    }
+
+    mmsg_prepare(hdrs, iovs, msgs, n, 1);
+#ifdef UDP_GRO
+    if (gro) {
+        for (i = 0; i < n; i++) {
+            hdrs[i].msg_hdr.msg_control = cmsgs[i].buf;
+            hdrs[i].msg_hdr.msg_controllen = sizeof(cmsgs[i].buf);
+        }
+    }
+#endif
+
+    do {
+        rv = recvmmsg(sock->socketdes, hdrs, n, flags | MSG_WAITFORONE, NULL);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && (sock->timeout > 0)) {
+        apr_status_t arv = apr_wait_for_io_or_timeout(NULL, sock, 1);
+        if (arv != APR_SUCCESS) {
+            return arv;
+        }
+        do {
+            rv = recvmmsg(sock->socketdes, hdrs, n, flags | MSG_WAITFORONE,
+                          NULL);
+        } while (rv == -1 && errno == EINTR);
+    }
+    if (rv == -1) {
+        return errno;
+    }
+
+    for (i = 0; i < (unsigned int)rv; i++) {
+        apr_sockaddr_t *from = msgs[i].addr;
+
+        msgs[i].len = hdrs[i].msg_len;
+        msgs[i].segment_size = 0;
+#ifdef UDP_GRO
+        if (gro) {
+            struct msghdr *mh = &hdrs[i].msg_hdr;
+            struct cmsghdr *cm;
+
+            for (cm = CMSG_FIRSTHDR(mh); cm; cm = CMSG_NXTHDR(mh, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    int size;
+
+                    memcpy(&size, CMSG_DATA(cm), sizeof(size));
+                    msgs[i].segment_size = (apr_uint16_t)size;
+                    break;
+                }
+            }
+        }
+#endif
+        if (from) {
+            from->salen = hdrs[i].msg_hdr.msg_namelen;
+            if (from->salen > APR_OFFSETOF(struct sockaddr_in, sin_port)) {
+                apr_sockaddr_vars_set(from, from->sa.sin.sin_family,
+                                      ntohs(from->sa.sin.sin_port));
+            }
+        }
+    }
+    *nrecv = rv;
+    return APR_SUCCESS;
+#else
+    apr_sockaddr_t sa;
+    apr_status_t rv;
+
+    /* A single one, since waiting for the next one is not wanted */
+    *nrecv = 0;
+    if (!nmsgs) {
+        return APR_SUCCESS;
+    }
+    msgs[0].segment_size = 0;
+    rv = apr_socket_recvfrom(msgs[0].addr ? msgs[0].addr : &sa, sock, flags,
+                             msgs[0].buf, &msgs[0].len);
+    if (rv == APR_SUCCESS) {
+        *nrecv = 1;
+    }
+    return rv;
+#endif
+}
+
 apr_status_t apr_socket_sendv(apr_socket_t * sock, const struct iovec *vec,
                               apr_int32_t nvec, apr_size_t *len)
 {
@@ -242,6 +463,184 @@ do_select:
 #endif
 }
 
+apr_status_t apr_socket_recvv(apr_socket_t *sock, const struct iovec *vec,
+                              apr_int32_t nvec, apr_int32_t flags,
+                              apr_size_t *len)
+{
+#if defined(HAVE_WRITEV) && defined(MSG_DONTWAIT)
+    struct msghdr msg;
+    apr_ssize_t rv;
+    apr_size_t requested_len = 0;
+    apr_int32_t i;
+    int native_flags = 0, wait = (sock->timeout > 0);
+
+    for (i = 0; i < nvec; i++) {
+        requested_len += vec[i].iov_len;
+    }
+
+    if (flags & APR_RECV_NONBLOCK) {
+        /* Per call, rather than switching the socket back and forth */
+        if (sock->timeout < 0) {
+            native_flags = MSG_DONTWAIT;
+        }
+        wait = 0;
+        sock->options &= ~APR_INCOMPLETE_READ;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)vec;
+    msg.msg_iovlen = nvec;
+
+    if (sock->options & APR_INCOMPLETE_READ) {
+        sock->options &= ~APR_INCOMPLETE_READ;
+        goto do_select;
+    }
+
+    do {
+        rv = recvmsg(sock->socketdes, &msg, native_flags);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && wait) {
+        apr_status_t arv;
+do_select:
+        arv = apr_wait_for_io_or_timeout(NULL, sock, 1);
+        if (arv != APR_SUCCESS) {
+            *len = 0;
+            return arv;
+        }
+        else {
+            do {
+                rv = recvmsg(sock->socketdes, &msg, native_flags);
+            } while (rv == -1 && errno == EINTR);
+        }
+    }
+    if (rv == -1) {
+        *len = 0;
+        return errno;
+    }
+    if (wait && (rv < requested_len)) {
+        sock->options |= APR_INCOMPLETE_READ;
+    }
+    (*len) = rv;
+    if (rv == 0) {
+        return APR_EOF;
+    }
+    return APR_SUCCESS;
+#else
+    apr_interval_time_t timeout;
+    apr_status_t rv;
+
+    if (nvec < 1) {
+        *len = 0;
+        return APR_SUCCESS;
+    }
+    if (flags & APR_RECV_NONBLOCK) {
+        apr_socket_timeout_get(sock, &timeout);
+        apr_socket_timeout_set(sock, 0);
+    }
+    *len = vec[0].iov_len;
+    rv = apr_socket_recv(sock, vec[0].iov_base, len);
+    if (flags & APR_RECV_NONBLOCK) {
+        apr_socket_timeout_set(sock, timeout);
+    }
+    return rv;
+#endif
+}
+
+apr_status_t apr_socket_send_zc(apr_socket_t *sock, const char *buf,
+                                apr_size_t *len, apr_uint32_t *id)
+{
+#ifdef HAVE_MSG_ZEROCOPY
+    apr_ssize_t rv;
+
+    if (!apr_is_option_set(sock, APR_SO_ZEROCOPY)) {
+        *len = 0;
+        return APR_EINVAL;
+    }
+
+    do {
+        rv = send(sock->socketdes, buf, *len, MSG_ZEROCOPY);
+    } while (rv == -1 && errno == EINTR);
+
+    while ((rv == -1) && (errno == EAGAIN || errno == EWOULDBLOCK)
+                      && (sock->timeout > 0)) {
+        apr_status_t arv = apr_wait_for_io_or_timeout(NULL, sock, 0);
+        if (arv != APR_SUCCESS) {
+            *len = 0;
+            return arv;
+        }
+        do {
+            rv = send(sock->socketdes, buf, *len, MSG_ZEROCOPY);
+        } while (rv == -1 && errno == EINTR);
+    }
+    if (rv == -1) {
+        *len = 0;
+        return errno;
+    }
+    /* The kernel numbers the successful sends likewise */
+    *id = sock->zc_next++;
+    *len = rv;
+    return APR_SUCCESS;
+#else
+    *len = 0;
+    return APR_ENOTIMPL;
+#endif
+}
+
+apr_status_t apr_socket_zc_reap(apr_socket_t *sock, apr_uint32_t *first,
+                                apr_uint32_t *last, int *copied)
+{
+#ifdef HAVE_MSG_ZEROCOPY
+    union {
+        char buf[CMSG_SPACE(sizeof(struct sock_extended_err)
+                            + sizeof(struct sockaddr_storage))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    int rv;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        do {
+            rv = recvmsg(sock->socketdes, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        } while (rv == -1 && errno == EINTR);
+        if (rv == -1) {
+            return errno;
+        }
+
+        for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err ee;
+
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+#if APR_HAVE_IPV6
+                  || (cm->cmsg_level == SOL_IPV6
+                      && cm->cmsg_type == IPV6_RECVERR)
+#endif
+                  )) {
+                continue;
+            }
+            memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+            if (ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+                *first = ee.ee_info;
+                *last = ee.ee_data;
+                if (copied) {
+                    *copied = (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+                }
+                return APR_SUCCESS;
+            }
+        }
+        /* Not a completion (an ICMP error?), next */
+    }
+#else
+    return APR_ENOTIMPL;
+#endif
+}
+
 #if APR_HAS_SENDFILE
 
 /* TODO: Verify that all platforms handle the fd the same way,
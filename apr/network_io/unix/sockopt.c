@@ -342,6 +342,32 @@ apr_status_t apr_socket_opt_set(apr_socket_t *sock,
          * options, IP_BINDANY vs IPV6_BINDANY */
 #else
         return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_SO_ZEROCOPY:
+#ifdef HAVE_MSG_ZEROCOPY
+        if (on != apr_is_option_set(sock, APR_SO_ZEROCOPY)) {
+            if (setsockopt(sock->socketdes, SOL_SOCKET, SO_ZEROCOPY,
+                           (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_SO_ZEROCOPY, on);
+        }
+#else
+        return APR_ENOTIMPL;
+#endif
+        break;
+    case APR_UDP_GRO:
+#ifdef UDP_GRO
+        if (on != apr_is_option_set(sock, APR_UDP_GRO)) {
+            if (setsockopt(sock->socketdes, SOL_UDP, UDP_GRO,
+                           (void *)&one, sizeof(int)) == -1) {
+                return errno;
+            }
+            apr_set_option(sock, APR_UDP_GRO, on);
+        }
+#else
+        return APR_ENOTIMPL;
 #endif
         break;
     default:
@@ -147,6 +147,91 @@ APR_DECLARE(apr_status_t) apr_socket_sendv(apr_socket_t *sock,
     return rc;
 }
 
+static apr_status_t socket_recvv(apr_socket_t *sock,
+                                 const struct iovec *vec,
+                                 apr_int32_t in_vec, apr_size_t *nbytes)
+{
+    apr_status_t rc = APR_SUCCESS;
+    apr_ssize_t rv;
+    apr_int32_t i;
+    DWORD dwBytes = 0;
+    DWORD flags = 0;
+    WSABUF *pWsaBuf;
+
+    if (in_vec < 1) {
+        *nbytes = 0;
+        return APR_SUCCESS;
+    }
+
+    pWsaBuf = (in_vec <= WSABUF_ON_STACK) ? _alloca(sizeof(WSABUF) * (in_vec))
+                                          : malloc(sizeof(WSABUF) * (in_vec));
+    if (!pWsaBuf)
+        return APR_ENOMEM;
+
+    for (i = 0; i < in_vec; i++) {
+        pWsaBuf[i].buf = vec[i].iov_base;
+        pWsaBuf[i].len = (ULONG) vec[i].iov_len;
+    }
+#ifndef _WIN32_WCE
+    rv = WSARecv(sock->socketdes, pWsaBuf, in_vec, &dwBytes, &flags,
+                 NULL, NULL);
+#else
+    rv = recv(sock->socketdes, pWsaBuf[0].buf, pWsaBuf[0].len, 0);
+    dwBytes = rv;
+#endif
+    if (rv == SOCKET_ERROR) {
+        rc = apr_get_netos_error();
+        dwBytes = 0;
+    }
+    if (in_vec > WSABUF_ON_STACK)
+        free(pWsaBuf);
+
+    *nbytes = dwBytes;
+    if (rc == APR_SUCCESS && dwBytes == 0) {
+        rc = APR_EOF;
+    }
+    return rc;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_recvv(apr_socket_t *sock,
+                                           const struct iovec *vec,
+                                           apr_int32_t nvec,
+                                           apr_int32_t flags,
+                                           apr_size_t *len)
+{
+    apr_interval_time_t timeout;
+    apr_status_t rv;
+
+    if (flags & APR_RECV_NONBLOCK) {
+        apr_socket_timeout_get(sock, &timeout);
+        apr_socket_timeout_set(sock, 0);
+    }
+    rv = socket_recvv(sock, vec, nvec, len);
+    if (flags & APR_RECV_NONBLOCK) {
+        apr_socket_timeout_set(sock, timeout);
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_socket_send_zc(apr_socket_t *sock,
+                                             const char *buf,
+                                             apr_size_t *len,
+                                             apr_uint32_t *id)
+{
+    *len = 0;
+    return APR_ENOTIMPL;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_zc_reap(apr_socket_t *sock,
+                                             apr_uint32_t *first,
+                                             apr_uint32_t *last,
+                                             int *copied)
+{
+    return APR_ENOTIMPL;
+}
+
+
 
 APR_DECLARE(apr_status_t) apr_socket_sendto(apr_socket_t *sock,
                                             apr_sockaddr_t *where,
@@ -194,6 +279,59 @@ APR_DECLARE(apr_status_t) apr_socket_recvfrom(apr_sockaddr_t *from,
     return APR_SUCCESS;
 }
 
+APR_DECLARE(apr_status_t) apr_socket_sendmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_size_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_size_t *nsent)
+{
+    apr_status_t rv = APR_SUCCESS;
+    apr_size_t i;
+
+    for (i = 0; i < nmsgs; i++) {
+        if (msgs[i].segment_size) {
+            rv = APR_ENOTIMPL;
+        }
+        else if (msgs[i].addr) {
+            rv = apr_socket_sendto(sock, msgs[i].addr, flags, msgs[i].buf,
+                                   &msgs[i].len);
+        }
+        else {
+            rv = apr_socket_send(sock, msgs[i].buf, &msgs[i].len);
+        }
+        if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    *nsent = i;
+    return i ? APR_SUCCESS : rv;
+}
+
+
+APR_DECLARE(apr_status_t) apr_socket_recvmmsg(apr_socket_t *sock,
+                                              apr_socket_msg_t *msgs,
+                                              apr_size_t nmsgs,
+                                              apr_int32_t flags,
+                                              apr_size_t *nrecv)
+{
+    apr_sockaddr_t sa;
+    apr_status_t rv;
+
+    /* A single one, since waiting for the next one is not wanted */
+    *nrecv = 0;
+    if (!nmsgs) {
+        return APR_SUCCESS;
+    }
+    msgs[0].segment_size = 0;
+    rv = apr_socket_recvfrom(msgs[0].addr ? msgs[0].addr : &sa, sock, flags,
+                             msgs[0].buf, &msgs[0].len);
+    if (rv == APR_SUCCESS) {
+        *nrecv = 1;
+    }
+    return rv;
+}
+
+
 
 #if APR_HAS_SENDFILE
 static apr_status_t collapse_iovec(char **off, apr_size_t *len, 
@@ -308,6 +308,30 @@ APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset)
 
 
 
+APR_DECLARE(apr_status_t) apr_pollset_rearm(apr_pollset_t *pollset,
+                                            const apr_pollfd_t *descriptor)
+{
+    return APR_ENOTIMPL;
+}
+
+
+
+APR_DECLARE(apr_status_t) apr_pollset_recv(apr_pollset_t *pollset,
+                                           apr_pollset_io_t *io)
+{
+    return APR_ENOTIMPL;
+}
+
+
+
+APR_DECLARE(apr_status_t) apr_pollset_send(apr_pollset_t *pollset,
+                                           apr_pollset_io_t *io)
+{
+    return APR_ENOTIMPL;
+}
+
+
+
 APR_DECLARE(const char *) apr_poll_method_defname(void)
 {
     return "select";
@@ -25,6 +25,53 @@
 
 #if defined(HAVE_EPOLL)
 
+/* epoll_pwait2() (Linux 5.11) takes the timeout as a timespec, for the
+ * sub-millisecond ones; it is called through syscall() since the C library
+ * may not know it.
+ */
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#ifdef __NR_epoll_pwait2
+#define HAVE_EPOLL_PWAIT2 1
+
+/* struct __kernel_timespec */
+struct epoll_timespec {
+    apr_int64_t tv_sec;
+    apr_int64_t tv_nsec;
+};
+
+static volatile int epoll_pwait2_missing = 0;
+#endif
+
+/* epoll_wait() with a timeout in microseconds (no limit if negative) */
+static int epoll_wait_usec(int epfd, struct epoll_event *events,
+                           int maxevents, apr_interval_time_t timeout)
+{
+#ifdef HAVE_EPOLL_PWAIT2
+    /* Whole milliseconds are fine for epoll_wait() */
+    if (timeout > 0 && (timeout % 1000) && !epoll_pwait2_missing) {
+        struct epoll_timespec ts;
+        int ret;
+
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000;
+        ret = syscall(__NR_epoll_pwait2, epfd, events, maxevents, &ts,
+                      NULL, 0);
+        /* seccomp filters unaware of it may deny it (EPERM) */
+        if (ret >= 0 || (errno != ENOSYS && errno != EPERM)) {
+            return ret;
+        }
+        epoll_pwait2_missing = 1;
+    }
+#endif
+
+    if (timeout > 0) {
+        timeout = (timeout + 999) / 1000;
+    }
+    return epoll_wait(epfd, events, maxevents, timeout);
+}
+
 static apr_int16_t get_epoll_event(apr_int16_t event)
 {
     apr_int16_t rv = 0;
@@ -59,6 +106,18 @@ static apr_int16_t get_epoll_revent(apr_int16_t event)
     return rv;
 }
 
+static apr_uint32_t get_epoll_flags(apr_int16_t reqevents)
+{
+    apr_uint32_t rv = 0;
+
+    if (reqevents & APR_POLLSET_EDGE)
+        rv |= EPOLLET;
+    if (reqevents & APR_POLLSET_ONESHOT)
+        rv |= EPOLLONESHOT;
+
+    return rv;
+}
+
 struct apr_pollset_private_t
 {
     int epoll_fd;
@@ -167,9 +226,14 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
     pfd_elem_t *elem = NULL;
     apr_status_t rv = APR_SUCCESS;
 
-    ev.events = get_epoll_event(descriptor->reqevents);
+    ev.events = get_epoll_event(descriptor->reqevents) |
+                get_epoll_flags(descriptor->reqevents);
 
-    if (pollset->flags & APR_POLLSET_NOCOPY) {
+    if (apr_poll_is_wakeup(descriptor)) {
+        /* Told from the others by its data alone, no element needed */
+        ev.data.ptr = APR_POLL_WAKEUP_DATA;
+    }
+    else if (pollset->flags & APR_POLLSET_NOCOPY) {
         ev.data.ptr = (void *)descriptor;
     }
     else {
@@ -199,7 +263,7 @@ static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
         rv = apr_get_netos_error();
     }
 
-    if (!(pollset->flags & APR_POLLSET_NOCOPY)) {
+    if (elem) {
         if (rv != APR_SUCCESS) {
             APR_RING_INSERT_TAIL(&(pollset->p->free_ring), elem, pfd_elem_t, link);
         }
@@ -256,6 +320,56 @@ static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
     return rv;
 }
 
+static apr_status_t impl_pollset_rearm(apr_pollset_t *pollset,
+                                       const apr_pollfd_t *descriptor)
+{
+    struct epoll_event ev = {0};
+    pfd_elem_t *ep;
+    apr_status_t rv = APR_SUCCESS;
+    int fd, ret;
+
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        fd = descriptor->desc.s->socketdes;
+    }
+    else {
+        fd = descriptor->desc.f->filedes;
+    }
+    ev.events = get_epoll_event(descriptor->reqevents) |
+                get_epoll_flags(descriptor->reqevents);
+
+    if (pollset->flags & APR_POLLSET_NOCOPY) {
+        ev.data.ptr = (void *)descriptor;
+        ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    else {
+        pollset_lock_rings();
+
+        for (ep = APR_RING_FIRST(&(pollset->p->query_ring));
+             ep != APR_RING_SENTINEL(&(pollset->p->query_ring),
+                                     pfd_elem_t, link);
+             ep = APR_RING_NEXT(ep, link)) {
+            if (descriptor->desc.s == ep->pfd.desc.s) {
+                break;
+            }
+        }
+        if (ep == APR_RING_SENTINEL(&(pollset->p->query_ring),
+                                    pfd_elem_t, link)) {
+            pollset_unlock_rings();
+            return APR_NOTFOUND;
+        }
+        ep->pfd = *descriptor;
+        ev.data.ptr = ep;
+        ret = epoll_ctl(pollset->p->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+
+        pollset_unlock_rings();
+    }
+    if (ret < 0) {
+        rv = (errno == ENOENT) ? APR_NOTFOUND : apr_get_netos_error();
+    }
+
+    return rv;
+}
+
 static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
                                            apr_interval_time_t timeout,
                                            apr_int32_t *num,
@@ -266,12 +380,8 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
 
     *num = 0;
 
-    if (timeout > 0) {
-        timeout = (timeout + 999) / 1000;
-    }
-
-    ret = epoll_wait(pollset->p->epoll_fd, pollset->p->pollset, pollset->nalloc,
-                     timeout);
+    ret = epoll_wait_usec(pollset->p->epoll_fd, pollset->p->pollset,
+                          pollset->nalloc, timeout);
     if (ret < 0) {
         rv = apr_get_netos_error();
     }
@@ -283,27 +393,26 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
         const apr_pollfd_t *fdptr;
 
         for (i = 0, j = 0; i < ret; i++) {
-            if (pollset->flags & APR_POLLSET_NOCOPY) {
-                fdptr = (apr_pollfd_t *)(pollset->p->pollset[i].data.ptr);
-            }
-            else {
-                fdptr = &(((pfd_elem_t *) (pollset->p->pollset[i].data.ptr))->pfd);
-            }
+            void *data = pollset->p->pollset[i].data.ptr;
+
             /* Check if the polled descriptor is our
              * wakeup pipe. In that case do not put it result set.
              */
-            if ((pollset->flags & APR_POLLSET_WAKEABLE) &&
-                fdptr->desc_type == APR_POLL_FILE &&
-                fdptr->desc.f == pollset->wakeup_pipe[0]) {
+            if (data == APR_POLL_WAKEUP_DATA) {
                 apr_poll_drain_wakeup_pipe(pollset->wakeup_pipe);
                 rv = APR_EINTR;
+                continue;
+            }
+            if (pollset->flags & APR_POLLSET_NOCOPY) {
+                fdptr = (apr_pollfd_t *)data;
             }
             else {
-                pollset->p->result_set[j] = *fdptr;
-                pollset->p->result_set[j].rtnevents =
-                    get_epoll_revent(pollset->p->pollset[i].events);
-                j++;
+                fdptr = &(((pfd_elem_t *)data)->pfd);
             }
+            pollset->p->result_set[j] = *fdptr;
+            pollset->p->result_set[j].rtnevents =
+                get_epoll_revent(pollset->p->pollset[i].events);
+            j++;
         }
         if (((*num) = j)) { /* any event besides wakeup pipe? */
             rv = APR_SUCCESS;
@@ -332,7 +441,9 @@ static const apr_pollset_provider_t impl = {
     impl_pollset_remove,
     impl_pollset_poll,
     impl_pollset_cleanup,
-    "epoll"
+    "epoll",
+    NULL,
+    impl_pollset_rearm
 };
 
 const apr_pollset_provider_t *const apr_pollset_provider_epoll = &impl;
@@ -401,7 +512,12 @@ static apr_status_t impl_pollcb_add(apr_pollcb_t *pollcb,
     int ret;
     
     ev.events = get_epoll_event(descriptor->reqevents);
-    ev.data.ptr = (void *) descriptor;
+    if (apr_poll_is_wakeup(descriptor)) {
+        ev.data.ptr = APR_POLL_WAKEUP_DATA;
+    }
+    else {
+        ev.data.ptr = (void *) descriptor;
+    }
 
     if (descriptor->desc_type == APR_POLL_SOCKET) {
         ret = epoll_ctl(pollcb->fd, EPOLL_CTL_ADD,
@@ -453,12 +569,8 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
     int ret, i;
     apr_status_t rv = APR_SUCCESS;
     
-    if (timeout > 0) {
-        timeout = (timeout + 999) / 1000;
-    }
-    
-    ret = epoll_wait(pollcb->fd, pollcb->pollset.epoll, pollcb->nalloc,
-                     timeout);
+    ret = epoll_wait_usec(pollcb->fd, pollcb->pollset.epoll, pollcb->nalloc,
+                          timeout);
     if (ret < 0) {
         rv = apr_get_netos_error();
     }
@@ -469,9 +581,7 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
         for (i = 0; i < ret; i++) {
             apr_pollfd_t *pollfd = (apr_pollfd_t *)(pollcb->pollset.epoll[i].data.ptr);
 
-            if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
-                pollfd->desc_type == APR_POLL_FILE &&
-                pollfd->desc.f == pollcb->wakeup_pipe[0]) {
+            if (pollfd == APR_POLL_WAKEUP_DATA) {
                 apr_poll_drain_wakeup_pipe(pollcb->wakeup_pipe);
                 return APR_EINTR;
             }
@@ -283,9 +283,7 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
 
         for (i = 0, j = 0; i < ret; i++) {
             fd = &((pfd_elem_t *)pollset->p->ke_set[i].udata)->pfd;
-            if ((pollset->flags & APR_POLLSET_WAKEABLE) &&
-                fd->desc_type == APR_POLL_FILE &&
-                fd->desc.f == pollset->wakeup_pipe[0]) {
+            if (apr_poll_is_wakeup(fd)) {
                 apr_poll_drain_wakeup_pipe(pollset->wakeup_pipe);
                 rv = APR_EINTR;
             }
@@ -470,9 +468,7 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
         for (i = 0; i < ret; i++) {
             apr_pollfd_t *pollfd = (apr_pollfd_t *)(pollcb->pollset.ke[i].udata);
 
-            if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
-                pollfd->desc_type == APR_POLL_FILE &&
-                pollfd->desc.f == pollcb->wakeup_pipe[0]) {
+            if (apr_poll_is_wakeup(pollfd)) {
                 apr_poll_drain_wakeup_pipe(pollcb->wakeup_pipe);
                 return APR_EINTR;
             }
@@ -278,9 +278,7 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
                 /* Check if the polled descriptor is our
                  * wakeup pipe. In that case do not put it result set.
                  */
-                if ((pollset->flags & APR_POLLSET_WAKEABLE) &&
-                    pollset->p->query_set[i].desc_type == APR_POLL_FILE &&
-                    pollset->p->query_set[i].desc.f == pollset->wakeup_pipe[0]) {
+                if (apr_poll_is_wakeup(&pollset->p->query_set[i])) {
                     apr_poll_drain_wakeup_pipe(pollset->wakeup_pipe);
                     rv = APR_EINTR;
                 }
@@ -431,9 +429,7 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
             if (pollcb->pollset.ps[i].revents != 0) {
                 apr_pollfd_t *pollfd = pollcb->copyset[i];
 
-                if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
-                    pollfd->desc_type == APR_POLL_FILE &&
-                    pollfd->desc.f == pollcb->wakeup_pipe[0]) {
+                if (apr_poll_is_wakeup(pollfd)) {
                     apr_poll_drain_wakeup_pipe(pollcb->wakeup_pipe);
                     return APR_EINTR;
                 }
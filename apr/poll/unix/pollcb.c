@@ -40,6 +40,9 @@ extern const apr_pollcb_provider_t *apr_pollcb_provider_epoll;
 #if defined(HAVE_POLL)
 extern const apr_pollcb_provider_t *apr_pollcb_provider_poll;
 #endif
+#if defined(HAVE_IO_URING)
+extern const apr_pollcb_provider_t *apr_pollcb_provider_uring;
+#endif
 
 static const apr_pollcb_provider_t *pollcb_provider(apr_pollset_method_e method)
 {
@@ -63,6 +66,11 @@ static const apr_pollcb_provider_t *pollcb_provider(apr_pollset_method_e method)
         case APR_POLLSET_POLL:
 #if defined(HAVE_POLL)
             provider = apr_pollcb_provider_poll;
+#endif
+        break;
+        case APR_POLLSET_URING:
+#if defined(HAVE_IO_URING)
+            provider = apr_pollcb_provider_uring;
 #endif
         break;
         case APR_POLLSET_SELECT:
@@ -99,6 +107,10 @@ APR_DECLARE(apr_status_t) apr_pollcb_create_ex(apr_pollcb_t **ret_pollcb,
 
     *ret_pollcb = NULL;
 
+#if defined(HAVE_IO_URING)
+    apr_poll_uring_release_inherited();
+#endif
+
  #ifdef WIN32
     /* This will work only if ws2_32.dll has WSAPoll funtion.
      * We could check the presence of the function here,
@@ -213,7 +225,7 @@ APR_DECLARE(apr_status_t) apr_pollcb_poll(apr_pollcb_t *pollcb,
 APR_DECLARE(apr_status_t) apr_pollcb_wakeup(apr_pollcb_t *pollcb)
 {
     if (pollcb->flags & APR_POLLSET_WAKEABLE)
-        return apr_file_putc(1, pollcb->wakeup_pipe[1]);
+        return apr_poll_write_wakeup_pipe(pollcb->wakeup_pipe);
     else
         return APR_EINIT;
 }
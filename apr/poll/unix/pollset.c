@@ -58,6 +58,9 @@ extern const apr_pollset_provider_t *apr_pollset_provider_aio_msgq;
 #if defined(HAVE_POLL)
 extern const apr_pollset_provider_t *apr_pollset_provider_poll;
 #endif
+#if defined(HAVE_IO_URING)
+extern const apr_pollset_provider_t *apr_pollset_provider_uring;
+#endif
 extern const apr_pollset_provider_t *apr_pollset_provider_select;
 
 static const apr_pollset_provider_t *pollset_provider(apr_pollset_method_e method)
@@ -87,6 +90,11 @@ static const apr_pollset_provider_t *pollset_provider(apr_pollset_method_e metho
         case APR_POLLSET_POLL:
 #if defined(HAVE_POLL)
             provider = apr_pollset_provider_poll;
+#endif
+        break;
+        case APR_POLLSET_URING:
+#if defined(HAVE_IO_URING)
+            provider = apr_pollset_provider_uring;
 #endif
         break;
         case APR_POLLSET_SELECT:
@@ -110,6 +118,10 @@ APR_DECLARE(apr_status_t) apr_pollset_create_ex(apr_pollset_t **ret_pollset,
 
     *ret_pollset = NULL;
 
+#if defined(HAVE_IO_URING)
+    apr_poll_uring_release_inherited();
+#endif
+
  #ifdef WIN32
     /* Favor WSAPoll if supported.
      * This will work only if ws2_32.dll has WSAPoll funtion.
@@ -221,7 +233,7 @@ APR_DECLARE(apr_status_t) apr_pollset_destroy(apr_pollset_t * pollset)
 APR_DECLARE(apr_status_t) apr_pollset_wakeup(apr_pollset_t *pollset)
 {
     if (pollset->flags & APR_POLLSET_WAKEABLE)
-        return apr_file_putc(1, pollset->wakeup_pipe[1]);
+        return apr_poll_write_wakeup_pipe(pollset->wakeup_pipe);
     else
         return APR_EINIT;
 }
@@ -238,10 +250,65 @@ APR_DECLARE(apr_status_t) apr_pollset_remove(apr_pollset_t *pollset,
     return (*pollset->provider->remove)(pollset, descriptor);
 }
 
+APR_DECLARE(apr_status_t) apr_pollset_rearm(apr_pollset_t *pollset,
+                                            const apr_pollfd_t *descriptor)
+{
+    apr_status_t rv;
+
+    if (pollset->provider->rearm) {
+        return (*pollset->provider->rearm)(pollset, descriptor);
+    }
+
+    /* Emulated, the descriptor was removed when signalled */
+    rv = (*pollset->provider->remove)(pollset, descriptor);
+    if (rv != APR_SUCCESS && !APR_STATUS_IS_NOTFOUND(rv)) {
+        return rv;
+    }
+    return (*pollset->provider->add)(pollset, descriptor);
+}
+
 APR_DECLARE(apr_status_t) apr_pollset_poll(apr_pollset_t *pollset,
                                            apr_interval_time_t timeout,
                                            apr_int32_t *num,
                                            const apr_pollfd_t **descriptors)
 {
-    return (*pollset->provider->poll)(pollset, timeout, num, descriptors);
+    const apr_pollfd_t *result = NULL;
+    apr_status_t rv;
+    apr_int32_t i;
+
+    if (pollset->provider->rearm) {
+        return (*pollset->provider->poll)(pollset, timeout, num, descriptors);
+    }
+
+    rv = (*pollset->provider->poll)(pollset, timeout, num, &result);
+    if (rv == APR_SUCCESS && result) {
+        /* Emulate APR_POLLSET_ONESHOT */
+        for (i = 0; i < *num; i++) {
+            if (result[i].reqevents & APR_POLLSET_ONESHOT) {
+                (*pollset->provider->remove)(pollset, &result[i]);
+            }
+        }
+    }
+    if (descriptors && result) {
+        *descriptors = result;
+    }
+    return rv;
+}
+
+APR_DECLARE(apr_status_t) apr_pollset_recv(apr_pollset_t *pollset,
+                                           apr_pollset_io_t *io)
+{
+    if (!pollset->provider->io) {
+        return APR_ENOTIMPL;
+    }
+    return (*pollset->provider->io)(pollset, io, APR_POLLIN);
+}
+
+APR_DECLARE(apr_status_t) apr_pollset_send(apr_pollset_t *pollset,
+                                           apr_pollset_io_t *io)
+{
+    if (!pollset->provider->io) {
+        return APR_ENOTIMPL;
+    }
+    return (*pollset->provider->io)(pollset, io, APR_POLLOUT);
 }
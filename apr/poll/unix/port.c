@@ -408,9 +408,7 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
 
     for (i = 0, j = 0; i < nget; i++) {
         ep = (pfd_elem_t *)pollset->p->port_set[i].portev_user;
-        if ((pollset->flags & APR_POLLSET_WAKEABLE) &&
-            ep->pfd.desc_type == APR_POLL_FILE &&
-            ep->pfd.desc.f == pollset->wakeup_pipe[0]) {
+        if (apr_poll_is_wakeup(&ep->pfd)) {
             apr_poll_drain_wakeup_pipe(pollset->wakeup_pipe);
             rv = APR_EINTR;
         }
@@ -560,9 +558,7 @@ static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
         for (i = 0; i < nget; i++) {
             apr_pollfd_t *pollfd = (apr_pollfd_t *)(pollcb->pollset.port[i].portev_user);
 
-            if ((pollcb->flags & APR_POLLSET_WAKEABLE) &&
-                pollfd->desc_type == APR_POLL_FILE &&
-                pollfd->desc.f == pollcb->wakeup_pipe[0]) {
+            if (apr_poll_is_wakeup(pollfd)) {
                 apr_poll_drain_wakeup_pipe(pollcb->wakeup_pipe);
                 return APR_EINTR;
             }
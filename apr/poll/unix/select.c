@@ -399,8 +399,7 @@ static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
             fd = pollset->p->query_set[i].desc.s->socketdes;
         }
         else {
-            if ((pollset->flags & APR_POLLSET_WAKEABLE) &&
-                pollset->p->query_set[i].desc.f == pollset->wakeup_pipe[0]) {
+            if (apr_poll_is_wakeup(&pollset->p->query_set[i])) {
                 apr_poll_drain_wakeup_pipe(pollset->wakeup_pipe);
                 rv = APR_EINTR;
                 continue;
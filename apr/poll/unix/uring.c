@@ -0,0 +1,1120 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr.h"
+#include "apr_atomic.h"
+#include "apr_poll.h"
+#include "apr_time.h"
+#include "apr_portable.h"
+#include "apr_arch_file_io.h"
+#include "apr_arch_networkio.h"
+#include "apr_arch_poll_private.h"
+
+#if defined(HAVE_IO_URING)
+
+#include <sys/mman.h>
+
+/*
+ * The descriptors are watched by one shot IORING_OP_POLL_ADD requests,
+ * armed again by the apr_pollset_poll() following the one which reported
+ * them: the kernel checks the readiness when the request is armed, which
+ * gives the level-triggered semantics of the other methods.  Requests
+ * (adds, removes, re-arms) are queued in the submission ring and handed to
+ * the kernel in the same io_uring_enter() as the wait, so a poll costs a
+ * single system call whatever the number of changes to the set.
+ *
+ * APR_POLLSET_ONESHOT descriptors are not armed again until
+ * apr_pollset_rearm(), and APR_POLLSET_EDGE ones are watched by a
+ * multishot request (when available) which reports each new event until
+ * the kernel ends it.
+ *
+ * The user_data of a request is the uring_elem_t of the descriptor, an
+ * apr_pollset_io_t tagged in its low bits for apr_pollset_recv() and
+ * apr_pollset_send(), or zero for removals (whose completion is ignored).
+ */
+#define URING_TAG_IO    0x1
+#define URING_TAG_SEND  0x2
+#define URING_TAG_MASK  0x3
+
+#define URING_MIN_ENTRIES 16
+#define URING_MAX_ENTRIES 4096
+
+#define URING_FEATURES (IORING_FEAT_SINGLE_MMAP | \
+                        IORING_FEAT_NODROP | \
+                        IORING_FEAT_EXT_ARG)
+
+typedef struct uring_elem_t uring_elem_t;
+
+/* A descriptor of the set.  It is recycled only once the kernel is done
+ * with its poll request, since a completion may still refer to it after
+ * the descriptor has been removed.
+ */
+struct uring_elem_t {
+    /* Link in the free or re-arm list */
+    uring_elem_t *next;
+    /* Copy of the descriptor */
+    apr_pollfd_t pfd;
+    /* &pfd, or the caller's descriptor (APR_POLLSET_NOCOPY, pollcb) */
+    apr_pollfd_t *descriptor;
+    int fd;
+    /* APR_POLLSET_EDGE and APR_POLLSET_ONESHOT, as honoured by the ring */
+    apr_int16_t mode;
+    /* Whether a poll request is in flight, or the element in the re-arm
+     * list */
+    apr_byte_t armed;
+    apr_byte_t queued;
+    int removed;
+};
+
+typedef struct apr_pollcb_uring_t uring_t;
+
+struct apr_pollcb_uring_t {
+    int fd;
+    /* Submission ring, sq_tail being ahead of *sq_khead by the number of
+     * requests queued but not submitted yet */
+    unsigned int *sq_khead;
+    unsigned int *sq_ktail;
+    unsigned int *sq_array;
+    unsigned int sq_mask;
+    unsigned int sq_entries;
+    unsigned int sq_tail;
+    struct io_uring_sqe *sqes;
+    /* Completion ring */
+    unsigned int *cq_khead;
+    unsigned int *cq_ktail;
+    unsigned int cq_mask;
+    struct io_uring_cqe *cqes;
+    void *ring_map;
+    size_t ring_len;
+    size_t sqes_len;
+    /* Descriptors of the set, indexed by fd */
+    uring_elem_t **elems;
+    int nelems;
+    /* Descriptors reported by the last poll, to be armed again */
+    uring_elem_t *rearm;
+    uring_elem_t **rearm_tail;
+    uring_elem_t *free_elems;
+    /* Requests the kernel still has to complete */
+    apr_uint32_t inflight;
+    /* Registration flags honoured (pollsets only) */
+    apr_int16_t modes;
+    apr_pool_t *pool;
+};
+
+/* Closing a ring makes the kernel interrupt the next blocking system call
+ * of the threads which used it (EINTR), so the last destroyed ring is kept
+ * (once quiet) for the next pollset rather than closed.  A child process
+ * inherits it but must not use it, the queues being shared with the
+ * parent, so it is kept along with the pid of its process.  It is closed
+ * with the root of the pools of the pollsets which kept it (the global
+ * pool, usually), if not reused before.
+ */
+#define URING_IDLE_EMPTY 0
+#define URING_IDLE_BUSY  1
+#define URING_IDLE_FULL  2
+static apr_uint32_t uring_idle_state = URING_IDLE_EMPTY;
+static uring_t uring_idle;
+static pid_t uring_idle_pid;
+static apr_pool_t *uring_idle_root;
+
+#define URING_QUIESCE_TIMEOUT apr_time_from_msec(100)
+
+static apr_uint32_t get_uring_event(apr_int16_t event)
+{
+    apr_uint32_t rv = 0;
+
+    if (event & APR_POLLIN)
+        rv |= POLLIN;
+    if (event & APR_POLLPRI)
+        rv |= POLLPRI;
+    if (event & APR_POLLOUT)
+        rv |= POLLOUT;
+    /* POLLERR, POLLHUP and POLLNVAL are return-only */
+
+#if APR_IS_BIGENDIAN
+    /* poll32_events is read as two swapped 16-bit halves */
+    rv = (rv << 16) | (rv >> 16);
+#endif
+    return rv;
+}
+
+static apr_int16_t get_uring_revent(apr_int32_t event)
+{
+    apr_int16_t rv = 0;
+
+    if (event & POLLIN)
+        rv |= APR_POLLIN;
+    if (event & POLLPRI)
+        rv |= APR_POLLPRI;
+    if (event & POLLOUT)
+        rv |= APR_POLLOUT;
+    if (event & POLLERR)
+        rv |= APR_POLLERR;
+    if (event & POLLHUP)
+        rv |= APR_POLLHUP;
+    if (event & POLLNVAL)
+        rv |= APR_POLLNVAL;
+
+    return rv;
+}
+
+static int uring_enter(uring_t *ring, unsigned int to_submit,
+                       unsigned int min_complete, unsigned int flags,
+                       apr_interval_time_t timeout)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+
+    if (timeout > 0) {
+        ts.tv_sec = apr_time_sec(timeout);
+        ts.tv_nsec = apr_time_usec(timeout) * 1000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (apr_uint64_t)(apr_uintptr_t)&ts;
+        return syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+                       flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+    return syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+                   flags, NULL, 0);
+}
+
+static APR_INLINE unsigned int uring_pending(uring_t *ring)
+{
+    return ring->sq_tail - __atomic_load_n(ring->sq_khead, __ATOMIC_ACQUIRE);
+}
+
+static APR_INLINE int uring_cq_ready(uring_t *ring)
+{
+    return __atomic_load_n(ring->cq_ktail, __ATOMIC_ACQUIRE) != *ring->cq_khead;
+}
+
+/* Hands the queued requests to the kernel */
+static apr_status_t uring_submit(uring_t *ring)
+{
+    unsigned int pending;
+    int ret;
+
+    while ((pending = uring_pending(ring))) {
+        ret = uring_enter(ring, pending, 0, 0, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (ret == 0) {
+            return APR_EAGAIN;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+/* Queues a request, submitting the previous ones if the ring is full */
+static apr_status_t uring_prep(uring_t *ring, apr_byte_t opcode, int fd,
+                               const void *addr, apr_uint32_t len,
+                               apr_uint32_t op_flags, apr_uint64_t user_data)
+{
+    struct io_uring_sqe *sqe;
+    unsigned int idx;
+    apr_status_t rv;
+
+    if (uring_pending(ring) >= ring->sq_entries) {
+        if ((rv = uring_submit(ring)) != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    idx = ring->sq_tail & ring->sq_mask;
+    sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (apr_uint64_t)(apr_uintptr_t)addr;
+    sqe->len = len;
+    /* poll32_events and msg_flags share the same union */
+    sqe->poll32_events = op_flags;
+    sqe->user_data = user_data;
+    ring->sq_array[idx] = idx;
+
+    __atomic_store_n(ring->sq_ktail, ++ring->sq_tail, __ATOMIC_RELEASE);
+    ring->inflight++;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t uring_arm(uring_t *ring, uring_elem_t *elem)
+{
+    apr_uint32_t poll_flags = 0;
+    apr_status_t rv;
+
+#ifdef IORING_POLL_ADD_MULTI
+    if (elem->mode == APR_POLLSET_EDGE) {
+        poll_flags = IORING_POLL_ADD_MULTI;
+    }
+#endif
+    rv = uring_prep(ring, IORING_OP_POLL_ADD, elem->fd, NULL, poll_flags,
+                    get_uring_event(elem->descriptor->reqevents),
+                    (apr_uint64_t)(apr_uintptr_t)elem);
+    if (rv == APR_SUCCESS) {
+        elem->armed = 1;
+    }
+    return rv;
+}
+
+static void uring_free_elem(uring_t *ring, uring_elem_t *elem)
+{
+    elem->next = ring->free_elems;
+    ring->free_elems = elem;
+}
+
+/* Arms again the descriptors reported by the last poll */
+static apr_status_t uring_rearm(uring_t *ring)
+{
+    uring_elem_t *elem;
+    apr_status_t rv;
+
+    while ((elem = ring->rearm)) {
+        if (!elem->removed && (rv = uring_arm(ring, elem)) != APR_SUCCESS) {
+            return rv;
+        }
+        ring->rearm = elem->next;
+        elem->queued = 0;
+        if (elem->removed) {
+            uring_free_elem(ring, elem);
+        }
+    }
+    ring->rearm_tail = &ring->rearm;
+    return APR_SUCCESS;
+}
+
+/* Reaps a completion, returning whether its request is done */
+static APR_INLINE int uring_cqe_done(uring_t *ring,
+                                     const struct io_uring_cqe *cqe)
+{
+    if (cqe->flags & IORING_CQE_F_MORE) {
+        return 0;
+    }
+    ring->inflight--;
+    return 1;
+}
+
+/* Cancels the requests in flight and waits for their completion */
+static apr_status_t uring_quiesce(uring_t *ring)
+{
+#ifdef IORING_ASYNC_CANCEL_ANY
+    apr_time_t deadline = apr_time_now() + URING_QUIESCE_TIMEOUT;
+    apr_status_t rv;
+
+    if (ring->inflight) {
+        rv = uring_prep(ring, IORING_OP_ASYNC_CANCEL, -1, NULL, 0,
+                        IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_ANY, 0);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    while (ring->inflight) {
+        unsigned int head, tail;
+        apr_time_t now;
+
+        if (uring_enter(ring, uring_pending(ring), 1, IORING_ENTER_GETEVENTS,
+                        URING_QUIESCE_TIMEOUT) < 0
+            && errno != ETIME && errno != EINTR) {
+            return errno;
+        }
+        head = *ring->cq_khead;
+        tail = __atomic_load_n(ring->cq_ktail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            uring_cqe_done(ring, &ring->cqes[head++ & ring->cq_mask]);
+        }
+        __atomic_store_n(ring->cq_khead, head, __ATOMIC_RELEASE);
+
+        now = apr_time_now();
+        if (ring->inflight && now >= deadline) {
+            return APR_TIMEUP;
+        }
+    }
+    return APR_SUCCESS;
+#else
+    return ring->inflight ? APR_ENOTIMPL : APR_SUCCESS;
+#endif
+}
+
+static void uring_close(uring_t *ring)
+{
+    munmap(ring->sqes, ring->sqes_len);
+    munmap(ring->ring_map, ring->ring_len);
+    close(ring->fd);
+}
+
+static apr_status_t uring_idle_cleanup(void *data)
+{
+    apr_uint32_t state;
+
+    /* Wait for whoever is taking or keeping the ring */
+    do {
+        state = apr_atomic_read32(&uring_idle_state);
+    } while (state == URING_IDLE_BUSY
+             || apr_atomic_cas32(&uring_idle_state, URING_IDLE_BUSY,
+                                 state) != state);
+
+    if (state == URING_IDLE_FULL) {
+        uring_close(&uring_idle);
+    }
+    uring_idle_root = NULL;
+    apr_atomic_set32(&uring_idle_state, URING_IDLE_EMPTY);
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t uring_cleanup(uring_t *ring)
+{
+    if (uring_quiesce(ring) == APR_SUCCESS &&
+        apr_atomic_cas32(&uring_idle_state, URING_IDLE_BUSY,
+                         URING_IDLE_EMPTY) == URING_IDLE_EMPTY) {
+        uring_idle = *ring;
+        uring_idle_pid = getpid();
+        if (!uring_idle_root) {
+            apr_pool_t *root = ring->pool, *parent;
+
+            while ((parent = apr_pool_parent_get(root)) != NULL) {
+                root = parent;
+            }
+            apr_pool_cleanup_register(root, NULL, uring_idle_cleanup,
+                                      apr_pool_cleanup_null);
+            uring_idle_root = root;
+        }
+        apr_atomic_set32(&uring_idle_state, URING_IDLE_FULL);
+        return APR_SUCCESS;
+    }
+
+    uring_close(ring);
+    return APR_SUCCESS;
+}
+
+void apr_poll_uring_release_inherited(void)
+{
+    if (apr_atomic_read32(&uring_idle_state) == URING_IDLE_FULL
+        && apr_atomic_cas32(&uring_idle_state, URING_IDLE_BUSY,
+                            URING_IDLE_FULL) == URING_IDLE_FULL) {
+        if (uring_idle_pid != getpid()) {
+            /* the parent's, only our copy of the mappings goes */
+            uring_close(&uring_idle);
+            apr_atomic_set32(&uring_idle_state, URING_IDLE_EMPTY);
+        }
+        else {
+            apr_atomic_set32(&uring_idle_state, URING_IDLE_FULL);
+        }
+    }
+}
+
+/* Takes the idle ring if it is big enough */
+static int uring_reuse(uring_t *ring, unsigned int entries)
+{
+    int reused = 0;
+
+    if (apr_atomic_cas32(&uring_idle_state, URING_IDLE_BUSY,
+                         URING_IDLE_FULL) == URING_IDLE_FULL) {
+        if (uring_idle.sq_entries >= entries) {
+            *ring = uring_idle;
+            apr_atomic_set32(&uring_idle_state, URING_IDLE_EMPTY);
+            reused = 1;
+        }
+        else {
+            apr_atomic_set32(&uring_idle_state, URING_IDLE_FULL);
+        }
+    }
+    return reused;
+}
+
+static apr_status_t uring_create(uring_t *ring, apr_uint32_t size,
+                                 apr_pool_t *p)
+{
+    struct io_uring_params params;
+    unsigned int entries = URING_MIN_ENTRIES;
+    size_t sq_len, cq_len;
+    char *map;
+    apr_status_t rv;
+    int fd;
+
+    while (entries < size && entries < URING_MAX_ENTRIES) {
+        entries <<= 1;
+    }
+    if (uring_reuse(ring, entries)) {
+        goto init;
+    }
+
+    memset(&params, 0, sizeof(params));
+#if defined(IORING_SETUP_SUBMIT_ALL) && defined(IORING_SETUP_COOP_TASKRUN)
+    /* Not fatal if unknown to the kernel (before Linux 5.19) */
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        fd = syscall(__NR_io_uring_setup, entries, &params);
+    }
+#else
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+#endif
+    if (fd < 0) {
+        /* Not supported by the kernel, or disabled for this process */
+        if (errno == ENOSYS || errno == EPERM || errno == EINVAL) {
+            return APR_ENOTIMPL;
+        }
+        return errno;
+    }
+    if ((params.features & URING_FEATURES) != URING_FEATURES) {
+        close(fd);
+        return APR_ENOTIMPL;
+    }
+
+    sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_len = params.cq_off.cqes +
+             params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_len = (sq_len > cq_len) ? sq_len : cq_len;
+    ring->ring_map = mmap(NULL, ring->ring_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->ring_map == MAP_FAILED) {
+        rv = errno;
+        close(fd);
+        return rv;
+    }
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        rv = errno;
+        munmap(ring->ring_map, ring->ring_len);
+        close(fd);
+        return rv;
+    }
+
+    map = ring->ring_map;
+    ring->fd = fd;
+    ring->sq_khead = (unsigned int *)(map + params.sq_off.head);
+    ring->sq_ktail = (unsigned int *)(map + params.sq_off.tail);
+    ring->sq_array = (unsigned int *)(map + params.sq_off.array);
+    ring->sq_mask = *(unsigned int *)(map + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_tail = *ring->sq_ktail;
+    ring->cq_khead = (unsigned int *)(map + params.cq_off.head);
+    ring->cq_ktail = (unsigned int *)(map + params.cq_off.tail);
+    ring->cq_mask = *(unsigned int *)(map + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(map + params.cq_off.cqes);
+
+init:
+    ring->nelems = 64;
+    ring->elems = apr_pcalloc(p, ring->nelems * sizeof(uring_elem_t *));
+    ring->rearm = NULL;
+    ring->rearm_tail = &ring->rearm;
+    ring->free_elems = NULL;
+    ring->inflight = 0;
+    ring->modes = 0;
+    ring->pool = p;
+
+    return APR_SUCCESS;
+}
+
+static int uring_desc_fd(const apr_pollfd_t *descriptor)
+{
+    if (descriptor->desc_type == APR_POLL_SOCKET) {
+        return descriptor->desc.s->socketdes;
+    }
+    return descriptor->desc.f->filedes;
+}
+
+/* Stops watching a descriptor, its element being recycled when the
+ * cancelled request completes (or by the next uring_rearm() if it had
+ * been reported, or now if it is disabled).
+ */
+static apr_status_t uring_retire(uring_t *ring, uring_elem_t *elem)
+{
+    elem->removed = 1;
+    ring->elems[elem->fd] = NULL;
+
+    if (elem->armed) {
+        return uring_prep(ring, IORING_OP_POLL_REMOVE, -1, elem, 0, 0, 0);
+    }
+    if (!elem->queued) {
+        uring_free_elem(ring, elem);
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t uring_add(uring_t *ring, const apr_pollfd_t *descriptor,
+                              int copy)
+{
+    uring_elem_t *elem;
+    apr_status_t rv;
+    int fd = uring_desc_fd(descriptor);
+
+    if (fd < 0) {
+        return APR_EBADF;
+    }
+
+    if (fd >= ring->nelems) {
+        uring_elem_t **elems;
+        int nelems = ring->nelems * 2;
+
+        if (nelems <= fd) {
+            nelems = fd + 1;
+        }
+        elems = apr_pcalloc(ring->pool, nelems * sizeof(uring_elem_t *));
+        memcpy(elems, ring->elems, ring->nelems * sizeof(uring_elem_t *));
+        ring->elems = elems;
+        ring->nelems = nelems;
+    }
+    else if ((elem = ring->elems[fd])) {
+        if (elem->pfd.desc.s == descriptor->desc.s) {
+            return APR_EEXIST;
+        }
+        /* The previous descriptor was closed without being removed and
+         * its number reused, its request still holds the old file.
+         */
+        if ((rv = uring_retire(ring, elem)) != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    if (ring->free_elems) {
+        elem = ring->free_elems;
+        ring->free_elems = elem->next;
+    }
+    else {
+        elem = apr_palloc(ring->pool, sizeof(uring_elem_t));
+    }
+    elem->next = NULL;
+    elem->pfd = *descriptor;
+    elem->descriptor = copy ? &elem->pfd : (apr_pollfd_t *)descriptor;
+    elem->fd = fd;
+    elem->mode = descriptor->reqevents & ring->modes;
+    elem->armed = 0;
+    elem->queued = 0;
+    elem->removed = 0;
+
+    if ((rv = uring_arm(ring, elem)) != APR_SUCCESS) {
+        uring_free_elem(ring, elem);
+        return rv;
+    }
+    ring->elems[fd] = elem;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t uring_remove(uring_t *ring,
+                                 const apr_pollfd_t *descriptor)
+{
+    uring_elem_t *elem;
+    int fd = uring_desc_fd(descriptor);
+
+    if (fd < 0 || fd >= ring->nelems || !(elem = ring->elems[fd])
+        || elem->pfd.desc.s != descriptor->desc.s) {
+        return APR_NOTFOUND;
+    }
+
+    return uring_retire(ring, elem);
+}
+
+static apr_status_t uring_enable(uring_t *ring,
+                                 const apr_pollfd_t *descriptor, int copy)
+{
+    uring_elem_t *elem;
+    apr_status_t rv;
+    int fd = uring_desc_fd(descriptor);
+
+    if (fd < 0 || fd >= ring->nelems || !(elem = ring->elems[fd])
+        || elem->pfd.desc.s != descriptor->desc.s) {
+        return APR_NOTFOUND;
+    }
+
+    if (elem->armed) {
+        /* The request in flight can't be changed, replace it */
+        if ((rv = uring_retire(ring, elem)) != APR_SUCCESS) {
+            return rv;
+        }
+        return uring_add(ring, descriptor, copy);
+    }
+
+    elem->pfd = *descriptor;
+    elem->descriptor = copy ? &elem->pfd : (apr_pollfd_t *)descriptor;
+    elem->mode = descriptor->reqevents & ring->modes;
+    if (elem->queued) {
+        /* armed by the next poll */
+        return APR_SUCCESS;
+    }
+    return uring_arm(ring, elem);
+}
+
+/* Submits the queued requests (unless another thread may be queuing) and
+ * waits for a completion, up to timeout (no limit if negative, no wait if
+ * zero).
+ */
+static apr_status_t uring_wait(uring_t *ring, apr_interval_time_t timeout,
+                               int submit)
+{
+    unsigned int to_submit = submit ? uring_pending(ring) : 0;
+    unsigned int min_complete = 0;
+
+    if (timeout != 0 && !uring_cq_ready(ring)) {
+        min_complete = 1;
+    }
+    else {
+        timeout = 0;
+    }
+
+    if (uring_enter(ring, to_submit, min_complete, IORING_ENTER_GETEVENTS,
+                    timeout) < 0) {
+        if (errno == ETIME) {
+            return APR_TIMEUP;
+        }
+        return errno;
+    }
+    return APR_SUCCESS;
+}
+
+/* Handles the completion of a poll request, returning the element of the
+ * signalled descriptor (if not removed in the meantime) and its events.
+ */
+static uring_elem_t *uring_complete(uring_t *ring,
+                                    const struct io_uring_cqe *cqe,
+                                    apr_int16_t *rtnevents)
+{
+    uring_elem_t *elem = (uring_elem_t *)(apr_uintptr_t)cqe->user_data;
+    int done = uring_cqe_done(ring, cqe);
+
+    if (!elem) {
+        /* completion of a removal */
+        return NULL;
+    }
+    if (done) {
+        elem->armed = 0;
+    }
+    if (elem->removed) {
+        if (done) {
+            uring_free_elem(ring, elem);
+        }
+        return NULL;
+    }
+
+    if (cqe->res >= 0) {
+        *rtnevents = get_uring_revent(cqe->res);
+    }
+    else if (cqe->res == -EBADF) {
+        *rtnevents = APR_POLLNVAL;
+    }
+    else {
+        *rtnevents = APR_POLLERR;
+    }
+
+    if (done && !(elem->mode & APR_POLLSET_ONESHOT)) {
+        /* in order, to report the descriptors likewise */
+        elem->queued = 1;
+        elem->next = NULL;
+        *ring->rearm_tail = elem;
+        ring->rearm_tail = &elem->next;
+    }
+    return elem;
+}
+
+struct apr_pollset_private_t
+{
+    uring_t ring;
+    apr_pollfd_t *result_set;
+#if APR_HAS_THREADS
+    /* A thread mutex to protect operations on the ring */
+    apr_thread_mutex_t *ring_lock;
+#endif
+};
+
+static apr_status_t impl_pollset_cleanup(apr_pollset_t *pollset)
+{
+    return uring_cleanup(&pollset->p->ring);
+}
+
+static apr_status_t impl_pollset_create(apr_pollset_t *pollset,
+                                        apr_uint32_t size,
+                                        apr_pool_t *p,
+                                        apr_uint32_t flags)
+{
+    apr_status_t rv;
+
+#if !APR_HAS_THREADS
+    if (flags & APR_POLLSET_THREADSAFE) {
+        pollset->p = NULL;
+        return APR_ENOTIMPL;
+    }
+#endif
+
+    pollset->p = apr_palloc(p, sizeof(apr_pollset_private_t));
+    if ((rv = uring_create(&pollset->p->ring, size, p)) != APR_SUCCESS) {
+        pollset->p = NULL;
+        return rv;
+    }
+#if APR_HAS_THREADS
+    if ((flags & APR_POLLSET_THREADSAFE) &&
+        ((rv = apr_thread_mutex_create(&pollset->p->ring_lock,
+                                       APR_THREAD_MUTEX_DEFAULT,
+                                       p)) != APR_SUCCESS)) {
+        uring_cleanup(&pollset->p->ring);
+        pollset->p = NULL;
+        return rv;
+    }
+#endif
+    pollset->p->result_set = apr_palloc(p, size * sizeof(apr_pollfd_t));
+    pollset->p->ring.modes = APR_POLLSET_EDGE | APR_POLLSET_ONESHOT;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollset_add(apr_pollset_t *pollset,
+                                     const apr_pollfd_t *descriptor)
+{
+    uring_t *ring = &pollset->p->ring;
+    apr_status_t rv;
+
+    pollset_lock_rings();
+
+    rv = uring_add(ring, descriptor,
+                   !(pollset->flags & APR_POLLSET_NOCOPY));
+    if (rv == APR_SUCCESS && (pollset->flags & APR_POLLSET_THREADSAFE)) {
+        /* The poller may be blocked already */
+        rv = uring_submit(ring);
+    }
+
+    pollset_unlock_rings();
+
+    return rv;
+}
+
+static apr_status_t impl_pollset_remove(apr_pollset_t *pollset,
+                                        const apr_pollfd_t *descriptor)
+{
+    uring_t *ring = &pollset->p->ring;
+    apr_status_t rv;
+
+    pollset_lock_rings();
+
+    rv = uring_remove(ring, descriptor);
+    if (rv == APR_SUCCESS && (pollset->flags & APR_POLLSET_THREADSAFE)) {
+        rv = uring_submit(ring);
+    }
+
+    pollset_unlock_rings();
+
+    return rv;
+}
+
+static apr_status_t impl_pollset_rearm(apr_pollset_t *pollset,
+                                       const apr_pollfd_t *descriptor)
+{
+    uring_t *ring = &pollset->p->ring;
+    apr_status_t rv;
+
+    pollset_lock_rings();
+
+    rv = uring_enable(ring, descriptor,
+                      !(pollset->flags & APR_POLLSET_NOCOPY));
+    if (rv == APR_SUCCESS && (pollset->flags & APR_POLLSET_THREADSAFE)) {
+        rv = uring_submit(ring);
+    }
+
+    pollset_unlock_rings();
+
+    return rv;
+}
+
+static apr_status_t impl_pollset_io(apr_pollset_t *pollset,
+                                    apr_pollset_io_t *io,
+                                    apr_int16_t event)
+{
+    uring_t *ring = &pollset->p->ring;
+    apr_uint64_t user_data = (apr_uint64_t)(apr_uintptr_t)io | URING_TAG_IO;
+    apr_uint32_t len = (io->len > APR_UINT32_MAX) ? APR_UINT32_MAX
+                                                  : (apr_uint32_t)io->len;
+    apr_byte_t opcode = IORING_OP_RECV;
+    apr_status_t rv;
+
+    if (event == APR_POLLOUT) {
+        opcode = IORING_OP_SEND;
+        user_data |= URING_TAG_SEND;
+    }
+
+    pollset_lock_rings();
+
+    rv = uring_prep(ring, opcode, io->sock->socketdes, io->buf, len, 0,
+                    user_data);
+    if (rv == APR_SUCCESS && (pollset->flags & APR_POLLSET_THREADSAFE)) {
+        rv = uring_submit(ring);
+    }
+
+    pollset_unlock_rings();
+
+    return rv;
+}
+
+static apr_status_t impl_pollset_poll(apr_pollset_t *pollset,
+                                      apr_interval_time_t timeout,
+                                      apr_int32_t *num,
+                                      const apr_pollfd_t **descriptors)
+{
+    uring_t *ring = &pollset->p->ring;
+    apr_pollfd_t *result_set = pollset->p->result_set;
+    apr_time_t deadline = 0;
+    apr_status_t rv;
+    apr_uint32_t j = 0;
+    int woken = 0;
+
+    *num = 0;
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    pollset_lock_rings();
+
+    rv = uring_rearm(ring);
+    while (rv == APR_SUCCESS) {
+        unsigned int head, tail;
+
+        if (pollset->flags & APR_POLLSET_THREADSAFE) {
+            /* Don't block with the lock held, adders submit by themselves */
+            if ((rv = uring_submit(ring)) != APR_SUCCESS) {
+                break;
+            }
+            pollset_unlock_rings();
+            rv = uring_wait(ring, timeout, 0);
+            pollset_lock_rings();
+        }
+        else {
+            rv = uring_wait(ring, timeout, 1);
+        }
+        if (rv != APR_SUCCESS && rv != APR_TIMEUP) {
+            break;
+        }
+
+        head = *ring->cq_khead;
+        tail = __atomic_load_n(ring->cq_ktail, __ATOMIC_ACQUIRE);
+        while (head != tail && j < pollset->nalloc) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head++ & ring->cq_mask];
+            uring_elem_t *elem;
+            apr_int16_t rtnevents;
+
+            if (cqe->user_data & URING_TAG_IO) {
+                apr_pollset_io_t *io = (apr_pollset_io_t *)(apr_uintptr_t)
+                    (cqe->user_data & ~(apr_uint64_t)URING_TAG_MASK);
+                apr_pollfd_t *pfd = &result_set[j++];
+
+                uring_cqe_done(ring, cqe);
+                rtnevents = APR_POLLIO;
+                rtnevents |= (cqe->user_data & URING_TAG_SEND) ? APR_POLLOUT
+                                                              : APR_POLLIN;
+                if (cqe->res < 0) {
+                    io->status = -cqe->res;
+                    io->len = 0;
+                }
+                else {
+                    io->status = (cqe->res || (rtnevents & APR_POLLOUT)
+                                  || !io->len) ? APR_SUCCESS : APR_EOF;
+                    io->len = cqe->res;
+                }
+                pfd->p = pollset->pool;
+                pfd->desc_type = APR_POLL_SOCKET;
+                pfd->reqevents = rtnevents;
+                pfd->rtnevents = rtnevents;
+                pfd->desc.s = io->sock;
+                pfd->client_data = io;
+            }
+            else if ((elem = uring_complete(ring, cqe, &rtnevents))) {
+                /* Check if the polled descriptor is our
+                 * wakeup pipe. In that case do not put it result set.
+                 */
+                if (apr_poll_is_wakeup(&elem->pfd)) {
+                    apr_poll_drain_wakeup_pipe(pollset->wakeup_pipe);
+                    woken = 1;
+                }
+                else {
+                    result_set[j] = *elem->descriptor;
+                    result_set[j].rtnevents = rtnevents;
+                    j++;
+                }
+            }
+        }
+        __atomic_store_n(ring->cq_khead, head, __ATOMIC_RELEASE);
+
+        /* Completions of removals alone don't end the wait */
+        if (j || woken || rv == APR_TIMEUP || timeout == 0) {
+            break;
+        }
+        if (timeout > 0) {
+            apr_time_t now = apr_time_now();
+            if (now >= deadline) {
+                break;
+            }
+            timeout = deadline - now;
+        }
+    }
+
+    pollset_unlock_rings();
+
+    if (j) { /* any event besides wakeup pipe? */
+        *num = j;
+        if (descriptors) {
+            *descriptors = result_set;
+        }
+        return APR_SUCCESS;
+    }
+    if (woken) {
+        return APR_EINTR;
+    }
+    if (rv == APR_SUCCESS) {
+        rv = APR_TIMEUP;
+    }
+    return rv;
+}
+
+static const apr_pollset_provider_t impl = {
+    impl_pollset_create,
+    impl_pollset_add,
+    impl_pollset_remove,
+    impl_pollset_poll,
+    impl_pollset_cleanup,
+    "uring",
+    impl_pollset_io,
+    impl_pollset_rearm
+};
+
+const apr_pollset_provider_t *const apr_pollset_provider_uring = &impl;
+
+static apr_status_t impl_pollcb_cleanup(apr_pollcb_t *pollcb)
+{
+    return uring_cleanup(pollcb->pollset.uring);
+}
+
+static apr_status_t impl_pollcb_create(apr_pollcb_t *pollcb,
+                                       apr_uint32_t size,
+                                       apr_pool_t *p,
+                                       apr_uint32_t flags)
+{
+    uring_t *ring = apr_palloc(p, sizeof(uring_t));
+    apr_status_t rv;
+
+    if ((rv = uring_create(ring, size, p)) != APR_SUCCESS) {
+        pollcb->fd = -1;
+        return rv;
+    }
+    pollcb->fd = ring->fd;
+    pollcb->pollset.uring = ring;
+
+    return APR_SUCCESS;
+}
+
+static apr_status_t impl_pollcb_add(apr_pollcb_t *pollcb,
+                                    apr_pollfd_t *descriptor)
+{
+    return uring_add(pollcb->pollset.uring, descriptor, 0);
+}
+
+static apr_status_t impl_pollcb_remove(apr_pollcb_t *pollcb,
+                                       apr_pollfd_t *descriptor)
+{
+    return uring_remove(pollcb->pollset.uring, descriptor);
+}
+
+static apr_status_t impl_pollcb_poll(apr_pollcb_t *pollcb,
+                                     apr_interval_time_t timeout,
+                                     apr_pollcb_cb_t func,
+                                     void *baton)
+{
+    uring_t *ring = pollcb->pollset.uring;
+    apr_time_t deadline = 0;
+    apr_status_t rv;
+    int n = 0;
+
+    if (timeout > 0) {
+        deadline = apr_time_now() + timeout;
+    }
+
+    rv = uring_rearm(ring);
+    while (rv == APR_SUCCESS) {
+        unsigned int head, tail;
+
+        rv = uring_wait(ring, timeout, 1);
+        if (rv != APR_SUCCESS && rv != APR_TIMEUP) {
+            break;
+        }
+
+        head = *ring->cq_khead;
+        tail = __atomic_load_n(ring->cq_ktail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head++ & ring->cq_mask];
+            uring_elem_t *elem;
+            apr_int16_t rtnevents;
+            apr_status_t cbrv;
+
+            if (!(elem = uring_complete(ring, cqe, &rtnevents))) {
+                continue;
+            }
+            if (apr_poll_is_wakeup(&elem->pfd)) {
+                __atomic_store_n(ring->cq_khead, head, __ATOMIC_RELEASE);
+                apr_poll_drain_wakeup_pipe(pollcb->wakeup_pipe);
+                return APR_EINTR;
+            }
+
+            elem->descriptor->rtnevents = rtnevents;
+            n++;
+
+            /* The callback may add or remove descriptors, so let the
+             * completions it consumed go first.
+             */
+            __atomic_store_n(ring->cq_khead, head, __ATOMIC_RELEASE);
+            cbrv = func(baton, elem->descriptor);
+            if (cbrv) {
+                return cbrv;
+            }
+        }
+        __atomic_store_n(ring->cq_khead, head, __ATOMIC_RELEASE);
+
+        if (n || rv == APR_TIMEUP || timeout == 0) {
+            break;
+        }
+        if (timeout > 0) {
+            apr_time_t now = apr_time_now();
+            if (now >= deadline) {
+                break;
+            }
+            timeout = deadline - now;
+        }
+    }
+
+    if (n) {
+        return APR_SUCCESS;
+    }
+    if (rv == APR_SUCCESS) {
+        rv = APR_TIMEUP;
+    }
+    return rv;
+}
+
+static const apr_pollcb_provider_t impl_cb = {
+    impl_pollcb_create,
+    impl_pollcb_add,
+    impl_pollcb_remove,
+    impl_pollcb_poll,
+    impl_pollcb_cleanup,
+    "uring"
+};
+
+const apr_pollcb_provider_t *const apr_pollcb_provider_uring = &impl_cb;
+
+#endif /* HAVE_IO_URING */
@@ -23,6 +23,8 @@
 #include "apr_arch_poll_private.h"
 #include "apr_arch_inherit.h"
 
+char apr_poll_wakeup_token;
+
 #if !APR_FILES_AS_SOCKETS
 
 #ifdef WIN32
@@ -39,6 +41,7 @@ apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
     pfd->reqevents = APR_POLLIN;
     pfd->desc_type = APR_POLL_FILE;
     pfd->desc.f = wakeup_pipe[0];
+    pfd->client_data = APR_POLL_WAKEUP_DATA;
     return APR_SUCCESS;
 }
 
@@ -59,6 +62,11 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
     return rv0 ? rv0 : rv1;
 }
 
+apr_status_t apr_poll_write_wakeup_pipe(apr_file_t **wakeup_pipe)
+{
+    return apr_file_putc(1, wakeup_pipe[1]);
+}
+
 #else /* !WIN32 */
 
 apr_status_t apr_poll_create_wakeup_pipe(apr_pollfd_t *pfd, apr_file_t **wakeup_pipe)
@@ -71,6 +79,11 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
     return APR_ENOTIMPL;
 }
 
+apr_status_t apr_poll_write_wakeup_pipe(apr_file_t **wakeup_pipe)
+{
+    return APR_ENOTIMPL;
+}
+
 #endif /* !WIN32 */
 
 #else  /* APR_FILES_AS_SOCKETS */
@@ -80,6 +93,28 @@ apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
 {
     apr_status_t rv;
 
+#ifdef HAVE_EVENTFD
+    /* A single descriptor, whose counter coalesces the wakeups */
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (fd >= 0) {
+        if ((rv = apr_os_pipe_put_ex(&wakeup_pipe[0], &fd, 1,
+                                     pool)) != APR_SUCCESS) {
+            close(fd);
+            return rv;
+        }
+        wakeup_pipe[1] = NULL;
+
+        pfd->p = pool;
+        pfd->reqevents = APR_POLLIN;
+        pfd->desc_type = APR_POLL_FILE;
+        pfd->desc.f = wakeup_pipe[0];
+        pfd->client_data = APR_POLL_WAKEUP_DATA;
+        return APR_SUCCESS;
+    }
+    /* fall back to a pipe */
+#endif
+
     if ((rv = apr_file_pipe_create_ex(&wakeup_pipe[0], &wakeup_pipe[1],
                                       APR_WRITE_BLOCK,
                                       pool)) != APR_SUCCESS)
@@ -89,6 +124,7 @@ apr_status_t apr_poll_create_wakeup_pipe(apr_pool_t *pool, apr_pollfd_t *pfd,
     pfd->reqevents = APR_POLLIN;
     pfd->desc_type = APR_POLL_FILE;
     pfd->desc.f = wakeup_pipe[0];
+    pfd->client_data = APR_POLL_WAKEUP_DATA;
 
     {
         int flags;
@@ -131,6 +167,23 @@ apr_status_t apr_poll_close_wakeup_pipe(apr_file_t **wakeup_pipe)
     return rv0 ? rv0 : rv1;
 }
 
+apr_status_t apr_poll_write_wakeup_pipe(apr_file_t **wakeup_pipe)
+{
+#ifdef HAVE_EVENTFD
+    if (!wakeup_pipe[1]) {
+        apr_uint64_t one = 1;
+
+        if (write(wakeup_pipe[0]->filedes, &one, sizeof(one)) < 0
+            && errno != EAGAIN) {
+            /* EAGAIN means the counter is (about) full, hence signalled */
+            return errno;
+        }
+        return APR_SUCCESS;
+    }
+#endif
+    return apr_file_putc(1, wakeup_pipe[1]);
+}
+
 #endif /* APR_FILES_AS_SOCKETS */
 
 /* Read and discard whatever is in the wakeup pipe.
@@ -140,6 +193,16 @@ void apr_poll_drain_wakeup_pipe(apr_file_t **wakeup_pipe)
     char rb[512];
     apr_size_t nr = sizeof(rb);
 
+#ifdef HAVE_EVENTFD
+    if (!wakeup_pipe[1]) {
+        apr_uint64_t count;
+
+        /* Resets the counter, whatever the number of wakeups */
+        (void)read(wakeup_pipe[0]->filedes, &count, sizeof(count));
+        return;
+    }
+#endif
+
     while (apr_file_read(wakeup_pipe[0], rb, &nr) == APR_SUCCESS) {
         /* Although we write just one byte to the other end of the pipe
          * during wakeup, multiple threads could call the wakeup.
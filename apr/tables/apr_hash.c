@@ -40,9 +40,18 @@
  * are resolved by hanging a linked list of hash entries off each
  * element of the array. Although this is a really simple design it
  * isn't too bad given that pools have a low allocation overhead.
+ *
+ * With APR_HASH_OPEN_ADDRESSING, the entries are stored in the array
+ * itself (slots of half a cache line) and collisions are resolved by
+ * linear probing.  The slots have their key's hash and length inline, so
+ * a probe is a scan of contiguous memory which dereferences the key only
+ * when they match.  Deleted slots are marked as such rather than moving
+ * the next entries back (hence iterations are not disturbed by deletions),
+ * they are reused by insertions and purged when the table is resized.
  */
 
 typedef struct apr_hash_entry_t apr_hash_entry_t;
+typedef struct apr_hash_slot_t apr_hash_slot_t;
 
 struct apr_hash_entry_t {
     apr_hash_entry_t *next;
@@ -52,6 +61,14 @@ struct apr_hash_entry_t {
     const void       *val;
 };
 
+struct apr_hash_slot_t {
+    const void       *key;
+    apr_ssize_t       klen;
+    const void       *val;
+    unsigned int      hash;
+    unsigned int      state;    /* OA_EMPTY, OA_FULL or OA_DELETED */
+};
+
 /*
  * Data structure for iterating through a hash table.
  *
@@ -63,6 +80,7 @@ struct apr_hash_index_t {
     apr_hash_t         *ht;
     apr_hash_entry_t   *this, *next;
     unsigned int        index;
+    apr_hash_slot_t    *slot;   /* APR_HASH_OPEN_ADDRESSING */
 };
 
 /*
@@ -76,13 +94,23 @@ struct apr_hash_t {
     apr_pool_t          *pool;
     apr_hash_entry_t   **array;
     apr_hash_index_t     iterator;  /* For apr_hash_first(NULL, ...) */
-    unsigned int         count, max, seed;
+    unsigned int         count, max;
+    apr_uint64_t         seed;
     apr_hashfunc_t       hash_func;
     apr_hash_entry_t    *free;  /* List of recycled entries */
+    /* APR_HASH_OPEN_ADDRESSING */
+    apr_hash_slot_t     *slots; /* NULL if chained */
+    unsigned int         used;  /* Full and deleted slots */
 };
 
 #define INITIAL_MAX 15 /* tunable == 2^n - 1 */
 
+#define OA_EMPTY   0
+#define OA_FULL    1
+#define OA_DELETED 2
+/* Maximum load (full and deleted slots), 3/4 */
+#define OA_LOAD(max) ((max) + 1 - ((max) + 1) / 4)
+
 
 /*
  * Hash creation functions.
@@ -93,7 +121,15 @@ static apr_hash_entry_t **alloc_array(apr_hash_t *ht, unsigned int max)
    return apr_pcalloc(ht->pool, sizeof(*ht->array) * (max + 1));
 }
 
-APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
+static void oa_alloc_slots(apr_hash_t *ht, unsigned int max)
+{
+    ht->slots = apr_pcalloc(ht->pool, sizeof(*ht->slots) * (max + 1));
+    ht->used = 0;
+}
+
+APR_DECLARE(apr_hash_t *) apr_hash_make_ex(apr_pool_t *pool,
+                                           apr_hashfunc_t hash_func,
+                                           unsigned int flags)
 {
     apr_hash_t *ht;
     apr_time_t now = apr_time_now();
@@ -103,20 +139,32 @@ APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
     ht->free = NULL;
     ht->count = 0;
     ht->max = INITIAL_MAX;
-    ht->seed = (unsigned int)((now >> 32) ^ now ^ (apr_uintptr_t)pool ^
-                              (apr_uintptr_t)ht ^ (apr_uintptr_t)&now) - 1;
-    ht->array = alloc_array(ht, ht->max);
-    ht->hash_func = NULL;
+    ht->seed = ((apr_uint64_t)now ^ ((apr_uint64_t)(apr_uintptr_t)pool << 16)
+                ^ (apr_uint64_t)(apr_uintptr_t)ht
+                ^ ((apr_uint64_t)(apr_uintptr_t)&now << 32)) - 1;
+    if (flags & APR_HASH_OPEN_ADDRESSING) {
+        ht->array = NULL;
+        oa_alloc_slots(ht, ht->max);
+    }
+    else {
+        ht->array = alloc_array(ht, ht->max);
+        ht->slots = NULL;
+        ht->used = 0;
+    }
+    ht->hash_func = hash_func;
 
     return ht;
 }
 
+APR_DECLARE(apr_hash_t *) apr_hash_make(apr_pool_t *pool)
+{
+    return apr_hash_make_ex(pool, NULL, 0);
+}
+
 APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
                                                apr_hashfunc_t hash_func)
 {
-    apr_hash_t *ht = apr_hash_make(pool);
-    ht->hash_func = hash_func;
-    return ht;
+    return apr_hash_make_ex(pool, hash_func, 0);
 }
 
 
@@ -126,6 +174,16 @@ APR_DECLARE(apr_hash_t *) apr_hash_make_custom(apr_pool_t *pool,
 
 APR_DECLARE(apr_hash_index_t *) apr_hash_next(apr_hash_index_t *hi)
 {
+    if (hi->ht->slots) {
+        while (hi->index <= hi->ht->max) {
+            hi->slot = &hi->ht->slots[hi->index++];
+            if (hi->slot->state == OA_FULL) {
+                return hi;
+            }
+        }
+        return NULL;
+    }
+
     hi->this = hi->next;
     while (!hi->this) {
         if (hi->index > hi->ht->max)
@@ -149,6 +207,7 @@ APR_DECLARE(apr_hash_index_t *) apr_hash_first(apr_pool_t *p, apr_hash_t *ht)
     hi->index = 0;
     hi->this = NULL;
     hi->next = NULL;
+    hi->slot = NULL;
     return apr_hash_next(hi);
 }
 
@@ -157,11 +216,35 @@ APR_DECLARE(void) apr_hash_this(apr_hash_index_t *hi,
                                 apr_ssize_t *klen,
                                 void **val)
 {
+    if (hi->slot) {
+        if (key)  *key  = hi->slot->key;
+        if (klen) *klen = hi->slot->klen;
+        if (val)  *val  = (void *)hi->slot->val;
+        return;
+    }
     if (key)  *key  = hi->this->key;
     if (klen) *klen = hi->this->klen;
     if (val)  *val  = (void *)hi->this->val;
 }
 
+/*
+ * The current entry of the iteration, or a copy of it (in view) for
+ * open addressing.
+ */
+static apr_hash_entry_t *index_entry(apr_hash_index_t *hi,
+                                     apr_hash_entry_t *view)
+{
+    if (!hi->slot)
+        return hi->this;
+
+    view->next = NULL;
+    view->hash = hi->slot->hash;
+    view->key  = hi->slot->key;
+    view->klen = hi->slot->klen;
+    view->val  = hi->slot->val;
+    return view;
+}
+
 APR_DECLARE(const void *) apr_hash_this_key(apr_hash_index_t *hi)
 {
     const void *key;
@@ -273,6 +356,134 @@ APR_DECLARE_NONSTD(unsigned int) apr_hashfunc_default(const char *char_key,
     return hashfunc_default(char_key, klen, 0);
 }
 
+/*
+ * The hash function of the tables (unless custom), which hashes a word at
+ * a time and is keyed with the table's seed.  This is the wyhash design
+ * by Wang Yi (public domain, https://github.com/wangyi-fudan/wyhash):
+ * each 16 bytes are mixed by a 64x64->128 bits multiply, folded, and the
+ * short keys and tails are read as (possibly overlapping) words.
+ */
+
+#define HASH_SECRET0 APR_UINT64_C(0xa0761d6478bd642f)
+#define HASH_SECRET1 APR_UINT64_C(0xe7037ed1a0b428db)
+#define HASH_SECRET2 APR_UINT64_C(0x8ebc6af09c88c6e3)
+#define HASH_SECRET3 APR_UINT64_C(0x589965cc75374cc3)
+
+static APR_INLINE void hash_mum(apr_uint64_t *a, apr_uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (apr_uint64_t)r;
+    *b = (apr_uint64_t)(r >> 64);
+#else
+    apr_uint64_t ha = *a >> 32, hb = *b >> 32;
+    apr_uint64_t la = (apr_uint32_t)*a, lb = (apr_uint32_t)*b;
+    apr_uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    apr_uint64_t t = rl + (rm0 << 32), lo, c = t < rl;
+    lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static APR_INLINE apr_uint64_t hash_mix(apr_uint64_t a, apr_uint64_t b)
+{
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+static APR_INLINE apr_uint64_t hash_read8(const unsigned char *p)
+{
+    apr_uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static APR_INLINE apr_uint64_t hash_read4(const unsigned char *p)
+{
+    apr_uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static unsigned int hashfunc_seeded(const char *char_key, apr_ssize_t *klen,
+                                    apr_uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)char_key;
+    apr_size_t len, i;
+    apr_uint64_t a, b;
+
+    if (*klen == APR_HASH_KEY_STRING) {
+        *klen = strlen(char_key);
+    }
+    len = (apr_size_t)*klen;
+
+    seed ^= hash_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (hash_read4(p) << 32) | hash_read4(p + ((len >> 3) << 2));
+            b = (hash_read4(p + len - 4) << 32)
+                | hash_read4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0) {
+            a = ((apr_uint64_t)p[0] << 16) | ((apr_uint64_t)p[len >> 1] << 8)
+                | p[len - 1];
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        i = len;
+        if (i > 48) {
+            apr_uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = hash_mix(hash_read8(p) ^ HASH_SECRET1,
+                                hash_read8(p + 8) ^ seed);
+                see1 = hash_mix(hash_read8(p + 16) ^ HASH_SECRET2,
+                                hash_read8(p + 24) ^ see1);
+                see2 = hash_mix(hash_read8(p + 32) ^ HASH_SECRET3,
+                                hash_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hash_mix(hash_read8(p) ^ HASH_SECRET1,
+                            hash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = hash_read8(p + i - 16);
+        b = hash_read8(p + i - 8);
+    }
+
+    a ^= HASH_SECRET1;
+    b ^= seed;
+    hash_mum(&a, &b);
+    return (unsigned int)hash_mix(a ^ HASH_SECRET0 ^ len, b ^ HASH_SECRET1);
+}
+
+APR_DECLARE(unsigned int) apr_hashfunc_seeded(const char *key,
+                                              apr_ssize_t *klen,
+                                              apr_uint64_t seed)
+{
+    return hashfunc_seeded(key, klen, seed);
+}
+
+static APR_INLINE unsigned int hash_key(const apr_hash_t *ht, const void *key,
+                                        apr_ssize_t *klen)
+{
+    if (ht->hash_func)
+        return ht->hash_func(key, klen);
+    else
+        return hashfunc_seeded(key, klen, ht->seed);
+}
+
 /*
  * This is where we keep the details of the hash function and control
  * the maximum collision rate.
@@ -285,15 +496,10 @@ APR_DECLARE_NONSTD(unsigned int) apr_hashfunc_default(const char *char_key,
 static apr_hash_entry_t **find_entry(apr_hash_t *ht,
                                      const void *key,
                                      apr_ssize_t klen,
+                                     unsigned int hash,
                                      const void *val)
 {
     apr_hash_entry_t **hep, *he;
-    unsigned int hash;
-
-    if (ht->hash_func)
-        hash = ht->hash_func(key, &klen);
-    else
-        hash = hashfunc_default(key, &klen, ht->seed);
 
     /* scan linked list */
     for (hep = &ht->array[hash & ht->max], he = *hep;
@@ -321,6 +527,103 @@ static apr_hash_entry_t **find_entry(apr_hash_t *ht,
     return hep;
 }
 
+/*
+ * Open addressing: find the slot of the key, or return NULL.
+ */
+static apr_hash_slot_t *oa_find(apr_hash_t *ht, const void *key,
+                                apr_ssize_t klen, unsigned int hash)
+{
+    apr_hash_slot_t *slot;
+    unsigned int i;
+
+    for (i = hash & ht->max; (slot = &ht->slots[i])->state != OA_EMPTY;
+         i = (i + 1) & ht->max) {
+        if (slot->hash == hash
+            && slot->klen == klen
+            && slot->state == OA_FULL
+            && memcmp(slot->key, key, klen) == 0)
+            return slot;
+    }
+    return NULL;
+}
+
+/*
+ * Open addressing: return the first free (empty or deleted) slot for the
+ * hash.
+ */
+static apr_hash_slot_t *oa_free_slot(apr_hash_t *ht, unsigned int hash)
+{
+    unsigned int i;
+
+    for (i = hash & ht->max; ht->slots[i].state == OA_FULL;
+         i = (i + 1) & ht->max)
+        ;
+    return &ht->slots[i];
+}
+
+/*
+ * Open addressing: move the entries to new slots, doubled if the table
+ * is more than half full (otherwise just purge the deleted slots).
+ */
+static void oa_resize(apr_hash_t *ht)
+{
+    apr_hash_slot_t *old_slots = ht->slots;
+    unsigned int old_max = ht->max, i;
+
+    if (ht->count >= OA_LOAD(ht->max) / 2) {
+        ht->max = ht->max * 2 + 1;
+    }
+    oa_alloc_slots(ht, ht->max);
+    for (i = 0; i <= old_max; i++) {
+        if (old_slots[i].state == OA_FULL) {
+            *oa_free_slot(ht, old_slots[i].hash) = old_slots[i];
+        }
+    }
+    ht->used = ht->count;
+}
+
+/*
+ * Open addressing: add a new entry (the key is not in the table).
+ */
+static void oa_add(apr_hash_t *ht, const void *key, apr_ssize_t klen,
+                   unsigned int hash, const void *val)
+{
+    apr_hash_slot_t *slot;
+
+    slot = oa_free_slot(ht, hash);
+    if (slot->state == OA_EMPTY) {
+        if (ht->used + 1 > OA_LOAD(ht->max)) {
+            oa_resize(ht);
+            slot = oa_free_slot(ht, hash);
+        }
+        ht->used++;
+    }
+    slot->key   = key;
+    slot->klen  = klen;
+    slot->val   = val;
+    slot->hash  = hash;
+    slot->state = OA_FULL;
+    ht->count++;
+}
+
+/*
+ * Open addressing: remove the entry.
+ */
+static void oa_remove(apr_hash_t *ht, apr_hash_slot_t *slot)
+{
+    unsigned int i = (unsigned int)(slot - ht->slots);
+
+    /* No probing goes through the slot if the next one is empty */
+    if (ht->slots[(i + 1) & ht->max].state == OA_EMPTY) {
+        slot->state = OA_EMPTY;
+        ht->used--;
+    }
+    else {
+        slot->state = OA_DELETED;
+    }
+    ht->count--;
+}
+
 APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
                                         const apr_hash_t *orig)
 {
@@ -328,6 +631,21 @@ APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
     apr_hash_entry_t *new_vals;
     unsigned int i, j;
 
+    if (orig->slots) {
+        ht = apr_palloc(pool, sizeof(apr_hash_t));
+        ht->pool = pool;
+        ht->free = NULL;
+        ht->count = orig->count;
+        ht->max = orig->max;
+        ht->seed = orig->seed;
+        ht->hash_func = orig->hash_func;
+        ht->array = NULL;
+        ht->slots = apr_palloc(pool, sizeof(*ht->slots) * (ht->max + 1));
+        memcpy(ht->slots, orig->slots, sizeof(*ht->slots) * (ht->max + 1));
+        ht->used = orig->used;
+        return ht;
+    }
+
     ht = apr_palloc(pool, sizeof(apr_hash_t) +
                     sizeof(*ht->array) * (orig->max + 1) +
                     sizeof(apr_hash_entry_t) * orig->count);
@@ -338,6 +656,8 @@ APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
     ht->seed = orig->seed;
     ht->hash_func = orig->hash_func;
     ht->array = (apr_hash_entry_t **)((char *)ht + sizeof(apr_hash_t));
+    ht->slots = NULL;
+    ht->used = 0;
 
     new_vals = (apr_hash_entry_t *)((char *)(ht) + sizeof(apr_hash_t) +
                                     sizeof(*ht->array) * (orig->max + 1));
@@ -359,25 +679,39 @@ APR_DECLARE(apr_hash_t *) apr_hash_copy(apr_pool_t *pool,
     return ht;
 }
 
-APR_DECLARE(void *) apr_hash_get(apr_hash_t *ht,
-                                 const void *key,
-                                 apr_ssize_t klen)
+static void *hash_get(apr_hash_t *ht, const void *key, apr_ssize_t klen,
+                      unsigned int hash)
 {
     apr_hash_entry_t *he;
-    he = *find_entry(ht, key, klen, NULL);
+    if (ht->slots) {
+        apr_hash_slot_t *slot = oa_find(ht, key, klen, hash);
+        return slot ? (void *)slot->val : NULL;
+    }
+    he = *find_entry(ht, key, klen, hash, NULL);
     if (he)
         return (void *)he->val;
     else
         return NULL;
 }
 
-APR_DECLARE(void) apr_hash_set(apr_hash_t *ht,
-                               const void *key,
-                               apr_ssize_t klen,
-                               const void *val)
+static void hash_set(apr_hash_t *ht, const void *key, apr_ssize_t klen,
+                     unsigned int hash, const void *val)
 {
     apr_hash_entry_t **hep;
-    hep = find_entry(ht, key, klen, val);
+    if (ht->slots) {
+        apr_hash_slot_t *slot = oa_find(ht, key, klen, hash);
+        if (slot) {
+            if (val)
+                slot->val = val;
+            else
+                oa_remove(ht, slot);
+        }
+        else if (val) {
+            oa_add(ht, key, klen, hash, val);
+        }
+        return;
+    }
+    hep = find_entry(ht, key, klen, hash, val);
     if (*hep) {
         if (!val) {
             /* delete entry */
@@ -399,6 +733,93 @@ APR_DECLARE(void) apr_hash_set(apr_hash_t *ht,
     /* else key not present and val==NULL */
 }
 
+APR_DECLARE(void *) apr_hash_get(apr_hash_t *ht,
+                                 const void *key,
+                                 apr_ssize_t klen)
+{
+    unsigned int hash = hash_key(ht, key, &klen);
+    return hash_get(ht, key, klen, hash);
+}
+
+APR_DECLARE(void) apr_hash_set(apr_hash_t *ht,
+                               const void *key,
+                               apr_ssize_t klen,
+                               const void *val)
+{
+    unsigned int hash = hash_key(ht, key, &klen);
+    hash_set(ht, key, klen, hash, val);
+}
+
+APR_DECLARE(void) apr_hash_key_init(apr_hash_key_t *hk, const apr_hash_t *ht,
+                                    const void *key, apr_ssize_t klen)
+{
+    hk->hash = hash_key(ht, key, &klen);
+    hk->key = key;
+    hk->klen = klen;
+}
+
+APR_DECLARE(void *) apr_hash_get_prehashed(apr_hash_t *ht,
+                                           const apr_hash_key_t *hk)
+{
+    return hash_get(ht, hk->key, hk->klen, hk->hash);
+}
+
+APR_DECLARE(void) apr_hash_set_prehashed(apr_hash_t *ht,
+                                         const apr_hash_key_t *hk,
+                                         const void *val)
+{
+    hash_set(ht, hk->key, hk->klen, hk->hash, val);
+}
+
+#if defined(__GNUC__)
+#define HASH_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define HASH_PREFETCH(addr) ((void)0)
+#endif
+
+/* Keys looked up at once by apr_hash_get_many(), the prefetched lines
+ * should still be cached when probed.
+ */
+#define GET_MANY_BATCH 16
+
+APR_DECLARE(void) apr_hash_get_many(apr_hash_t *ht,
+                                    const apr_hash_key_t *hks,
+                                    void **vals, apr_size_t nelts)
+{
+    apr_size_t n, i;
+
+    while (nelts) {
+        n = nelts < GET_MANY_BATCH ? nelts : GET_MANY_BATCH;
+
+        /* Prefetch the buckets (slots), then for chaining the first
+         * entries, before probing them in turn.
+         */
+        if (ht->slots) {
+            for (i = 0; i < n; i++) {
+                HASH_PREFETCH(&ht->slots[hks[i].hash & ht->max]);
+            }
+        }
+        else {
+            for (i = 0; i < n; i++) {
+                HASH_PREFETCH(&ht->array[hks[i].hash & ht->max]);
+            }
+            for (i = 0; i < n; i++) {
+                apr_hash_entry_t *he = ht->array[hks[i].hash & ht->max];
+                if (he) {
+                    HASH_PREFETCH(he);
+                }
+            }
+        }
+        for (i = 0; i < n; i++) {
+            vals[i] = hash_get(ht, hks[i].key, hks[i].klen, hks[i].hash);
+        }
+
+        hks += n;
+        vals += n;
+        nelts -= n;
+    }
+}
+
 APR_DECLARE(unsigned int) apr_hash_count(apr_hash_t *ht)
 {
     return ht->count;
@@ -407,6 +828,11 @@ APR_DECLARE(unsigned int) apr_hash_count(apr_hash_t *ht)
 APR_DECLARE(void) apr_hash_clear(apr_hash_t *ht)
 {
     apr_hash_index_t *hi;
+    if (ht->slots) {
+        memset(ht->slots, 0, sizeof(*ht->slots) * (ht->max + 1));
+        ht->count = ht->used = 0;
+        return;
+    }
     for (hi = apr_hash_first(NULL, ht); hi; hi = apr_hash_next(hi))
         apr_hash_set(ht, hi->this->key, hi->this->klen, NULL);
 }
@@ -431,8 +857,10 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
 {
     apr_hash_t *res;
     apr_hash_entry_t *new_vals = NULL;
-    apr_hash_entry_t *iter;
+    apr_hash_entry_t *iter, view;
     apr_hash_entry_t *ent;
+    apr_hash_slot_t *slot;
+    apr_hash_index_t hix, *hi;
     unsigned int i, j, k, hash;
 
 #if APR_POOL_DEBUG
@@ -452,9 +880,38 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
     }
 #endif
 
+    /* Don't use overlay's iterator, it's const */
+    hix.ht = (apr_hash_t *)overlay;
+    hix.index = 0;
+    hix.this = NULL;
+    hix.next = NULL;
+    hix.slot = NULL;
+
+    if (base->slots) {
+        res = apr_hash_copy(p, base);
+        for (hi = apr_hash_next(&hix); hi; hi = apr_hash_next(hi)) {
+            iter = index_entry(hi, &view);
+            hash = hash_key(res, iter->key, &iter->klen);
+            slot = oa_find(res, iter->key, iter->klen, hash);
+            if (!slot) {
+                oa_add(res, iter->key, iter->klen, hash, iter->val);
+            }
+            else if (merger) {
+                slot->val = (*merger)(p, iter->key, iter->klen,
+                                      iter->val, slot->val, data);
+            }
+            else {
+                slot->val = iter->val;
+            }
+        }
+        return res;
+    }
+
     res = apr_palloc(p, sizeof(apr_hash_t));
     res->pool = p;
     res->free = NULL;
+    res->slots = NULL;
+    res->used = 0;
     res->hash_func = base->hash_func;
     res->count = base->count;
     res->max = (overlay->max > base->max) ? overlay->max : base->max;
@@ -481,36 +938,32 @@ APR_DECLARE(apr_hash_t *) apr_hash_merge(apr_pool_t *p,
         }
     }
 
-    for (k = 0; k <= overlay->max; k++) {
-        for (iter = overlay->array[k]; iter; iter = iter->next) {
-            if (res->hash_func)
-                hash = res->hash_func(iter->key, &iter->klen);
-            else
-                hash = hashfunc_default(iter->key, &iter->klen, res->seed);
-            i = hash & res->max;
-            for (ent = res->array[i]; ent; ent = ent->next) {
-                if ((ent->klen == iter->klen) &&
-                    (memcmp(ent->key, iter->key, iter->klen) == 0)) {
-                    if (merger) {
-                        ent->val = (*merger)(p, iter->key, iter->klen,
-                                             iter->val, ent->val, data);
-                    }
-                    else {
-                        ent->val = iter->val;
-                    }
-                    break;
+    for (hi = apr_hash_next(&hix); hi; hi = apr_hash_next(hi)) {
+        iter = index_entry(hi, &view);
+        hash = hash_key(res, iter->key, &iter->klen);
+        i = hash & res->max;
+        for (ent = res->array[i]; ent; ent = ent->next) {
+            if ((ent->klen == iter->klen) &&
+                (memcmp(ent->key, iter->key, iter->klen) == 0)) {
+                if (merger) {
+                    ent->val = (*merger)(p, iter->key, iter->klen,
+                                         iter->val, ent->val, data);
                 }
+                else {
+                    ent->val = iter->val;
+                }
+                break;
             }
-            if (!ent) {
-                new_vals[j].klen = iter->klen;
-                new_vals[j].key = iter->key;
-                new_vals[j].val = iter->val;
-                new_vals[j].hash = hash;
-                new_vals[j].next = res->array[i];
-                res->array[i] = &new_vals[j];
-                res->count++;
-                j++;
-            }
+        }
+        if (!ent) {
+            new_vals[j].klen = iter->klen;
+            new_vals[j].key = iter->key;
+            new_vals[j].val = iter->val;
+            new_vals[j].hash = hash;
+            new_vals[j].next = res->array[i];
+            res->array[i] = &new_vals[j];
+            res->count++;
+            j++;
         }
     }
     return res;
@@ -535,11 +988,14 @@ APR_DECLARE(int) apr_hash_do(apr_hash_do_callback_fn_t *comp,
     hix.index = 0;
     hix.this  = NULL;
     hix.next  = NULL;
+    hix.slot  = NULL;
 
     if ((hi = apr_hash_next(&hix))) {
         /* Scan the entire table */
         do {
-            rv = (*comp)(rec, hi->this->key, hi->this->klen, hi->this->val);
+            apr_hash_entry_t *he, view;
+            he = index_entry(hi, &view);
+            rv = (*comp)(rec, he->key, he->klen, he->val);
         } while (rv && (hi = apr_hash_next(hi)));
 
         if (rv == 0) {
@@ -299,6 +299,12 @@ APR_DECLARE(char *) apr_array_pstrcat(apr_pool_t *p,
 #define TABLE_INDEX_IS_INITIALIZED(t, i) ((t)->index_initialized & (1u << (i)))
 #define TABLE_SET_INDEX_INITIALIZED(t, i) ((t)->index_initialized |= (1u << (i)))
 
+/* Number of entries from which the table also maintains a real hash index
+ * of its keys (the one above only looks at the first character, so lookups
+ * in big tables whose keys share a prefix degenerate into linear scans).
+ */
+#define TABLE_HINDEX_MIN 32
+
 /* Compute the "checksum" for a key, consisting of the first
  * 4 bytes, normalized for case-insensitivity and packed into
  * an int...this checksum allows us to do a single integer
@@ -328,6 +334,17 @@ APR_DECLARE(char *) apr_array_pstrcat(apr_pool_t *p,
     checksum &= CASE_MASK;                     \
 }
 
+/* A bucket of the hash index, and the per-entry chaining data */
+typedef struct {
+    int first;
+    int last;
+} table_hbucket_t;
+
+typedef struct {
+    apr_uint32_t hash;
+    int next;
+} table_hentry_t;
+
 /** The opaque string-content table type */
 struct apr_table_t {
     /* This has to be first to promote backwards compatibility with
@@ -355,6 +372,22 @@ struct apr_table_t {
     apr_uint32_t index_initialized;
     int index_first[TABLE_HASH_SIZE];
     int index_last[TABLE_HASH_SIZE];
+    /* The hash index for big tables, which works the same way but with
+     * hindex_size buckets indexed by the full (case-insensitive) hash of
+     * the key:
+     *   - hindex[hash & (hindex_size - 1)] has the offsets of the first
+     *     and last entries in that bucket (first is -1 if it's empty)
+     *   - hentries[i] has the hash of the i'th entry's key and the offset
+     *     of the next entry in the same bucket (or -1), so each chain is
+     *     in table order and keeps the duplicate keys
+     * It's built once the table reaches TABLE_HINDEX_MIN entries, until
+     * then (or after the table shrank below that) hindex_size is zero.
+     */
+    table_hbucket_t *hindex;
+    table_hentry_t *hentries;
+    int hindex_size;
+    int hindex_alloc;
+    int hentries_alloc;
 };
 
 /* keep state for apr_table_getm() */
@@ -387,6 +420,141 @@ static apr_table_entry_t *do_table_push(const char *func, apr_table_t *t)
 #define table_push(t)	((apr_table_entry_t *) apr_array_push_noclear(&(t)->a))
 #endif /* MAKE_TABLE_PROFILE */
 
+/* FNV-1a over the key with the case bit of every character masked out,
+ * so that keys differing only by case hash the same.
+ */
+static APR_INLINE apr_uint32_t table_hindex_hash(const char *key)
+{
+    const unsigned char *k = (const unsigned char *)key;
+    apr_uint32_t hash = 0x811c9dc5;
+
+    while (*k) {
+        hash ^= *k++ & (unsigned char)CASE_MASK;
+        hash *= 0x01000193;
+    }
+    return hash ^ (hash >> 16);
+}
+
+static APR_INLINE void table_hindex_link(apr_table_t *t, int i)
+{
+    table_hbucket_t *bucket;
+
+    bucket = &t->hindex[t->hentries[i].hash & (t->hindex_size - 1)];
+    t->hentries[i].next = -1;
+    if (bucket->first < 0) {
+        bucket->first = i;
+    }
+    else {
+        t->hentries[bucket->last].next = i;
+    }
+    bucket->last = i;
+}
+
+/* Add the entries from offset start on to the hash index, building it if
+ * the table just became big enough, and growing it to keep chains short.
+ */
+static void table_hindex_update(apr_table_t *t, int start)
+{
+    const apr_table_entry_t *elts = (const apr_table_entry_t *)t->a.elts;
+    const int nelts = t->a.nelts;
+    int i;
+
+    if (!t->hindex_size) {
+        if (nelts < TABLE_HINDEX_MIN) {
+            return;
+        }
+        start = 0;
+    }
+
+    if (t->hentries_alloc < nelts) {
+        int alloc = (t->a.nalloc > nelts) ? t->a.nalloc : nelts;
+        table_hentry_t *hentries = apr_palloc(t->a.pool,
+                                              alloc * sizeof(table_hentry_t));
+        if (start) {
+            memcpy(hentries, t->hentries, start * sizeof(table_hentry_t));
+        }
+        t->hentries = hentries;
+        t->hentries_alloc = alloc;
+    }
+    for (i = start; i < nelts; i++) {
+        t->hentries[i].hash = table_hindex_hash(elts[i].key);
+    }
+
+    if (nelts > t->hindex_size) {
+        int size = t->hindex_size ? t->hindex_size : TABLE_HINDEX_MIN;
+
+        while (size < nelts) {
+            size <<= 1;
+        }
+        if (size > t->hindex_alloc) {
+            t->hindex = apr_palloc(t->a.pool, size * sizeof(table_hbucket_t));
+            t->hindex_alloc = size;
+        }
+        for (i = 0; i < size; i++) {
+            t->hindex[i].first = -1;
+        }
+        t->hindex_size = size;
+        start = 0;
+    }
+    for (i = start; i < nelts; i++) {
+        table_hindex_link(t, i);
+    }
+}
+
+/* Index the entry just pushed, when the table is (or becomes) big */
+#define TABLE_HINDEX_PUSHED(t) do { \
+    if ((t)->hindex_size || (t)->a.nelts >= TABLE_HINDEX_MIN) { \
+        table_hindex_update((t), (t)->a.nelts - 1); \
+    } \
+} while (0)
+
+/* Walk the chain from offset i, up to the first entry matching key */
+static APR_INLINE int table_hindex_match(const apr_table_t *t, int i,
+                                         const char *key, apr_uint32_t hash,
+                                         apr_uint32_t checksum)
+{
+    const apr_table_entry_t *elts = (const apr_table_entry_t *)t->a.elts;
+
+    for (; i >= 0; i = t->hentries[i].next) {
+        if ((hash == t->hentries[i].hash) &&
+            (checksum == elts[i].key_checksum) &&
+            !strcasecmp(elts[i].key, key)) {
+            break;
+        }
+    }
+    return i;
+}
+
+/* Offset of the first entry matching key, or -1 */
+static int table_hindex_first(const apr_table_t *t, const char *key,
+                              apr_uint32_t checksum)
+{
+    apr_uint32_t hash = table_hindex_hash(key);
+
+    return table_hindex_match(t,
+                              t->hindex[hash & (t->hindex_size - 1)].first,
+                              key, hash, checksum);
+}
+
+/* Offset of the next entry after the i'th one (which matches key) matching
+ * key, or -1
+ */
+static int table_hindex_next(const apr_table_t *t, int i, const char *key,
+                             apr_uint32_t checksum)
+{
+    return table_hindex_match(t, t->hentries[i].next, key,
+                              t->hentries[i].hash, checksum);
+}
+
+static void table_hindex_init(apr_table_t *t)
+{
+    t->hindex = NULL;
+    t->hentries = NULL;
+    t->hindex_size = 0;
+    t->hindex_alloc = 0;
+    t->hentries_alloc = 0;
+}
+
 APR_DECLARE(const apr_array_header_t *) apr_table_elts(const apr_table_t *t)
 {
     return (const apr_array_header_t *)t;
@@ -406,6 +574,7 @@ APR_DECLARE(apr_table_t *) apr_table_make(apr_pool_t *p, int nelts)
     t->creator = __builtin_return_address(0);
 #endif
     t->index_initialized = 0;
+    table_hindex_init(t);
     return t;
 }
 
@@ -428,6 +597,16 @@ APR_DECLARE(apr_table_t *) apr_table_copy(apr_pool_t *p, const apr_table_t *t)
     memcpy(new->index_first, t->index_first, sizeof(int) * TABLE_HASH_SIZE);
     memcpy(new->index_last, t->index_last, sizeof(int) * TABLE_HASH_SIZE);
     new->index_initialized = t->index_initialized;
+    table_hindex_init(new);
+    if (t->hindex_size) {
+        new->hindex = apr_pmemdup(p, t->hindex,
+                                  t->hindex_size * sizeof(table_hbucket_t));
+        new->hindex_size = new->hindex_alloc = t->hindex_size;
+        new->hentries = apr_palloc(p, new->a.nalloc * sizeof(table_hentry_t));
+        memcpy(new->hentries, t->hentries,
+               t->a.nelts * sizeof(table_hentry_t));
+        new->hentries_alloc = new->a.nalloc;
+    }
     return new;
 }
 
@@ -460,12 +639,41 @@ static void table_reindex(apr_table_t *t)
             TABLE_SET_INDEX_INITIALIZED(t, hash);
         }
     }
+
+    t->hindex_size = 0;
+    table_hindex_update(t, 0);
+}
+
+/* Remove the entries matching key from the i'th one (which matches) on,
+ * for tables with a hash index.
+ */
+static void table_hindex_remove(apr_table_t *t, int i, const char *key,
+                                apr_uint32_t checksum)
+{
+    apr_table_entry_t *elts = (apr_table_entry_t *)t->a.elts;
+    int next_match = i;
+    int dst = i;
+
+    /* The chain still refers to the original offsets, which is fine since
+     * only the entries before the current one get overwritten.
+     */
+    for (; i < t->a.nelts; i++) {
+        if (i == next_match) {
+            next_match = table_hindex_next(t, i, key, checksum);
+        }
+        else {
+            elts[dst++] = elts[i];
+        }
+    }
+    t->a.nelts = dst;
+    table_reindex(t);
 }
 
 APR_DECLARE(void) apr_table_clear(apr_table_t *t)
 {
     t->a.nelts = 0;
     t->index_initialized = 0;
+    t->hindex_size = 0;
 }
 
 APR_DECLARE(const char *) apr_table_get(const apr_table_t *t, const char *key)
@@ -484,6 +692,10 @@ APR_DECLARE(const char *) apr_table_get(const apr_table_t *t, const char *key)
         return NULL;
     }
     COMPUTE_KEY_CHECKSUM(key, checksum);
+    if (t->hindex_size) {
+        int i = table_hindex_first(t, key, checksum);
+        return (i < 0) ? NULL : ((apr_table_entry_t *) t->a.elts)[i].val;
+    }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
 
@@ -513,6 +725,18 @@ APR_DECLARE(void) apr_table_set(apr_table_t *t, const char *key,
         TABLE_SET_INDEX_INITIALIZED(t, hash);
         goto add_new_elt;
     }
+    if (t->hindex_size) {
+        int i = table_hindex_first(t, key, checksum);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        ((apr_table_entry_t *) t->a.elts)[i].val = apr_pstrdup(t->a.pool, val);
+        i = table_hindex_next(t, i, key, checksum);
+        if (i >= 0) {
+            table_hindex_remove(t, i, key, checksum);
+        }
+        return;
+    }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
     table_end =((apr_table_entry_t *) t->a.elts) + t->a.nelts;
@@ -567,6 +791,7 @@ add_new_elt:
     next_elt->key = apr_pstrdup(t->a.pool, key);
     next_elt->val = apr_pstrdup(t->a.pool, val);
     next_elt->key_checksum = checksum;
+    TABLE_HINDEX_PUSHED(t);
 }
 
 APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
@@ -585,6 +810,18 @@ APR_DECLARE(void) apr_table_setn(apr_table_t *t, const char *key,
         TABLE_SET_INDEX_INITIALIZED(t, hash);
         goto add_new_elt;
     }
+    if (t->hindex_size) {
+        int i = table_hindex_first(t, key, checksum);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        ((apr_table_entry_t *) t->a.elts)[i].val = (char *)val;
+        i = table_hindex_next(t, i, key, checksum);
+        if (i >= 0) {
+            table_hindex_remove(t, i, key, checksum);
+        }
+        return;
+    }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
     table_end =((apr_table_entry_t *) t->a.elts) + t->a.nelts;
@@ -639,6 +876,7 @@ add_new_elt:
     next_elt->key = (char *)key;
     next_elt->val = (char *)val;
     next_elt->key_checksum = checksum;
+    TABLE_HINDEX_PUSHED(t);
 }
 
 APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
@@ -655,6 +893,13 @@ APR_DECLARE(void) apr_table_unset(apr_table_t *t, const char *key)
         return;
     }
     COMPUTE_KEY_CHECKSUM(key, checksum);
+    if (t->hindex_size) {
+        int i = table_hindex_first(t, key, checksum);
+        if (i >= 0) {
+            table_hindex_remove(t, i, key, checksum);
+        }
+        return;
+    }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
     must_reindex = 0;
@@ -710,6 +955,16 @@ APR_DECLARE(void) apr_table_merge(apr_table_t *t, const char *key,
         TABLE_SET_INDEX_INITIALIZED(t, hash);
         goto add_new_elt;
     }
+    if (t->hindex_size) {
+        int i = table_hindex_first(t, key, checksum);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        next_elt = ((apr_table_entry_t *) t->a.elts) + i;
+        next_elt->val = apr_pstrcat(t->a.pool, next_elt->val, ", ",
+                                    val, NULL);
+        return;
+    }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
 
@@ -730,6 +985,7 @@ add_new_elt:
     next_elt->key = apr_pstrdup(t->a.pool, key);
     next_elt->val = apr_pstrdup(t->a.pool, val);
     next_elt->key_checksum = checksum;
+    TABLE_HINDEX_PUSHED(t);
 }
 
 APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
@@ -765,6 +1021,16 @@ APR_DECLARE(void) apr_table_mergen(apr_table_t *t, const char *key,
         TABLE_SET_INDEX_INITIALIZED(t, hash);
         goto add_new_elt;
     }
+    if (t->hindex_size) {
+        int i = table_hindex_first(t, key, checksum);
+        if (i < 0) {
+            goto add_new_elt;
+        }
+        next_elt = ((apr_table_entry_t *) t->a.elts) + i;
+        next_elt->val = apr_pstrcat(t->a.pool, next_elt->val, ", ",
+                                    val, NULL);
+        return;
+    }
     next_elt = ((apr_table_entry_t *) t->a.elts) + t->index_first[hash];;
     end_elt = ((apr_table_entry_t *) t->a.elts) + t->index_last[hash];
 
@@ -785,6 +1051,7 @@ add_new_elt:
     next_elt->key = (char *)key;
     next_elt->val = (char *)val;
     next_elt->key_checksum = checksum;
+    TABLE_HINDEX_PUSHED(t);
 }
 
 APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
@@ -805,6 +1072,7 @@ APR_DECLARE(void) apr_table_add(apr_table_t *t, const char *key,
     elts->key = apr_pstrdup(t->a.pool, key);
     elts->val = apr_pstrdup(t->a.pool, val);
     elts->key_checksum = checksum;
+    TABLE_HINDEX_PUSHED(t);
 }
 
 APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
@@ -838,6 +1106,7 @@ APR_DECLARE(void) apr_table_addn(apr_table_t *t, const char *key,
     elts->key = (char *)key;
     elts->val = (char *)val;
     elts->key_checksum = checksum;
+    TABLE_HINDEX_PUSHED(t);
 }
 
 APR_DECLARE(apr_table_t *) apr_table_overlay(apr_pool_t *p,
@@ -868,6 +1137,7 @@ APR_DECLARE(apr_table_t *) apr_table_overlay(apr_pool_t *p,
     res->a.pool = p;
     copy_array_hdr_core(&res->a, &overlay->a);
     apr_array_cat(&res->a, &base->a);
+    table_hindex_init(res);
     table_reindex(res);
     return res;
 }
@@ -974,13 +1244,23 @@ APR_DECLARE(int) apr_table_vdo(apr_table_do_callback_fn_t *comp,
             if (TABLE_INDEX_IS_INITIALIZED(t, hash)) {
                 apr_uint32_t checksum;
                 COMPUTE_KEY_CHECKSUM(argp, checksum);
-                for (i = t->index_first[hash];
-                     rv && (i <= t->index_last[hash]); ++i) {
-                    if (elts[i].key && (checksum == elts[i].key_checksum) &&
-                                        !strcasecmp(elts[i].key, argp)) {
+                if (t->hindex_size) {
+                    for (i = table_hindex_first(t, argp, checksum);
+                         rv && (i >= 0);
+                         i = table_hindex_next(t, i, argp, checksum)) {
                         rv = (*comp) (rec, elts[i].key, elts[i].val);
                     }
                 }
+                else {
+                    for (i = t->index_first[hash];
+                         rv && (i <= t->index_last[hash]); ++i) {
+                        if (elts[i].key &&
+                            (checksum == elts[i].key_checksum) &&
+                            !strcasecmp(elts[i].key, argp)) {
+                            rv = (*comp) (rec, elts[i].key, elts[i].val);
+                        }
+                    }
+                }
             }
         }
         else {
@@ -1215,19 +1495,21 @@ static void apr_table_cat(apr_table_t *t, const apr_table_t *s)
         memcpy(t->index_first,s->index_first,sizeof(int) * TABLE_HASH_SIZE);
         memcpy(t->index_last, s->index_last, sizeof(int) * TABLE_HASH_SIZE);
         t->index_initialized = s->index_initialized;
-        return;
     }
-
-    for (idx = 0; idx < TABLE_HASH_SIZE; ++idx) {
-        if (TABLE_INDEX_IS_INITIALIZED(s, idx)) {
-            t->index_last[idx] = s->index_last[idx] + n;
-            if (!TABLE_INDEX_IS_INITIALIZED(t, idx)) {
-                t->index_first[idx] = s->index_first[idx] + n;
+    else {
+        for (idx = 0; idx < TABLE_HASH_SIZE; ++idx) {
+            if (TABLE_INDEX_IS_INITIALIZED(s, idx)) {
+                t->index_last[idx] = s->index_last[idx] + n;
+                if (!TABLE_INDEX_IS_INITIALIZED(t, idx)) {
+                    t->index_first[idx] = s->index_first[idx] + n;
+                }
             }
         }
+
+        t->index_initialized |= s->index_initialized;
     }
 
-    t->index_initialized |= s->index_initialized;
+    table_hindex_update(t, n);
 }
 
 APR_DECLARE(void) apr_table_overlap(apr_table_t *a, const apr_table_t *b,
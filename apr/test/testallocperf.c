@@ -0,0 +1,203 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_thread_proc.h"
+#include "apr_thread_mutex.h"
+#include "apr_allocator.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !APR_HAS_THREADS
+int main(void)
+{
+    printf("This program won't work on this platform because there is no "
+           "support for threads.\n");
+    return 0;
+}
+#else /* !APR_HAS_THREADS */
+
+/* Contention benchmark for the allocator shared by several threads, each
+ * one clearing its own pool repeatedly (which takes and gives back the
+ * nodes through apr_allocator_alloc() and apr_allocator_free()), with
+ * and without per-thread magazines.
+ */
+
+#define DEFAULT_MAX_COUNTER 100000
+#define MAX_THREADS 64
+#define MAGAZINE_DEPTH 16
+
+static int verbose = 0;
+static long max_counter = DEFAULT_MAX_COUNTER;
+
+static apr_pool_t *pool;
+static apr_thread_mutex_t *start_lock;
+
+static void * APR_THREAD_FUNC thread_pool_func(apr_thread_t *thd, void *data)
+{
+    apr_pool_t *p = data;
+    long i;
+
+    apr_thread_mutex_lock(start_lock);
+    apr_thread_mutex_unlock(start_lock);
+
+    for (i = 0; i < max_counter; i++) {
+        /* Two or three nodes per round, of the common (8K and 12K) sizes */
+        apr_palloc(p, 6000);
+        apr_palloc(p, 6000);
+        if (i & 1) {
+            apr_palloc(p, 10000);
+        }
+        apr_pool_clear(p);
+    }
+
+    return NULL;
+}
+
+static apr_status_t test_allocator(int num_threads, apr_size_t depth,
+                                   apr_time_t *elapsed)
+{
+    apr_thread_t *t[MAX_THREADS];
+    apr_pool_t *p[MAX_THREADS];
+    apr_status_t rv, s;
+    apr_allocator_t *allocator;
+    apr_thread_mutex_t *mutex;
+    apr_pool_t *subpool;
+    apr_time_t time_start;
+    int i;
+
+    if ((rv = apr_pool_create(&subpool, pool)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_allocator_create(&allocator)) != APR_SUCCESS) {
+        return rv;
+    }
+    if ((rv = apr_thread_mutex_create(&mutex, APR_THREAD_MUTEX_DEFAULT,
+                                      subpool)) != APR_SUCCESS) {
+        return rv;
+    }
+    apr_allocator_mutex_set(allocator, mutex);
+    if ((rv = apr_allocator_magazine_set(allocator, depth)) != APR_SUCCESS) {
+        return rv;
+    }
+
+    for (i = 0; i < num_threads; ++i) {
+        rv = apr_pool_create_unmanaged_ex(&p[i], NULL, allocator);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    apr_thread_mutex_lock(start_lock);
+    for (i = 0; i < num_threads; ++i) {
+        rv = apr_thread_create(&t[i], NULL, thread_pool_func, p[i], subpool);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+
+    time_start = apr_time_now();
+    apr_thread_mutex_unlock(start_lock);
+
+    for (i = 0; i < num_threads; ++i) {
+        apr_thread_join(&s, t[i]);
+    }
+    *elapsed = apr_time_now() - time_start;
+
+    for (i = 0; i < num_threads; ++i) {
+        apr_pool_destroy(p[i]);
+    }
+    apr_allocator_destroy(allocator);
+    apr_pool_destroy(subpool);
+
+    return APR_SUCCESS;
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    apr_time_t shared, magazines;
+    int i;
+
+    printf("APR Allocator Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "c:v", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'c') {
+            max_counter = atol(optarg);
+        }
+        else if (optchar == 'v') {
+            verbose = 1;
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    if ((rv = apr_thread_mutex_create(&start_lock, APR_THREAD_MUTEX_DEFAULT,
+                                      pool)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not create mutex: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    printf("%ld pool clears per thread, microseconds in total\n\n",
+           max_counter);
+    printf("%8s %16s %16s %8s\n", "threads", "shared", "magazines",
+           "speedup");
+
+    for (i = 1; i <= MAX_THREADS; i *= 2) {
+        if ((rv = test_allocator(i, 0, &shared)) != APR_SUCCESS) {
+            fprintf(stderr, "allocator test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-3);
+        }
+        if ((rv = test_allocator(i, MAGAZINE_DEPTH,
+                                 &magazines)) != APR_SUCCESS) {
+            fprintf(stderr, "allocator (magazines) test failed : [%d] %s\n",
+                    rv, apr_strerror(rv, errmsg, sizeof errmsg));
+            exit(-4);
+        }
+        printf("%8d %16" APR_INT64_T_FMT " %16" APR_INT64_T_FMT " %7.2fx\n",
+               i, shared, magazines,
+               magazines ? (double)shared / (double)magazines : 0.0);
+    }
+
+    return 0;
+}
+
+#endif /* !APR_HAS_THREADS */
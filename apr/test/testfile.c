@@ -620,6 +620,129 @@ static void test_gets_ungetc(abts_case *tc, void *data)
     apr_file_close(f);
 }
 
+#define SPAN_LINES "first line\n" "\n" "a line much longer than the buffer\n" \
+                   "last"
+
+static void test_gets_small_buffer(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testgets_small_buffer.dat";
+    char filebuf[8];
+    char buf[16];
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_WRITE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file", rv);
+    rv = apr_file_puts(SPAN_LINES, f);
+    APR_ASSERT_SUCCESS(tc, "write test data", rv);
+    apr_file_close(f);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_READ | APR_FOPEN_BUFFERED,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "re-open test file", rv);
+    /* Lines spanning several refills of the file's buffer */
+    rv = apr_file_buffer_set(f, filebuf, sizeof(filebuf));
+    APR_ASSERT_SUCCESS(tc, "set file buffer", rv);
+
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read first line", rv);
+    ABTS_STR_EQUAL(tc, "first line\n", buf);
+
+    rv = apr_file_ungetc('x', f);
+    APR_ASSERT_SUCCESS(tc, "call ungetc", rv);
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read empty line", rv);
+    ABTS_STR_EQUAL(tc, "x\n", buf);
+
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read start of long line", rv);
+    ABTS_STR_EQUAL(tc, "a line much lon", buf);
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read middle of long line", rv);
+    ABTS_STR_EQUAL(tc, "ger than the bu", buf);
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read end of long line", rv);
+    ABTS_STR_EQUAL(tc, "ffer\n", buf);
+
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    APR_ASSERT_SUCCESS(tc, "read last line", rv);
+    ABTS_STR_EQUAL(tc, "last", buf);
+    rv = apr_file_gets(buf, sizeof(buf), f);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_STR_EQUAL(tc, "", buf);
+    apr_file_close(f);
+}
+
+static void test_getline_span(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testgetline_span.dat";
+    char filebuf[16];
+    const char *line;
+    apr_size_t len;
+    char ch;
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_WRITE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file", rv);
+    rv = apr_file_puts(SPAN_LINES, f);
+    APR_ASSERT_SUCCESS(tc, "write test data", rv);
+
+    /* Not buffered */
+    rv = apr_file_getline_span(f, &line, &len);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_file_getline_span");
+        apr_file_close(f);
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    apr_file_close(f);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_READ | APR_FOPEN_BUFFERED,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "re-open test file", rv);
+    rv = apr_file_buffer_set(f, filebuf, sizeof(filebuf));
+    APR_ASSERT_SUCCESS(tc, "set file buffer", rv);
+
+    rv = apr_file_getline_span(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read first line", rv);
+    ABTS_STR_EQUAL(tc, "first line\n", apr_pstrmemdup(p, line, len));
+
+    rv = apr_file_getline_span(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read empty line", rv);
+    ABTS_STR_EQUAL(tc, "\n", apr_pstrmemdup(p, line, len));
+
+    /* In pieces of the buffer's size, after an ungetc */
+    rv = apr_file_getc(&ch, f);
+    APR_ASSERT_SUCCESS(tc, "getc", rv);
+    ABTS_INT_EQUAL(tc, 'a', ch);
+    rv = apr_file_ungetc('A', f);
+    APR_ASSERT_SUCCESS(tc, "call ungetc", rv);
+    rv = apr_file_getline_span(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read start of long line", rv);
+    ABTS_STR_EQUAL(tc, "A line much long", apr_pstrmemdup(p, line, len));
+    rv = apr_file_getline_span(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read middle of long line", rv);
+    ABTS_STR_EQUAL(tc, "er than the buff", apr_pstrmemdup(p, line, len));
+    rv = apr_file_getline_span(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read end of long line", rv);
+    ABTS_STR_EQUAL(tc, "er\n", apr_pstrmemdup(p, line, len));
+
+    rv = apr_file_getline_span(f, &line, &len);
+    APR_ASSERT_SUCCESS(tc, "read last line", rv);
+    ABTS_STR_EQUAL(tc, "last", apr_pstrmemdup(p, line, len));
+    rv = apr_file_getline_span(f, &line, &len);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+    apr_file_close(f);
+}
+
 static void test_gets_buffered_big(abts_case *tc, void *data)
 {
     apr_status_t rv;
@@ -2227,6 +2350,229 @@ static void test_append_buffered(abts_case *tc, void *data)
     apr_file_remove(fname, p);
 }
 
+static void test_pread_pwrite(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testpread_pwrite.dat";
+    apr_size_t nbytes;
+    apr_off_t off;
+    char buf[64];
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_READ
+                       | APR_FOPEN_WRITE, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file", rv);
+
+    nbytes = 6;
+    rv = apr_file_pwrite(f, "ghijkl", &nbytes, 6);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_file_pwrite");
+        apr_file_close(f);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "pwrite past the start", rv);
+    ABTS_SIZE_EQUAL(tc, 6, nbytes);
+    nbytes = 6;
+    rv = apr_file_pwrite(f, "abcdef", &nbytes, 0);
+    APR_ASSERT_SUCCESS(tc, "pwrite at the start", rv);
+
+    /* The file position has not moved */
+    off = 0;
+    rv = apr_file_seek(f, APR_CUR, &off);
+    APR_ASSERT_SUCCESS(tc, "get file position", rv);
+    ABTS_INT_EQUAL(tc, 0, (int)off);
+
+    memset(buf, 0, sizeof(buf));
+    nbytes = 4;
+    rv = apr_file_pread(f, buf, &nbytes, 4);
+    APR_ASSERT_SUCCESS(tc, "pread in the middle", rv);
+    ABTS_SIZE_EQUAL(tc, 4, nbytes);
+    ABTS_STR_EQUAL(tc, "efgh", buf);
+
+    memset(buf, 0, sizeof(buf));
+    nbytes = sizeof(buf);
+    rv = apr_file_pread(f, buf, &nbytes, 10);
+    APR_ASSERT_SUCCESS(tc, "pread up to the end", rv);
+    ABTS_SIZE_EQUAL(tc, 2, nbytes);
+    ABTS_STR_EQUAL(tc, "kl", buf);
+
+    nbytes = sizeof(buf);
+    rv = apr_file_pread(f, buf, &nbytes, 12);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, nbytes);
+
+    /* Sequential reads still start from the beginning */
+    memset(buf, 0, sizeof(buf));
+    rv = apr_file_read_full(f, buf, 3, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "read from file", rv);
+    ABTS_STR_EQUAL(tc, "abc", buf);
+
+    apr_file_close(f);
+    apr_file_remove(fname, p);
+}
+
+static void test_preadv_pwritev(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testpreadv_pwritev.dat";
+    apr_size_t nbytes;
+    struct iovec vec[3];
+    char buf1[5], buf2[64];
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_READ
+                       | APR_FOPEN_WRITE, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file", rv);
+
+    vec[0].iov_base = LINE1;
+    vec[0].iov_len = strlen(LINE1);
+    vec[1].iov_base = LINE2;
+    vec[1].iov_len = strlen(LINE2);
+    rv = apr_file_pwritev(f, vec, 2, 3, &nbytes);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_file_pwritev");
+        apr_file_close(f);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "pwritev at an offset", rv);
+    if (nbytes == strlen(LINE1)) {
+        /* Only the first iovec where pwritev() is not available */
+        nbytes = strlen(LINE2);
+        rv = apr_file_pwrite(f, LINE2, &nbytes, 3 + strlen(LINE1));
+        APR_ASSERT_SUCCESS(tc, "pwrite the second iovec", rv);
+        nbytes += strlen(LINE1);
+    }
+    ABTS_SIZE_EQUAL(tc, strlen(LINE1 LINE2), nbytes);
+    nbytes = 3;
+    rv = apr_file_pwrite(f, "123", &nbytes, 0);
+    APR_ASSERT_SUCCESS(tc, "pwrite at the start", rv);
+
+    memset(buf2, 0, sizeof(buf2));
+    vec[0].iov_base = buf1;
+    vec[0].iov_len = sizeof(buf1);
+    vec[1].iov_base = buf2;
+    vec[1].iov_len = sizeof(buf2) - 1;
+    rv = apr_file_preadv(f, vec, 2, 1, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "preadv at an offset", rv);
+    ABTS_ASSERT(tc, "nothing read", nbytes > 0);
+    ABTS_TRUE(tc, memcmp(buf1, "23thi", sizeof(buf1)) == 0);
+    if (nbytes > sizeof(buf1)) {
+        /* Filled both buffers where preadv() is available */
+        ABTS_SIZE_EQUAL(tc, 2 + strlen(LINE1 LINE2), nbytes);
+        ABTS_STR_EQUAL(tc, LINE1 LINE2 + 3, buf2);
+    }
+
+    apr_file_close(f);
+    file_contents_equal(tc, fname, "123" LINE1 LINE2,
+                        3 + strlen(LINE1 LINE2));
+    apr_file_remove(fname, p);
+}
+
+static void test_pread_buffered(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testpread_buffered.dat";
+    apr_size_t nbytes;
+    char buf[64];
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_WRITE,
+                       APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file for writing", rv);
+    rv = apr_file_write_full(f, "abcdef", 6, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "write to file", rv);
+    apr_file_close(f);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_READ | APR_FOPEN_WRITE
+                       | APR_FOPEN_BUFFERED, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file buffered", rv);
+
+    /* Fill the read buffer */
+    memset(buf, 0, sizeof(buf));
+    rv = apr_file_read_full(f, buf, 2, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "read from file", rv);
+    ABTS_STR_EQUAL(tc, "ab", buf);
+
+    memset(buf, 0, sizeof(buf));
+    nbytes = 3;
+    rv = apr_file_pread(f, buf, &nbytes, 0);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "apr_file_pread");
+        apr_file_close(f);
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "pread from buffered file", rv);
+    ABTS_SIZE_EQUAL(tc, 3, nbytes);
+    ABTS_STR_EQUAL(tc, "abc", buf);
+
+    /* The buffered reads go on from where they were */
+    memset(buf, 0, sizeof(buf));
+    rv = apr_file_read_full(f, buf, 2, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "read from file", rv);
+    ABTS_STR_EQUAL(tc, "cd", buf);
+
+    /* Write past the buffered data, then into a flushed write buffer */
+    nbytes = 2;
+    rv = apr_file_pwrite(f, "gh", &nbytes, 6);
+    APR_ASSERT_SUCCESS(tc, "pwrite to buffered file", rv);
+    rv = apr_file_write_full(f, "EF", 2, &nbytes);
+    APR_ASSERT_SUCCESS(tc, "write to buffered file", rv);
+    rv = apr_file_flush(f);
+    APR_ASSERT_SUCCESS(tc, "flush buffered file", rv);
+
+    memset(buf, 0, sizeof(buf));
+    nbytes = sizeof(buf);
+    rv = apr_file_pread(f, buf, &nbytes, 3);
+    APR_ASSERT_SUCCESS(tc, "pread from buffered file", rv);
+    ABTS_STR_EQUAL(tc, "dEFgh", buf);
+
+    apr_file_close(f);
+    apr_file_remove(fname, p);
+}
+
+static void test_advise_allocate(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    const char *fname = "data/testadvise_allocate.dat";
+    apr_finfo_t finfo;
+    int advice;
+
+    apr_file_remove(fname, p);
+
+    rv = apr_file_open(&f, fname, APR_FOPEN_CREATE | APR_FOPEN_READ
+                       | APR_FOPEN_WRITE, APR_FPROT_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "open test file", rv);
+
+    /* Space reserved past the end does not make the file grow */
+    rv = apr_file_allocate(f, 0, 65536);
+    APR_ASSERT_SUCCESS(tc, "allocate space", rv);
+    rv = apr_file_info_get(&finfo, APR_FINFO_SIZE, f);
+    APR_ASSERT_SUCCESS(tc, "get file size", rv);
+    ABTS_INT_EQUAL(tc, 0, (int)finfo.size);
+
+    rv = apr_file_puts(LINE1, f);
+    APR_ASSERT_SUCCESS(tc, "write to file", rv);
+
+    for (advice = APR_FADVISE_NORMAL; advice <= APR_FADVISE_NOREUSE;
+         advice++) {
+        rv = apr_file_advise(f, 0, 0, advice);
+        APR_ASSERT_SUCCESS(tc, "advise", rv);
+    }
+    rv = apr_file_advise(f, 0, 0, APR_FADVISE_NOREUSE + 1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    apr_file_close(f);
+    file_contents_equal(tc, fname, LINE1, strlen(LINE1));
+    apr_file_remove(fname, p);
+}
+
 abts_suite *testfile(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -2257,6 +2603,8 @@ abts_suite *testfile(abts_suite *suite)
     abts_run_test(suite, test_gets_multiline, NULL);
     abts_run_test(suite, test_gets_small_buf, NULL);
     abts_run_test(suite, test_gets_ungetc, NULL);
+    abts_run_test(suite, test_gets_small_buffer, NULL);
+    abts_run_test(suite, test_getline_span, NULL);
     abts_run_test(suite, test_gets_buffered_big, NULL);
     abts_run_test(suite, test_puts, NULL);
     abts_run_test(suite, test_writev, NULL);
@@ -2292,6 +2640,10 @@ abts_suite *testfile(abts_suite *suite)
     abts_run_test(suite, test_single_byte_reads_buffered, NULL);
     abts_run_test(suite, test_read_buffered_seek, NULL);
     abts_run_test(suite, test_append_buffered, NULL);
+    abts_run_test(suite, test_pread_pwrite, NULL);
+    abts_run_test(suite, test_preadv_pwritev, NULL);
+    abts_run_test(suite, test_pread_buffered, NULL);
+    abts_run_test(suite, test_advise_allocate, NULL);
 
     return suite;
 }
@@ -19,6 +19,9 @@
 #include "apr_file_info.h"
 #include "apr_errno.h"
 #include "apr_pools.h"
+#include "apr_strings.h"
+
+#define SPLICE_LEN 200000
 
 static void copy_helper(abts_case *tc, const char *from, const char * to,
                         apr_fileperms_t perms, int append, apr_pool_t *p)
@@ -123,6 +126,172 @@ static void append_exist(abts_case *tc, void *data)
     APR_ASSERT_SUCCESS(tc, "Couldn't remove copy file", rv);
 }
 
+static void compare_contents(abts_case *tc, const char *path,
+                             const char *expected, apr_size_t len)
+{
+    apr_status_t rv;
+    char *contents;
+    apr_file_t *f;
+    apr_size_t nbytes = len + 1;
+
+    contents = apr_palloc(p, nbytes);
+    rv = apr_file_open(&f, path, APR_FOPEN_READ, APR_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't open copy file", rv);
+    rv = apr_file_read_full(f, contents, nbytes, &nbytes);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, len, nbytes);
+    ABTS_ASSERT(tc, "Contents differ", memcmp(contents, expected, len) == 0);
+    apr_file_close(f);
+}
+
+static char *write_large_file(abts_case *tc, const char *path)
+{
+    apr_status_t rv;
+    apr_file_t *f;
+    char *data;
+    apr_size_t i;
+
+    data = apr_palloc(p, SPLICE_LEN);
+    for (i = 0; i < SPLICE_LEN; i++) {
+        data[i] = (char)('a' + i % 26 + i / 4096 % 3);
+    }
+    rv = apr_file_open(&f, path, APR_FOPEN_WRITE | APR_FOPEN_CREATE
+                       | APR_FOPEN_TRUNCATE, APR_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create source file", rv);
+    rv = apr_file_write_full(f, data, SPLICE_LEN, NULL);
+    APR_ASSERT_SUCCESS(tc, "Couldn't write source file", rv);
+    apr_file_close(f);
+
+    return data;
+}
+
+static void copy_large_file(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    char *contents, *twice;
+
+    contents = write_large_file(tc, "data/file_copy_src.txt");
+    apr_file_remove("data/file_copy.txt", p);
+
+    rv = apr_file_copy("data/file_copy_src.txt", "data/file_copy.txt",
+                       APR_FILE_SOURCE_PERMS, p);
+    APR_ASSERT_SUCCESS(tc, "Error copying file", rv);
+    compare_contents(tc, "data/file_copy.txt", contents, SPLICE_LEN);
+
+    rv = apr_file_append("data/file_copy_src.txt", "data/file_copy.txt",
+                         APR_FILE_SOURCE_PERMS, p);
+    APR_ASSERT_SUCCESS(tc, "Error appending file", rv);
+    twice = apr_pstrcat(p, apr_pstrmemdup(p, contents, SPLICE_LEN),
+                        apr_pstrmemdup(p, contents, SPLICE_LEN), NULL);
+    compare_contents(tc, "data/file_copy.txt", twice, 2 * SPLICE_LEN);
+
+    apr_file_remove("data/file_copy.txt", p);
+    apr_file_remove("data/file_copy_src.txt", p);
+}
+
+/* Moves the whole of in to out, one apr_file_splice() at a time */
+static void splice_all(abts_case *tc, apr_file_t *out, apr_file_t *in,
+                       apr_size_t total)
+{
+    apr_status_t rv;
+    apr_size_t done = 0, len;
+
+    while (done < total) {
+        len = total - done;
+        rv = apr_file_splice(out, in, &len);
+        APR_ASSERT_SUCCESS(tc, "Error splicing", rv);
+        if (rv != APR_SUCCESS) {
+            return;
+        }
+        ABTS_ASSERT(tc, "Nothing spliced", len > 0);
+        done += len;
+    }
+}
+
+static void splice_through_pipe(abts_case *tc, apr_int32_t in_flags)
+{
+    apr_status_t rv;
+    apr_file_t *in, *out, *rpipe, *wpipe;
+    apr_size_t len, chunk;
+    char *contents;
+
+    contents = write_large_file(tc, "data/file_copy_src.txt");
+
+    rv = apr_file_open(&in, "data/file_copy_src.txt",
+                       APR_FOPEN_READ | in_flags, APR_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't open source file", rv);
+    rv = apr_file_open(&out, "data/file_copy.txt", APR_FOPEN_WRITE
+                       | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE,
+                       APR_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create copy file", rv);
+    rv = apr_file_pipe_create(&rpipe, &wpipe, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create pipe", rv);
+
+    /* file -> pipe -> file, in chunks that fit in the pipe */
+    for (len = 0; len < SPLICE_LEN; len += chunk) {
+        chunk = SPLICE_LEN - len > 16384 ? 16384 : SPLICE_LEN - len;
+        splice_all(tc, wpipe, in, chunk);
+        splice_all(tc, out, rpipe, chunk);
+    }
+
+    len = 1;
+    rv = apr_file_splice(wpipe, in, &len);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+
+    apr_file_close(in);
+    apr_file_close(out);
+    apr_file_close(rpipe);
+    apr_file_close(wpipe);
+
+    compare_contents(tc, "data/file_copy.txt", contents, SPLICE_LEN);
+    apr_file_remove("data/file_copy.txt", p);
+    apr_file_remove("data/file_copy_src.txt", p);
+}
+
+static void splice_file_pipe(abts_case *tc, void *data)
+{
+    splice_through_pipe(tc, 0);
+}
+
+/* No pipe on either side, so this goes through sendfile() on Linux */
+static void splice_file_file(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_file_t *in, *out;
+    apr_size_t len;
+    char *contents;
+
+    contents = write_large_file(tc, "data/file_copy_src.txt");
+
+    rv = apr_file_open(&in, "data/file_copy_src.txt", APR_FOPEN_READ,
+                       APR_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't open source file", rv);
+    rv = apr_file_open(&out, "data/file_copy.txt", APR_FOPEN_WRITE
+                       | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE,
+                       APR_OS_DEFAULT, p);
+    APR_ASSERT_SUCCESS(tc, "Couldn't create copy file", rv);
+
+    splice_all(tc, out, in, SPLICE_LEN);
+
+    len = 1;
+    rv = apr_file_splice(out, in, &len);
+    ABTS_INT_EQUAL(tc, APR_EOF, rv);
+    ABTS_SIZE_EQUAL(tc, 0, len);
+
+    apr_file_close(in);
+    apr_file_close(out);
+
+    compare_contents(tc, "data/file_copy.txt", contents, SPLICE_LEN);
+    apr_file_remove("data/file_copy.txt", p);
+    apr_file_remove("data/file_copy_src.txt", p);
+}
+
+static void splice_buffered(abts_case *tc, void *data)
+{
+    splice_through_pipe(tc, APR_FOPEN_BUFFERED);
+}
+
 abts_suite *testfilecopy(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -133,6 +302,11 @@ abts_suite *testfilecopy(abts_suite *suite)
     abts_run_test(suite, append_nonexist, NULL);
     abts_run_test(suite, append_exist, NULL);
 
+    abts_run_test(suite, copy_large_file, NULL);
+    abts_run_test(suite, splice_file_pipe, NULL);
+    abts_run_test(suite, splice_file_file, NULL);
+    abts_run_test(suite, splice_buffered, NULL);
+
     return suite;
 }
 
@@ -21,6 +21,8 @@
 #include "apr_pools.h"
 #include "apr_hash.h"
 
+#include <stdlib.h>
+
 #define MAX_LTH 256
 #define MAX_DEPTH 11
 
@@ -511,6 +513,305 @@ static void overlay_fetch(abts_case *tc, void *data)
                        apr_hash_get(overlay, "overlay5", APR_HASH_KEY_STRING));
 }
 
+#define OA_KEYS 10000
+
+static unsigned int hash_collide(const char *key, apr_ssize_t *klen)
+{
+    if (*klen == APR_HASH_KEY_STRING)
+        *klen = strlen(key);
+    return 42;
+}
+
+static int count_entries(void *rec, const void *key, apr_ssize_t klen,
+                         const void *value)
+{
+    ++*(int *)rec;
+    return 1;
+}
+
+static void *merge_values(apr_pool_t *p, const void *key, apr_ssize_t klen,
+                          const void *h1_val, const void *h2_val,
+                          const void *data)
+{
+    return apr_psprintf(p, "%s+%s", (const char *)h2_val,
+                        (const char *)h1_val);
+}
+
+static void hash_open_addressing(abts_case *tc, void *data)
+{
+    apr_hash_t *h, *copy, *other, *res;
+    apr_hash_index_t *hi;
+    char **keys = apr_palloc(p, OA_KEYS * sizeof(char *));
+    int i, n;
+
+    h = apr_hash_make_ex(p, NULL, APR_HASH_OPEN_ADDRESSING);
+    ABTS_PTR_NOTNULL(tc, h);
+
+    for (i = 0; i < OA_KEYS; i++) {
+        keys[i] = apr_psprintf(p, "key%d", i);
+        apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+    }
+    ABTS_INT_EQUAL(tc, OA_KEYS, apr_hash_count(h));
+    for (i = 0; i < OA_KEYS; i++) {
+        ABTS_PTR_EQUAL(tc, keys[i], apr_hash_get(h, keys[i],
+                                                 APR_HASH_KEY_STRING));
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_get(h, "nokey", APR_HASH_KEY_STRING));
+
+    /* delete the odd ones while iterating */
+    n = 0;
+    for (hi = apr_hash_first(p, h); hi; hi = apr_hash_next(hi)) {
+        const char *key = apr_hash_this_key(hi);
+        n++;
+        if (atoi(key + 3) & 1) {
+            apr_hash_set(h, key, APR_HASH_KEY_STRING, NULL);
+        }
+    }
+    ABTS_INT_EQUAL(tc, OA_KEYS, n);
+    ABTS_INT_EQUAL(tc, OA_KEYS / 2, apr_hash_count(h));
+    for (i = 0; i < OA_KEYS; i++) {
+        ABTS_PTR_EQUAL(tc, (i & 1) ? NULL : keys[i],
+                       apr_hash_get(h, keys[i], APR_HASH_KEY_STRING));
+    }
+
+    /* churn on the deleted slots */
+    for (n = 0; n < 10; n++) {
+        for (i = 1; i < OA_KEYS; i += 2) {
+            apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+        }
+        for (i = 1; i < OA_KEYS; i += 2) {
+            apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, NULL);
+        }
+    }
+    ABTS_INT_EQUAL(tc, OA_KEYS / 2, apr_hash_count(h));
+    n = 0;
+    apr_hash_do(count_entries, &n, h);
+    ABTS_INT_EQUAL(tc, OA_KEYS / 2, n);
+
+    /* copy, overlay and merge, with a chained table too */
+    copy = apr_hash_copy(p, h);
+    apr_hash_set(copy, "key0", APR_HASH_KEY_STRING, "copy");
+    ABTS_STR_EQUAL(tc, "key0", apr_hash_get(h, "key0", APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "copy", apr_hash_get(copy, "key0",
+                                            APR_HASH_KEY_STRING));
+    ABTS_INT_EQUAL(tc, OA_KEYS / 2, apr_hash_count(copy));
+
+    other = apr_hash_make(p);
+    apr_hash_set(other, "key0", APR_HASH_KEY_STRING, "other");
+    apr_hash_set(other, "key1", APR_HASH_KEY_STRING, "other");
+    res = apr_hash_merge(p, other, h, merge_values, NULL);
+    ABTS_INT_EQUAL(tc, OA_KEYS / 2 + 1, apr_hash_count(res));
+    ABTS_STR_EQUAL(tc, "key0+other", apr_hash_get(res, "key0",
+                                                  APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "other", apr_hash_get(res, "key1",
+                                             APR_HASH_KEY_STRING));
+    res = apr_hash_overlay(p, h, other);
+    ABTS_INT_EQUAL(tc, OA_KEYS / 2 + 1, apr_hash_count(res));
+    ABTS_STR_EQUAL(tc, "key0", apr_hash_get(res, "key0",
+                                            APR_HASH_KEY_STRING));
+    ABTS_STR_EQUAL(tc, "key2", apr_hash_get(res, "key2",
+                                            APR_HASH_KEY_STRING));
+
+    apr_hash_clear(h);
+    ABTS_INT_EQUAL(tc, 0, apr_hash_count(h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_first(p, h));
+    ABTS_PTR_EQUAL(tc, NULL, apr_hash_get(h, "key0", APR_HASH_KEY_STRING));
+
+    /* all the keys in the same probing sequence */
+    h = apr_hash_make_ex(p, hash_collide, APR_HASH_OPEN_ADDRESSING);
+    for (i = 0; i < 100; i++) {
+        apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, keys[i]);
+    }
+    for (i = 0; i < 100; i += 3) {
+        apr_hash_set(h, keys[i], APR_HASH_KEY_STRING, NULL);
+    }
+    for (i = 0; i < 100; i++) {
+        ABTS_PTR_EQUAL(tc, (i % 3) ? keys[i] : NULL,
+                       apr_hash_get(h, keys[i], APR_HASH_KEY_STRING));
+    }
+    ABTS_INT_EQUAL(tc, 66, apr_hash_count(h));
+}
+
+static void hash_prehashed(abts_case *tc, void *data)
+{
+    apr_hash_key_t hks[40], hk;
+    void *vals[40];
+    apr_hash_t *h, *copy;
+    int i, layout;
+
+    for (layout = 0; layout < 2; layout++) {
+        h = apr_hash_make_ex(p, NULL, layout ? APR_HASH_OPEN_ADDRESSING : 0);
+
+        for (i = 0; i < 40; i++) {
+            apr_hash_key_init(&hks[i], h, apr_psprintf(p, "key%d", i),
+                              APR_HASH_KEY_STRING);
+            ABTS_INT_EQUAL(tc, strlen(hks[i].key), (int)hks[i].klen);
+            if (i < 30) {
+                apr_hash_set_prehashed(h, &hks[i], hks[i].key);
+            }
+        }
+        ABTS_INT_EQUAL(tc, 30, apr_hash_count(h));
+
+        /* interchangeable with the non prehashed calls */
+        ABTS_STR_EQUAL(tc, "key7", apr_hash_get(h, "key7",
+                                                APR_HASH_KEY_STRING));
+        apr_hash_set(h, "key8", 4, "eight");
+        ABTS_STR_EQUAL(tc, "eight", apr_hash_get_prehashed(h, &hks[8]));
+        ABTS_PTR_EQUAL(tc, NULL, apr_hash_get_prehashed(h, &hks[35]));
+
+        /* more than a batch */
+        apr_hash_get_many(h, hks, vals, 40);
+        for (i = 0; i < 40; i++) {
+            if (i == 8) {
+                ABTS_STR_EQUAL(tc, "eight", vals[i]);
+            }
+            else {
+                ABTS_PTR_EQUAL(tc, i < 30 ? hks[i].key : NULL, vals[i]);
+            }
+        }
+
+        /* valid for a copy */
+        copy = apr_hash_copy(p, h);
+        ABTS_STR_EQUAL(tc, "key9", apr_hash_get_prehashed(copy, &hks[9]));
+
+        apr_hash_set_prehashed(h, &hks[9], NULL);
+        ABTS_PTR_EQUAL(tc, NULL, apr_hash_get(h, "key9", 4));
+        ABTS_INT_EQUAL(tc, 29, apr_hash_count(h));
+    }
+
+    /* custom hash function */
+    h = apr_hash_make_custom(p, apr_hashfunc_default);
+    apr_hash_key_init(&hk, h, "custom", APR_HASH_KEY_STRING);
+    ABTS_INT_EQUAL(tc, 6, (int)hk.klen);
+    ABTS_INT_EQUAL(tc, apr_hashfunc_default("custom", &hk.klen), hk.hash);
+    apr_hash_set(h, "custom", 6, "value");
+    ABTS_STR_EQUAL(tc, "value", apr_hash_get_prehashed(h, &hk));
+}
+
+#define DIST_BITS 16
+#define DIST_KEYS (1 << DIST_BITS)
+
+/* Check that the hashes of the keys spread like random ones would over
+ * as many buckets: about 1/e of them empty, and no long chain.
+ */
+static void check_distribution(abts_case *tc, const char *what,
+                               const unsigned int *hashes)
+{
+    unsigned char *load = calloc(DIST_KEYS, 1);
+    int i, empty = 0, max = 0;
+
+    for (i = 0; i < DIST_KEYS; i++) {
+        unsigned char *l = &load[hashes[i] & (DIST_KEYS - 1)];
+        if (++*l > max) {
+            max = *l;
+        }
+    }
+    for (i = 0; i < DIST_KEYS; i++) {
+        if (!load[i]) {
+            empty++;
+        }
+    }
+    free(load);
+
+    /* 36.8% +/- 1.5% (more than 5 sigmas), and max ~8 */
+    if (empty < DIST_KEYS * 353 / 1000 || empty > DIST_KEYS * 383 / 1000
+            || max > 16) {
+        char msg[128];
+        apr_snprintf(msg, sizeof msg, "%s: %d empty buckets of %d, "
+                     "max chain %d", what, empty, DIST_KEYS, max);
+        ABTS_FAIL(tc, msg);
+    }
+}
+
+static void hash_seeded_distribution(abts_case *tc, void *data)
+{
+    unsigned int *hashes = calloc(DIST_KEYS, sizeof(*hashes));
+    apr_uint64_t seed = APR_UINT64_C(0x0123456789abcdef);
+    char key[300];
+    apr_ssize_t klen;
+    apr_uint32_t n;
+    int i;
+
+    /* short decimal strings */
+    for (i = 0; i < DIST_KEYS; i++) {
+        klen = APR_HASH_KEY_STRING;
+        apr_snprintf(key, sizeof key, "key%d", i);
+        hashes[i] = apr_hashfunc_seeded(key, &klen, seed);
+    }
+    check_distribution(tc, "decimal", hashes);
+
+    /* sequential binary words */
+    for (i = 0; i < DIST_KEYS; i++) {
+        klen = sizeof(n);
+        n = (apr_uint32_t)i;
+        hashes[i] = apr_hashfunc_seeded((const char *)&n, &klen, seed);
+    }
+    check_distribution(tc, "binary", hashes);
+
+    /* long keys with a common prefix, and ending with the counter
+     * (or having it in the middle)
+     */
+    memset(key, 'x', sizeof key);
+    for (i = 0; i < DIST_KEYS; i++) {
+        klen = 256;
+        memcpy(key + 252, &i, 4);
+        hashes[i] = apr_hashfunc_seeded(key, &klen, seed);
+    }
+    check_distribution(tc, "suffix", hashes);
+    memset(key, 'x', sizeof key);
+    for (i = 0; i < DIST_KEYS; i++) {
+        klen = 100;
+        memcpy(key + 49, &i, 4);
+        hashes[i] = apr_hashfunc_seeded(key, &klen, seed);
+    }
+    check_distribution(tc, "infix", hashes);
+
+    /* same key, different seeds */
+    for (i = 0; i < DIST_KEYS; i++) {
+        klen = APR_HASH_KEY_STRING;
+        hashes[i] = apr_hashfunc_seeded("http://www.example.com/", &klen,
+                                        seed + i);
+    }
+    check_distribution(tc, "seeds", hashes);
+
+    free(hashes);
+}
+
+static void hash_seeded_avalanche(abts_case *tc, void *data)
+{
+    apr_uint64_t seed = APR_UINT64_C(0xfedcba9876543210);
+    unsigned char key[64];
+    apr_ssize_t klen;
+    unsigned int h0, h;
+    int bit, flipped = 0, total = 0;
+
+    memset(key, 0, sizeof key);
+    for (klen = 1; klen <= (apr_ssize_t)sizeof key; klen++) {
+        apr_ssize_t len = klen;
+        h0 = apr_hashfunc_seeded((const char *)key, &len, seed);
+        for (bit = 0; bit < klen * 8; bit++) {
+            key[bit / 8] ^= 1 << (bit % 8);
+            h = apr_hashfunc_seeded((const char *)key, &len, seed);
+            key[bit / 8] ^= 1 << (bit % 8);
+            ABTS_ASSERT(tc, "single bit flip collides", h != h0);
+            for (h ^= h0; h; h &= h - 1) {
+                flipped++;
+            }
+            total += 32;
+        }
+    }
+    /* half of the output bits should flip */
+    ABTS_ASSERT(tc, "bad avalanche", flipped > total * 48 / 100
+                                     && flipped < total * 52 / 100);
+
+    /* APR_HASH_KEY_STRING hashes the string length */
+    klen = APR_HASH_KEY_STRING;
+    h0 = apr_hashfunc_seeded("hello world", &klen, seed);
+    ABTS_INT_EQUAL(tc, 11, (int)klen);
+    h = apr_hashfunc_seeded("hello world", &klen, seed);
+    ABTS_INT_EQUAL(tc, h0, h);
+}
+
 abts_suite *testhash(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -536,6 +837,12 @@ abts_suite *testhash(abts_suite *suite)
     abts_run_test(suite, overlay_same, NULL);
     abts_run_test(suite, overlay_fetch, NULL);
 
+    abts_run_test(suite, hash_open_addressing, NULL);
+    abts_run_test(suite, hash_prehashed, NULL);
+
+    abts_run_test(suite, hash_seeded_distribution, NULL);
+    abts_run_test(suite, hash_seeded_avalanche, NULL);
+
     return suite;
 }
 
@@ -0,0 +1,284 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_hash.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_strings.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Hashing and lookup benchmark for the hash functions, the (seeded)
+ * default one of the hash tables and apr_hashfunc_default() ("times 33"),
+ * for key lengths from 4 to 4096 bytes.  Then lookups in big tables,
+ * chained and APR_HASH_OPEN_ADDRESSING, by key, prehashed key or batches
+ * of prehashed keys.
+ */
+
+#define DEFAULT_MAX_COUNTER 1000000
+#define MIN_KLEN 4
+#define MAX_KLEN 4096
+#define NUM_KEYS 64
+#define MAX_ENTRIES 1000000
+
+static long max_counter = DEFAULT_MAX_COUNTER;
+
+static volatile unsigned int sink;
+
+static unsigned int hash_seeded(const char *key, apr_ssize_t *klen)
+{
+    return apr_hashfunc_seeded(key, klen, 0);
+}
+
+/* Nanoseconds per hash of each key in turn */
+static double time_hash(apr_hashfunc_t func, char **keys,
+                        apr_ssize_t klen, long count)
+{
+    apr_time_t start = apr_time_now();
+    unsigned int h = 0;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        apr_ssize_t len = klen;
+        h += func(keys[i % NUM_KEYS], &len);
+    }
+    sink = h;
+
+    return (double)(apr_time_now() - start) * 1000.0 / (double)count;
+}
+
+/* Nanoseconds per apr_hash_get() of each key in turn */
+static double time_lookup(apr_hash_t *ht, char **keys, apr_ssize_t klen,
+                          long count)
+{
+    apr_time_t start = apr_time_now();
+    unsigned int h = 0;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        h += apr_hash_get(ht, keys[i % NUM_KEYS], klen) != NULL;
+    }
+    sink = h;
+
+    return (double)(apr_time_now() - start) * 1000.0 / (double)count;
+}
+
+/* Nanoseconds per apr_hash_get() of the keys in a random order */
+static double time_big_lookup(apr_hash_t *ht, char **keys, int nkeys,
+                              const int *order, long count)
+{
+    apr_time_t start = apr_time_now();
+    unsigned int h = 0;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        h += apr_hash_get(ht, keys[order[i % nkeys]],
+                          APR_HASH_KEY_STRING) != NULL;
+    }
+    sink = h;
+
+    return (double)(apr_time_now() - start) * 1000.0 / (double)count;
+}
+
+/* Nanoseconds per apr_hash_get_prehashed() of the keys in a random order */
+static double time_prehashed(apr_hash_t *ht, apr_hash_key_t *hks, int nkeys,
+                             const int *order, long count)
+{
+    apr_time_t start = apr_time_now();
+    unsigned int h = 0;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        h += apr_hash_get_prehashed(ht, &hks[order[i % nkeys]]) != NULL;
+    }
+    sink = h;
+
+    return (double)(apr_time_now() - start) * 1000.0 / (double)count;
+}
+
+/* Nanoseconds per key of apr_hash_get_many() for batches of BATCH keys
+ * (in a random order)
+ */
+#define BATCH 16
+static double time_many(apr_hash_t *ht, apr_hash_key_t *hks, int nkeys,
+                        const int *order, long count)
+{
+    apr_hash_key_t batch[BATCH];
+    void *vals[BATCH];
+    apr_time_t start;
+    unsigned int h = 0;
+    long i;
+    int j;
+
+    start = apr_time_now();
+    for (i = 0; i < count; i += BATCH) {
+        for (j = 0; j < BATCH; j++) {
+            batch[j] = hks[order[(i + j) % nkeys]];
+        }
+        apr_hash_get_many(ht, batch, vals, BATCH);
+        h += vals[0] != NULL;
+    }
+    sink = h;
+
+    return (double)(apr_time_now() - start) * 1000.0 / (double)count;
+}
+
+static void test_big_tables(apr_pool_t *pool)
+{
+    int nkeys;
+
+    printf("\n%ld lookups (random order) per table size, nanoseconds per "
+           "lookup\n\n", max_counter);
+    printf("%8s %10s %12s %12s %12s\n", "entries", "layout", "get",
+           "prehashed", "get_many");
+
+    for (nkeys = 1000; nkeys <= MAX_ENTRIES; nkeys *= 10) {
+        apr_pool_t *subpool;
+        apr_hash_t *chained, *open;
+        apr_hash_key_t *hks_chained, *hks_open;
+        char **keys;
+        int *order;
+        int i;
+
+        apr_pool_create(&subpool, pool);
+        chained = apr_hash_make(subpool);
+        open = apr_hash_make_ex(subpool, NULL, APR_HASH_OPEN_ADDRESSING);
+        keys = apr_palloc(subpool, nkeys * sizeof(*keys));
+        hks_chained = apr_palloc(subpool, nkeys * sizeof(*hks_chained));
+        hks_open = apr_palloc(subpool, nkeys * sizeof(*hks_open));
+        order = apr_palloc(subpool, nkeys * sizeof(*order));
+        /* the keys first (e.g. from a configuration), then the tables */
+        for (i = 0; i < nkeys; i++) {
+            keys[i] = apr_psprintf(subpool, "/route/%08d", i);
+        }
+        for (i = 0; i < nkeys; i++) {
+            apr_hash_set(chained, keys[i], APR_HASH_KEY_STRING, keys[i]);
+            apr_hash_set(open, keys[i], APR_HASH_KEY_STRING, keys[i]);
+            apr_hash_key_init(&hks_chained[i], chained, keys[i],
+                              APR_HASH_KEY_STRING);
+            apr_hash_key_init(&hks_open[i], open, keys[i],
+                              APR_HASH_KEY_STRING);
+            order[i] = i;
+        }
+        srand(nkeys);
+        for (i = nkeys - 1; i > 0; i--) {
+            int j = rand() % (i + 1), t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+
+        printf("%8d %10s %12.1f %12.1f %12.1f\n", nkeys, "chained",
+               time_big_lookup(chained, keys, nkeys, order, max_counter),
+               time_prehashed(chained, hks_chained, nkeys, order,
+                              max_counter),
+               time_many(chained, hks_chained, nkeys, order, max_counter));
+        printf("%8s %10s %12.1f %12.1f %12.1f\n", "", "open",
+               time_big_lookup(open, keys, nkeys, order, max_counter),
+               time_prehashed(open, hks_open, nkeys, order, max_counter),
+               time_many(open, hks_open, nkeys, order, max_counter));
+
+        apr_pool_destroy(subpool);
+    }
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_pool_t *pool;
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    char *keys[NUM_KEYS];
+    apr_ssize_t klen;
+    int i;
+
+    printf("APR Hash Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "c:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'c') {
+            max_counter = atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    printf("%ld operations per key length, nanoseconds per operation\n\n",
+           max_counter);
+    printf("%6s %12s %12s %8s %12s %12s %8s\n", "klen",
+           "hash times33", "hash seeded", "speedup",
+           "get times33", "get seeded", "speedup");
+
+    for (klen = MIN_KLEN; klen <= MAX_KLEN; klen *= 2) {
+        apr_pool_t *subpool;
+        apr_hash_t *seeded, *times33;
+        double t33, tsd, g33, gsd;
+        long count = max_counter;
+
+        /* keep the long ones reasonable */
+        if (klen > 64) {
+            count = max_counter / (klen / 64);
+        }
+
+        apr_pool_create(&subpool, pool);
+        seeded = apr_hash_make(subpool);
+        times33 = apr_hash_make_custom(subpool, apr_hashfunc_default);
+        for (i = 0; i < NUM_KEYS; i++) {
+            /* URL like, differing at the end */
+            keys[i] = apr_palloc(subpool, klen + 1);
+            memset(keys[i], 'a' + i % 26, klen);
+            apr_snprintf(keys[i], klen + 1, "/%d", i);
+            keys[i][strlen(keys[i])] = '/';
+            keys[i][klen - 1] = (char)('0' + i % 10);
+            keys[i][klen] = '\0';
+            apr_hash_set(seeded, keys[i], klen, keys[i]);
+            apr_hash_set(times33, keys[i], klen, keys[i]);
+        }
+
+        t33 = time_hash(apr_hashfunc_default, keys, klen, count);
+        tsd = time_hash(hash_seeded, keys, klen, count);
+        g33 = time_lookup(times33, keys, klen, count);
+        gsd = time_lookup(seeded, keys, klen, count);
+        printf("%6" APR_SSIZE_T_FMT " %12.1f %12.1f %7.2fx %12.1f %12.1f "
+               "%7.2fx\n", klen, t33, tsd, tsd > 0 ? t33 / tsd : 0.0,
+               g33, gsd, gsd > 0 ? g33 / gsd : 0.0);
+
+        apr_pool_destroy(subpool);
+    }
+
+    test_big_tables(pool);
+
+    return 0;
+}
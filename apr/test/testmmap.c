@@ -140,6 +140,45 @@ static void test_mmap_offset(abts_case *tc, void *data)
     /* Must use nEquals since the string is not guaranteed to be NULL terminated */
     ABTS_STR_NEQUAL(tc, addr, test_string + 5, thisfsize-5);
 }
+
+static void test_mmap_advise(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+
+    ABTS_PTR_NOTNULL(tc, themmap);
+    rv = apr_mmap_advise(themmap, 0, 0, APR_FADVISE_SEQUENTIAL);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_mmap_advise(themmap, 5, thisfsize - 5, APR_FADVISE_WILLNEED);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_mmap_advise(themmap, 0, 0, APR_FADVISE_DONTNEED);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* The data is read again if dropped */
+    ABTS_STR_NEQUAL(tc, themmap->mm, test_string, thisfsize);
+
+    rv = apr_mmap_advise(themmap, 5, thisfsize, APR_FADVISE_NORMAL);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+    rv = apr_mmap_advise(themmap, 0, 0, -1);
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+}
+
+static void test_mmap_populate(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_mmap_t *mm = NULL;
+
+    rv = apr_mmap_create(&mm, thefile, 0, (apr_size_t) thisfinfo.size,
+                         APR_MMAP_READ | APR_MMAP_POPULATE, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_PTR_NOTNULL(tc, mm);
+    if (rv != APR_SUCCESS) {
+        return;
+    }
+    ABTS_STR_NEQUAL(tc, mm->mm, test_string, thisfsize);
+
+    rv = apr_mmap_delete(mm);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
 #endif
 
 abts_suite *testmmap(abts_suite *suite)
@@ -154,7 +193,9 @@ abts_suite *testmmap(abts_suite *suite)
     abts_run_test(suite, test_mmap_create, NULL);
     abts_run_test(suite, test_mmap_contents, NULL);
     abts_run_test(suite, test_mmap_offset, NULL);
+    abts_run_test(suite, test_mmap_advise, NULL);
     abts_run_test(suite, test_mmap_delete, NULL);
+    abts_run_test(suite, test_mmap_populate, NULL);
     abts_run_test(suite, test_file_close, NULL);
 #else
     abts_run_test(suite, not_implemented, NULL);
@@ -24,6 +24,9 @@
 
 #if defined(__linux__)
 #include "arch/unix/apr_private.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #endif
 #ifndef HAVE_EPOLL_WAIT_RELIABLE_TIMEOUT
 #define HAVE_EPOLL_WAIT_RELIABLE_TIMEOUT 0
@@ -813,6 +816,16 @@ static void pollset_wakeup(abts_case *tc, void *data)
         ABTS_INT_EQUAL(tc, APR_EINTR, rv);
     }
 
+    /* Several wakeups are consumed by a single apr_pollset_poll() */
+    for (i = 0; i < 3; ++i) {
+        rv = apr_pollset_wakeup(pollset);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+    rv = apr_pollset_poll(pollset, -1, &num, &descriptors);
+    ABTS_INT_EQUAL(tc, APR_EINTR, rv);
+    rv = apr_pollset_poll(pollset, 0, &num, &descriptors);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
     /* send wakeup and data; apr_pollset_poll() should return APR_SUCCESS */
     socket_pollfd.desc_type = APR_POLL_SOCKET;
     socket_pollfd.reqevents = APR_POLLIN;
@@ -861,6 +874,272 @@ static void pollcb_wakeup(abts_case *tc, void *data)
     ABTS_INT_EQUAL(tc, APR_EINTR, rv);
 }
 
+static const apr_pollset_method_e rearm_methods[] = {
+    APR_POLLSET_DEFAULT,
+    APR_POLLSET_SELECT,
+    APR_POLLSET_KQUEUE,
+    APR_POLLSET_PORT,
+    APR_POLLSET_EPOLL,
+    APR_POLLSET_POLL,
+    APR_POLLSET_URING};
+
+static void pollset_oneshot(abts_case *tc, void *data)
+{
+    apr_socket_t *sock[1];
+    apr_sockaddr_t *sas[1];
+    apr_pollset_t *ps;
+    apr_pollfd_t pfd;
+    apr_pool_t *subp;
+    apr_status_t rv;
+    const apr_pollfd_t *descs = NULL;
+    apr_int32_t num;
+    int i;
+
+    for (i = 0; i < sizeof rearm_methods / sizeof rearm_methods[0]; i++) {
+        apr_pool_create(&subp, p);
+        rv = apr_pollset_create_ex(&ps, 4, subp, APR_POLLSET_NODEFAULT,
+                                   rearm_methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            apr_pool_destroy(subp);
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        make_socket(&sock[0], &sas[0], 7830, subp, tc);
+
+        /* never ending POLLOUT, signalled once per rearm */
+        pfd.p = subp;
+        pfd.desc_type = APR_POLL_SOCKET;
+        pfd.reqevents = APR_POLLOUT | APR_POLLSET_ONESHOT;
+        pfd.rtnevents = 0;
+        pfd.desc.s = sock[0];
+        pfd.client_data = sock;
+        rv = apr_pollset_add(ps, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        rv = apr_pollset_poll(ps, apr_time_from_msec(100), &num, &descs);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+        ABTS_PTR_EQUAL(tc, sock, descs[0].client_data);
+        ABTS_ASSERT(tc, "POLLOUT not signalled",
+                    descs[0].rtnevents & APR_POLLOUT);
+
+        rv = apr_pollset_poll(ps, 0, &num, &descs);
+        ABTS_ASSERT(tc, apr_pollset_method_name(ps),
+                    APR_STATUS_IS_TIMEUP(rv));
+        ABTS_INT_EQUAL(tc, 0, num);
+
+        rv = apr_pollset_rearm(ps, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollset_poll(ps, apr_time_from_msec(100), &num, &descs);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+
+        /* rearmed without the flag, back to level-triggered */
+        pfd.reqevents = APR_POLLOUT;
+        rv = apr_pollset_rearm(ps, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rv = apr_pollset_poll(ps, apr_time_from_msec(100), &num, &descs);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+        rv = apr_pollset_poll(ps, apr_time_from_msec(100), &num, &descs);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+
+        rv = apr_pollset_remove(ps, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        apr_pollset_destroy(ps);
+        apr_pool_destroy(subp);
+    }
+}
+
+static void pollset_edge(abts_case *tc, void *data)
+{
+    apr_socket_t *sock[1];
+    apr_sockaddr_t *sas[1];
+    apr_pollset_t *ps;
+    apr_pollfd_t pfd;
+    apr_pool_t *subp;
+    apr_status_t rv;
+    const apr_pollfd_t *descs = NULL;
+    apr_int32_t num;
+    const char *name;
+    int i;
+
+    for (i = 0; i < sizeof rearm_methods / sizeof rearm_methods[0]; i++) {
+        apr_pool_create(&subp, p);
+        rv = apr_pollset_create_ex(&ps, 4, subp, APR_POLLSET_NODEFAULT,
+                                   rearm_methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            apr_pool_destroy(subp);
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        name = apr_pollset_method_name(ps);
+        make_socket(&sock[0], &sas[0], 7831, subp, tc);
+
+        pfd.p = subp;
+        pfd.desc_type = APR_POLL_SOCKET;
+        pfd.reqevents = APR_POLLIN | APR_POLLSET_EDGE;
+        pfd.rtnevents = 0;
+        pfd.desc.s = sock[0];
+        pfd.client_data = NULL;
+        rv = apr_pollset_add(ps, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        rv = apr_pollset_poll(ps, 0, &num, &descs);
+        ABTS_ASSERT(tc, name, APR_STATUS_IS_TIMEUP(rv));
+
+        send_msg(sock, sas, 0, tc);
+        rv = apr_pollset_poll(ps, apr_time_from_msec(100), &num, &descs);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+        ABTS_ASSERT(tc, "POLLIN not signalled",
+                    descs[0].rtnevents & APR_POLLIN);
+
+        /* Still readable, but nothing new (level-triggered otherwise) */
+        rv = apr_pollset_poll(ps, 0, &num, &descs);
+        if (!strcmp(name, "epoll") || !strcmp(name, "uring")) {
+            ABTS_ASSERT(tc, name, APR_STATUS_IS_TIMEUP(rv));
+        }
+
+        send_msg(sock, sas, 0, tc);
+        rv = apr_pollset_poll(ps, apr_time_from_msec(100), &num, &descs);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        ABTS_INT_EQUAL(tc, 1, num);
+
+        recv_msg(sock, 0, subp, tc);
+        recv_msg(sock, 0, subp, tc);
+
+        rv = apr_pollset_remove(ps, &pfd);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        apr_pollset_destroy(ps);
+        apr_pool_destroy(subp);
+    }
+}
+
+static void setup_uring(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *ps;
+
+    rv = apr_pollset_create_ex(&ps, 1, p, APR_POLLSET_NODEFAULT,
+                               APR_POLLSET_URING);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "io_uring not supported");
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_STR_EQUAL(tc, "uring", apr_pollset_method_name(ps));
+    apr_pollset_destroy(ps);
+
+    /* run the following pollset tests with io_uring */
+    default_pollset_impl = APR_POLLSET_URING;
+}
+
+static void reset_default_impl(abts_case *tc, void *data)
+{
+    default_pollset_impl = APR_POLLSET_DEFAULT;
+}
+
+static void uring_recv_send(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_pollset_t *ps;
+    apr_pollset_io_t rio, sio;
+    const apr_pollfd_t *descs;
+    char buf[16];
+    apr_int32_t num;
+
+    rv = apr_pollset_create_ex(&ps, 2, p, APR_POLLSET_NODEFAULT,
+                               APR_POLLSET_URING);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "io_uring not supported");
+
+        rv = apr_pollset_create(&ps, 2, p, 0);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        rio.sock = s[4];
+        rio.buf = buf;
+        rio.len = sizeof(buf);
+        rv = apr_pollset_recv(ps, &rio);
+        ABTS_INT_EQUAL(tc, APR_ENOTIMPL, rv);
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    /* the receive completes with the datagram, no socket read needed */
+    memset(buf, 0, sizeof(buf));
+    rio.sock = s[4];
+    rio.buf = buf;
+    rio.len = sizeof(buf);
+    rio.client_data = s[4];
+    rv = apr_pollset_recv(ps, &rio);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_pollset_poll(ps, 0, &num, &descs);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+
+    send_msg(s, sa, 4, tc);
+
+    rv = apr_pollset_poll(ps, -1, &num, &descs);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_INT_EQUAL(tc, APR_POLLIN | APR_POLLIO, descs[0].rtnevents);
+    ABTS_PTR_EQUAL(tc, s[4], descs[0].desc.s);
+    ABTS_PTR_EQUAL(tc, &rio, descs[0].client_data);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rio.status);
+    ABTS_SIZE_EQUAL(tc, 5, rio.len);
+    ABTS_STR_EQUAL(tc, "hello", buf);
+
+    /* and the send through a connected datagram socket */
+    rv = apr_socket_connect(s[5], sa[6]);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    sio.sock = s[5];
+    sio.buf = "world";
+    sio.len = 5;
+    sio.client_data = s[5];
+    rv = apr_pollset_send(ps, &sio);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_pollset_poll(ps, -1, &num, &descs);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_INT_EQUAL(tc, APR_POLLOUT | APR_POLLIO, descs[0].rtnevents);
+    ABTS_PTR_EQUAL(tc, &sio, descs[0].client_data);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, sio.status);
+    ABTS_SIZE_EQUAL(tc, 5, sio.len);
+
+    rio.sock = s[6];
+    rio.len = sizeof(buf);
+    memset(buf, 0, sizeof(buf));
+    rv = apr_pollset_recv(ps, &rio);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_pollset_poll(ps, -1, &num, &descs);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    ABTS_INT_EQUAL(tc, 1, num);
+    ABTS_SIZE_EQUAL(tc, 5, rio.len);
+    ABTS_STR_EQUAL(tc, "world", buf);
+
+    rv = apr_pollset_destroy(ps);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void setup_pollcb_uring(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+
+    rv = apr_pollcb_create_ex(&pollcb, LARGE_NUM_SOCKETS, p,
+                              APR_POLLSET_NODEFAULT, APR_POLLSET_URING);
+    if (rv == APR_ENOTIMPL) {
+        pollcb = NULL;
+        ABTS_NOT_IMPL(tc, "io_uring not supported");
+    }
+    else {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+}
+
 #define JUSTSLEEP_DELAY apr_time_from_msec(200)
 #if HAVE_EPOLL_WAIT_RELIABLE_TIMEOUT
 #define JUSTSLEEP_ENOUGH(ts, te) \
@@ -885,7 +1164,8 @@ static void justsleep(abts_case *tc, void *data)
         APR_POLLSET_KQUEUE,
         APR_POLLSET_PORT,
         APR_POLLSET_EPOLL,
-        APR_POLLSET_POLL};
+        APR_POLLSET_POLL,
+        APR_POLLSET_URING};
 
     nsds = 1;
     t1 = apr_time_now();
@@ -933,6 +1213,106 @@ static void justsleep(abts_case *tc, void *data)
     }
 }
 
+/* A sub-millisecond timeout must not be cut short (nor rounded down) */
+#define SHORTSLEEP_DELAY 1500
+/* Well below the 500us rounding up to whole milliseconds would add */
+#define SHORTSLEEP_SLACK 400
+
+/* Whether the method waits for timeouts to the microsecond */
+static int precise_timeouts(apr_pollset_method_e method)
+{
+#if defined(__linux__)
+    if (method == APR_POLLSET_URING) {
+        return 1;
+    }
+#if defined(__NR_epoll_pwait2)
+    if (method == APR_POLLSET_EPOLL) {
+        /* fails with EBADF where the kernel (and seccomp) let it run */
+        errno = 0;
+        syscall(__NR_epoll_pwait2, -1, NULL, 1, NULL, NULL, 0);
+        return errno != ENOSYS && errno != EPERM;
+    }
+#endif
+#endif
+    return 0;
+}
+
+static void shortsleep(abts_case *tc, void *data)
+{
+    apr_int32_t nsds;
+    const apr_pollfd_t *hot_files;
+    apr_pollset_t *pollset;
+    apr_pollcb_t *pollcb;
+    apr_status_t rv;
+    apr_time_t t1, t2, shortest;
+    int i, j;
+    apr_pollset_method_e methods[] = {
+        APR_POLLSET_DEFAULT,
+        APR_POLLSET_SELECT,
+        APR_POLLSET_KQUEUE,
+        APR_POLLSET_PORT,
+        APR_POLLSET_EPOLL,
+        APR_POLLSET_POLL,
+        APR_POLLSET_URING};
+
+    for (i = 0; i < sizeof methods / sizeof methods[0]; i++) {
+        rv = apr_pollset_create_ex(&pollset, 5, p, APR_POLLSET_NODEFAULT,
+                                   methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        for (j = 0, shortest = -1; j < 5; j++) {
+            t1 = apr_time_now();
+            rv = apr_pollset_poll(pollset, SHORTSLEEP_DELAY, &nsds,
+                                  &hot_files);
+            t2 = apr_time_now();
+            ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+            if (HAVE_EPOLL_WAIT_RELIABLE_TIMEOUT) {
+                ABTS_ASSERT(tc, apr_pollset_method_name(pollset),
+                            t2 - t1 >= SHORTSLEEP_DELAY);
+            }
+            if (shortest < 0 || t2 - t1 < shortest) {
+                shortest = t2 - t1;
+            }
+        }
+        /* not rounded up to whole milliseconds */
+        if (precise_timeouts(methods[i])) {
+            ABTS_ASSERT(tc, apr_pollset_method_name(pollset),
+                        shortest < SHORTSLEEP_DELAY + SHORTSLEEP_SLACK);
+        }
+
+        rv = apr_pollset_destroy(pollset);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        rv = apr_pollcb_create_ex(&pollcb, 5, p, APR_POLLSET_NODEFAULT,
+                                  methods[i]);
+        if (rv == APR_ENOTIMPL) {
+            continue;
+        }
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+        for (j = 0, shortest = -1; j < 5; j++) {
+            t1 = apr_time_now();
+            rv = apr_pollcb_poll(pollcb, SHORTSLEEP_DELAY, NULL, NULL);
+            t2 = apr_time_now();
+            ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_TIMEUP(rv));
+            if (HAVE_EPOLL_WAIT_RELIABLE_TIMEOUT) {
+                ABTS_ASSERT(tc, "apr_pollcb_poll() didn't sleep",
+                            t2 - t1 >= SHORTSLEEP_DELAY);
+            }
+            if (shortest < 0 || t2 - t1 < shortest) {
+                shortest = t2 - t1;
+            }
+        }
+        if (precise_timeouts(methods[i])) {
+            ABTS_ASSERT(tc, "apr_pollcb_poll() rounded the timeout up",
+                        shortest < SHORTSLEEP_DELAY + SHORTSLEEP_SLACK);
+        }
+    }
+}
+
 abts_suite *testpoll(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -972,9 +1352,33 @@ abts_suite *testpoll(abts_suite *suite)
     abts_run_test(suite, pollset_wakeup, NULL);
     abts_run_test(suite, pollcb_wakeup, NULL);
     abts_run_test(suite, close_all_sockets, NULL);
+    abts_run_test(suite, create_all_sockets, NULL);
+    abts_run_test(suite, setup_uring, NULL);
+    abts_run_test(suite, setup_pollset, NULL);
+    abts_run_test(suite, multi_event_pollset, NULL);
+    abts_run_test(suite, add_sockets_pollset, NULL);
+    abts_run_test(suite, nomessage_pollset, NULL);
+    abts_run_test(suite, send0_pollset, NULL);
+    abts_run_test(suite, recv0_pollset, NULL);
+    abts_run_test(suite, send_middle_pollset, NULL);
+    abts_run_test(suite, clear_middle_pollset, NULL);
+    abts_run_test(suite, send_last_pollset, NULL);
+    abts_run_test(suite, clear_last_pollset, NULL);
+    abts_run_test(suite, pollset_remove, NULL);
+    abts_run_test(suite, setup_pollcb_uring, NULL);
+    abts_run_test(suite, trigger_pollcb, NULL);
+    abts_run_test(suite, timeout_pollcb, NULL);
+    abts_run_test(suite, timeout_pollin_pollcb, NULL);
+    abts_run_test(suite, pollset_wakeup, NULL);
+    abts_run_test(suite, reset_default_impl, NULL);
+    abts_run_test(suite, uring_recv_send, NULL);
+    abts_run_test(suite, close_all_sockets, NULL);
+    abts_run_test(suite, pollset_oneshot, NULL);
+    abts_run_test(suite, pollset_edge, NULL);
     abts_run_test(suite, pollset_default, NULL);
     abts_run_test(suite, pollcb_default, NULL);
     abts_run_test(suite, justsleep, NULL);
+    abts_run_test(suite, shortsleep, NULL);
 
     return suite;
 }
@@ -17,6 +17,7 @@
 
 #include "apr_general.h"
 #include "apr_pools.h"
+#include "apr_allocator.h"
 #include "apr_errno.h"
 #include "apr_file_io.h"
 #include <string.h>
@@ -139,6 +140,253 @@ static void test_cleanups(abts_case *tc, void *data)
     }
 }
 
+#if APR_HAS_THREADS
+static void test_magazines(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_allocator_stats_t astats;
+    apr_memnode_t *node[8], *again;
+    apr_status_t rv;
+    apr_size_t held;
+    int i;
+
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+    rv = apr_allocator_magazine_set(allocator, 4);
+    APR_ASSERT_SUCCESS(tc, "enable magazines", rv);
+
+    /* More nodes than the magazine holds, so that it has to rebalance */
+    for (i = 0; i < 8; i++) {
+        node[i] = apr_allocator_alloc(allocator, 1000);
+        ABTS_PTR_NOTNULL(tc, node[i]);
+        memset(node[i]->first_avail, i, 1000);
+    }
+    for (i = 0; i < 8; i++) {
+        apr_allocator_free(allocator, node[i]);
+    }
+
+    /* The most recently freed node is recycled first */
+    again = apr_allocator_alloc(allocator, 1000);
+    ABTS_PTR_EQUAL(tc, node[7], again);
+    ABTS_PTR_EQUAL(tc, NULL, again->next);
+    apr_allocator_free(allocator, again);
+
+    /* Lowering the threshold drains the magazines */
+    apr_allocator_max_free_set(allocator, 8192);
+    for (i = 0; i < 8; i++) {
+        node[i] = apr_allocator_alloc(allocator, 1000);
+        ABTS_PTR_NOTNULL(tc, node[i]);
+    }
+    for (i = 0; i < 8; i++) {
+        apr_allocator_free(allocator, node[i]);
+    }
+    /* 8192 bytes is room for a single minimal node, the rest is evicted */
+    apr_allocator_stats_get(allocator, &astats);
+    held = astats.magazine_nodes;
+    for (i = 0; i < APR_ALLOCATOR_STATS_NINDEX; i++) {
+        held += astats.free_nodes[i];
+    }
+    ABTS_TRUE(tc, held <= 1);
+    ABTS_TRUE(tc, astats.evicted_nodes >= 7);
+
+    rv = apr_allocator_magazine_set(allocator, 0);
+    APR_ASSERT_SUCCESS(tc, "disable magazines", rv);
+    apr_allocator_destroy(allocator);
+}
+#endif
+
+static void test_stats(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_allocator_stats_t astats;
+    apr_pool_t *root, *a1, *a2, *b;
+    apr_pool_stats_t stats[4];
+    apr_size_t nelts, i, held;
+    apr_status_t rv;
+
+    rv = apr_allocator_create(&allocator);
+    APR_ASSERT_SUCCESS(tc, "create allocator", rv);
+    rv = apr_pool_create_unmanaged_ex(&root, NULL, allocator);
+    APR_ASSERT_SUCCESS(tc, "create root pool", rv);
+    apr_allocator_owner_set(allocator, root);
+    apr_pool_create(&a1, root);
+    apr_pool_create(&a2, root);
+    apr_pool_create(&b, a2);
+    apr_pool_tag(a1, "stats-a");
+    apr_pool_tag(a2, "stats-a");
+    apr_pool_tag(b, "stats-b");
+
+    apr_palloc(a1, 100);
+    apr_palloc(a1, 20000);
+    apr_pool_stats_get(a1, &stats[0]);
+    ABTS_STR_EQUAL(tc, "stats-a", stats[0].tag);
+    ABTS_INT_EQUAL(tc, 1, stats[0].pools);
+    ABTS_TRUE(tc, stats[0].bytes_allocated >= 20100);
+    ABTS_TRUE(tc, stats[0].bytes_held >= stats[0].bytes_allocated);
+    ABTS_TRUE(tc, stats[0].peak_size >= stats[0].bytes_held);
+    ABTS_INT_EQUAL(tc, 0, stats[0].clears);
+#if !APR_POOL_DEBUG
+    ABTS_INT_EQUAL(tc, 2, stats[0].nodes_acquired);
+#endif
+    held = stats[0].bytes_held;
+
+    apr_pool_clear(a1);
+    apr_pool_stats_get(a1, &stats[0]);
+    ABTS_INT_EQUAL(tc, 0, stats[0].bytes_allocated);
+    ABTS_INT_EQUAL(tc, 1, stats[0].clears);
+    ABTS_TRUE(tc, stats[0].peak_size >= held);
+#if !APR_POOL_DEBUG
+    ABTS_TRUE(tc, stats[0].bytes_held < held);
+
+    /* The big node went back to the allocator */
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_TRUE(tc, astats.free_bytes >= 20000);
+    for (nelts = 0, i = 0; i < APR_ALLOCATOR_STATS_NINDEX; i++) {
+        nelts += astats.free_nodes[i];
+    }
+    ABTS_TRUE(tc, nelts >= 1);
+    ABTS_TRUE(tc, astats.malloc_nodes + astats.mmap_nodes >= 5);
+    ABTS_INT_EQUAL(tc, 0, astats.evicted_nodes);
+#endif
+
+    nelts = 4;
+    rv = apr_pool_stats_walk(root, stats, &nelts);
+    APR_ASSERT_SUCCESS(tc, "walk pools", rv);
+    ABTS_INT_EQUAL(tc, 3, nelts);
+    for (i = 0; i < nelts; i++) {
+        if (!stats[i].tag) {
+            ABTS_INT_EQUAL(tc, 1, stats[i].pools);
+        }
+        else if (!strcmp(stats[i].tag, "stats-a")) {
+            ABTS_INT_EQUAL(tc, 2, stats[i].pools);
+            ABTS_INT_EQUAL(tc, 1, stats[i].clears);
+        }
+        else {
+            ABTS_STR_EQUAL(tc, "stats-b", stats[i].tag);
+            ABTS_INT_EQUAL(tc, 1, stats[i].pools);
+        }
+    }
+
+    nelts = 1;
+    rv = apr_pool_stats_walk(root, stats, &nelts);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+    ABTS_INT_EQUAL(tc, 1, nelts);
+    ABTS_PTR_EQUAL(tc, NULL, stats[0].tag);
+
+#if !APR_POOL_DEBUG
+    /* Nodes beyond max_free are given back to the system */
+    apr_allocator_max_free_set(allocator, 1);
+    apr_palloc(b, 50000);
+    apr_pool_destroy(b);
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_TRUE(tc, astats.evicted_nodes >= 1);
+#endif
+
+    apr_pool_destroy(root);
+}
+
+static void test_arenas(abts_case *tc, void *data)
+{
+    apr_allocator_t *allocator;
+    apr_allocator_attr_t attr;
+    apr_allocator_stats_t astats;
+    apr_allocator_arena_stats_t arenas[8];
+    apr_memnode_t *node[64], *again;
+    apr_size_t nelts, nodes;
+    apr_status_t rv;
+    int i;
+
+    memset(&attr, 0, sizeof attr);
+    attr.flags = APR_ALLOCATOR_ARENAS;
+    attr.arena_size = 256 * 1024;
+    rv = apr_allocator_create_ex(&allocator, &attr);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "allocator arenas");
+        return;
+    }
+    APR_ASSERT_SUCCESS(tc, "create allocator with arenas", rv);
+
+    /* 64 nodes of 8K don't fit in one arena */
+    for (i = 0; i < 64; i++) {
+        node[i] = apr_allocator_alloc(allocator, 4000);
+        ABTS_PTR_NOTNULL(tc, node[i]);
+        memset(node[i]->first_avail, i, node[i]->endp - node[i]->first_avail);
+    }
+    for (i = 1; i < 64; i++) {
+        ABTS_TRUE(tc, node[i]->first_avail[0] == i);
+    }
+
+    nelts = 8;
+    rv = apr_allocator_arena_stats_get(allocator, arenas, &nelts);
+    APR_ASSERT_SUCCESS(tc, "arena stats", rv);
+    ABTS_TRUE(tc, nelts >= 2);
+    for (nodes = 0, i = 0; i < (int)nelts; i++) {
+        ABTS_TRUE(tc, arenas[i].used <= arenas[i].size);
+        nodes += arenas[i].nodes;
+    }
+    ABTS_INT_EQUAL(tc, 64, nodes);
+
+    nelts = 1;
+    rv = apr_allocator_arena_stats_get(allocator, arenas, &nelts);
+    ABTS_INT_EQUAL(tc, APR_INCOMPLETE, rv);
+    ABTS_INT_EQUAL(tc, 1, nelts);
+
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_INT_EQUAL(tc, 64, astats.arena_nodes);
+    ABTS_INT_EQUAL(tc, 0, astats.malloc_nodes + astats.mmap_nodes);
+
+    /* Bigger nodes than the arenas' are standalone */
+    again = apr_allocator_alloc(allocator, 1024 * 1024);
+    ABTS_PTR_NOTNULL(tc, again);
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_INT_EQUAL(tc, 1, astats.malloc_nodes + astats.mmap_nodes);
+    apr_allocator_free(allocator, again);
+
+    /* Evicted nodes are kept as spares and reused */
+    apr_allocator_max_free_set(allocator, 1);
+    for (i = 0; i < 64; i++) {
+        node[i]->next = NULL;
+        apr_allocator_free(allocator, node[i]);
+    }
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_TRUE(tc, astats.evicted_nodes >= 63);
+    again = apr_allocator_alloc(allocator, 4000);
+    ABTS_PTR_NOTNULL(tc, again);
+    apr_allocator_stats_get(allocator, &astats);
+    ABTS_INT_EQUAL(tc, 64, astats.arena_nodes);
+    apr_allocator_free(allocator, again);
+
+    apr_allocator_destroy(allocator);
+
+    /* Huge pages are best effort */
+    attr.flags = APR_ALLOCATOR_HUGE_PAGES;
+    attr.arena_size = 0;
+    rv = apr_allocator_create_ex(&allocator, &attr);
+    APR_ASSERT_SUCCESS(tc, "create allocator with huge pages", rv);
+    nelts = 1;
+    apr_allocator_arena_stats_get(allocator, arenas, &nelts);
+    ABTS_INT_EQUAL(tc, 1, nelts);
+    ABTS_INT_EQUAL(tc, 0, (apr_uintptr_t)arenas[0].base % (2 * 1024 * 1024));
+    again = apr_allocator_alloc(allocator, 100000);
+    ABTS_PTR_NOTNULL(tc, again);
+    apr_allocator_free(allocator, again);
+    apr_allocator_destroy(allocator);
+
+    /* Binding may not be allowed here, but a bad node is refused */
+    attr.flags = APR_ALLOCATOR_NUMA_BIND;
+    attr.numa_node = -1;
+    rv = apr_allocator_create_ex(&allocator, &attr);
+    ABTS_TRUE(tc, rv == APR_EINVAL || rv == APR_ENOTIMPL);
+    attr.numa_node = 0;
+    rv = apr_allocator_create_ex(&allocator, &attr);
+    if (rv == APR_SUCCESS) {
+        again = apr_allocator_alloc(allocator, 4000);
+        ABTS_PTR_NOTNULL(tc, again);
+        apr_allocator_free(allocator, again);
+        apr_allocator_destroy(allocator);
+    }
+}
+
 abts_suite *testpool(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -150,6 +398,11 @@ abts_suite *testpool(abts_suite *suite)
     abts_run_test(suite, alloc_bytes, NULL);
     abts_run_test(suite, calloc_bytes, NULL);
     abts_run_test(suite, test_cleanups, NULL);
+#if APR_HAS_THREADS
+    abts_run_test(suite, test_magazines, NULL);
+#endif
+    abts_run_test(suite, test_stats, NULL);
+    abts_run_test(suite, test_arenas, NULL);
 
     return suite;
 }
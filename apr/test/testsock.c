@@ -577,6 +577,172 @@ static void test_freebind(abts_case *tc, void *data)
 #endif
 }
 
+#define ZC_SENDS 3
+#define ZC_SIZE (64 * 1024)
+
+static void test_zerocopy(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *ld, *sd, *cd;
+    apr_sockaddr_t *sa;
+    apr_pool_t *subp;
+    apr_pollfd_t pfd;
+    apr_uint32_t id, first, last, done = 0;
+    apr_size_t len, total = 0;
+    apr_time_t deadline;
+    char *buf, *rbuf;
+    int i, copied, n;
+
+    APR_ASSERT_SUCCESS(tc, "create subpool", apr_pool_create(&subp, p));
+
+    ld = setup_socket(tc);
+    if (!ld) return;
+
+    APR_ASSERT_SUCCESS(tc, "get local address of bound socket",
+                       apr_socket_addr_get(&sa, APR_LOCAL, ld));
+    rv = apr_socket_create(&cd, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, subp);
+    APR_ASSERT_SUCCESS(tc, "create client socket", rv);
+    APR_ASSERT_SUCCESS(tc, "connect to listener",
+                       apr_socket_connect(cd, sa));
+    APR_ASSERT_SUCCESS(tc, "accept connection",
+                       apr_socket_accept(&sd, ld, subp));
+    apr_socket_close(ld);
+
+    buf = apr_palloc(subp, ZC_SIZE);
+    rbuf = apr_palloc(subp, ZC_SIZE);
+    memset(buf, 'z', ZC_SIZE);
+
+    len = ZC_SIZE;
+    rv = apr_socket_send_zc(cd, buf, &len, &id);
+    if (rv == APR_ENOTIMPL) {
+        ABTS_NOT_IMPL(tc, "zero-copy sends");
+        apr_pool_destroy(subp);
+        return;
+    }
+    ABTS_INT_EQUAL(tc, APR_EINVAL, rv);
+
+    rv = apr_socket_opt_set(cd, APR_SO_ZEROCOPY, 1);
+    if (rv != APR_SUCCESS) {
+        /* kernel older than 4.14 */
+        ABTS_NOT_IMPL(tc, "APR_SO_ZEROCOPY");
+        apr_pool_destroy(subp);
+        return;
+    }
+
+    for (i = 0; i < ZC_SENDS; i++) {
+        len = ZC_SIZE;
+        rv = apr_socket_send_zc(cd, buf, &len, &id);
+        APR_ASSERT_SUCCESS(tc, "zero-copy send", rv);
+        ABTS_INT_EQUAL(tc, i, id);
+        total += len;
+    }
+    while (total) {
+        len = ZC_SIZE;
+        rv = apr_socket_recv(sd, rbuf, &len);
+        APR_ASSERT_SUCCESS(tc, "receive", rv);
+        if (rv != APR_SUCCESS)
+            break;
+        ABTS_INT_EQUAL(tc, 'z', rbuf[len - 1]);
+        total -= len;
+    }
+
+    /* The completions come through the error queue, signalled by POLLERR */
+    pfd.p = subp;
+    pfd.desc_type = APR_POLL_SOCKET;
+    pfd.reqevents = APR_POLLIN;
+    pfd.desc.s = cd;
+    pfd.client_data = NULL;
+    deadline = apr_time_now() + apr_time_from_sec(5);
+    while (done < ZC_SENDS && apr_time_now() < deadline) {
+        rv = apr_socket_zc_reap(cd, &first, &last, &copied);
+        if (APR_STATUS_IS_EAGAIN(rv)) {
+            rv = apr_poll(&pfd, 1, &n, apr_time_from_msec(100));
+            if (rv == APR_SUCCESS) {
+                ABTS_ASSERT(tc, "POLLERR not signalled",
+                            pfd.rtnevents & APR_POLLERR);
+            }
+            continue;
+        }
+        APR_ASSERT_SUCCESS(tc, "reap zero-copy completion", rv);
+        if (rv != APR_SUCCESS)
+            break;
+        ABTS_INT_EQUAL(tc, done, first);
+        ABTS_ASSERT(tc, "completion out of range", last < ZC_SENDS);
+        done = last + 1;
+    }
+    ABTS_INT_EQUAL(tc, ZC_SENDS, done);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(apr_socket_zc_reap(cd, &first,
+                                                                  &last,
+                                                                  NULL)));
+
+    apr_pool_destroy(subp);
+}
+
+static void test_recvv(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *ld, *sd, *cd;
+    apr_sockaddr_t *sa;
+    apr_pool_t *subp;
+    apr_interval_time_t timeout;
+    struct iovec vec[3];
+    char buf[16];
+    apr_size_t len, total;
+    int i, n;
+
+    APR_ASSERT_SUCCESS(tc, "create subpool", apr_pool_create(&subp, p));
+
+    ld = setup_socket(tc);
+    if (!ld) return;
+
+    APR_ASSERT_SUCCESS(tc, "get local address of bound socket",
+                       apr_socket_addr_get(&sa, APR_LOCAL, ld));
+    rv = apr_socket_create(&cd, sa->family, SOCK_STREAM,
+                           APR_PROTO_TCP, subp);
+    APR_ASSERT_SUCCESS(tc, "create client socket", rv);
+    APR_ASSERT_SUCCESS(tc, "connect to listener",
+                       apr_socket_connect(cd, sa));
+    APR_ASSERT_SUCCESS(tc, "accept connection",
+                       apr_socket_accept(&sd, ld, subp));
+    apr_socket_close(ld);
+
+    /* Nothing to read, yet the blocking socket stays so */
+    apr_socket_timeout_set(sd, -1);
+    vec[0].iov_base = buf;
+    vec[0].iov_len = 5;
+    rv = apr_socket_recvv(sd, vec, 1, APR_RECV_NONBLOCK, &len);
+    ABTS_INT_EQUAL(tc, 1, APR_STATUS_IS_EAGAIN(rv));
+    ABTS_SIZE_EQUAL(tc, 0, len);
+    apr_socket_timeout_get(sd, &timeout);
+    ABTS_INT_EQUAL(tc, 1, timeout < 0);
+
+    len = strlen("hello, world");
+    APR_ASSERT_SUCCESS(tc, "send", apr_socket_send(cd, "hello, world", &len));
+
+    /* The buffers are filled in order */
+    memset(buf, 0, sizeof(buf));
+    for (total = 0; total < 12; total += len) {
+        for (i = 0, n = 0; i < 3; i++) {
+            apr_size_t from = (total > i * 5) ? total : i * 5;
+
+            if (from < (i + 1) * 5) {
+                vec[n].iov_base = buf + from;
+                vec[n].iov_len = (i + 1) * 5 - from;
+                n++;
+            }
+        }
+        rv = apr_socket_recvv(sd, vec, n, 0, &len);
+        APR_ASSERT_SUCCESS(tc, "receive into several buffers", rv);
+        if (rv != APR_SUCCESS)
+            break;
+    }
+    ABTS_SIZE_EQUAL(tc, 12, total);
+    ABTS_STR_EQUAL(tc, "hello, world", buf);
+
+    apr_pool_destroy(subp);
+}
+
 #define TEST_ZONE_ADDR "fe80::1"
 
 #ifdef __linux__
@@ -687,6 +853,8 @@ abts_suite *testsock(abts_suite *suite)
     abts_run_test(suite, test_get_addr, NULL);
     abts_run_test(suite, test_nonblock_inheritance, NULL);
     abts_run_test(suite, test_freebind, NULL);
+    abts_run_test(suite, test_zerocopy, NULL);
+    abts_run_test(suite, test_recvv, NULL);
     abts_run_test(suite, test_zone, NULL);
 
 #if APR_HAVE_SOCKADDR_UN
@@ -18,6 +18,7 @@
 #include "apr_errno.h"
 #include "apr_general.h"
 #include "apr_lib.h"
+#include "apr_strings.h"
 #include "testutil.h"
 
 #define STRLEN 21
@@ -190,6 +191,145 @@ static void sendto_receivefrom6(abts_case *tc, void *data)
 }
 #endif
 
+static void mmsg_sockets(abts_case *tc, apr_socket_t **sock,
+                         apr_socket_t **sock2, apr_sockaddr_t **to)
+{
+    apr_status_t rv;
+    apr_sockaddr_t *from;
+
+    rv = apr_socket_create(sock, APR_INET, SOCK_DGRAM, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_socket_create(sock2, APR_INET, SOCK_DGRAM, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_sockaddr_info_get(to, "127.0.0.1", APR_INET, 7774, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_sockaddr_info_get(&from, "127.0.0.1", APR_INET, 7773, 0, p);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+
+    rv = apr_socket_opt_set(*sock, APR_SO_REUSEADDR, 1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_socket_opt_set(*sock2, APR_SO_REUSEADDR, 1);
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    rv = apr_socket_bind(*sock, *to);
+    APR_ASSERT_SUCCESS(tc, "Could not bind socket", rv);
+    rv = apr_socket_bind(*sock2, from);
+    APR_ASSERT_SUCCESS(tc, "Could not bind second socket", rv);
+
+    rv = apr_socket_timeout_set(*sock, apr_time_from_sec(5));
+    ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+}
+
+static void sendmmsg_recvmmsg(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *sock, *sock2;
+    apr_sockaddr_t *to;
+    apr_socket_msg_t msgs[4];
+    char bufs[4][16];
+    apr_size_t n, total;
+    int i;
+
+    mmsg_sockets(tc, &sock, &sock2, &to);
+
+    for (i = 0; i < 4; i++) {
+        msgs[i].addr = to;
+        msgs[i].buf = apr_psprintf(p, "datagram %d", i);
+        msgs[i].len = strlen(msgs[i].buf);
+        msgs[i].segment_size = 0;
+    }
+    for (total = 0; total < 4; total += n) {
+        rv = apr_socket_sendmmsg(sock2, msgs + total, 4 - total, 0, &n);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (rv != APR_SUCCESS)
+            return;
+        ABTS_ASSERT(tc, "nothing sent", n > 0);
+    }
+    ABTS_SIZE_EQUAL(tc, strlen("datagram 3"), msgs[3].len);
+
+    for (i = 0; i < 4; i++) {
+        apr_sockaddr_info_get(&msgs[i].addr, "127.1.2.3", APR_INET, 4242, 0, p);
+        msgs[i].buf = bufs[i];
+        msgs[i].len = sizeof(bufs[i]);
+    }
+    for (total = 0; total < 4; total += n) {
+        rv = apr_socket_recvmmsg(sock, msgs + total, 4 - total, 0, &n);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (rv != APR_SUCCESS)
+            return;
+        ABTS_ASSERT(tc, "nothing received", n > 0);
+    }
+    for (i = 0; i < 4; i++) {
+        char *ip_addr;
+
+        ABTS_SIZE_EQUAL(tc, strlen("datagram 0"), msgs[i].len);
+        ABTS_INT_EQUAL(tc, '0' + i, msgs[i].buf[msgs[i].len - 1]);
+        ABTS_INT_EQUAL(tc, 0, msgs[i].segment_size);
+        apr_sockaddr_ip_get(&ip_addr, msgs[i].addr);
+        ABTS_STR_EQUAL(tc, "127.0.0.1", ip_addr);
+        ABTS_INT_EQUAL(tc, 7773, msgs[i].addr->port);
+    }
+
+    apr_socket_close(sock);
+    apr_socket_close(sock2);
+}
+
+static void sendmmsg_segments(abts_case *tc, void *data)
+{
+    apr_status_t rv;
+    apr_socket_t *sock, *sock2;
+    apr_sockaddr_t *to;
+    apr_socket_msg_t msgs[1];
+    char *buf = apr_pcalloc(p, 3 * 1000);
+    apr_size_t n, total, i;
+
+    mmsg_sockets(tc, &sock, &sock2, &to);
+    rv = apr_socket_opt_set(sock, APR_UDP_GRO, 1);
+    if (rv != APR_SUCCESS && rv != APR_ENOTIMPL) {
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+    }
+
+    /* Three datagrams of 1000 bytes at once */
+    for (i = 0; i < 3 * 1000; i++) {
+        buf[i] = (char)(i / 1000);
+    }
+    msgs[0].addr = to;
+    msgs[0].buf = buf;
+    msgs[0].len = 3 * 1000;
+    msgs[0].segment_size = 1000;
+    rv = apr_socket_sendmmsg(sock2, msgs, 1, 0, &n);
+    if (rv != APR_SUCCESS) {
+        /* no UDP segmentation offload */
+        ABTS_NOT_IMPL(tc, "UDP segmentation offload");
+        apr_socket_close(sock);
+        apr_socket_close(sock2);
+        return;
+    }
+    ABTS_SIZE_EQUAL(tc, 1, n);
+    ABTS_SIZE_EQUAL(tc, 3 * 1000, msgs[0].len);
+
+    /* Coalesced again by GRO, or not, so one message at a time */
+    msgs[0].addr = NULL;
+    msgs[0].buf = apr_pcalloc(p, 3 * 1000);
+    msgs[0].len = 3 * 1000;
+    for (total = 0; total < 3 * 1000; total += msgs[0].len) {
+        rv = apr_socket_recvmmsg(sock, msgs, 1, 0, &n);
+        ABTS_INT_EQUAL(tc, APR_SUCCESS, rv);
+        if (rv != APR_SUCCESS)
+            break;
+        ABTS_ASSERT(tc, "datagrams not resegmented",
+                    msgs[0].segment_size == 0 ? msgs[0].len == 1000
+                                              : msgs[0].segment_size == 1000);
+        ABTS_INT_EQUAL(tc, total / 1000, msgs[0].buf[0]);
+        ABTS_INT_EQUAL(tc, (total + msgs[0].len - 1) / 1000,
+                       msgs[0].buf[msgs[0].len - 1]);
+        msgs[0].len = 3 * 1000;
+    }
+
+    apr_socket_close(sock);
+    apr_socket_close(sock2);
+}
+
 static void socket_userdata(abts_case *tc, void *data)
 {
     apr_socket_t *sock1, *sock2;
@@ -223,6 +363,8 @@ abts_suite *testsockets(abts_suite *suite)
     abts_run_test(suite, udp_socket, NULL);
 
     abts_run_test(suite, sendto_receivefrom, NULL);
+    abts_run_test(suite, sendmmsg_recvmmsg, NULL);
+    abts_run_test(suite, sendmmsg_segments, NULL);
 
 #if APR_HAVE_IPV6
     abts_run_test(suite, tcp6_socket, NULL);
@@ -222,6 +222,132 @@ static void table_overlap3(abts_case *tc, void *data)
 
 }
 
+static int table_do_collect(void *rec, const char *key, const char *val)
+{
+    apr_array_header_t *vals = rec;
+
+    APR_ARRAY_PUSH(vals, const char *) = val;
+    return 1;
+}
+
+/* Big enough tables to use the hash index */
+#define BIG_NELTS 1000
+
+static void table_big(abts_case *tc, void *data)
+{
+    apr_table_t *t = apr_table_make(p, 1), *t2;
+    apr_array_header_t *vals;
+    char key[32];
+    int i;
+
+    for (i = 0; i < BIG_NELTS; i++) {
+        apr_snprintf(key, sizeof key, "X-Key-%d", i);
+        apr_table_add(t, key, apr_itoa(p, i));
+        if (i % 10 == 0) {
+            apr_table_add(t, key, "dup");
+        }
+    }
+    ABTS_INT_EQUAL(tc, BIG_NELTS + BIG_NELTS / 10, apr_table_elts(t)->nelts);
+
+    for (i = 0; i < BIG_NELTS; i++) {
+        apr_snprintf(key, sizeof key, "x-kEY-%d", i);
+        ABTS_STR_EQUAL(tc, apr_itoa(p, i), apr_table_get(t, key));
+    }
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Key-"));
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Key-1000"));
+
+    /* duplicates are kept, in order */
+    vals = apr_array_make(p, 2, sizeof(const char *));
+    apr_table_do(table_do_collect, vals, t, "X-KEY-20", "x-key-21", NULL);
+    ABTS_INT_EQUAL(tc, 3, vals->nelts);
+    ABTS_STR_EQUAL(tc, "20", APR_ARRAY_IDX(vals, 0, const char *));
+    ABTS_STR_EQUAL(tc, "dup", APR_ARRAY_IDX(vals, 1, const char *));
+    ABTS_STR_EQUAL(tc, "21", APR_ARRAY_IDX(vals, 2, const char *));
+    ABTS_STR_EQUAL(tc, "30,dup", apr_table_getm(p, t, "X-Key-30"));
+
+    /* set and unset drop all the duplicates */
+    apr_table_set(t, "X-Key-40", "forty");
+    ABTS_STR_EQUAL(tc, "forty", apr_table_get(t, "X-Key-40"));
+    ABTS_STR_EQUAL(tc, "forty", apr_table_getm(p, t, "X-Key-40"));
+    apr_table_unset(t, "x-key-50");
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Key-50"));
+    ABTS_INT_EQUAL(tc, BIG_NELTS + BIG_NELTS / 10 - 3,
+                   apr_table_elts(t)->nelts);
+    ABTS_STR_EQUAL(tc, "51", apr_table_get(t, "X-Key-51"));
+    ABTS_STR_EQUAL(tc, "999", apr_table_get(t, "X-Key-999"));
+
+    apr_table_merge(t, "X-Key-60", "more");
+    ABTS_STR_EQUAL(tc, "60, more", apr_table_get(t, "X-Key-60"));
+    apr_table_setn(t, "X-New", "new");
+    ABTS_STR_EQUAL(tc, "new", apr_table_get(t, "x-new"));
+
+    t2 = apr_table_copy(p, t);
+    apr_table_addn(t2, "X-Copy", "copy");
+    ABTS_STR_EQUAL(tc, "copy", apr_table_get(t2, "X-Copy"));
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "X-Copy"));
+    ABTS_STR_EQUAL(tc, "123", apr_table_get(t2, "X-Key-123"));
+
+    apr_table_overlap(t2, t, APR_OVERLAP_TABLES_ADD);
+    vals->nelts = 0;
+    apr_table_do(table_do_collect, vals, t2, "X-Key-7", NULL);
+    ABTS_INT_EQUAL(tc, 2, vals->nelts);
+    apr_table_overlap(t2, t, APR_OVERLAP_TABLES_SET);
+    ABTS_STR_EQUAL(tc, "dup", apr_table_get(t2, "X-Key-10"));
+    ABTS_STR_EQUAL(tc, "copy", apr_table_get(t2, "X-Copy"));
+
+    /* shrinking back to a small table */
+    for (i = 0; i < BIG_NELTS - 2; i++) {
+        apr_snprintf(key, sizeof key, "X-Key-%d", i);
+        apr_table_unset(t, key);
+    }
+    ABTS_INT_EQUAL(tc, 3, apr_table_elts(t)->nelts);
+    ABTS_STR_EQUAL(tc, "998", apr_table_get(t, "X-Key-998"));
+    ABTS_STR_EQUAL(tc, "new", apr_table_get(t, "X-New"));
+
+    apr_table_clear(t2);
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t2, "X-Key-1"));
+    apr_table_set(t2, "X-Key-1", "one");
+    ABTS_STR_EQUAL(tc, "one", apr_table_get(t2, "X-Key-1"));
+}
+
+/*
+ * Lookups in tables of 10 to 10,000 entries sharing a common prefix, see
+ * testtableperf for their cost.
+ */
+static void table_sizes_nelts(abts_case *tc, int nelts)
+{
+    apr_pool_t *subp;
+    apr_table_t *t;
+    const char **keys;
+    int i;
+
+    apr_pool_create(&subp, p);
+    t = apr_table_make(subp, 10);
+    keys = apr_palloc(subp, nelts * sizeof(const char *));
+    for (i = 0; i < nelts; i++) {
+        keys[i] = apr_psprintf(subp, "Header-%d", i);
+        apr_table_addn(t, keys[i], keys[i] + 7);
+    }
+
+    for (i = 0; i < nelts; i++) {
+        if (apr_table_get(t, keys[i]) != keys[i] + 7) {
+            break;
+        }
+    }
+    ABTS_INT_EQUAL(tc, nelts, i);
+    ABTS_PTR_EQUAL(tc, NULL, apr_table_get(t, "Header-"));
+
+    apr_pool_destroy(subp);
+}
+
+static void table_sizes(abts_case *tc, void *data)
+{
+    table_sizes_nelts(tc, 10);
+    table_sizes_nelts(tc, 100);
+    table_sizes_nelts(tc, 1000);
+    table_sizes_nelts(tc, 10000);
+}
+
 abts_suite *testtable(abts_suite *suite)
 {
     suite = ADD_SUITE(suite)
@@ -239,6 +365,8 @@ abts_suite *testtable(abts_suite *suite)
     abts_run_test(suite, table_overlap, NULL);
     abts_run_test(suite, table_overlap2, NULL);
     abts_run_test(suite, table_overlap3, NULL);
+    abts_run_test(suite, table_big, NULL);
+    abts_run_test(suite, table_sizes, NULL);
 
     return suite;
 }
@@ -0,0 +1,149 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "apr_tables.h"
+#include "apr_pools.h"
+#include "apr_errno.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_strings.h"
+#include "apr_time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Lookup benchmark for tables of 10 to 10,000 entries sharing a common
+ * prefix, with apr_table_get() (which uses the hash index of the big
+ * tables) against a plain scan of the entries.
+ */
+
+#define DEFAULT_MAX_COUNTER 1000000
+#define MIN_NELTS 10
+#define MAX_NELTS 10000
+
+static long max_counter = DEFAULT_MAX_COUNTER;
+
+static volatile int sink;
+
+/* Nanoseconds per apr_table_get() of each key in turn */
+static double time_get(apr_table_t *t, const char **keys, int nelts,
+                       long rounds)
+{
+    apr_time_t start = apr_time_now();
+    int found = 0;
+    long round;
+    int i;
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < nelts; i++) {
+            found += apr_table_get(t, keys[i]) != NULL;
+        }
+    }
+    sink = found;
+
+    return (double)(apr_time_now() - start) * 1000.0
+           / ((double)rounds * nelts);
+}
+
+/* Nanoseconds per lookup of each key in turn, scanning the entries */
+static double time_scan(apr_table_t *t, const char **keys, int nelts,
+                        long rounds)
+{
+    const apr_table_entry_t *elts;
+    apr_time_t start = apr_time_now();
+    int found = 0;
+    long round;
+    int i, j;
+
+    elts = (const apr_table_entry_t *)apr_table_elts(t)->elts;
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < nelts; i++) {
+            for (j = 0; j < nelts; j++) {
+                if (!strcasecmp(elts[j].key, keys[i])) {
+                    found++;
+                    break;
+                }
+            }
+        }
+    }
+    sink = found;
+
+    return (double)(apr_time_now() - start) * 1000.0
+           / ((double)rounds * nelts);
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_pool_t *pool, *subpool;
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+    apr_table_t *t;
+    const char **keys;
+    long rounds;
+    int nelts, i;
+
+    printf("APR Table Performance Test\n==============\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "c:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'c') {
+            max_counter = atol(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    printf("About %ld lookups per table size, nanoseconds per lookup\n\n",
+           max_counter);
+    printf("%8s %12s %12s\n", "entries", "get", "scan");
+
+    for (nelts = MIN_NELTS; nelts <= MAX_NELTS; nelts *= 10) {
+        apr_pool_create(&subpool, pool);
+        t = apr_table_make(subpool, 10);
+        keys = apr_palloc(subpool, nelts * sizeof(const char *));
+        for (i = 0; i < nelts; i++) {
+            keys[i] = apr_psprintf(subpool, "Header-%d", i);
+            apr_table_addn(t, keys[i], keys[i] + 7);
+        }
+
+        rounds = max_counter / nelts + 1;
+        printf("%8d %12.1f", nelts, time_get(t, keys, nelts, rounds));
+        /* the scan is quadratic, keep it to about the same time */
+        rounds = max_counter / ((long)nelts * nelts) + 1;
+        printf(" %12.1f\n", time_scan(t, keys, nelts, rounds));
+
+        apr_pool_destroy(subpool);
+    }
+
+    return 0;
+}
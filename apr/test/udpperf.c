@@ -0,0 +1,274 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* udpperf.c
+ * This program measures the datagrams per second going through the
+ * loopback interface between two UDP sockets, in bursts sent and then
+ * received with:
+ *   - apr_socket_sendto() and apr_socket_recvfrom(), one by one,
+ *   - apr_socket_sendmmsg() and apr_socket_recvmmsg(), all at once,
+ *   - the latter with UDP segmentation offload and APR_UDP_GRO, where
+ *     supported.
+ *
+ * To run,
+ *
+ *   ./udpperf [-n datagrams] [-s size] [-b burst]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>  /* for atexit() */
+
+#include "apr.h"
+#include "apr_network_io.h"
+#include "apr_general.h"
+#include "apr_getopt.h"
+#include "apr_strings.h"
+#include "apr_time.h"
+
+#define DEFAULT_DATAGRAMS 200000
+#define DEFAULT_SIZE      512
+#define DEFAULT_BURST     32
+#define MAX_BURST         64
+
+static apr_pool_t *pool;
+static long num_datagrams = DEFAULT_DATAGRAMS;
+static apr_size_t size = DEFAULT_SIZE;
+static int burst = DEFAULT_BURST;
+
+static apr_socket_t *receiver, *sender;
+static apr_sockaddr_t *to;
+static char *sendbuf, *recvbuf;
+
+typedef apr_status_t (*burst_func_t)(int *received);
+
+static apr_status_t burst_single(int *received)
+{
+    apr_sockaddr_t *from;
+    apr_status_t rv;
+    apr_size_t len;
+    int i;
+
+    apr_sockaddr_info_get(&from, "127.0.0.1", APR_INET, 0, 0, pool);
+    for (i = 0; i < burst; i++) {
+        len = size;
+        rv = apr_socket_sendto(sender, to, 0, sendbuf + i * size, &len);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    for (*received = 0; *received < burst; ++*received) {
+        len = size;
+        rv = apr_socket_recvfrom(from, receiver, 0, recvbuf, &len);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t burst_mmsg(int *received)
+{
+    apr_socket_msg_t msgs[MAX_BURST];
+    apr_status_t rv;
+    apr_size_t n;
+    int i, sent;
+
+    for (sent = 0; sent < burst; sent += n) {
+        for (i = 0; i < burst - sent; i++) {
+            msgs[i].addr = to;
+            msgs[i].buf = sendbuf + (sent + i) * size;
+            msgs[i].len = size;
+            msgs[i].segment_size = 0;
+        }
+        rv = apr_socket_sendmmsg(sender, msgs, burst - sent, 0, &n);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    for (*received = 0; *received < burst; *received += n) {
+        for (i = 0; i < burst - *received; i++) {
+            msgs[i].addr = NULL;
+            msgs[i].buf = recvbuf + i * size;
+            msgs[i].len = size;
+        }
+        rv = apr_socket_recvmmsg(receiver, msgs, burst - *received, 0, &n);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+    }
+    return APR_SUCCESS;
+}
+
+static apr_status_t burst_gso(int *received)
+{
+    apr_socket_msg_t msgs[MAX_BURST];
+    apr_status_t rv;
+    apr_size_t n, i;
+
+    msgs[0].addr = to;
+    msgs[0].buf = sendbuf;
+    msgs[0].len = burst * size;
+    msgs[0].segment_size = (apr_uint16_t)size;
+    rv = apr_socket_sendmmsg(sender, msgs, 1, 0, &n);
+    if (rv != APR_SUCCESS) {
+        return rv;
+    }
+    for (*received = 0; *received < burst; ) {
+        for (i = 0; i < MAX_BURST; i++) {
+            msgs[i].addr = NULL;
+            msgs[i].buf = recvbuf + i * size;
+            msgs[i].len = size;
+        }
+        /* the whole burst at once if coalesced */
+        msgs[0].len = burst * size;
+        rv = apr_socket_recvmmsg(receiver, msgs, 1, 0, &n);
+        if (rv != APR_SUCCESS) {
+            return rv;
+        }
+        *received += msgs[0].segment_size
+                     ? (int)((msgs[0].len + size - 1) / size) : 1;
+    }
+    return APR_SUCCESS;
+}
+
+static void run(const char *name, burst_func_t func)
+{
+    apr_time_t start, elapsed;
+    apr_status_t rv = APR_SUCCESS;
+    long done, lost = 0;
+    char errmsg[200];
+
+    start = apr_time_now();
+    for (done = 0; done < num_datagrams; done += burst) {
+        int received = 0;
+
+        rv = func(&received);
+        if (APR_STATUS_IS_TIMEUP(rv)) {
+            lost += burst - received;
+            rv = APR_SUCCESS;
+        }
+        else if (rv != APR_SUCCESS) {
+            break;
+        }
+    }
+    elapsed = apr_time_now() - start;
+
+    if (rv != APR_SUCCESS) {
+        printf("%-10s %s\n", name, apr_strerror(rv, errmsg, sizeof errmsg));
+        return;
+    }
+    printf("%-10s %12.0f %10ld\n", name,
+           elapsed ? (double)done * APR_USEC_PER_SEC / elapsed : 0.0, lost);
+}
+
+static apr_status_t setup(void)
+{
+    apr_sockaddr_t *from;
+    apr_status_t rv;
+
+    if ((rv = apr_sockaddr_info_get(&to, "127.0.0.1", APR_INET, 7790, 0,
+                                    pool)) != APR_SUCCESS
+        || (rv = apr_sockaddr_info_get(&from, "127.0.0.1", APR_INET, 7791,
+                                       0, pool)) != APR_SUCCESS
+        || (rv = apr_socket_create(&receiver, APR_INET, SOCK_DGRAM, 0,
+                                   pool)) != APR_SUCCESS
+        || (rv = apr_socket_create(&sender, APR_INET, SOCK_DGRAM, 0,
+                                   pool)) != APR_SUCCESS
+        || (rv = apr_socket_opt_set(receiver, APR_SO_REUSEADDR,
+                                    1)) != APR_SUCCESS
+        || (rv = apr_socket_opt_set(sender, APR_SO_REUSEADDR,
+                                    1)) != APR_SUCCESS
+        || (rv = apr_socket_bind(receiver, to)) != APR_SUCCESS
+        || (rv = apr_socket_bind(sender, from)) != APR_SUCCESS
+        /* don't wait forever for a dropped datagram */
+        || (rv = apr_socket_timeout_set(receiver,
+                                        apr_time_from_sec(1))) != APR_SUCCESS) {
+        return rv;
+    }
+    apr_socket_opt_set(receiver, APR_SO_RCVBUF, 4 * 1024 * 1024);
+    apr_socket_opt_set(sender, APR_SO_SNDBUF, 4 * 1024 * 1024);
+
+    sendbuf = apr_pcalloc(pool, MAX_BURST * size);
+    recvbuf = apr_pcalloc(pool, MAX_BURST * size);
+    return APR_SUCCESS;
+}
+
+int main(int argc, const char * const *argv)
+{
+    apr_status_t rv;
+    char errmsg[200];
+    apr_getopt_t *opt;
+    char optchar;
+    const char *optarg;
+
+    printf("APR UDP Performance Test\n========================\n\n");
+
+    apr_initialize();
+    atexit(apr_terminate);
+
+    if (apr_pool_create(&pool, NULL) != APR_SUCCESS)
+        exit(-1);
+
+    if ((rv = apr_getopt_init(&opt, pool, argc, argv)) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up to parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+
+    while ((rv = apr_getopt(opt, "n:s:b:", &optchar, &optarg)) == APR_SUCCESS) {
+        if (optchar == 'n') {
+            num_datagrams = atol(optarg);
+        }
+        else if (optchar == 's') {
+            size = (apr_size_t)atol(optarg);
+        }
+        else if (optchar == 'b') {
+            burst = atoi(optarg);
+        }
+    }
+
+    if (rv != APR_SUCCESS && rv != APR_EOF) {
+        fprintf(stderr, "Could not parse options: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-1);
+    }
+    if (burst < 1 || burst > MAX_BURST || size < 1 || size > 8192) {
+        fprintf(stderr, "The burst must be 1 to %d datagrams, "
+                "of 1 to 8192 bytes\n", MAX_BURST);
+        exit(-1);
+    }
+
+    if ((rv = setup()) != APR_SUCCESS) {
+        fprintf(stderr, "Could not set up the sockets: [%d] %s\n",
+                rv, apr_strerror(rv, errmsg, sizeof errmsg));
+        exit(-2);
+    }
+
+    printf("%ld datagrams of %" APR_SIZE_T_FMT " bytes, "
+           "in bursts of %d\n\n", num_datagrams, size, burst);
+    printf("%-10s %12s %10s\n", "method", "datagrams/s", "lost");
+
+    run("sendto", burst_single);
+    run("mmsg", burst_mmsg);
+    if (apr_socket_opt_set(receiver, APR_UDP_GRO, 1) == APR_SUCCESS) {
+        run("gso+gro", burst_gso);
+    }
+    else {
+        printf("%-10s %s\n", "gso+gro", "not supported");
+    }
+
+    return 0;
+}